@@ -25,22 +25,218 @@
  *                                                                        *
  **************************************************************************/
 
+/* SDL has no file mapping of its own, so use POSIX mmap where it is
+   available, and plain reads elsewhere.  Likewise, its clock only
+   counts milliseconds, so use the POSIX monotonic clock where there
+   is one. */
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#define DM_BASE_SDL_MMAP
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef DM_BASE_SDL_MMAP
+#include <time.h>
+#include <unistd.h>
+
+#if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 \
+  && defined(CLOCK_MONOTONIC)
+#define DM_BASE_SDL_CLOCK
+#endif
+#endif /* DM_BASE_SDL_MMAP */
+
+#ifdef DM_BASE_SDL_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif /* DM_BASE_SDL_MMAP */
+
 #include "SDL/SDL.h"
 
 #include "../dismal.h"
 #include "dm-base-sdl.h"
 
+static SDL_mutex *dm_base_sdl_video;
+
 int dm_base_sdl_init(dm_Config *conf)
 {
   if (SDL_Init(0) == 0) {
-    return DM_SUCCESS;
-  } else {
-    dm_fatal("BASE-SDL: Could not initialise SDL.");
-    return DM_FAILURE;
+    dm_base_sdl_video = SDL_CreateMutex();
+
+    if (dm_base_sdl_video)
+      return DM_SUCCESS;
   }
+
+  dm_fatal("BASE-SDL: Could not initialise SDL.");
+  return DM_FAILURE;
 }
 
 void dm_base_sdl_cleanup(void)
 {
+  if (dm_base_sdl_video) {
+    SDL_DestroyMutex(dm_base_sdl_video);
+    dm_base_sdl_video = NULL;
+  }
+
   SDL_Quit();
 }
+
+void dm_base_sdl_video_lock(void)
+{
+  if (dm_base_sdl_video)
+    SDL_LockMutex(dm_base_sdl_video);
+}
+
+void dm_base_sdl_video_unlock(void)
+{
+  if (dm_base_sdl_video)
+    SDL_UnlockMutex(dm_base_sdl_video);
+}
+
+/* The opaque base threading types are SDL's own, cast. */
+
+dm_Thread *dm_base_sdl_thread_create(int (*fn)(void *arg), void *arg)
+{
+  return (dm_Thread*) SDL_CreateThread(fn, arg);
+}
+
+int dm_base_sdl_thread_wait(dm_Thread *thread)
+{
+  int status;
+
+  SDL_WaitThread((SDL_Thread*) thread, &status);
+  return status;
+}
+
+dm_Mutex *dm_base_sdl_mutex_create(void)
+{
+  return (dm_Mutex*) SDL_CreateMutex();
+}
+
+void dm_base_sdl_mutex_destroy(dm_Mutex *mutex)
+{
+  SDL_DestroyMutex((SDL_mutex*) mutex);
+}
+
+void dm_base_sdl_mutex_lock(dm_Mutex *mutex)
+{
+  SDL_mutexP((SDL_mutex*) mutex);
+}
+
+void dm_base_sdl_mutex_unlock(dm_Mutex *mutex)
+{
+  SDL_mutexV((SDL_mutex*) mutex);
+}
+
+dm_Cond *dm_base_sdl_cond_create(void)
+{
+  return (dm_Cond*) SDL_CreateCond();
+}
+
+void dm_base_sdl_cond_destroy(dm_Cond *cond)
+{
+  SDL_DestroyCond((SDL_cond*) cond);
+}
+
+void dm_base_sdl_cond_wait(dm_Cond *cond, dm_Mutex *mutex)
+{
+  SDL_CondWait((SDL_cond*) cond, (SDL_mutex*) mutex);
+}
+
+void dm_base_sdl_cond_signal(dm_Cond *cond)
+{
+  SDL_CondSignal((SDL_cond*) cond);
+}
+
+void dm_base_sdl_cond_broadcast(dm_Cond *cond)
+{
+  SDL_CondBroadcast((SDL_cond*) cond);
+}
+
+#ifdef DM_BASE_SDL_MMAP
+
+void *dm_base_sdl_map_file(const char filename[], unsigned long *size)
+{
+  struct stat st;
+  void *map;
+  int fd;
+
+  fd = open(filename, O_RDONLY);
+
+  if (fd < 0)
+    return NULL;
+
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  /* The mapping keeps the file alive on its own. */
+  close(fd);
+
+  if (map == MAP_FAILED)
+    return NULL;
+
+  *size = (unsigned long) st.st_size;
+  return map;
+}
+
+void dm_base_sdl_unmap_file(void *map, unsigned long size)
+{
+  munmap(map, size);
+}
+
+#else /* !DM_BASE_SDL_MMAP */
+
+void *dm_base_sdl_map_file(const char filename[], unsigned long *size)
+{
+  FILE *file;
+  long len;
+  void *map;
+
+  file = fopen(filename, "rb");
+
+  if (file == NULL)
+    return NULL;
+
+  map = NULL;
+
+  if (fseek(file, 0, SEEK_END) == 0 && (len = ftell(file)) > 0
+      && fseek(file, 0, SEEK_SET) == 0) {
+    map = malloc(len);
+
+    if (map && fread(map, 1, len, file) != (size_t) len) {
+      free(map);
+      map = NULL;
+    }
+
+    *size = (unsigned long) len;
+  }
+
+  fclose(file);
+  return map;
+}
+
+void dm_base_sdl_unmap_file(void *map, unsigned long size)
+{
+  free(map);
+}
+
+#endif /* DM_BASE_SDL_MMAP */
+
+unsigned long dm_base_sdl_time_us(void)
+{
+#ifdef DM_BASE_SDL_CLOCK
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return (unsigned long) ts.tv_sec * 1000000UL
+      + (unsigned long) ts.tv_nsec / 1000UL;
+#endif /* DM_BASE_SDL_CLOCK */
+
+  return (unsigned long) SDL_GetTicks() * 1000UL;
+}
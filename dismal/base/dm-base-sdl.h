@@ -44,4 +44,49 @@ int dm_base_sdl_init(struct dm_Config *conf);
 /** De-initialise the SDL base. */
 void dm_base_sdl_cleanup();
 
+
+/* SDL implementations of the base threading primitives.
+
+   @see dm_thread_create and friends in dm-base.h */
+
+dm_Thread *dm_base_sdl_thread_create(int (*fn)(void *arg), void *arg);
+int dm_base_sdl_thread_wait(dm_Thread *thread);
+dm_Mutex *dm_base_sdl_mutex_create(void);
+void dm_base_sdl_mutex_destroy(dm_Mutex *mutex);
+void dm_base_sdl_mutex_lock(dm_Mutex *mutex);
+void dm_base_sdl_mutex_unlock(dm_Mutex *mutex);
+dm_Cond *dm_base_sdl_cond_create(void);
+void dm_base_sdl_cond_destroy(dm_Cond *cond);
+void dm_base_sdl_cond_wait(dm_Cond *cond, dm_Mutex *mutex);
+void dm_base_sdl_cond_signal(dm_Cond *cond);
+void dm_base_sdl_cond_broadcast(dm_Cond *cond);
+
+
+/* SDL base implementations of file mapping.
+
+   @see dm_map_file and dm_unmap_file in dm-base.h */
+
+void *dm_base_sdl_map_file(const char filename[], unsigned long *size);
+void dm_base_sdl_unmap_file(void *map, unsigned long size);
+
+
+/** Lock SDL's video backend.
+ *
+ *  SDL's video functions are not thread-safe, so a render thread
+ *  presenting frames (see DM_GFX_PIPELINED) and the main thread
+ *  polling for input hold this around their calls into it.
+ */
+void dm_base_sdl_video_lock(void);
+
+
+/** Unlock SDL's video backend. */
+void dm_base_sdl_video_unlock(void);
+
+
+/* SDL base implementation of the microsecond clock.
+
+   @see dm_time_us in dm-base.h */
+
+unsigned long dm_base_sdl_time_us(void);
+
 #endif /* __DM_BASE_SDL_H__ */
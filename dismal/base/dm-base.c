@@ -112,3 +112,105 @@ int dm_get_base_id(void)
 #endif /* DM_BASE_AMIGA68K */
 #endif /* DM_BASE_SDL */
 }
+
+/* Threading primitives.  Each simply forwards to the compiled base. */
+
+#ifdef DM_BASE_SDL
+
+dm_Thread *dm_thread_create(int (*fn)(void *arg), void *arg)
+{
+  return dm_base_sdl_thread_create(fn, arg);
+}
+
+int dm_thread_wait(dm_Thread *thread)
+{
+  return dm_base_sdl_thread_wait(thread);
+}
+
+dm_Mutex *dm_mutex_create(void)
+{
+  return dm_base_sdl_mutex_create();
+}
+
+void dm_mutex_destroy(dm_Mutex *mutex)
+{
+  dm_base_sdl_mutex_destroy(mutex);
+}
+
+void dm_mutex_lock(dm_Mutex *mutex)
+{
+  dm_base_sdl_mutex_lock(mutex);
+}
+
+void dm_mutex_unlock(dm_Mutex *mutex)
+{
+  dm_base_sdl_mutex_unlock(mutex);
+}
+
+dm_Cond *dm_cond_create(void)
+{
+  return dm_base_sdl_cond_create();
+}
+
+void dm_cond_destroy(dm_Cond *cond)
+{
+  dm_base_sdl_cond_destroy(cond);
+}
+
+void dm_cond_wait(dm_Cond *cond, dm_Mutex *mutex)
+{
+  dm_base_sdl_cond_wait(cond, mutex);
+}
+
+void dm_cond_signal(dm_Cond *cond)
+{
+  dm_base_sdl_cond_signal(cond);
+}
+
+void dm_cond_broadcast(dm_Cond *cond)
+{
+  dm_base_sdl_cond_broadcast(cond);
+}
+
+#else /* !DM_BASE_SDL */
+
+#error No threading support for the selected base!
+
+#endif /* DM_BASE_SDL */
+
+/* File mapping. */
+
+void *dm_map_file(const char filename[], unsigned long *size)
+{
+#ifdef DM_BASE_SDL
+  return dm_base_sdl_map_file(filename, size);
+#else /* !DM_BASE_SDL */
+
+#error No file mapping support for the selected base!
+
+#endif /* DM_BASE_SDL */
+}
+
+void dm_unmap_file(void *map, unsigned long size)
+{
+#ifdef DM_BASE_SDL
+  dm_base_sdl_unmap_file(map, size);
+#else /* !DM_BASE_SDL */
+
+#error No file mapping support for the selected base!
+
+#endif /* DM_BASE_SDL */
+}
+
+/* Timing. */
+
+unsigned long dm_time_us(void)
+{
+#ifdef DM_BASE_SDL
+  return dm_base_sdl_time_us();
+#else /* !DM_BASE_SDL */
+
+#error No clock for the selected base!
+
+#endif /* DM_BASE_SDL */
+}
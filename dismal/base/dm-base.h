@@ -50,6 +50,15 @@ enum {
   DM_DOS       /**< MS-DOS base ID */
 };
 
+/* Threading primitives.  These are opaque; each base defines them in
+   terms of its own threading library.  Bases without threads should
+   fail to create them, and callers must then fall back to doing the
+   work on the calling thread. */
+
+typedef struct dm_Thread dm_Thread; /**< A thread. */
+typedef struct dm_Mutex dm_Mutex;   /**< A mutual exclusion lock. */
+typedef struct dm_Cond dm_Cond;     /**< A condition variable. */
+
 /** Initialise the compiled base.
  *
  *  This will set the value in conf->base_loaded to the ID of the
@@ -77,4 +86,127 @@ void dm_base_cleanup(void);
  */
 int dm_get_base_id(void);
 
+
+/** Start a new thread.
+ *
+ *  @param fn   The function to run in the thread.
+ *  @param arg  The argument to pass to fn.
+ *
+ *  @return a pointer to the thread, or NULL if it could not be
+ *  started.
+ */
+dm_Thread *dm_thread_create(int (*fn)(void *arg), void *arg);
+
+
+/** Wait for a thread to finish, and free it.
+ *
+ *  @param thread  The thread to wait for.
+ *
+ *  @return the value returned by the thread's function.
+ */
+int dm_thread_wait(dm_Thread *thread);
+
+
+/** Create a mutex.
+ *
+ *  @return a pointer to the mutex, or NULL on failure.
+ */
+dm_Mutex *dm_mutex_create(void);
+
+
+/** Destroy a mutex.
+ *
+ *  @param mutex  The mutex to destroy.  It must not be locked.
+ */
+void dm_mutex_destroy(dm_Mutex *mutex);
+
+
+/** Lock a mutex, waiting until it is available.
+ *
+ *  @param mutex  The mutex to lock.
+ */
+void dm_mutex_lock(dm_Mutex *mutex);
+
+
+/** Unlock a mutex.
+ *
+ *  @param mutex  The mutex to unlock.
+ */
+void dm_mutex_unlock(dm_Mutex *mutex);
+
+
+/** Create a condition variable.
+ *
+ *  @return a pointer to the condition variable, or NULL on failure.
+ */
+dm_Cond *dm_cond_create(void);
+
+
+/** Destroy a condition variable.
+ *
+ *  @param cond  The condition variable to destroy.
+ */
+void dm_cond_destroy(dm_Cond *cond);
+
+
+/** Wait on a condition variable.
+ *
+ *  The mutex must be locked by the caller; it is unlocked while
+ *  waiting and locked again before returning.  As wakeups may be
+ *  spurious, always wait in a loop that checks the condition.
+ *
+ *  @param cond   The condition variable to wait on.
+ *  @param mutex  The mutex protecting the condition.
+ */
+void dm_cond_wait(dm_Cond *cond, dm_Mutex *mutex);
+
+
+/** Wake one thread waiting on a condition variable.
+ *
+ *  @param cond  The condition variable to signal.
+ */
+void dm_cond_signal(dm_Cond *cond);
+
+
+/** Wake every thread waiting on a condition variable.
+ *
+ *  @param cond  The condition variable to broadcast.
+ */
+void dm_cond_broadcast(dm_Cond *cond);
+
+
+/** Map a file into memory, read-only.
+ *
+ *  Where the platform supports it, the file is memory-mapped, so that
+ *  its pages are only read in as they are touched; otherwise it is
+ *  read into an allocated buffer.  Either way, the mapping must be
+ *  released with dm_unmap_file().
+ *
+ *  @param filename  The name of the file to map.
+ *  @param size      Pointer to store the size of the file, in bytes.
+ *
+ *  @return a pointer to the file's contents, or NULL on failure.
+ */
+void *dm_map_file(const char filename[], unsigned long *size);
+
+
+/** Release a file mapped with dm_map_file().
+ *
+ *  @param map   The pointer returned by dm_map_file().
+ *  @param size  The size returned by dm_map_file().
+ */
+void dm_unmap_file(void *map, unsigned long size);
+
+
+/** Read a clock that counts microseconds, for timing.
+ *
+ *  The clock starts at an arbitrary point and wraps around, so only
+ *  the difference between two readings means anything.  Where the
+ *  platform has no finer clock, it only advances a millisecond at a
+ *  time.
+ *
+ *  @return the clock's reading.
+ */
+unsigned long dm_time_us(void);
+
 #endif /* __DM_BASE_H__ */
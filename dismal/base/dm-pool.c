@@ -0,0 +1,287 @@
+/** @file     base/dm-pool.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Generic worker thread pool, built on the base threading
+ *            primitives.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#include <stdlib.h>
+
+#include "../dismal.h"
+#include "dm-pool.h"
+
+static int dm_pool_worker(void *arg);
+static dm_PoolJob *dm_pool_take(dm_Pool *pool, dm_PoolGroup *group);
+static void dm_pool_finish(dm_Pool *pool, dm_PoolJob *job);
+
+dm_Pool *dm_pool_create(int threads)
+{
+  dm_Pool *pool;
+  int i;
+
+  if (threads <= 0)
+    return NULL;
+
+  pool = malloc(sizeof(dm_Pool));
+
+  if (pool == NULL) {
+    dm_fatal("POOL: Could not allocate worker pool.");
+    return NULL;
+  }
+
+  pool->head = pool->tail = pool->spare = NULL;
+  pool->quit = DM_FALSE;
+  pool->thread_count = 0;
+  pool->lock = dm_mutex_create();
+  pool->work = dm_cond_create();
+  pool->done = dm_cond_create();
+  pool->threads = malloc(sizeof(dm_Thread*) * threads);
+
+  if (pool->lock == NULL || pool->work == NULL || pool->done == NULL
+      || pool->threads == NULL) {
+    dm_fatal("POOL: Could not create worker pool.");
+    dm_pool_destroy(pool);
+    return NULL;
+  }
+
+  for (i = 0; i < threads; i++) {
+    pool->threads[i] = dm_thread_create(dm_pool_worker, pool);
+
+    if (pool->threads[i] == NULL)
+      break;
+
+    pool->thread_count++;
+  }
+
+  /* A pool with fewer threads than asked for is still useful. */
+  if (pool->thread_count == 0) {
+    dm_fatal("POOL: Could not start any worker threads.");
+    dm_pool_destroy(pool);
+    return NULL;
+  }
+
+  dm_debug("POOL: Started %d worker threads.", pool->thread_count);
+
+  return pool;
+}
+
+void dm_pool_destroy(dm_Pool *pool)
+{
+  dm_PoolJob *job;
+  int i;
+
+  if (pool == NULL)
+    return;
+
+  if (pool->thread_count > 0) {
+    dm_mutex_lock(pool->lock);
+    pool->quit = DM_TRUE;
+    dm_cond_broadcast(pool->work);
+    dm_mutex_unlock(pool->lock);
+
+    for (i = 0; i < pool->thread_count; i++)
+      dm_thread_wait(pool->threads[i]);
+  }
+
+  while (pool->spare) {
+    job = pool->spare;
+    pool->spare = job->next;
+    free(job);
+  }
+
+  if (pool->threads)
+    free(pool->threads);
+  if (pool->done)
+    dm_cond_destroy(pool->done);
+  if (pool->work)
+    dm_cond_destroy(pool->work);
+  if (pool->lock)
+    dm_mutex_destroy(pool->lock);
+
+  free(pool);
+}
+
+void dm_pool_group_init(dm_PoolGroup *group)
+{
+  group->pending = 0;
+}
+
+void dm_pool_submit(dm_Pool *pool,
+                    dm_PoolGroup *group,
+                    void (*fn)(void *arg),
+                    void *arg)
+{
+  dm_PoolJob *job;
+
+  if (pool == NULL) {
+    fn(arg);
+    return;
+  }
+
+  dm_mutex_lock(pool->lock);
+
+  /* Reuse a finished job if possible. */
+  if (pool->spare) {
+    job = pool->spare;
+    pool->spare = job->next;
+  } else {
+    job = malloc(sizeof(dm_PoolJob));
+  }
+
+  if (job == NULL) {
+    dm_mutex_unlock(pool->lock);
+    fn(arg);
+    return;
+  }
+
+  job->fn = fn;
+  job->arg = arg;
+  job->group = group;
+  job->next = NULL;
+  group->pending++;
+
+  if (pool->tail)
+    pool->tail->next = job;
+  else
+    pool->head = job;
+  pool->tail = job;
+
+  dm_cond_signal(pool->work);
+  dm_mutex_unlock(pool->lock);
+}
+
+void dm_pool_wait(dm_Pool *pool, dm_PoolGroup *group)
+{
+  dm_PoolJob *job;
+
+  if (pool == NULL)
+    return;
+
+  dm_mutex_lock(pool->lock);
+
+  while (group->pending > 0) {
+    /* Rather than idle, run one of the group's own queued jobs. */
+    job = dm_pool_take(pool, group);
+
+    if (job) {
+      dm_mutex_unlock(pool->lock);
+      job->fn(job->arg);
+      dm_mutex_lock(pool->lock);
+      dm_pool_finish(pool, job);
+    } else {
+      dm_cond_wait(pool->done, pool->lock);
+    }
+  }
+
+  dm_mutex_unlock(pool->lock);
+}
+
+int dm_pool_finished(dm_Pool *pool, dm_PoolGroup *group)
+{
+  int finished;
+
+  if (pool == NULL)
+    return DM_TRUE;
+
+  dm_mutex_lock(pool->lock);
+  finished = (group->pending == 0);
+  dm_mutex_unlock(pool->lock);
+
+  return finished;
+}
+
+int dm_pool_size(dm_Pool *pool)
+{
+  if (pool == NULL)
+    return 0;
+
+  return pool->thread_count;
+}
+
+/* Worker thread main loop: run jobs until told to quit and the queue
+   is empty. */
+static int dm_pool_worker(void *arg)
+{
+  dm_Pool *pool;
+  dm_PoolJob *job;
+
+  pool = (dm_Pool*) arg;
+
+  dm_mutex_lock(pool->lock);
+
+  for (;;) {
+    while (pool->head == NULL && !pool->quit)
+      dm_cond_wait(pool->work, pool->lock);
+
+    job = dm_pool_take(pool, NULL);
+
+    if (job == NULL)
+      break; /* Quitting, and nothing is left to do. */
+
+    dm_mutex_unlock(pool->lock);
+    job->fn(job->arg);
+    dm_mutex_lock(pool->lock);
+    dm_pool_finish(pool, job);
+  }
+
+  dm_mutex_unlock(pool->lock);
+
+  return 0;
+}
+
+/* Remove and return the first queued job in the given group (or any
+   group, if group is NULL).  The pool must be locked. */
+static dm_PoolJob *dm_pool_take(dm_Pool *pool, dm_PoolGroup *group)
+{
+  dm_PoolJob *job, *prev;
+
+  prev = NULL;
+
+  for (job = pool->head; job != NULL; prev = job, job = job->next) {
+    if (group == NULL || job->group == group) {
+      if (prev)
+        prev->next = job->next;
+      else
+        pool->head = job->next;
+
+      if (pool->tail == job)
+        pool->tail = prev;
+
+      return job;
+    }
+  }
+
+  return NULL;
+}
+
+/* Account for a finished job and keep it for reuse.  The pool must be
+   locked. */
+static void dm_pool_finish(dm_Pool *pool, dm_PoolJob *job)
+{
+  if (--job->group->pending == 0)
+    dm_cond_broadcast(pool->done);
+
+  job->next = pool->spare;
+  pool->spare = job;
+}
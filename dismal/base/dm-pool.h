@@ -0,0 +1,141 @@
+/** @file     base/dm-pool.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for the generic worker thread pool.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_POOL_H__
+#define __DM_POOL_H__
+
+#include "../dismal.h"
+
+typedef struct dm_Pool dm_Pool;           /**< Worker pool type. */
+typedef struct dm_PoolJob dm_PoolJob;     /**< Worker pool job type. */
+typedef struct dm_PoolGroup dm_PoolGroup; /**< Job group type. */
+
+/** A group of jobs that can be waited on together.
+ *
+ *  Groups are owned by the caller, and may live on the stack as long
+ *  as they are waited on before going out of scope.
+ */
+struct dm_PoolGroup {
+  int pending; /**< Number of jobs in the group yet to finish. */
+};
+
+/** A queued job. */
+struct dm_PoolJob {
+  void (*fn)(void *arg);   /**< The job function. */
+  void *arg;               /**< The argument to the job function. */
+  dm_PoolGroup *group;     /**< The group the job belongs to. */
+  struct dm_PoolJob *next; /**< The next job in the queue. */
+};
+
+/** A pool of worker threads sharing one job queue. */
+struct dm_Pool {
+  dm_Mutex *lock;      /**< Lock protecting everything below. */
+  dm_Cond *work;       /**< Signalled when a job is queued. */
+  dm_Cond *done;       /**< Broadcast when a group finishes. */
+  dm_Thread **threads; /**< The worker threads. */
+  int thread_count;    /**< Number of worker threads. */
+  dm_PoolJob *head;    /**< First job in the queue. */
+  dm_PoolJob *tail;    /**< Last job in the queue. */
+  dm_PoolJob *spare;   /**< Finished jobs, kept for reuse. */
+  int quit;            /**< Set when the workers should exit. */
+};
+
+
+/** Create a worker pool.
+ *
+ *  @param threads  Number of worker threads to start.
+ *
+ *  @return a pointer to the pool, or NULL if threads is not positive
+ *  or the pool could not be created.  A NULL pool is still valid to
+ *  pass to the other pool functions, which then run every job on the
+ *  calling thread.
+ */
+dm_Pool *dm_pool_create(int threads);
+
+
+/** Destroy a worker pool.
+ *
+ *  Any jobs still queued are run before the workers exit.
+ *
+ *  @param pool  The pool to destroy.
+ */
+void dm_pool_destroy(dm_Pool *pool);
+
+
+/** Initialise a job group.
+ *
+ *  @param group  The group to initialise.
+ */
+void dm_pool_group_init(dm_PoolGroup *group);
+
+
+/** Queue a job on a worker pool.
+ *
+ *  If the pool is NULL, or the job cannot be queued, it is run
+ *  immediately on the calling thread instead.
+ *
+ *  @param pool   The pool to queue the job on.
+ *  @param group  The group to add the job to.
+ *  @param fn     The job function.
+ *  @param arg    The argument to pass to the job function.
+ */
+void dm_pool_submit(dm_Pool *pool,
+                    dm_PoolGroup *group,
+                    void (*fn)(void *arg),
+                    void *arg);
+
+
+/** Wait for every job in a group to finish.
+ *
+ *  While waiting, the calling thread runs any of the group's jobs
+ *  still in the queue itself.
+ *
+ *  @param pool   The pool the jobs were queued on.
+ *  @param group  The group to wait for.
+ */
+void dm_pool_wait(dm_Pool *pool, dm_PoolGroup *group);
+
+
+/** Check whether every job in a group has finished.
+ *
+ *  @param pool   The pool the jobs were queued on.
+ *  @param group  The group to check.
+ *
+ *  @return DM_TRUE if the group has finished, DM_FALSE otherwise.
+ */
+int dm_pool_finished(dm_Pool *pool, dm_PoolGroup *group);
+
+
+/** Retrieve the number of worker threads in a pool.
+ *
+ *  @param pool  The pool.
+ *
+ *  @return the number of worker threads, or 0 for a NULL pool.
+ */
+int dm_pool_size(dm_Pool *pool);
+
+#endif /* __DM_POOL_H__ */
@@ -34,6 +34,7 @@
 #include "gfx/dm-gfx.h"
 
 dm_Config *_conf = NULL;
+static dm_Pool *_pool = NULL;
 
 int
 dm_init (void)
@@ -47,6 +48,10 @@ dm_init (void)
     if (dm_base_init (_conf) == DM_FAILURE)
       return DM_FAILURE;
 
+    /* Failing to start workers is not fatal; their jobs will just run
+       on the calling thread. */
+    _pool = dm_pool_create (_conf->threads);
+
     if (DM_GFX)
       {
         if (dm_gfx_init (_conf) == DM_FAILURE)
@@ -77,16 +82,20 @@ dm_cleanup (void)
 {
   dm_debug("Closing DISMAL. Have a nice day.\n");
 
-  if (_conf)
-    free (_conf);
-
   if (DM_INPUT)
     dm_input_cleanup ();
 
   if (DM_GFX)
     dm_gfx_cleanup ();
 
+  dm_pool_destroy (_pool);
+  _pool = NULL;
+
   dm_base_cleanup ();
+
+  if (_conf)
+    free (_conf);
+  _conf = NULL;
 }
 
 int
@@ -105,7 +114,14 @@ dm_config_init (void)
           _conf->gfx_screen_width = 640;
           _conf->gfx_screen_height = 400;
           _conf->gfx_screen_depth = 32;
+          _conf->gfx_driver = NULL;
           _conf->gfx_flags = DM_GFX_AUTO_TRANSLATE;
+          _conf->gfx_atlas_page_size = 1024;
+          _conf->gfx_atlas_max_image = 256;
+          _conf->gfx_image_budget = 0;
+          _conf->gfx_render_threads = 0;
+          _conf->gfx_command_buffers = 2;
+          _conf->threads = 4;
         }
       else
         {
@@ -126,15 +142,42 @@ dm_set_resolution (unsigned short width, unsigned short height)
     }
 }
 
+void
+dm_set_gfx_driver (const char *name)
+{
+  if (dm_config_init () == DM_SUCCESS)
+    _conf->gfx_driver = name;
+}
+
 void
 dm_set_gfx_flag (unsigned short flag_id, unsigned short value)
 {
+#ifdef DM_GFX
+  /* Anything already queued must be drawn before immediate draws. */
+  if ((flag_id & DM_GFX_DEFERRED) && !value)
+    dm_queue_flush ();
+#endif /* DM_GFX */
+
   if (value)
     _conf->gfx_flags |= flag_id;
   else
     _conf->gfx_flags &= ~flag_id;
 }
 
+void
+dm_set_render_threads (int threads)
+{
+  if (dm_config_init () == DM_SUCCESS)
+    _conf->gfx_render_threads = threads;
+}
+
+void
+dm_set_command_buffers (int buffers)
+{
+  if (dm_config_init () == DM_SUCCESS)
+    _conf->gfx_command_buffers = buffers;
+}
+
 unsigned short
 dm_get_gfx_flag (unsigned short flag_id)
 {
@@ -145,6 +188,12 @@ dm_get_gfx_flag (unsigned short flag_id)
 }
 
 
+struct dm_Pool *
+dm_get_pool (void)
+{
+  return _pool;
+}
+
 DM_INLINE void
 dm_fatal (const char *str, ...)
 {
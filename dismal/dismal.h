@@ -90,7 +90,36 @@ struct dm_Config
                             OpenGL) targets. */
   int gfx_screen_depth; /**< Desired screen depth on hi-res (SDL,
                            OpenGL) targets. */
+  const char *gfx_driver; /**< Name of the graphics driver to use
+                             (eg "sdl", "sdl-opengl", or "memory"
+                             to draw into memory with no display),
+                             or NULL for the first one compiled
+                             in. */
   int gfx_flags; /**< Bit-field of flags. */
+  int gfx_atlas_page_size; /**< Width and height of image atlas pages.
+                              Set to 0 to disable atlasing. */
+  int gfx_atlas_max_image; /**< Images wider or taller than this are
+                              not packed into atlas pages. */
+  unsigned long gfx_image_budget; /**< Most bytes of image data to
+                                     keep loaded.  Images that have
+                                     not been drawn recently are
+                                     evicted, and reloaded when next
+                                     drawn, to stay within it.  Set to
+                                     0 for no limit. */
+  int gfx_render_threads; /**< Number of worker threads that deferred
+                             drawing is split between, each drawing a
+                             horizontal band of the screen.  The
+                             calling thread draws a band as well.
+                             If 0, all drawing is done on the calling
+                             thread. */
+  int gfx_command_buffers; /**< Number of buffers that frames are
+                              recorded into with DM_GFX_PIPELINED:
+                              2 to let one frame be drawn while the
+                              next is recorded, or 3 to let two. */
+
+  int threads; /**< Number of worker threads to start for background
+                  work such as image decoding.  If 0, all such work
+                  is done on the calling thread. */
 };
 
 /** Initialise DISMAL.
@@ -153,8 +182,72 @@ dm_debug (const char *str, ...);
 void
 dm_set_resolution (unsigned short width, unsigned short height);
 
+/** Choose the graphics driver.
+ *
+ *  This must be called before dm_init.  If the driver is not compiled
+ *  in, the first one that is will be used instead.
+ *
+ *  @param name  The driver name (eg "sdl", "sdl-opengl" or "memory"),
+ *  or NULL for the first driver compiled in.
+ */
+
+void
+dm_set_gfx_driver (const char *name);
+
+/** Set or clear a graphics flag.
+ *
+ *  @param flag_id  The flag to change (eg DM_GFX_AUTO_TRANSLATE).
+ *  @param value    Non-zero to set the flag, zero to clear it.
+ */
+
+void
+dm_set_gfx_flag (unsigned short flag_id, unsigned short value);
+
+/** Set the number of render threads.
+ *
+ *  This must be called before dm_init.
+ *
+ *  @param threads  The number of worker threads to split deferred
+ *  drawing between (see gfx_render_threads in dm_Config), or 0 to
+ *  draw only on the calling thread.
+ */
+
+void
+dm_set_render_threads (int threads);
+
+/** Set the number of command buffers used with a render thread.
+ *
+ *  This must be called before dm_init.
+ *
+ *  @param buffers  The number of buffers (see gfx_command_buffers in
+ *  dm_Config): 2 or 3.
+ */
+
+void
+dm_set_command_buffers (int buffers);
+
+/** Check a graphics flag.
+ *
+ *  @param flag_id  The flag to check.
+ *
+ *  @return DM_TRUE if the flag is set, DM_FALSE otherwise.
+ */
+
+unsigned short
+dm_get_gfx_flag (unsigned short flag_id);
+
+/** Retrieve DISMAL's worker pool.
+ *
+ *  @return the pool started by dm_init, or NULL if there is none (in
+ *  which case the pool functions run jobs on the calling thread).
+ */
+
+struct dm_Pool *
+dm_get_pool (void);
+
 /* Include other headers for convenience. */
 #include "base/dm-base.h"
+#include "base/dm-pool.h"
 #include "gfx/dm-gfx.h"
 #include "input/dm-input.h"
 
@@ -0,0 +1,348 @@
+/** @file     gfx/dm-gfx-atlas.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Image atlas packer for the DISMAL graphics subsystem.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+/* Small images are packed into large atlas pages so that frames
+   mixing many sprites draw from a few source images.  Pages are
+   packed with the skyline bottom-left heuristic. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-atlas.h"
+
+static dm_GfxAtlasPage *dm_atlas_new_page(void);
+static void dm_atlas_release_page(dm_GfxAtlasPage *page);
+static int dm_atlas_find(dm_GfxAtlasPage *page,
+                         unsigned short w,
+                         unsigned short h,
+                         unsigned short *xp,
+                         unsigned short *yp,
+                         int *segp);
+static void dm_atlas_add_segment(dm_GfxAtlasPage *page,
+                                 int seg,
+                                 unsigned short x,
+                                 unsigned short y,
+                                 unsigned short w,
+                                 unsigned short h);
+
+int
+dm_atlas_insert (struct dm_GfxImageNode *node)
+{
+  dm_GfxAtlasPage *page;
+  dm_GfxDriver *dri;
+  unsigned short x, y;
+  int seg, max;
+
+  dri = dm_gfxdata->driver;
+  max = dm_gfxdata->conf->gfx_atlas_max_image;
+
+  /* Only pack small images of known size, and only if the driver can
+     build pages. */
+  if (dm_gfxdata->conf->gfx_atlas_page_size <= 0
+      || dri->create_image_data == NULL
+      || dri->copy_image_data == NULL
+      || node->w == 0 || node->h == 0
+      || node->w > max || node->h > max
+      || node->w > dm_gfxdata->conf->gfx_atlas_page_size
+      || node->h > dm_gfxdata->conf->gfx_atlas_page_size)
+    return DM_FAILURE;
+
+  /* Find the first page with room, opening a new one if needed. */
+  for (page = dm_gfxdata->atlas; page != NULL; page = page->next)
+    {
+      if (dm_atlas_find (page, node->w, node->h, &x, &y, &seg))
+        break;
+    }
+
+  if (page == NULL)
+    {
+      page = dm_atlas_new_page ();
+
+      if (page == NULL
+          || !dm_atlas_find (page, node->w, node->h, &x, &y, &seg))
+        return DM_FAILURE;
+    }
+
+  /* Frames in flight may be drawing from the page. */
+  dm_pipeline_sync ();
+
+  /* The driver may refuse images it cannot represent in a page (for
+     example, ones with translucent pixels). */
+  if (dri->copy_image_data (page->data, node->data, node->x, node->y,
+                            x, y, node->w, node->h) == DM_FAILURE)
+    {
+      if (page->images == 0)
+        dm_atlas_release_page (page);
+      return DM_FAILURE;
+    }
+
+  dm_atlas_add_segment (page, seg, x, y, node->w, node->h);
+  page->images++;
+  page->used += (unsigned long) node->w * node->h;
+
+  dri->free_image_data (node->data);
+  node->data = page->data;
+  node->page = page;
+  node->x = x;
+  node->y = y;
+
+  return DM_SUCCESS;
+}
+
+void
+dm_atlas_release (struct dm_GfxImageNode *node)
+{
+  dm_GfxAtlasPage *page;
+
+  page = node->page;
+  node->page = NULL;
+  node->data = NULL;
+
+  if (--page->images == 0)
+    dm_atlas_release_page (page);
+}
+
+/* Unlink a page from the page list and free it. */
+static void
+dm_atlas_release_page (dm_GfxAtlasPage *page)
+{
+  dm_GfxAtlasPage **pp;
+
+  for (pp = &dm_gfxdata->atlas; *pp != NULL; pp = &(*pp)->next)
+    {
+      if (*pp == page)
+        {
+          *pp = page->next;
+          break;
+        }
+    }
+
+  dm_gfxdata->driver->free_image_data (page->data);
+  free (page->skyline);
+  free (page);
+}
+
+void
+dm_atlas_clear (void)
+{
+  while (dm_gfxdata->atlas)
+    dm_atlas_release_page (dm_gfxdata->atlas);
+}
+
+void
+dm_atlas_dump (FILE *out)
+{
+  dm_GfxAtlasPage *page;
+  unsigned long area, under;
+  int i, n;
+
+  n = 0;
+
+  for (page = dm_gfxdata->atlas; page != NULL; page = page->next, n++)
+    {
+      area = (unsigned long) page->w * page->h;
+
+      for (i = 0, under = 0; i < page->segments; i++)
+        under += (unsigned long) page->skyline[i].w * page->skyline[i].y;
+
+      fprintf (out, "GFX: Atlas page %d: %ux%u, %d images, "
+               "%lu%% used, %lu%% under skyline, %d segments\n",
+               n, page->w, page->h, page->images,
+               (page->used * 100) / area, (under * 100) / area,
+               page->segments);
+    }
+
+  fprintf (out, "GFX: %d atlas pages of %dx%d, max image size %d\n",
+           n, dm_gfxdata->conf->gfx_atlas_page_size,
+           dm_gfxdata->conf->gfx_atlas_page_size,
+           dm_gfxdata->conf->gfx_atlas_max_image);
+}
+
+/* Create an empty page and add it to the end of the page list. */
+static dm_GfxAtlasPage *
+dm_atlas_new_page (void)
+{
+  dm_GfxAtlasPage *page, **pp;
+  unsigned short size;
+
+  size = (unsigned short) dm_gfxdata->conf->gfx_atlas_page_size;
+
+  page = malloc (sizeof (dm_GfxAtlasPage));
+
+  if (page == NULL)
+    return NULL;
+
+  /* A skyline can never have more segments than the page is wide;
+     one more slot is needed while a new segment is being added. */
+  page->skyline = malloc (sizeof (dm_GfxAtlasSkyline) * (size + 1));
+  page->data = dm_gfxdata->driver->create_image_data (size, size);
+
+  if (page->skyline == NULL || page->data == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate atlas page.");
+
+      if (page->data)
+        dm_gfxdata->driver->free_image_data (page->data);
+      if (page->skyline)
+        free (page->skyline);
+      free (page);
+      return NULL;
+    }
+
+  page->w = page->h = size;
+  page->skyline[0].x = page->skyline[0].y = 0;
+  page->skyline[0].w = size;
+  page->segments = 1;
+  page->images = 0;
+  page->used = 0;
+  page->next = NULL;
+
+  for (pp = &dm_gfxdata->atlas; *pp != NULL; pp = &(*pp)->next)
+    ;
+  *pp = page;
+
+  dm_debug ("GFX: Opened atlas page of %ux%u.", size, size);
+
+  return page;
+}
+
+/* Find the lowest position (breaking ties by narrowest segment) where
+   a w by h image fits on the page's skyline, returning DM_TRUE and
+   the position and starting segment if there is one. */
+static int
+dm_atlas_find (dm_GfxAtlasPage *page,
+               unsigned short w,
+               unsigned short h,
+               unsigned short *xp,
+               unsigned short *yp,
+               int *segp)
+{
+  int i, j, best;
+  unsigned int y, width_left, best_top, best_w;
+
+  best = -1;
+  best_top = best_w = 0;
+
+  for (i = 0; i < page->segments; i++)
+    {
+      if (page->skyline[i].x + w > page->w)
+        break;
+
+      /* The image rests on the highest segment it spans. */
+      y = 0;
+      width_left = w;
+
+      for (j = i; width_left > 0; j++)
+        {
+          if (page->skyline[j].y > y)
+            y = page->skyline[j].y;
+
+          if (page->skyline[j].w >= width_left)
+            width_left = 0;
+          else
+            width_left -= page->skyline[j].w;
+        }
+
+      if (y + h > page->h)
+        continue;
+
+      if (best == -1
+          || y + h < best_top
+          || (y + h == best_top && page->skyline[i].w < best_w))
+        {
+          best = i;
+          best_top = y + h;
+          best_w = page->skyline[i].w;
+          *xp = page->skyline[i].x;
+          *yp = (unsigned short) y;
+        }
+    }
+
+  *segp = best;
+  return best != -1;
+}
+
+/* Raise the skyline over an image placed at (x, y) starting at
+   segment seg, then merge segments at equal heights. */
+static void
+dm_atlas_add_segment (dm_GfxAtlasPage *page,
+                      int seg,
+                      unsigned short x,
+                      unsigned short y,
+                      unsigned short w,
+                      unsigned short h)
+{
+  dm_GfxAtlasSkyline *sky;
+  unsigned short right, cut;
+  int i;
+
+  sky = page->skyline;
+  right = x + w;
+
+  /* Insert the new segment before seg. */
+  memmove (&sky[seg + 1], &sky[seg],
+           sizeof (dm_GfxAtlasSkyline) * (page->segments - seg));
+  sky[seg].x = x;
+  sky[seg].y = y + h;
+  sky[seg].w = w;
+  page->segments++;
+
+  /* Shrink or remove the segments now underneath it. */
+  for (i = seg + 1; i < page->segments; )
+    {
+      if (sky[i].x >= right)
+        break;
+
+      cut = right - sky[i].x;
+
+      if (cut < sky[i].w)
+        {
+          sky[i].x += cut;
+          sky[i].w -= cut;
+          break;
+        }
+
+      memmove (&sky[i], &sky[i + 1],
+               sizeof (dm_GfxAtlasSkyline) * (page->segments - i - 1));
+      page->segments--;
+    }
+
+  for (i = 0; i + 1 < page->segments; )
+    {
+      if (sky[i].y == sky[i + 1].y)
+        {
+          sky[i].w += sky[i + 1].w;
+          memmove (&sky[i + 1], &sky[i + 2],
+                   sizeof (dm_GfxAtlasSkyline) * (page->segments - i - 2));
+          page->segments--;
+        }
+      else
+        i++;
+    }
+}
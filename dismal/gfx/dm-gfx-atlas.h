@@ -0,0 +1,115 @@
+/** @file     gfx/dm-gfx-atlas.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for the image atlas packer.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_ATLAS_H__
+#define __DM_GFX_ATLAS_H__
+
+#include "../dismal.h"
+
+typedef struct dm_GfxAtlasSkyline dm_GfxAtlasSkyline;
+typedef struct dm_GfxAtlasPage dm_GfxAtlasPage;
+
+/** One segment of an atlas page's skyline.
+ *
+ *  The skyline is the upper envelope of everything packed into the
+ *  page so far: a list of horizontal segments, left to right, each
+ *  at the height below which the page is full.
+ */
+struct dm_GfxAtlasSkyline
+{
+  unsigned short x; /**< Left edge of the segment. */
+  unsigned short y; /**< Height of the segment. */
+  unsigned short w; /**< Width of the segment. */
+};
+
+/** An atlas page, holding many small images in one driver image. */
+struct dm_GfxAtlasPage
+{
+  void *data;            /**< Driver-dependent image data for the
+                            whole page. */
+  unsigned short w;      /**< Width of the page. */
+  unsigned short h;      /**< Height of the page. */
+  dm_GfxAtlasSkyline *skyline; /**< Skyline segments. */
+  int segments;          /**< Number of skyline segments in use. */
+  int images;            /**< Number of live images in the page. */
+  unsigned long used;    /**< Area, in pixels, of all images ever
+                            packed into the page.  Space is only
+                            reclaimed when the whole page empties. */
+  struct dm_GfxAtlasPage *next; /**< The next page, if any. */
+};
+
+
+/** Try to pack an image into an atlas page.
+ *
+ *  If the image is small enough (see dm_Config's
+ *  gfx_atlas_max_image) and the driver supports atlasing, its data
+ *  is copied into an atlas page, opening a new page if none has room,
+ *  and the node is updated to refer to its sub-rectangle of that
+ *  page.  The node's standalone data is then freed.
+ *
+ *  @param node  The image node to pack.  Its data must be standalone
+ *               (not already in a page) and its size known.
+ *
+ *  @return  DM_SUCCESS if the image was packed, DM_FAILURE if it was
+ *           left standalone.  A failure is not an error.
+ */
+
+int dm_atlas_insert(struct dm_GfxImageNode *node);
+
+
+/** Release an image's space in its atlas page.
+ *
+ *  The page is freed once its last image is released.
+ *
+ *  @param node  The image node to release.  It must be in a page.
+ */
+
+void dm_atlas_release(struct dm_GfxImageNode *node);
+
+
+/** Free every atlas page.
+ *
+ *  This should only be called once no image nodes refer to the pages,
+ *  for example from dm_clear_images().
+ */
+
+void dm_atlas_clear(void);
+
+
+/** Write a summary of atlas occupancy to a file.
+ *
+ *  For each page this gives its size, the number of images in it, the
+ *  proportion of its area used by images, and the proportion lying
+ *  under the skyline (that is, used or wasted).  This is intended
+ *  for tuning gfx_atlas_page_size and gfx_atlas_max_image.
+ *
+ *  @param out  The file to write to (for example, stderr).
+ */
+
+void dm_atlas_dump(FILE *out);
+
+#endif /* __DM_GFX_ATLAS_H__ */
@@ -0,0 +1,898 @@
+/** @file     gfx/dm-gfx-blit.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Driver-independent blit and fill kernels.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
+/* AVX2 kernels are compiled whatever the target, and only run if the
+   CPU turns out to have AVX2. */
+#if (defined (__i386__) || defined (__x86_64__))                \
+  && (defined (__clang__)                                       \
+      || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define DM_BLIT_HAVE_AVX2
+#define DM_BLIT_TARGET_AVX2 __attribute__ ((target ("avx2")))
+#include <immintrin.h>
+#endif
+
+#include "dm-gfx-blit.h"
+
+/* Divide a product of two bytes by 255, rounding to nearest; exact
+   for every such product, and the same sum the vector kernels do. */
+#define DM_BLIT_DIV255(x) ((((x) + 128) + (((x) + 128) >> 8)) >> 8)
+
+static unsigned int dm_blit_features;
+
+static void dm_blit_keyed_scalar (const unsigned char *src,
+                                  unsigned char *dest,
+                                  unsigned long count,
+                                  unsigned int bpp,
+                                  unsigned long key);
+static void dm_blit_fill_scalar (unsigned char *dest,
+                                 unsigned long count,
+                                 unsigned int bpp,
+                                 unsigned long colour);
+static void dm_blit_expand_scalar (const unsigned char *src,
+                                   unsigned char *dest,
+                                   unsigned long count,
+                                   unsigned int bpp,
+                                   const unsigned int table[256]);
+static void dm_blit_blend_scalar (const unsigned char *src,
+                                  unsigned char *dest,
+                                  unsigned long count);
+static void dm_blit_add_scalar (const unsigned char *src,
+                                unsigned char *dest,
+                                unsigned long count);
+
+#ifdef __SSE2__
+static __m128i dm_blit_splat_sse2 (unsigned int bpp,
+                                   unsigned long pixel);
+static unsigned long dm_blit_keyed_sse2 (const unsigned char *src,
+                                         unsigned char *dest,
+                                         unsigned long bytes,
+                                         unsigned int bpp,
+                                         unsigned long key);
+static unsigned long dm_blit_fill_sse2 (unsigned char *dest,
+                                        unsigned long bytes,
+                                        unsigned int bpp,
+                                        unsigned long colour,
+                                        int stream);
+static __m128i dm_blit_over_sse2 (__m128i s, __m128i d);
+static unsigned long dm_blit_blend_sse2 (const unsigned char *src,
+                                         unsigned char *dest,
+                                         unsigned long count);
+static unsigned long dm_blit_add_sse2 (const unsigned char *src,
+                                       unsigned char *dest,
+                                       unsigned long count);
+#endif /* __SSE2__ */
+
+#ifdef DM_BLIT_HAVE_AVX2
+static __m256i dm_blit_splat_avx2 (unsigned int bpp,
+                                   unsigned long pixel)
+  DM_BLIT_TARGET_AVX2;
+static unsigned long dm_blit_keyed_avx2 (const unsigned char *src,
+                                         unsigned char *dest,
+                                         unsigned long bytes,
+                                         unsigned int bpp,
+                                         unsigned long key)
+  DM_BLIT_TARGET_AVX2;
+static unsigned long dm_blit_fill_avx2 (unsigned char *dest,
+                                        unsigned long bytes,
+                                        unsigned int bpp,
+                                        unsigned long colour,
+                                        int stream)
+  DM_BLIT_TARGET_AVX2;
+static unsigned long dm_blit_expand_avx2 (const unsigned char *src,
+                                          unsigned char *dest,
+                                          unsigned long count,
+                                          const unsigned int table[256])
+  DM_BLIT_TARGET_AVX2;
+static __m256i dm_blit_over_avx2 (__m256i s, __m256i d)
+  DM_BLIT_TARGET_AVX2;
+static unsigned long dm_blit_blend_avx2 (const unsigned char *src,
+                                         unsigned char *dest,
+                                         unsigned long count)
+  DM_BLIT_TARGET_AVX2;
+static unsigned long dm_blit_add_avx2 (const unsigned char *src,
+                                       unsigned char *dest,
+                                       unsigned long count)
+  DM_BLIT_TARGET_AVX2;
+#endif /* DM_BLIT_HAVE_AVX2 */
+
+unsigned int
+dm_blit_init (void)
+{
+  dm_blit_features = 0;
+
+#ifdef __SSE2__
+  dm_blit_features |= DM_BLIT_SSE2;
+#endif /* __SSE2__ */
+
+#ifdef DM_BLIT_HAVE_AVX2
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("avx2"))
+    dm_blit_features |= DM_BLIT_AVX2;
+#endif /* DM_BLIT_HAVE_AVX2 */
+
+  return dm_blit_features;
+}
+
+void
+dm_blit_copy (const unsigned char *src,
+              unsigned long src_pitch,
+              unsigned char *dest,
+              unsigned long dest_pitch,
+              unsigned int width,
+              unsigned int height,
+              unsigned int bpp)
+{
+  unsigned long bytes;
+  unsigned int y;
+
+  bytes = (unsigned long) width * bpp;
+
+  /* The C library's memcpy is already as wide as the CPU allows. */
+  for (y = 0; y < height; y++, src += src_pitch, dest += dest_pitch)
+    memcpy (dest, src, bytes);
+}
+
+void
+dm_blit_keyed (const unsigned char *src,
+               unsigned long src_pitch,
+               unsigned char *dest,
+               unsigned long dest_pitch,
+               unsigned int width,
+               unsigned int height,
+               unsigned int bpp,
+               unsigned long key)
+{
+  unsigned long bytes, done;
+  unsigned int y;
+
+  bytes = (unsigned long) width * bpp;
+
+  for (y = 0; y < height; y++, src += src_pitch, dest += dest_pitch)
+    {
+      done = 0;
+
+#ifdef DM_BLIT_HAVE_AVX2
+      if (dm_blit_features & DM_BLIT_AVX2)
+        done = dm_blit_keyed_avx2 (src, dest, bytes, bpp, key);
+#endif /* DM_BLIT_HAVE_AVX2 */
+
+#ifdef __SSE2__
+      done += dm_blit_keyed_sse2 (src + done, dest + done,
+                                  bytes - done, bpp, key);
+#endif /* __SSE2__ */
+
+      dm_blit_keyed_scalar (src + done, dest + done,
+                            (bytes - done) / bpp, bpp, key);
+    }
+}
+
+void
+dm_blit_fill (unsigned char *dest,
+              unsigned long dest_pitch,
+              unsigned int width,
+              unsigned int height,
+              unsigned int bpp,
+              unsigned long colour)
+{
+  unsigned long bytes, align, head, done;
+  unsigned int y;
+  int stream;
+
+  bytes = (unsigned long) width * bpp;
+  stream = 0;
+
+#ifdef __SSE2__
+  stream = (bytes * height >= DM_BLIT_STREAM_BYTES);
+#endif /* __SSE2__ */
+  align = (dm_blit_features & DM_BLIT_AVX2) ? 32 : 16;
+
+  for (y = 0; y < height; y++, dest += dest_pitch)
+    {
+      /* Fill up to the first aligned pixel one at a time, so the rest
+         can use aligned (and streaming) stores.  Rows of pixels not
+         even aligned to their own size are done entirely that way. */
+      if ((unsigned long) dest % bpp != 0)
+        head = width;
+      else
+        head = ((align - (unsigned long) dest % align) % align) / bpp;
+
+      if (head > width)
+        head = width;
+
+      dm_blit_fill_scalar (dest, head, bpp, colour);
+      done = head * bpp;
+
+#ifdef DM_BLIT_HAVE_AVX2
+      if (dm_blit_features & DM_BLIT_AVX2)
+        done += dm_blit_fill_avx2 (dest + done, bytes - done, bpp,
+                                   colour, stream);
+#endif /* DM_BLIT_HAVE_AVX2 */
+
+#ifdef __SSE2__
+      done += dm_blit_fill_sse2 (dest + done, bytes - done, bpp,
+                                 colour, stream);
+#endif /* __SSE2__ */
+
+      dm_blit_fill_scalar (dest + done, (bytes - done) / bpp, bpp,
+                           colour);
+    }
+
+#ifdef __SSE2__
+  /* Streaming stores must be seen before anything reads the pixels. */
+  if (stream)
+    _mm_sfence ();
+#endif /* __SSE2__ */
+}
+
+void
+dm_blit_expand (const unsigned char *src,
+                unsigned long src_pitch,
+                unsigned char *dest,
+                unsigned long dest_pitch,
+                unsigned int width,
+                unsigned int height,
+                unsigned int bpp,
+                const unsigned int table[256])
+{
+  unsigned long done;
+  unsigned int y;
+
+  for (y = 0; y < height; y++, src += src_pitch, dest += dest_pitch)
+    {
+      done = 0;
+
+      /* SSE2 has no gather, so without AVX2 the table lookups are no
+         quicker as vectors. */
+#ifdef DM_BLIT_HAVE_AVX2
+      if ((dm_blit_features & DM_BLIT_AVX2) && bpp == 4)
+        done = dm_blit_expand_avx2 (src, dest, width, table);
+#endif /* DM_BLIT_HAVE_AVX2 */
+
+      dm_blit_expand_scalar (src + done, dest + done * bpp,
+                             width - done, bpp, table);
+    }
+}
+
+void
+dm_blit_blend (const unsigned char *src,
+               unsigned long src_pitch,
+               unsigned char *dest,
+               unsigned long dest_pitch,
+               unsigned int width,
+               unsigned int height)
+{
+  unsigned long done;
+  unsigned int y;
+
+  for (y = 0; y < height; y++, src += src_pitch, dest += dest_pitch)
+    {
+      done = 0;
+
+#ifdef DM_BLIT_HAVE_AVX2
+      if (dm_blit_features & DM_BLIT_AVX2)
+        done = dm_blit_blend_avx2 (src, dest, width);
+#endif /* DM_BLIT_HAVE_AVX2 */
+
+#ifdef __SSE2__
+      done += dm_blit_blend_sse2 (src + done * 4, dest + done * 4,
+                                  width - done);
+#endif /* __SSE2__ */
+
+      dm_blit_blend_scalar (src + done * 4, dest + done * 4,
+                            width - done);
+    }
+}
+
+void
+dm_blit_add (const unsigned char *src,
+             unsigned long src_pitch,
+             unsigned char *dest,
+             unsigned long dest_pitch,
+             unsigned int width,
+             unsigned int height)
+{
+  unsigned long done;
+  unsigned int y;
+
+  for (y = 0; y < height; y++, src += src_pitch, dest += dest_pitch)
+    {
+      done = 0;
+
+#ifdef DM_BLIT_HAVE_AVX2
+      if (dm_blit_features & DM_BLIT_AVX2)
+        done = dm_blit_add_avx2 (src, dest, width);
+#endif /* DM_BLIT_HAVE_AVX2 */
+
+#ifdef __SSE2__
+      done += dm_blit_add_sse2 (src + done * 4, dest + done * 4,
+                                width - done);
+#endif /* __SSE2__ */
+
+      dm_blit_add_scalar (src + done * 4, dest + done * 4,
+                          width - done);
+    }
+}
+
+/* Copy keyed pixels one at a time.  DISMAL's targets all have 32-bit
+   ints. */
+static void
+dm_blit_keyed_scalar (const unsigned char *src,
+                      unsigned char *dest,
+                      unsigned long count,
+                      unsigned int bpp,
+                      unsigned long key)
+{
+  unsigned short p16;
+  unsigned int p32;
+  unsigned long i;
+
+  switch (bpp)
+    {
+    case 1:
+      for (i = 0; i < count; i++)
+        {
+          if (src[i] != (unsigned char) key)
+            dest[i] = src[i];
+        }
+      break;
+    case 2:
+      for (i = 0; i < count; i++, src += 2, dest += 2)
+        {
+          memcpy (&p16, src, 2);
+
+          if (p16 != (unsigned short) key)
+            memcpy (dest, &p16, 2);
+        }
+      break;
+    case 4:
+      for (i = 0; i < count; i++, src += 4, dest += 4)
+        {
+          memcpy (&p32, src, 4);
+
+          if (p32 != (unsigned int) key)
+            memcpy (dest, &p32, 4);
+        }
+      break;
+    }
+}
+
+/* Fill pixels one at a time. */
+static void
+dm_blit_fill_scalar (unsigned char *dest,
+                     unsigned long count,
+                     unsigned int bpp,
+                     unsigned long colour)
+{
+  unsigned short p16;
+  unsigned int p32;
+  unsigned long i;
+
+  switch (bpp)
+    {
+    case 1:
+      memset (dest, (unsigned char) colour, count);
+      break;
+    case 2:
+      p16 = (unsigned short) colour;
+
+      for (i = 0; i < count; i++, dest += 2)
+        memcpy (dest, &p16, 2);
+      break;
+    case 4:
+      p32 = (unsigned int) colour;
+
+      for (i = 0; i < count; i++, dest += 4)
+        memcpy (dest, &p32, 4);
+      break;
+    }
+}
+
+/* Expand palette indices one at a time. */
+static void
+dm_blit_expand_scalar (const unsigned char *src,
+                       unsigned char *dest,
+                       unsigned long count,
+                       unsigned int bpp,
+                       const unsigned int table[256])
+{
+  unsigned short p16;
+  unsigned long i;
+
+  switch (bpp)
+    {
+    case 2:
+      for (i = 0; i < count; i++, dest += 2)
+        {
+          p16 = (unsigned short) table[src[i]];
+          memcpy (dest, &p16, 2);
+        }
+      break;
+    case 4:
+      for (i = 0; i < count; i++, dest += 4)
+        memcpy (dest, &table[src[i]], 4);
+      break;
+    }
+}
+
+/* Composite premultiplied pixels one at a time, passing over empty
+   ones and copying fully opaque ones. */
+static void
+dm_blit_blend_scalar (const unsigned char *src,
+                      unsigned char *dest,
+                      unsigned long count)
+{
+  unsigned int s, d, na, c, out, shift;
+  unsigned long i;
+
+  for (i = 0; i < count; i++, src += 4, dest += 4)
+    {
+      memcpy (&s, src, 4);
+      na = 255 - (s >> 24);
+
+      if (s == 0)
+        continue;
+
+      if (na != 0)
+        {
+          memcpy (&d, dest, 4);
+          out = 0;
+
+          for (shift = 0; shift < 32; shift += 8)
+            {
+              c = ((s >> shift) & 0xFF)
+                + DM_BLIT_DIV255 (((d >> shift) & 0xFF) * na);
+              out |= (c > 255 ? 255 : c) << shift;
+            }
+
+          s = out;
+        }
+
+      memcpy (dest, &s, 4);
+    }
+}
+
+/* Add pixels one at a time. */
+static void
+dm_blit_add_scalar (const unsigned char *src,
+                    unsigned char *dest,
+                    unsigned long count)
+{
+  unsigned long i;
+  unsigned int c;
+
+  for (i = 0; i < count * 4; i++)
+    {
+      c = (unsigned int) src[i] + dest[i];
+      dest[i] = (unsigned char) (c > 255 ? 255 : c);
+    }
+}
+
+#ifdef __SSE2__
+
+/* Make a vector of copies of one pixel. */
+static __m128i
+dm_blit_splat_sse2 (unsigned int bpp, unsigned long pixel)
+{
+  switch (bpp)
+    {
+    case 1:
+      return _mm_set1_epi8 ((char) pixel);
+    case 2:
+      return _mm_set1_epi16 ((short) pixel);
+    default:
+      return _mm_set1_epi32 ((int) pixel);
+    }
+}
+
+/* Copy keyed pixels 16 bytes at a time, returning how many bytes were
+   done.  Each pixel size gets its own loop so the compare is fixed
+   within it. */
+static unsigned long
+dm_blit_keyed_sse2 (const unsigned char *src,
+                    unsigned char *dest,
+                    unsigned long bytes,
+                    unsigned int bpp,
+                    unsigned long key)
+{
+  __m128i k, s, d, m;
+  unsigned long i;
+
+  k = dm_blit_splat_sse2 (bpp, key);
+
+  /* Where the mask is set the source is the key, so the destination
+     shows through. */
+  switch (bpp)
+    {
+    case 1:
+      for (i = 0; i + 16 <= bytes; i += 16)
+        {
+          s = _mm_loadu_si128 ((const __m128i *) (src + i));
+          d = _mm_loadu_si128 ((const __m128i *) (dest + i));
+          m = _mm_cmpeq_epi8 (s, k);
+          _mm_storeu_si128 ((__m128i *) (dest + i),
+                            _mm_or_si128 (_mm_and_si128 (m, d),
+                                          _mm_andnot_si128 (m, s)));
+        }
+      break;
+    case 2:
+      for (i = 0; i + 16 <= bytes; i += 16)
+        {
+          s = _mm_loadu_si128 ((const __m128i *) (src + i));
+          d = _mm_loadu_si128 ((const __m128i *) (dest + i));
+          m = _mm_cmpeq_epi16 (s, k);
+          _mm_storeu_si128 ((__m128i *) (dest + i),
+                            _mm_or_si128 (_mm_and_si128 (m, d),
+                                          _mm_andnot_si128 (m, s)));
+        }
+      break;
+    case 4:
+      for (i = 0; i + 16 <= bytes; i += 16)
+        {
+          s = _mm_loadu_si128 ((const __m128i *) (src + i));
+          d = _mm_loadu_si128 ((const __m128i *) (dest + i));
+          m = _mm_cmpeq_epi32 (s, k);
+          _mm_storeu_si128 ((__m128i *) (dest + i),
+                            _mm_or_si128 (_mm_and_si128 (m, d),
+                                          _mm_andnot_si128 (m, s)));
+        }
+      break;
+    default:
+      i = 0;
+      break;
+    }
+
+  return i;
+}
+
+/* Fill 16 bytes at a time from a 16-byte aligned destination,
+   returning how many bytes were done. */
+static unsigned long
+dm_blit_fill_sse2 (unsigned char *dest,
+                   unsigned long bytes,
+                   unsigned int bpp,
+                   unsigned long colour,
+                   int stream)
+{
+  __m128i p;
+  unsigned long i;
+
+  if ((unsigned long) dest % 16 != 0)
+    return 0;
+
+  p = dm_blit_splat_sse2 (bpp, colour);
+
+  if (stream)
+    {
+      for (i = 0; i + 16 <= bytes; i += 16)
+        _mm_stream_si128 ((__m128i *) (dest + i), p);
+    }
+  else
+    {
+      for (i = 0; i + 16 <= bytes; i += 16)
+        _mm_store_si128 ((__m128i *) (dest + i), p);
+    }
+
+  return i;
+}
+
+/* Composite four premultiplied pixels over four others.  Channels are
+   widened to 16 bits, two pixels to a vector, so that the
+   destination can be scaled by one minus the source alpha, which is
+   spread across each pixel's channels. */
+static __m128i
+dm_blit_over_sse2 (__m128i s, __m128i d)
+{
+  __m128i zero, na, lo, hi, nlo, nhi, round;
+
+  zero = _mm_setzero_si128 ();
+  round = _mm_set1_epi16 (128);
+
+  /* Bytes of 255 - alpha are the bitwise complement of alpha. */
+  na = _mm_xor_si128 (s, _mm_set1_epi32 (-1));
+  nlo = _mm_unpacklo_epi8 (na, zero);
+  nhi = _mm_unpackhi_epi8 (na, zero);
+  nlo = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (nlo, 0xFF), 0xFF);
+  nhi = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (nhi, 0xFF), 0xFF);
+
+  lo = _mm_add_epi16 (_mm_mullo_epi16 (_mm_unpacklo_epi8 (d, zero), nlo),
+                      round);
+  hi = _mm_add_epi16 (_mm_mullo_epi16 (_mm_unpackhi_epi8 (d, zero), nhi),
+                      round);
+  lo = _mm_srli_epi16 (_mm_add_epi16 (lo, _mm_srli_epi16 (lo, 8)), 8);
+  hi = _mm_srli_epi16 (_mm_add_epi16 (hi, _mm_srli_epi16 (hi, 8)), 8);
+
+  return _mm_adds_epu8 (_mm_packus_epi16 (lo, hi), s);
+}
+
+/* Composite premultiplied pixels 4 at a time, returning how many were
+   done.  Runs of empty or fully opaque pixels, which make up most of
+   a typical sprite, skip the arithmetic. */
+static unsigned long
+dm_blit_blend_sse2 (const unsigned char *src,
+                    unsigned char *dest,
+                    unsigned long count)
+{
+  __m128i s, a, zero, full;
+  unsigned long i;
+
+  zero = _mm_setzero_si128 ();
+  full = _mm_set1_epi32 (0xFF);
+
+  for (i = 0; i + 4 <= count; i += 4)
+    {
+      s = _mm_loadu_si128 ((const __m128i *) (src + i * 4));
+      a = _mm_srli_epi32 (s, 24);
+
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (s, zero)) == 0xFFFF)
+        continue;
+
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (a, full)) != 0xFFFF)
+        s = dm_blit_over_sse2 (s, _mm_loadu_si128 ((const __m128i *)
+                                                   (dest + i * 4)));
+
+      _mm_storeu_si128 ((__m128i *) (dest + i * 4), s);
+    }
+
+  return i;
+}
+
+/* Add pixels 4 at a time, returning how many were done. */
+static unsigned long
+dm_blit_add_sse2 (const unsigned char *src,
+                  unsigned char *dest,
+                  unsigned long count)
+{
+  __m128i s, d;
+  unsigned long i;
+
+  for (i = 0; i + 4 <= count; i += 4)
+    {
+      s = _mm_loadu_si128 ((const __m128i *) (src + i * 4));
+      d = _mm_loadu_si128 ((const __m128i *) (dest + i * 4));
+      _mm_storeu_si128 ((__m128i *) (dest + i * 4), _mm_adds_epu8 (s, d));
+    }
+
+  return i;
+}
+
+#endif /* __SSE2__ */
+
+#ifdef DM_BLIT_HAVE_AVX2
+
+/* Make a vector of copies of one pixel. */
+static __m256i
+dm_blit_splat_avx2 (unsigned int bpp, unsigned long pixel)
+{
+  switch (bpp)
+    {
+    case 1:
+      return _mm256_set1_epi8 ((char) pixel);
+    case 2:
+      return _mm256_set1_epi16 ((short) pixel);
+    default:
+      return _mm256_set1_epi32 ((int) pixel);
+    }
+}
+
+/* Copy keyed pixels 32 bytes at a time, returning how many bytes were
+   done. */
+static unsigned long
+dm_blit_keyed_avx2 (const unsigned char *src,
+                    unsigned char *dest,
+                    unsigned long bytes,
+                    unsigned int bpp,
+                    unsigned long key)
+{
+  __m256i k, s, d, m;
+  unsigned long i;
+
+  k = dm_blit_splat_avx2 (bpp, key);
+
+  /* As with SSE2, but a blend does the select in one go. */
+  switch (bpp)
+    {
+    case 1:
+      for (i = 0; i + 32 <= bytes; i += 32)
+        {
+          s = _mm256_loadu_si256 ((const __m256i *) (src + i));
+          d = _mm256_loadu_si256 ((const __m256i *) (dest + i));
+          m = _mm256_cmpeq_epi8 (s, k);
+          _mm256_storeu_si256 ((__m256i *) (dest + i),
+                               _mm256_blendv_epi8 (s, d, m));
+        }
+      break;
+    case 2:
+      for (i = 0; i + 32 <= bytes; i += 32)
+        {
+          s = _mm256_loadu_si256 ((const __m256i *) (src + i));
+          d = _mm256_loadu_si256 ((const __m256i *) (dest + i));
+          m = _mm256_cmpeq_epi16 (s, k);
+          _mm256_storeu_si256 ((__m256i *) (dest + i),
+                               _mm256_blendv_epi8 (s, d, m));
+        }
+      break;
+    case 4:
+      for (i = 0; i + 32 <= bytes; i += 32)
+        {
+          s = _mm256_loadu_si256 ((const __m256i *) (src + i));
+          d = _mm256_loadu_si256 ((const __m256i *) (dest + i));
+          m = _mm256_cmpeq_epi32 (s, k);
+          _mm256_storeu_si256 ((__m256i *) (dest + i),
+                               _mm256_blendv_epi8 (s, d, m));
+        }
+      break;
+    default:
+      i = 0;
+      break;
+    }
+
+  return i;
+}
+
+/* Fill 32 bytes at a time from a 32-byte aligned destination,
+   returning how many bytes were done. */
+static unsigned long
+dm_blit_fill_avx2 (unsigned char *dest,
+                   unsigned long bytes,
+                   unsigned int bpp,
+                   unsigned long colour,
+                   int stream)
+{
+  __m256i p;
+  unsigned long i;
+
+  if ((unsigned long) dest % 32 != 0)
+    return 0;
+
+  p = dm_blit_splat_avx2 (bpp, colour);
+
+  if (stream)
+    {
+      for (i = 0; i + 32 <= bytes; i += 32)
+        _mm256_stream_si256 ((__m256i *) (dest + i), p);
+    }
+  else
+    {
+      for (i = 0; i + 32 <= bytes; i += 32)
+        _mm256_store_si256 ((__m256i *) (dest + i), p);
+    }
+
+  return i;
+}
+
+/* Expand palette indices into 32-bit pixels 8 at a time, returning
+   how many were done.  Each index is widened to a 32-bit lane and
+   used to gather its pixel from the table. */
+static unsigned long
+dm_blit_expand_avx2 (const unsigned char *src,
+                     unsigned char *dest,
+                     unsigned long count,
+                     const unsigned int table[256])
+{
+  __m256i idx;
+  unsigned long i;
+
+  for (i = 0; i + 8 <= count; i += 8)
+    {
+      idx = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *)
+                                                   (src + i)));
+      _mm256_storeu_si256 ((__m256i *) (dest + i * 4),
+                           _mm256_i32gather_epi32 ((const int *) table,
+                                                   idx, 4));
+    }
+
+  return i;
+}
+
+/* Composite eight premultiplied pixels over eight others, as the SSE2
+   version does; the unpacks and packs work within each 128-bit half,
+   so the pixels come back in order. */
+static __m256i
+dm_blit_over_avx2 (__m256i s, __m256i d)
+{
+  __m256i zero, na, lo, hi, nlo, nhi, round;
+
+  zero = _mm256_setzero_si256 ();
+  round = _mm256_set1_epi16 (128);
+
+  na = _mm256_xor_si256 (s, _mm256_set1_epi32 (-1));
+  nlo = _mm256_unpacklo_epi8 (na, zero);
+  nhi = _mm256_unpackhi_epi8 (na, zero);
+  nlo = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (nlo, 0xFF), 0xFF);
+  nhi = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (nhi, 0xFF), 0xFF);
+
+  lo = _mm256_add_epi16 (_mm256_mullo_epi16 (_mm256_unpacklo_epi8 (d, zero),
+                                             nlo), round);
+  hi = _mm256_add_epi16 (_mm256_mullo_epi16 (_mm256_unpackhi_epi8 (d, zero),
+                                             nhi), round);
+  lo = _mm256_srli_epi16 (_mm256_add_epi16 (lo, _mm256_srli_epi16 (lo, 8)),
+                          8);
+  hi = _mm256_srli_epi16 (_mm256_add_epi16 (hi, _mm256_srli_epi16 (hi, 8)),
+                          8);
+
+  return _mm256_adds_epu8 (_mm256_packus_epi16 (lo, hi), s);
+}
+
+/* Composite premultiplied pixels 8 at a time, returning how many were
+   done. */
+static unsigned long
+dm_blit_blend_avx2 (const unsigned char *src,
+                    unsigned char *dest,
+                    unsigned long count)
+{
+  __m256i s, a, zero, full;
+  unsigned long i;
+
+  zero = _mm256_setzero_si256 ();
+  full = _mm256_set1_epi32 (0xFF);
+
+  for (i = 0; i + 8 <= count; i += 8)
+    {
+      s = _mm256_loadu_si256 ((const __m256i *) (src + i * 4));
+      a = _mm256_srli_epi32 (s, 24);
+
+      if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (s, zero)) == -1)
+        continue;
+
+      if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (a, full)) != -1)
+        s = dm_blit_over_avx2 (s, _mm256_loadu_si256 ((const __m256i *)
+                                                      (dest + i * 4)));
+
+      _mm256_storeu_si256 ((__m256i *) (dest + i * 4), s);
+    }
+
+  return i;
+}
+
+/* Add pixels 8 at a time, returning how many were done. */
+static unsigned long
+dm_blit_add_avx2 (const unsigned char *src,
+                  unsigned char *dest,
+                  unsigned long count)
+{
+  __m256i s, d;
+  unsigned long i;
+
+  for (i = 0; i + 8 <= count; i += 8)
+    {
+      s = _mm256_loadu_si256 ((const __m256i *) (src + i * 4));
+      d = _mm256_loadu_si256 ((const __m256i *) (dest + i * 4));
+      _mm256_storeu_si256 ((__m256i *) (dest + i * 4),
+                           _mm256_adds_epu8 (s, d));
+    }
+
+  return i;
+}
+
+#endif /* DM_BLIT_HAVE_AVX2 */
@@ -0,0 +1,188 @@
+/** @file     gfx/dm-gfx-blit.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for driver-independent blit and fill kernels.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_BLIT_H__
+#define __DM_GFX_BLIT_H__
+
+/** Fills covering at least this many bytes use non-temporal stores,
+ *  so as not to flush the cache of everything else for pixels that
+ *  will not be read again soon.
+ */
+#define DM_BLIT_STREAM_BYTES 1048576UL
+
+enum
+  {
+    DM_BLIT_SSE2 = 1 << 0, /**< SSE2 kernels are compiled in. */
+    DM_BLIT_AVX2 = 1 << 1  /**< The CPU runs the AVX2 kernels. */
+  };
+
+/** Choose the blit kernels for the CPU.
+ *
+ *  Until this is called, only kernels the compiler can assume are
+ *  available (such as SSE2 on x86-64) are used.
+ *
+ *  @return a bit-field of DM_BLIT_ flags naming the kernels in use.
+ */
+
+unsigned int
+dm_blit_init (void);
+
+
+/** Copy a rectangle of pixels as-is.
+ *
+ *  @param src         Pointer to the first source pixel.
+ *  @param src_pitch   Bytes from one source row to the next.
+ *  @param dest        Pointer to the first destination pixel.
+ *  @param dest_pitch  Bytes from one destination row to the next.
+ *  @param width       Width of the rectangle, in pixels.
+ *  @param height      Height of the rectangle, in pixels.
+ *  @param bpp         Bytes per pixel.
+ */
+
+void
+dm_blit_copy (const unsigned char *src,
+              unsigned long src_pitch,
+              unsigned char *dest,
+              unsigned long dest_pitch,
+              unsigned int width,
+              unsigned int height,
+              unsigned int bpp);
+
+
+/** Copy a rectangle of pixels, leaving the destination alone where
+ *  the source pixel equals the colour key.
+ *
+ *  @param src         Pointer to the first source pixel.
+ *  @param src_pitch   Bytes from one source row to the next.
+ *  @param dest        Pointer to the first destination pixel.
+ *  @param dest_pitch  Bytes from one destination row to the next.
+ *  @param width       Width of the rectangle, in pixels.
+ *  @param height      Height of the rectangle, in pixels.
+ *  @param bpp         Bytes per pixel: 1, 2 or 4.
+ *  @param key         The colour key pixel value.
+ */
+
+void
+dm_blit_keyed (const unsigned char *src,
+               unsigned long src_pitch,
+               unsigned char *dest,
+               unsigned long dest_pitch,
+               unsigned int width,
+               unsigned int height,
+               unsigned int bpp,
+               unsigned long key);
+
+
+/** Fill a rectangle of pixels with one pixel value.
+ *
+ *  @param dest        Pointer to the first destination pixel.
+ *  @param dest_pitch  Bytes from one destination row to the next.
+ *  @param width       Width of the rectangle, in pixels.
+ *  @param height      Height of the rectangle, in pixels.
+ *  @param bpp         Bytes per pixel: 1, 2 or 4.
+ *  @param colour      The pixel value to fill with.
+ */
+
+void
+dm_blit_fill (unsigned char *dest,
+              unsigned long dest_pitch,
+              unsigned int width,
+              unsigned int height,
+              unsigned int bpp,
+              unsigned long colour);
+
+
+/** Expand a rectangle of 8-bit palette indices into pixels, by
+ *  looking each one up in a table of 256 pixel values.
+ *
+ *  @param src         Pointer to the first source index.
+ *  @param src_pitch   Bytes from one source row to the next.
+ *  @param dest        Pointer to the first destination pixel.
+ *  @param dest_pitch  Bytes from one destination row to the next.
+ *  @param width       Width of the rectangle, in pixels.
+ *  @param height      Height of the rectangle, in pixels.
+ *  @param bpp         Bytes per destination pixel: 2 or 4.
+ *  @param table       The pixel value of each index.
+ */
+
+void
+dm_blit_expand (const unsigned char *src,
+                unsigned long src_pitch,
+                unsigned char *dest,
+                unsigned long dest_pitch,
+                unsigned int width,
+                unsigned int height,
+                unsigned int bpp,
+                const unsigned int table[256]);
+
+
+/** Composite a rectangle of 32-bit premultiplied-alpha pixels over
+ *  the destination.
+ *
+ *  Alpha is the top 8 bits of each source pixel, and the order of the
+ *  other three channels does not matter, so long as it is the
+ *  destination's.  Each destination channel, its top 8 bits included,
+ *  becomes the source channel plus the destination channel scaled by
+ *  one minus the source alpha, so opaque destinations stay opaque.
+ *
+ *  @param src         Pointer to the first source pixel.
+ *  @param src_pitch   Bytes from one source row to the next.
+ *  @param dest        Pointer to the first destination pixel.
+ *  @param dest_pitch  Bytes from one destination row to the next.
+ *  @param width       Width of the rectangle, in pixels.
+ *  @param height      Height of the rectangle, in pixels.
+ */
+
+void
+dm_blit_blend (const unsigned char *src,
+               unsigned long src_pitch,
+               unsigned char *dest,
+               unsigned long dest_pitch,
+               unsigned int width,
+               unsigned int height);
+
+
+/** Add a rectangle of 32-bit premultiplied-alpha pixels to the
+ *  destination, channel by channel, saturating at 255.
+ *
+ *  @param src         Pointer to the first source pixel.
+ *  @param src_pitch   Bytes from one source row to the next.
+ *  @param dest        Pointer to the first destination pixel.
+ *  @param dest_pitch  Bytes from one destination row to the next.
+ *  @param width       Width of the rectangle, in pixels.
+ *  @param height      Height of the rectangle, in pixels.
+ */
+
+void
+dm_blit_add (const unsigned char *src,
+             unsigned long src_pitch,
+             unsigned char *dest,
+             unsigned long dest_pitch,
+             unsigned int width,
+             unsigned int height);
+
+#endif /* __DM_GFX_BLIT_H__ */
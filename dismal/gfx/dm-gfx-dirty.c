@@ -0,0 +1,246 @@
+/** @file     gfx/dm-gfx-dirty.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Dirty rectangle tracking for the DISMAL graphics subsystem.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-dirty.h"
+
+static int dm_dirty_touch(const dm_GfxRect *a, const dm_GfxRect *b);
+static void dm_dirty_union(dm_GfxRect *a, const dm_GfxRect *b);
+static unsigned long dm_dirty_area(const dm_GfxRect *r);
+static void dm_dirty_remove(int i);
+static void dm_dirty_absorb(dm_GfxRect *r);
+static int dm_dirty_clip(unsigned short pos, unsigned short len,
+                         unsigned long max, unsigned short *out_pos,
+                         unsigned short *out_len);
+
+void
+dm_dirty_add (unsigned short x,
+              unsigned short y,
+              unsigned short w,
+              unsigned short h)
+{
+  dm_GfxDirty *d;
+  dm_GfxRect r, u;
+  unsigned long sw, sh, growth, best_growth;
+  int i, best;
+
+  d = &dm_gfxdata->dirty;
+
+  if (d->full)
+    return;
+
+  /* Clip to the screen. */
+  sw = dm_gfxdata->width;
+  sh = dm_gfxdata->height;
+
+  if (dm_dirty_clip (x, w, sw, &r.x, &r.w) == DM_FAILURE
+      || dm_dirty_clip (y, h, sh, &r.y, &r.h) == DM_FAILURE)
+    return;
+
+  /* Absorb every rectangle the new one touches, so that the list
+     never holds overlaps. */
+  dm_dirty_absorb (&r);
+
+  /* If the list is full, merge with whichever rectangle wastes the
+     least area, and absorb anything that then touches. */
+  while (d->count == DM_GFX_DIRTY_MAX)
+    {
+      best = 0;
+      best_growth = (unsigned long) -1;
+
+      for (i = 0; i < d->count; i++)
+        {
+          u = r;
+          dm_dirty_union (&u, &d->rects[i]);
+          growth = (dm_dirty_area (&u) - dm_dirty_area (&d->rects[i])
+                    - dm_dirty_area (&r));
+
+          if (growth < best_growth)
+            {
+              best = i;
+              best_growth = growth;
+            }
+        }
+
+      dm_dirty_union (&r, &d->rects[best]);
+      dm_dirty_remove (best);
+
+      dm_dirty_absorb (&r);
+    }
+
+  d->rects[d->count++] = r;
+  d->area += dm_dirty_area (&r);
+
+  /* Past a point, updating piecemeal costs more than a full flip. */
+  if (d->area * 100 > sw * sh * DM_GFX_DIRTY_FULL_PERCENT)
+    d->full = DM_TRUE;
+}
+
+void
+dm_dirty_invalidate (void)
+{
+  dm_gfxdata->dirty.full = DM_TRUE;
+}
+
+void
+dm_dirty_present (void)
+{
+  dm_GfxDirty d;
+
+  dm_dirty_take (&d);
+  dm_dirty_present_rects (&d);
+}
+
+void
+dm_dirty_take (dm_GfxDirty *dest)
+{
+  dm_GfxDirty *d;
+
+  d = &dm_gfxdata->dirty;
+  *dest = *d;
+
+  d->count = 0;
+  d->area = 0;
+  d->full = DM_FALSE;
+}
+
+void
+dm_dirty_present_rects (const dm_GfxDirty *dirty)
+{
+  if (dirty->full || dm_gfxdata->driver->update_rects == NULL)
+    dm_gfxdata->driver->update ();
+  else
+    dm_gfxdata->driver->update_rects (dirty->rects, dirty->count);
+
+  dm_record_frame (dirty);
+}
+
+/* Clip a span to [0, max).  Spans that wrap past 65535 are treated as
+   starting off the left or top of the screen, as the drivers see
+   them. */
+static int
+dm_dirty_clip (unsigned short pos,
+               unsigned short len,
+               unsigned long max,
+               unsigned short *out_pos,
+               unsigned short *out_len)
+{
+  unsigned long end;
+
+  end = (unsigned long) pos + len;
+
+  if (end > 0xFFFFUL)
+    {
+      pos = 0;
+      end -= 0x10000UL;
+    }
+
+  if (pos >= max || end <= pos)
+    return DM_FAILURE;
+
+  if (end > max)
+    end = max;
+
+  *out_pos = pos;
+  *out_len = (unsigned short) (end - pos);
+  return DM_SUCCESS;
+}
+
+/* Check whether two rectangles overlap or share an edge. */
+static int
+dm_dirty_touch (const dm_GfxRect *a, const dm_GfxRect *b)
+{
+  return ((unsigned long) a->x <= (unsigned long) b->x + b->w
+          && (unsigned long) b->x <= (unsigned long) a->x + a->w
+          && (unsigned long) a->y <= (unsigned long) b->y + b->h
+          && (unsigned long) b->y <= (unsigned long) a->y + a->h);
+}
+
+/* Grow a to the bounding box of a and b. */
+static void
+dm_dirty_union (dm_GfxRect *a, const dm_GfxRect *b)
+{
+  unsigned long right, bottom;
+
+  right = (unsigned long) a->x + a->w;
+  bottom = (unsigned long) a->y + a->h;
+
+  if ((unsigned long) b->x + b->w > right)
+    right = (unsigned long) b->x + b->w;
+  if ((unsigned long) b->y + b->h > bottom)
+    bottom = (unsigned long) b->y + b->h;
+
+  if (b->x < a->x)
+    a->x = b->x;
+  if (b->y < a->y)
+    a->y = b->y;
+
+  a->w = (unsigned short) (right - a->x);
+  a->h = (unsigned short) (bottom - a->y);
+}
+
+static unsigned long
+dm_dirty_area (const dm_GfxRect *r)
+{
+  return (unsigned long) r->w * r->h;
+}
+
+/* Remove a rectangle from the list, by moving the last one into its
+   place. */
+static void
+dm_dirty_remove (int i)
+{
+  dm_GfxDirty *d;
+
+  d = &dm_gfxdata->dirty;
+  d->area -= dm_dirty_area (&d->rects[i]);
+  d->rects[i] = d->rects[--d->count];
+}
+
+/* Merge every rectangle that touches r into r, starting over each time
+   r grows. */
+static void
+dm_dirty_absorb (dm_GfxRect *r)
+{
+  dm_GfxDirty *d;
+  int i;
+
+  d = &dm_gfxdata->dirty;
+
+  for (i = 0; i < d->count; )
+    {
+      if (dm_dirty_touch (r, &d->rects[i]))
+        {
+          dm_dirty_union (r, &d->rects[i]);
+          dm_dirty_remove (i);
+          i = 0;
+        }
+      else
+        i++;
+    }
+}
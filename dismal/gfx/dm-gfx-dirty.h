@@ -0,0 +1,114 @@
+/** @file     gfx/dm-gfx-dirty.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for dirty rectangle tracking.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_DIRTY_H__
+#define __DM_GFX_DIRTY_H__
+
+enum {
+  DM_GFX_DIRTY_MAX = 32, /**< Most dirty rectangles kept per frame;
+                            beyond this, rectangles are merged. */
+  DM_GFX_DIRTY_FULL_PERCENT = 50 /**< If the dirty rectangles cover
+                                    more than this percentage of the
+                                    screen, the whole screen is
+                                    presented instead. */
+};
+
+typedef struct dm_GfxRect dm_GfxRect;
+typedef struct dm_GfxDirty dm_GfxDirty;
+
+/** A rectangle in screen (high-res) coordinates. */
+struct dm_GfxRect
+{
+  unsigned short x; /**< X coordinate of the left edge. */
+  unsigned short y; /**< Y coordinate of the top edge. */
+  unsigned short w; /**< Width. */
+  unsigned short h; /**< Height. */
+};
+
+/** The regions of the screen drawn to since it was last presented. */
+struct dm_GfxDirty
+{
+  dm_GfxRect rects[DM_GFX_DIRTY_MAX]; /**< Dirty rectangles, which
+                                         never overlap. */
+  int count;          /**< Number of dirty rectangles. */
+  unsigned long area; /**< Total area of the dirty rectangles. */
+  int full;           /**< If non-zero, the whole screen is dirty. */
+};
+
+
+/** Mark a region of the screen as drawn to.
+ *
+ *  Drawing functions call this themselves.
+ *
+ *  @param x  X coordinate of the region, in screen coordinates.
+ *  @param y  Y coordinate of the region, in screen coordinates.
+ *  @param w  Width of the region.
+ *  @param h  Height of the region.
+ */
+
+void dm_dirty_add(unsigned short x,
+                  unsigned short y,
+                  unsigned short w,
+                  unsigned short h);
+
+
+/** Mark the whole screen as drawn to, so that it is all presented at
+ *  the next dm_gfx_update().
+ */
+
+void dm_dirty_invalidate(void);
+
+
+/** Present the dirty regions of the screen, and start a new frame
+ *  with nothing dirty.
+ *
+ *  This should NOT be called outside dm_gfx_update.
+ */
+
+void dm_dirty_present(void);
+
+
+/** Take the regions drawn to this frame, and start a new frame with
+ *  nothing dirty.
+ *
+ *  @param dest  Structure to move the regions into.
+ */
+
+void dm_dirty_take(dm_GfxDirty *dest);
+
+
+/** Present the given regions of the screen.
+ *
+ *  The render thread presents frames with this (see
+ *  DM_GFX_PIPELINED).
+ *
+ *  @param dirty  The regions to present, taken by dm_dirty_take().
+ */
+
+void dm_dirty_present_rects(const dm_GfxDirty *dirty);
+
+#endif /* __DM_GFX_DIRTY_H__ */
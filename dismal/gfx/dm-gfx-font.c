@@ -0,0 +1,443 @@
+/** @file     gfx/dm-gfx-font.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Bitmap fonts and text drawing.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+/* Text is drawn from a cache of strings rendered whole into image
+   data of their own, so that a string drawn every frame costs one
+   blit rather than one per glyph.  The cache is small and replaces
+   its least recently drawn string; strings that change every frame
+   just cycle through it. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-font.h"
+
+static dm_GfxTextEntry *dm_text_lookup(const dm_Font *font,
+                                       const char *text,
+                                       unsigned short width);
+static int dm_text_render(dm_GfxTextEntry *entry,
+                          const dm_Font *font,
+                          const char *text,
+                          unsigned short width);
+static void dm_text_free_entry(dm_GfxTextEntry *entry);
+static int dm_text_draw_glyphs(const dm_Font *font,
+                               unsigned short x,
+                               unsigned short y,
+                               const char *text);
+static void dm_text_purge(const dm_Font *font);
+static int dm_text_glyph_batch(const dm_Font *font,
+                               const unsigned char *text,
+                               unsigned short gx[],
+                               unsigned short gy[],
+                               unsigned short gw[]);
+
+int
+dm_text_init (void)
+{
+  dm_gfxdata->text = calloc (1, sizeof (dm_GfxTextCache));
+
+  if (dm_gfxdata->text == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate text cache.");
+      return DM_FAILURE;
+    }
+
+  return DM_SUCCESS;
+}
+
+void
+dm_text_cleanup (void)
+{
+  if (dm_gfxdata->text == NULL)
+    return;
+
+  dm_text_purge (NULL);
+
+  free (dm_gfxdata->text);
+  dm_gfxdata->text = NULL;
+}
+
+dm_Font *
+dm_font_create (dm_ImageHandle image,
+                unsigned short glyph_w,
+                unsigned short glyph_h,
+                int cols)
+{
+  dm_Font *font;
+  int c;
+
+  if (cols <= 0 || glyph_w > 255)
+    {
+      dm_fatal ("GFX: Invalid font dimensions.");
+      return NULL;
+    }
+
+  font = malloc (sizeof (dm_Font));
+
+  if (font == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate font.");
+      return NULL;
+    }
+
+  font->image = image;
+  font->height = glyph_h;
+
+  for (c = 0; c < DM_FONT_GLYPHS; c++)
+    {
+      font->x[c] = (unsigned short) ((c % cols) * glyph_w);
+      font->y[c] = (unsigned short) ((c / cols) * glyph_h);
+      font->width[c] = (unsigned char) glyph_w;
+    }
+
+  return font;
+}
+
+void
+dm_font_set_widths (dm_Font *font, const unsigned char widths[])
+{
+  /* Strings already rendered in the font are now the wrong shape. */
+  dm_text_purge (font);
+  memcpy (font->width, widths, DM_FONT_GLYPHS);
+}
+
+void
+dm_font_destroy (dm_Font *font)
+{
+  if (font == NULL)
+    return;
+
+  dm_text_purge (font);
+  free (font);
+}
+
+unsigned short
+dm_text_width (const dm_Font *font, const char *text)
+{
+  const unsigned char *p;
+  unsigned long width;
+
+  width = 0;
+
+  for (p = (const unsigned char *) text; *p; p++)
+    width += font->width[*p];
+
+  return (width > 0xFFFFUL) ? 0xFFFF : (unsigned short) width;
+}
+
+int
+dm_draw_text (const dm_Font *font,
+              unsigned short x,
+              unsigned short y,
+              unsigned short box_width,
+              int alignment,
+              const char *text)
+{
+  dm_GfxTextEntry *entry;
+  unsigned short width;
+  long left;
+
+  if (*text == '\0')
+    return DM_SUCCESS;
+
+  width = dm_text_width (font, text);
+
+  switch (alignment)
+    {
+    default:
+    case DM_ALIGN_LEFT:
+      left = x;
+      break;
+    case DM_ALIGN_CENTRE:
+      left = (long) x + ((long) box_width - width) / 2;
+      break;
+    case DM_ALIGN_RIGHT:
+      left = (long) x + box_width - width;
+      break;
+    }
+
+  if (left < 0)
+    left = 0;
+
+  x = (unsigned short) left;
+
+  entry = dm_text_lookup (font, text, width);
+
+  if (entry == NULL)
+    return dm_text_draw_glyphs (font, x, y, text);
+
+  dm_coord_translate (&x, &y, DM_TRUE);
+
+  return dm_draw_image_translated (&entry->node, 0, 0, x, y,
+                                   entry->node.w, entry->node.h);
+}
+
+/* Find a string in the cache, rendering it into the least recently
+   drawn entry if it is not there.  Returns NULL if the string cannot
+   be cached. */
+static dm_GfxTextEntry *
+dm_text_lookup (const dm_Font *font,
+                const char *text,
+                unsigned short width)
+{
+  dm_GfxTextCache *cache;
+  dm_GfxTextEntry *entry, *victim;
+  unsigned long hash;
+  int i;
+
+  cache = dm_gfxdata->text;
+  hash = dm_ascii_hash (text);
+  victim = &cache->entries[0];
+
+  for (i = 0; i < DM_GFX_TEXT_CACHE; i++)
+    {
+      entry = &cache->entries[i];
+
+      if (entry->font == font && entry->hash == hash
+          && strcmp (entry->text, text) == 0)
+        {
+          entry->used = ++cache->clock;
+          return entry;
+        }
+
+      /* Prefer empty entries, then the least recently drawn. */
+      if (victim->font != NULL
+          && (entry->font == NULL || entry->used < victim->used))
+        victim = entry;
+    }
+
+  dm_text_free_entry (victim);
+
+  if (dm_text_render (victim, font, text, width) == DM_FAILURE)
+    return NULL;
+
+  victim->hash = hash;
+  victim->used = ++cache->clock;
+  return victim;
+}
+
+/* Render a string into an empty cache entry. */
+static int
+dm_text_render (dm_GfxTextEntry *entry,
+                const dm_Font *font,
+                const char *text,
+                unsigned short width)
+{
+  dm_GfxDriver *dri;
+  struct dm_GfxImageNode *img;
+  const unsigned char *p;
+  unsigned short gx[DM_TEXT_GLYPH_BATCH], gy[DM_TEXT_GLYPH_BATCH];
+  unsigned short gw[DM_TEXT_GLYPH_BATCH];
+  unsigned short w, h, cw, ch, dx;
+  void *data;
+  int i, n;
+
+  dri = dm_gfxdata->driver;
+
+  if (dri->create_image_data == NULL || dri->copy_image_data == NULL)
+    return DM_FAILURE;
+
+  /* Only cache strings rendered from the font itself, not from a
+     placeholder standing in for it. */
+  img = dm_image_node (font->image);
+
+  if (img == NULL || dm_image_drawable (img) != img)
+    return DM_FAILURE;
+
+  w = width;
+  h = font->height;
+  dm_coord_translate (&w, &h, DM_FALSE);
+
+  if (w == 0 || h == 0)
+    return DM_FAILURE;
+
+  data = dri->create_image_data (w, h);
+
+  if (data == NULL)
+    return DM_FAILURE;
+
+  dx = 0;
+
+  for (p = (const unsigned char *) text; *p; p += n)
+    {
+      n = dm_text_glyph_batch (font, p, gx, gy, gw);
+
+      for (i = 0; i < n; i++)
+        {
+          cw = gw[i];
+          ch = h;
+
+          /* Clip the glyph to the image, as drawing it would. */
+          if (img->w && (gx[i] >= img->w || gy[i] >= img->h))
+            cw = 0;
+          else if (img->w)
+            {
+              if (gx[i] + cw > img->w)
+                cw = img->w - gx[i];
+              if (gy[i] + ch > img->h)
+                ch = img->h - gy[i];
+            }
+
+          if (cw && ch
+              && dri->copy_image_data (data, img->data, img->x + gx[i],
+                                       img->y + gy[i], dx, 0,
+                                       cw, ch) == DM_FAILURE)
+            {
+              dri->free_image_data (data);
+              return DM_FAILURE;
+            }
+
+          dx += gw[i];
+        }
+    }
+
+  entry->text = malloc (strlen (text) + 1);
+
+  if (entry->text == NULL)
+    {
+      dri->free_image_data (data);
+      return DM_FAILURE;
+    }
+
+  strcpy (entry->text, text);
+
+  memset (&entry->node, 0, sizeof (struct dm_GfxImageNode));
+  entry->node.data = data;
+  entry->node.handle = DM_IMAGE_NONE;
+  entry->node.w = w;
+  entry->node.h = h;
+  entry->node.state = DM_IMAGE_READY;
+  entry->font = font;
+
+  return DM_SUCCESS;
+}
+
+/* Empty a cache entry. */
+static void
+dm_text_free_entry (dm_GfxTextEntry *entry)
+{
+  if (entry->font == NULL)
+    return;
+
+  /* Queued draws may still refer to the entry's data. */
+  dm_queue_flush ();
+
+  dm_gfxdata->driver->free_image_data (entry->node.data);
+  free (entry->text);
+
+  entry->font = NULL;
+  entry->text = NULL;
+}
+
+/* Draw a string a glyph at a time, translating its position once. */
+static int
+dm_text_draw_glyphs (const dm_Font *font,
+                     unsigned short x,
+                     unsigned short y,
+                     const char *text)
+{
+  struct dm_GfxImageNode *img;
+  const unsigned char *p;
+  unsigned short gx[DM_TEXT_GLYPH_BATCH], gy[DM_TEXT_GLYPH_BATCH];
+  unsigned short gw[DM_TEXT_GLYPH_BATCH];
+  unsigned short gh;
+  int i, n;
+
+  img = dm_image_node (font->image);
+
+  if (img == NULL)
+    return DM_FAILURE;
+
+  img = dm_image_drawable (img);
+
+  if (img == NULL)
+    return DM_FAILURE;
+
+  dm_coord_translate (&x, &y, DM_TRUE);
+
+  gh = font->height;
+  dm_coord_translate_array (NULL, &gh, 1, DM_FALSE);
+
+  for (p = (const unsigned char *) text; *p; p += n)
+    {
+      n = dm_text_glyph_batch (font, p, gx, gy, gw);
+
+      for (i = 0; i < n; i++)
+        {
+          if (gw[i])
+            dm_draw_image_translated (img, gx[i], gy[i], x, y, gw[i], gh);
+
+          x += gw[i];
+        }
+    }
+
+  return DM_SUCCESS;
+}
+
+/* Empty every cache entry rendered in a font, or every entry if font
+   is NULL. */
+static void
+dm_text_purge (const dm_Font *font)
+{
+  int i;
+
+  if (dm_gfxdata == NULL || dm_gfxdata->text == NULL)
+    return;
+
+  for (i = 0; i < DM_GFX_TEXT_CACHE; i++)
+    {
+      if (font == NULL || dm_gfxdata->text->entries[i].font == font)
+        dm_text_free_entry (&dm_gfxdata->text->entries[i]);
+    }
+}
+
+/* Look up the glyphs of up to DM_TEXT_GLYPH_BATCH characters of a
+   string, and translate them all at once.  Returns how many
+   characters were taken. */
+static int
+dm_text_glyph_batch (const dm_Font *font,
+                     const unsigned char *text,
+                     unsigned short gx[],
+                     unsigned short gy[],
+                     unsigned short gw[])
+{
+  int n;
+
+  for (n = 0; n < DM_TEXT_GLYPH_BATCH && text[n]; n++)
+    {
+      gx[n] = font->x[text[n]];
+      gy[n] = font->y[text[n]];
+      gw[n] = font->width[text[n]];
+    }
+
+  dm_coord_translate_array (gx, gy, n, DM_FALSE);
+  dm_coord_translate_array (gw, NULL, n, DM_FALSE);
+
+  return n;
+}
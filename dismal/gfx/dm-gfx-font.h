@@ -0,0 +1,187 @@
+/** @file     gfx/dm-gfx-font.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for bitmap fonts and text drawing.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_FONT_H__
+#define __DM_GFX_FONT_H__
+
+#include "../dismal.h"
+
+enum {
+  /* Text alignments. */
+  DM_ALIGN_LEFT   = 0, /**< Align text to the left of its box. */
+  DM_ALIGN_CENTRE = 1, /**< Centre text in its box. */
+  DM_ALIGN_RIGHT  = 2, /**< Align text to the right of its box. */
+
+  DM_FONT_GLYPHS = 256,   /**< Number of glyphs in a font. */
+  DM_GFX_TEXT_CACHE = 32, /**< Number of rendered strings kept in the
+                             text cache. */
+  DM_TEXT_GLYPH_BATCH = 64 /**< Most glyphs translated at once when
+                              drawing a string. */
+};
+
+typedef struct dm_Font dm_Font;
+typedef struct dm_GfxTextEntry dm_GfxTextEntry;
+typedef struct dm_GfxTextCache dm_GfxTextCache;
+
+/** A bitmap font.
+ *
+ *  The glyphs lie in a grid of equally sized cells in the font's
+ *  image, one cell per character code, counting along rows.  Each
+ *  glyph is drawn from the left of its cell, and may be narrower
+ *  than it.
+ */
+struct dm_Font
+{
+  dm_ImageHandle image;     /**< Image holding the glyphs. */
+  unsigned short height;    /**< Height of every glyph. */
+  unsigned short x[DM_FONT_GLYPHS]; /**< X coordinate of each glyph
+                                       in the image. */
+  unsigned short y[DM_FONT_GLYPHS]; /**< Y coordinate of each glyph
+                                       in the image. */
+  unsigned char width[DM_FONT_GLYPHS]; /**< Width of each glyph,
+                                          which is also how far the
+                                          pen advances past it. */
+};
+
+/** A string rendered into image data of its own. */
+struct dm_GfxTextEntry
+{
+  const dm_Font *font;   /**< Font the string was rendered in, or
+                            NULL if the entry is empty. */
+  unsigned long hash;    /**< Hash of the string. */
+  char *text;            /**< Copy of the string. */
+  unsigned long used;    /**< Value of the cache's clock when the
+                            entry was last drawn. */
+  struct dm_GfxImageNode node; /**< Image node holding the rendered
+                                  string, which is not in the image
+                                  table. */
+};
+
+/** The cache of rendered strings. */
+struct dm_GfxTextCache
+{
+  dm_GfxTextEntry entries[DM_GFX_TEXT_CACHE]; /**< Cached strings. */
+  unsigned long clock;   /**< Number of cached draws so far. */
+};
+
+
+/** Initialise the text cache.
+ *
+ *  This should NOT be called outside dm_gfx_init.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_text_init(void);
+
+
+/** Empty and shut down the text cache.
+ *
+ *  This should NOT be called outside dm_gfx_cleanup.
+ */
+
+void dm_text_cleanup(void);
+
+
+/** Create a fixed-width font.
+ *
+ *  @param image    The image holding the glyphs.
+ *  @param glyph_w  The width of each glyph's cell.
+ *  @param glyph_h  The height of each glyph's cell.
+ *  @param cols     The number of cells in each row of the image.
+ *
+ *  @return  the new font, or NULL if it could not be created.
+ */
+
+dm_Font *dm_font_create(dm_ImageHandle image,
+                        unsigned short glyph_w,
+                        unsigned short glyph_h,
+                        int cols);
+
+
+/** Make a font variable-width.
+ *
+ *  @param font    The font.
+ *  @param widths  The width of each of the font's DM_FONT_GLYPHS
+ *                 glyphs; none may be wider than its cell.
+ */
+
+void dm_font_set_widths(dm_Font *font, const unsigned char widths[]);
+
+
+/** Destroy a font, and any strings cached in it.
+ *
+ *  @param font  The font to destroy.
+ */
+
+void dm_font_destroy(dm_Font *font);
+
+
+/** Measure a string.
+ *
+ *  @param font  The font to measure the string in.
+ *  @param text  The string.
+ *
+ *  @return  the width of the string.
+ */
+
+unsigned short dm_text_width(const dm_Font *font, const char *text);
+
+
+/** Draw a string.
+ *
+ *  The string is rendered once into image data of its own and kept
+ *  in a small cache, so redrawing a string that has not changed
+ *  since it was last drawn, such as a HUD label, costs one blit.
+ *  Strings that cannot be cached, because the driver cannot create
+ *  image data or the font is still loading, are drawn a glyph at a
+ *  time.
+ *
+ *  Coordinates are translated in the same way as dm_draw_image()'s.
+ *
+ *  @param font       The font to draw the string in.
+ *  @param x          The X-coordinate of the left of the string's
+ *                    box.
+ *  @param y          The Y-coordinate of the top of the string.
+ *  @param box_width  The width of the box to align the string in;
+ *                    this need only be given for DM_ALIGN_CENTRE
+ *                    and DM_ALIGN_RIGHT.
+ *  @param alignment  DM_ALIGN_LEFT, DM_ALIGN_CENTRE or
+ *                    DM_ALIGN_RIGHT.
+ *  @param text       The string.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_draw_text(const dm_Font *font,
+                 unsigned short x,
+                 unsigned short y,
+                 unsigned short box_width,
+                 int alignment,
+                 const char *text);
+
+#endif /* __DM_GFX_FONT_H__ */
@@ -0,0 +1,333 @@
+/** @file     gfx/dm-gfx-load.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Background image loader for the DISMAL graphics subsystem.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+/* Images are decoded on DISMAL's worker pool, then handed back to the
+   main thread, which prepares them for drawing (colour keys, atlas
+   packing) and publishes them to their image nodes. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-load.h"
+
+enum {
+  DM_MANIFEST_LINE_LEN = 512 /**< Maximum manifest line length. */
+};
+
+static void dm_load_decode(void *arg);
+static void dm_load_publish(dm_GfxLoadJob *job);
+
+int
+dm_load_init (void)
+{
+  dm_GfxLoader *ld;
+
+  ld = malloc (sizeof (dm_GfxLoader));
+
+  if (ld == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate image loader.");
+      return DM_FAILURE;
+    }
+
+  ld->lock = dm_mutex_create ();
+
+  if (ld->lock == NULL)
+    {
+      dm_fatal ("GFX: Could not create image loader lock.");
+      free (ld);
+      return DM_FAILURE;
+    }
+
+  dm_pool_group_init (&ld->group);
+  ld->jobs = NULL;
+  ld->queued = ld->published = 0;
+
+  dm_gfxdata->loader = ld;
+  return DM_SUCCESS;
+}
+
+void
+dm_load_cleanup (void)
+{
+  dm_GfxLoader *ld;
+
+  ld = dm_gfxdata->loader;
+
+  if (ld == NULL)
+    return;
+
+  dm_load_wait ();
+  dm_mutex_destroy (ld->lock);
+  free (ld);
+
+  dm_gfxdata->loader = NULL;
+}
+
+dm_ImageHandle
+dm_load_image_async (const char filename[])
+{
+  dm_GfxLoader *ld;
+  dm_GfxLoadJob *job;
+  struct dm_GfxImageNode *node;
+
+  ld = dm_gfxdata->loader;
+  node = dm_get_image (filename, NULL);
+
+  if (node)
+    return node->handle;
+
+  /* Fall back to loading here and now if there is nobody to load in 
+     the background, or if the image is in a pack and so needs no
+     decoding. */
+  if (dm_get_pool () == NULL
+      || dm_pack_contains (filename)
+      || dm_gfxdata->driver->decode_image_data == NULL
+      || dm_gfxdata->driver->finish_image_data == NULL)
+    return dm_image_acquire (filename);
+
+  job = malloc (sizeof (dm_GfxLoadJob));
+  node = malloc (sizeof (struct dm_GfxImageNode));
+
+  if (job)
+    job->filename = malloc (strlen (filename) + 1);
+
+  if (job == NULL || node == NULL || job->filename == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate background load of %s.",
+                filename);
+      if (job && job->filename)
+        free (job->filename);
+      if (job)
+        free (job);
+      if (node)
+        free (node);
+      return DM_IMAGE_NONE;
+    }
+
+  /* Install an empty node now so that the image has a handle. */
+  node->data = NULL;
+  node->page = NULL;
+  node->lowres = NULL;
+  node->pack = NULL;
+  node->x = node->y = node->w = node->h = 0;
+  node->state = DM_IMAGE_LOADING;
+  node->used = node->pinned = DM_FALSE;
+  node->blend = DM_BLEND_KEYED;
+  node->size = 0;
+
+  node = dm_get_image (filename, node);
+
+  if (node == NULL)
+    {
+      free (job->filename);
+      free (job);
+      return DM_IMAGE_NONE;
+    }
+
+  strcpy (job->filename, filename);
+  job->node = node;
+  job->decoded = NULL;
+  job->done = DM_FALSE;
+
+  /* Start a new batch if nothing else is in flight. */
+  if (ld->jobs == NULL)
+    ld->queued = ld->published = 0;
+
+  job->next = ld->jobs;
+  ld->jobs = job;
+  ld->queued++;
+
+  dm_pool_submit (dm_get_pool (), &ld->group, dm_load_decode, job);
+
+  return node->handle;
+}
+
+int
+dm_preload_manifest (const char filename[])
+{
+  FILE *manifest;
+  char line[DM_MANIFEST_LINE_LEN];
+  char *p;
+  int result;
+
+  manifest = fopen (filename, "r");
+
+  if (manifest == NULL)
+    {
+      dm_fatal ("GFX: Could not open manifest %s.", filename);
+      return DM_FAILURE;
+    }
+
+  result = DM_SUCCESS;
+
+  while (fgets (line, sizeof (line), manifest))
+    {
+      /* Strip the line ending. */
+      for (p = line; *p != '\0' && *p != '\n' && *p != '\r'; p++)
+        ;
+      *p = '\0';
+
+      if (line[0] == '\0' || line[0] == '#')
+        continue;
+
+      if (dm_load_image_async (line) == DM_IMAGE_NONE)
+        result = DM_FAILURE;
+    }
+
+  fclose (manifest);
+  return result;
+}
+
+int
+dm_load_poll (void)
+{
+  dm_GfxLoader *ld;
+  dm_GfxLoadJob *job, **jp, *finished;
+  int pending;
+
+  ld = dm_gfxdata->loader;
+  finished = NULL;
+  pending = 0;
+
+  /* Pull the finished jobs off the outstanding list under the lock,
+     then publish them without it. */
+  dm_mutex_lock (ld->lock);
+
+  for (jp = &ld->jobs; *jp != NULL; )
+    {
+      job = *jp;
+
+      if (job->done)
+        {
+          *jp = job->next;
+          job->next = finished;
+          finished = job;
+        }
+      else
+        {
+          jp = &job->next;
+          pending++;
+        }
+    }
+
+  dm_mutex_unlock (ld->lock);
+
+  while (finished)
+    {
+      job = finished;
+      finished = job->next;
+
+      dm_load_publish (job);
+      ld->published++;
+
+      free (job->filename);
+      free (job);
+    }
+
+  return pending;
+}
+
+void
+dm_load_progress (int *done, int *total)
+{
+  *done = dm_gfxdata->loader->published;
+  *total = dm_gfxdata->loader->queued;
+}
+
+void
+dm_load_wait (void)
+{
+  dm_pool_wait (dm_get_pool (), &dm_gfxdata->loader->group);
+  dm_load_poll ();
+}
+
+void
+dm_image_set_placeholder (dm_ImageHandle handle)
+{
+  dm_gfxdata->placeholder = handle;
+}
+
+void
+dm_load_cancel (struct dm_GfxImageNode *node)
+{
+  dm_GfxLoadJob *job;
+
+  for (job = dm_gfxdata->loader->jobs; job != NULL; job = job->next)
+    {
+      if (job->node == node)
+        job->node = NULL;
+    }
+}
+
+/* Worker pool job: decode one image. */
+static void
+dm_load_decode (void *arg)
+{
+  dm_GfxLoadJob *job;
+  void *decoded;
+
+  job = (dm_GfxLoadJob*) arg;
+  decoded = dm_gfxdata->driver->decode_image_data (job->filename);
+
+  dm_mutex_lock (dm_gfxdata->loader->lock);
+  job->decoded = decoded;
+  job->done = DM_TRUE;
+  dm_mutex_unlock (dm_gfxdata->loader->lock);
+}
+
+/* Prepare a decoded image and hand it to its node, or throw it away
+   if the node has gone. */
+static void
+dm_load_publish (dm_GfxLoadJob *job)
+{
+  struct dm_GfxImageNode *node;
+
+  node = job->node;
+
+  if (node == NULL || node->state != DM_IMAGE_LOADING)
+    {
+      /* Deleted, or loaded synchronously in the meantime. */
+      if (job->decoded)
+        dm_gfxdata->driver->free_image_data (job->decoded);
+      return;
+    }
+
+  if (job->decoded)
+    node->data = dm_gfxdata->driver->finish_image_data (job->decoded);
+
+  if (node->data == NULL)
+    {
+      dm_fatal ("GFX: Could not load data for image %s", job->filename);
+      node->state = DM_IMAGE_FAILED;
+      return;
+    }
+
+  dm_image_loaded (node);
+}
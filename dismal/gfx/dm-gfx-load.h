@@ -0,0 +1,167 @@
+/** @file     gfx/dm-gfx-load.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for the background image loader.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_LOAD_H__
+#define __DM_GFX_LOAD_H__
+
+#include "../dismal.h"
+
+typedef struct dm_GfxLoadJob dm_GfxLoadJob;
+typedef struct dm_GfxLoader dm_GfxLoader;
+
+/** A request to load one image in the background. */
+struct dm_GfxLoadJob
+{
+  char *filename;    /**< Copy of the image's filename, as the name
+                        pool may move while the job runs. */
+  struct dm_GfxImageNode *node; /**< Node to publish the image to, or
+                                   NULL if it was deleted while
+                                   loading.  Only touched by the main
+                                   thread. */
+  void *decoded;     /**< Decoded image data, set by the worker. */
+  int done;          /**< Set by the worker once decoded is valid. */
+  struct dm_GfxLoadJob *next; /**< The next outstanding job. */
+};
+
+/** State of the background image loader. */
+struct dm_GfxLoader
+{
+  dm_Mutex *lock;        /**< Lock protecting the jobs' done flags. */
+  dm_PoolGroup group;    /**< Pool group holding every decode job. */
+  dm_GfxLoadJob *jobs;   /**< Outstanding (unpublished) jobs. */
+  int queued;            /**< Images queued in the current batch. */
+  int published;         /**< Images published in the current
+                            batch. */
+};
+
+
+/** Initialise the background image loader.
+ *
+ *  This should NOT be called outside dm_gfx_init.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_load_init(void);
+
+
+/** Shut down the background image loader.
+ *
+ *  This waits for any images still being decoded.
+ */
+
+void dm_load_cleanup(void);
+
+
+/** Load an image in the background.
+ *
+ *  The image is decoded on DISMAL's worker pool.  Its handle is
+ *  usable straight away, but draws against it are skipped (or draw
+ *  the placeholder image) until dm_load_poll() publishes it, which
+ *  dm_gfx_update() does every frame.
+ *
+ *  If there is no worker pool, or the driver cannot decode images off
+ *  the main thread, the image is loaded immediately instead.
+ *
+ *  @param filename  The name of the image file (eg boom.png).
+ *
+ *  @return  the image's handle, or DM_IMAGE_NONE on failure.  If the
+ *           image is already loaded or loading, its existing handle
+ *           is returned.
+ */
+
+dm_ImageHandle dm_load_image_async(const char filename[]);
+
+
+/** Load every image listed in a manifest file in the background.
+ *
+ *  The manifest lists one image filename per line.  Blank lines, and
+ *  lines starting with '#', are ignored.
+ *
+ *  @see dm_load_image_async
+ *
+ *  @param filename  The name of the manifest file.
+ *
+ *  @return  DM_SUCCESS if the manifest was read and every image
+ *           queued, DM_FAILURE otherwise.
+ */
+
+int dm_preload_manifest(const char filename[]);
+
+
+/** Publish any images that have finished loading in the background.
+ *
+ *  This must be called on the main thread.  dm_gfx_update() calls it
+ *  every frame, so there is normally no need to call it directly.
+ *
+ *  @return  the number of images still loading.
+ */
+
+int dm_load_poll(void);
+
+
+/** Report background loading progress.
+ *
+ *  The counts cover the current batch of background loads, which
+ *  begins when an image is queued with no others outstanding.
+ *
+ *  @param done   Pointer to store the number of images published so
+ *                far in the batch.
+ *  @param total  Pointer to store the number of images queued in the
+ *                batch.
+ */
+
+void dm_load_progress(int *done, int *total);
+
+
+/** Wait for every background load to finish, then publish them.
+ *
+ *  The calling thread helps with decoding while it waits.
+ */
+
+void dm_load_wait(void);
+
+
+/** Set the image drawn in place of images that are still loading.
+ *
+ *  @param handle  Handle of the placeholder image, or DM_IMAGE_NONE to
+ *                 skip drawing images that are not yet ready.
+ */
+
+void dm_image_set_placeholder(dm_ImageHandle handle);
+
+
+/** Forget any background load publishing to the given node.
+ *
+ *  This is called when a node that is still loading is freed.
+ *
+ *  @param node  The node being freed.
+ */
+
+void dm_load_cancel(struct dm_GfxImageNode *node);
+
+#endif /* __DM_GFX_LOAD_H__ */
@@ -0,0 +1,806 @@
+/** @file     gfx/dm-gfx-memory.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    In-memory framebuffer implementation of the DISMAL
+ *            graphical subsystem.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+/* The screen is a plain buffer of 32-bit pixels in memory, so no
+   display is needed, and everything is drawn with DISMAL's own
+   blitters, clipped as the SDL driver clips.  Images are decoded with
+   SDL_image, which needs no display either, and converted to the
+   buffer's format once, when they are loaded.
+
+   Each frame presented is checksummed, and can be written out as a
+   PPM file, so that rendering can be checked and timed on machines
+   with no display at all. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL/SDL.h"
+#include "SDL/SDL_image.h"
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-memory.h"
+
+static dm_GfxMemData *_dm_gfxmem;
+
+static dm_GfxMemImage *dm_mem_image_new(unsigned int width,
+                                        unsigned int height);
+static void dm_mem_key_magenta(dm_GfxMemImage *img);
+static dm_GfxMemImage *dm_mem_convert(SDL_Surface *src,
+                                      int keyed,
+                                      Uint32 key);
+static void dm_mem_blit(dm_GfxMemImage *src,
+                        int sx, int sy, int dx, int dy, int w, int h);
+static void dm_mem_blend(const unsigned char *src,
+                         unsigned long src_pitch,
+                         unsigned char *dest,
+                         unsigned long dest_pitch,
+                         unsigned int width,
+                         unsigned int height);
+static void dm_mem_fill(int x, int y, int w, int h, Uint32 colour);
+static unsigned long dm_mem_checksum(void);
+
+void dm_gfx_memory_register(dm_GfxDriver *driver)
+{
+  driver->init = dm_gfx_memory_init;
+  driver->update = dm_gfx_memory_update;
+  driver->cleanup = dm_gfx_memory_cleanup;
+  driver->load_image_data = dm_mem_load_image_data;
+  driver->free_image_data = dm_mem_free_image_data;
+  driver->draw_image = dm_mem_draw_image;
+  driver->fill_rect_rgb = dm_mem_fill_rect_rgb;
+  driver->create_image_data = dm_mem_create_image_data;
+  driver->copy_image_data = dm_mem_copy_image_data;
+  driver->image_data_size = dm_mem_image_data_size;
+  driver->decode_image_data = dm_mem_decode_image_data;
+  driver->finish_image_data = dm_mem_finish_image_data;
+  driver->image_data_bytes = dm_mem_image_data_bytes;
+  driver->scale_image_data = dm_mem_scale_image_data;
+  driver->image_data_from_pixels = dm_mem_image_data_from_pixels;
+  driver->submit_batch = dm_mem_submit_batch;
+  driver->read_pixels = dm_mem_read_pixels;
+  driver->blend_image_data = dm_mem_blend_image_data;
+}
+
+
+int dm_gfx_memory_init(dm_Config *conf)
+{
+  dm_GfxMemImage *screen;
+
+  dm_debug("GFX-MEM: Initialising.");
+
+  _dm_gfxmem = calloc(1, sizeof(dm_GfxMemData));
+
+  if (_dm_gfxmem == NULL) {
+    dm_fatal("GFX-MEM: Could not initialise driver structure.");
+    return DM_FAILURE;
+  }
+
+  screen = dm_mem_image_new(conf->gfx_screen_width,
+                            conf->gfx_screen_height);
+
+  if (screen == NULL) {
+    dm_fatal("GFX-MEM: Could not initialise screen.");
+    free(_dm_gfxmem);
+    _dm_gfxmem = NULL;
+    return DM_FAILURE;
+  }
+
+  /* The screen is a copy, so that the driver structure owns it. */
+  _dm_gfxmem->screen = *screen;
+  free(screen);
+
+  dm_blit_init();
+  dm_mem_fill(0, 0, _dm_gfxmem->screen.width, _dm_gfxmem->screen.height,
+              DM_MEM_AMASK);
+
+  return DM_SUCCESS;
+}
+
+void dm_gfx_memory_update(void)
+{
+  char filename[DM_MEM_DUMP_NAME];
+
+  _dm_gfxmem->checksum = dm_mem_checksum();
+  _dm_gfxmem->frames++;
+
+  /* dm_gfx_memory_dump_frames has checked the pattern fits. */
+  if (_dm_gfxmem->dump) {
+    sprintf(filename, _dm_gfxmem->dump, _dm_gfxmem->frames);
+    dm_gfx_memory_write_ppm(filename);
+  }
+}
+
+void dm_gfx_memory_cleanup(void)
+{
+  if (_dm_gfxmem) {
+    free(_dm_gfxmem->screen.block);
+    free(_dm_gfxmem);
+    _dm_gfxmem = NULL;
+  }
+}
+
+const unsigned char *dm_gfx_memory_pixels(unsigned int *width,
+                                          unsigned int *height,
+                                          unsigned long *pitch)
+{
+  if (_dm_gfxmem == NULL)
+    return NULL;
+
+  if (width)
+    *width = _dm_gfxmem->screen.width;
+  if (height)
+    *height = _dm_gfxmem->screen.height;
+  if (pitch)
+    *pitch = _dm_gfxmem->screen.pitch;
+
+  return _dm_gfxmem->screen.pixels;
+}
+
+unsigned long dm_gfx_memory_checksum(void)
+{
+  return (_dm_gfxmem ? _dm_gfxmem->checksum : 0);
+}
+
+unsigned long dm_gfx_memory_frames(void)
+{
+  return (_dm_gfxmem ? _dm_gfxmem->frames : 0);
+}
+
+int dm_gfx_memory_write_ppm(const char filename[])
+{
+  FILE *file;
+  unsigned char *row, *p;
+  const Uint32 *px;
+  unsigned int x, y, width;
+  int ok;
+
+  if (_dm_gfxmem == NULL)
+    return DM_FAILURE;
+
+  width = _dm_gfxmem->screen.width;
+  row = malloc(width * 3);
+  file = fopen(filename, "wb");
+
+  if (row == NULL || file == NULL) {
+    dm_fatal("GFX-MEM: Couldn't write %s!", filename);
+    if (row)
+      free(row);
+    if (file)
+      fclose(file);
+    return DM_FAILURE;
+  }
+
+  ok = (fprintf(file, "P6\n%u %u\n255\n", width,
+                _dm_gfxmem->screen.height) > 0);
+
+  for (y = 0; ok && y < _dm_gfxmem->screen.height; y++) {
+    px = (const Uint32*) (_dm_gfxmem->screen.pixels
+                          + y * _dm_gfxmem->screen.pitch);
+
+    for (x = 0, p = row; x < width; x++, p += 3) {
+      p[0] = (unsigned char) ((px[x] & DM_MEM_RMASK) >> 16);
+      p[1] = (unsigned char) ((px[x] & DM_MEM_GMASK) >> 8);
+      p[2] = (unsigned char) (px[x] & DM_MEM_BMASK);
+    }
+
+    ok = (fwrite(row, 3, width, file) == width);
+  }
+
+  free(row);
+
+  if (fclose(file) != 0 || !ok) {
+    dm_fatal("GFX-MEM: Couldn't write %s!", filename);
+    return DM_FAILURE;
+  }
+
+  return DM_SUCCESS;
+}
+
+int dm_gfx_memory_dump_frames(const char *pattern)
+{
+  if (_dm_gfxmem == NULL)
+    return DM_FAILURE;
+
+  if (pattern == NULL) {
+    _dm_gfxmem->dump = NULL;
+    return DM_SUCCESS;
+  }
+
+  if (dm_check_frame_pattern(pattern, DM_MEM_DUMP_NAME) == DM_FAILURE) {
+    dm_debug("GFX-MEM: Dump pattern %s is too long, or not a single "
+             "%%lu of at most two digits' width.", pattern);
+    return DM_FAILURE;
+  }
+
+  _dm_gfxmem->dump = pattern;
+  return DM_SUCCESS;
+}
+
+void *dm_mem_load_image_data(const char filename[])
+{
+  void *decoded;
+
+  decoded = dm_mem_decode_image_data(filename);
+
+  if (decoded == NULL)
+    return NULL;
+
+  return dm_mem_finish_image_data(decoded);
+}
+
+void *dm_mem_decode_image_data(const char filename[])
+{
+  SDL_Surface *surf;
+  dm_GfxMemImage *img;
+
+  surf = IMG_Load(filename);
+
+  if (surf == NULL) {
+    dm_fatal("GFX-MEM: Couldn't load %s!\n", filename);
+    return NULL;
+  }
+
+  /* Magenta is made transparent once the blend mode is known, as
+     the SDL driver's colour key only applies in some modes. */
+  img = dm_mem_convert(surf, DM_FALSE, 0);
+
+  if (img)
+    img->magenta = (surf->format->Amask ? DM_MEM_MAGENTA_KEYED
+                    : DM_MEM_MAGENTA_BLENDED);
+
+  SDL_FreeSurface(surf);
+
+  return (void*) img;
+}
+
+void *dm_mem_finish_image_data(void *decoded)
+{
+  /* Decoding left nothing to do. */
+  return decoded;
+}
+
+void dm_mem_free_image_data(void *data)
+{
+  dm_GfxMemImage *img;
+
+  if (data) {
+    img = (dm_GfxMemImage*) data;
+    free(img->block);
+    free(img);
+  }
+}
+
+void *dm_mem_create_image_data(unsigned int width, unsigned int height)
+{
+  dm_GfxMemImage *img;
+
+  img = dm_mem_image_new(width, height);
+
+  if (img == NULL) {
+    dm_fatal("GFX-MEM: Couldn't create %ux%u image!", width, height);
+    return NULL;
+  }
+
+  /* Zero pixels are transparent. */
+  memset(img->pixels, 0, img->pitch * height);
+  img->transparency = DM_MEM_KEYED;
+
+  return (void*) img;
+}
+
+int dm_mem_copy_image_data(void *dest,
+                           void *src,
+                           unsigned int src_x,
+                           unsigned int src_y,
+                           unsigned int dest_x,
+                           unsigned int dest_y,
+                           unsigned int width,
+                           unsigned int height)
+{
+  dm_GfxMemImage *d, *s;
+
+  d = (dm_GfxMemImage*) dest;
+  s = (dm_GfxMemImage*) src;
+
+  /* As with the SDL driver, translucent images are not copied. */
+  if (s->transparency >= DM_MEM_BLENDED)
+    return DM_FAILURE;
+
+  if (src_x + width > s->width || src_y + height > s->height
+      || dest_x + width > d->width || dest_y + height > d->height)
+    return DM_FAILURE;
+
+  dm_blit_copy(s->pixels + src_y * s->pitch + src_x * 4, s->pitch,
+               d->pixels + dest_y * d->pitch + dest_x * 4, d->pitch,
+               width, height, 4);
+
+  if (s->transparency > d->transparency)
+    d->transparency = s->transparency;
+
+  return DM_SUCCESS;
+}
+
+int dm_mem_image_data_size(void *data,
+                           unsigned int *width,
+                           unsigned int *height)
+{
+  if (data) {
+    *width = ((dm_GfxMemImage*) data)->width;
+    *height = ((dm_GfxMemImage*) data)->height;
+    return DM_SUCCESS;
+  }
+
+  return DM_FAILURE;
+}
+
+unsigned long dm_mem_image_data_bytes(void *data)
+{
+  dm_GfxMemImage *img;
+
+  img = (dm_GfxMemImage*) data;
+
+  return img->pitch * img->height;
+}
+
+void *dm_mem_scale_image_data(void *data,
+                              unsigned int x_factor,
+                              unsigned int y_factor)
+{
+  dm_GfxMemImage *src, *img;
+
+  src = (dm_GfxMemImage*) data;
+  img = dm_mem_image_new(src->width * x_factor, src->height * y_factor);
+
+  if (img == NULL) {
+    dm_fatal("GFX-MEM: Couldn't create enlarged image!");
+    return NULL;
+  }
+
+  dm_pixel_scale_nearest(src->pixels, src->pitch, img->pixels, img->pitch,
+                         src->width, src->height, 4, x_factor, y_factor);
+  img->transparency = src->transparency;
+
+  return (void*) img;
+}
+
+void *dm_mem_image_data_from_pixels(const void *pixels,
+                                    unsigned int width,
+                                    unsigned int height,
+                                    unsigned int pitch,
+                                    const dm_GfxPixelFormat *format)
+{
+  SDL_Surface *surf;
+  dm_GfxMemImage *img;
+
+  /* The pixels are only read, to convert them. */
+  surf = SDL_CreateRGBSurfaceFrom((void*) pixels, width, height,
+                                  format->bits, pitch,
+                                  format->rmask, format->gmask,
+                                  format->bmask, format->amask);
+
+  if (surf == NULL) {
+    dm_fatal("GFX-MEM: Couldn't create surface from pixels!");
+    return NULL;
+  }
+
+  img = dm_mem_convert(surf, format->keyed, (Uint32) format->key);
+  SDL_FreeSurface(surf);
+
+  return (void*) img;
+}
+
+int dm_mem_draw_image(struct dm_GfxImageNode *image,
+                      unsigned int image_x,
+                      unsigned int image_y,
+                      unsigned int screen_x,
+                      unsigned int screen_y,
+                      unsigned int width,
+                      unsigned int height)
+{
+  if (image->data == NULL)
+    return DM_FAILURE;
+
+  dm_mem_blit((dm_GfxMemImage*) image->data, image_x, image_y,
+              screen_x, screen_y, width, height);
+
+  return DM_SUCCESS;
+}
+
+void dm_mem_fill_rect_rgb(unsigned int x,
+                          unsigned int y,
+                          unsigned int w,
+                          unsigned int h,
+                          unsigned int r,
+                          unsigned int g,
+                          unsigned int b)
+{
+  dm_mem_fill(x, y, w, h,
+              DM_MEM_AMASK | ((Uint32) (r & 0xFF) << 16)
+              | ((g & 0xFF) << 8) | (b & 0xFF));
+}
+
+void dm_mem_submit_batch(const dm_GfxCommand *cmds, unsigned long count)
+{
+  unsigned long i;
+
+  for (i = 0; i < count; i++, cmds++) {
+    if (cmds->type == DM_GFX_CMD_FILL)
+      dm_mem_fill_rect_rgb(cmds->screen_x, cmds->screen_y,
+                           cmds->width, cmds->height,
+                           cmds->r, cmds->g, cmds->b);
+    else if (cmds->type == DM_GFX_CMD_IMAGE && cmds->image->data)
+      dm_mem_blit((dm_GfxMemImage*) cmds->image->data,
+                  cmds->image_x, cmds->image_y,
+                  cmds->screen_x, cmds->screen_y,
+                  cmds->width, cmds->height);
+  }
+}
+
+int dm_mem_read_pixels(const dm_GfxRect *rect, unsigned char *dest)
+{
+  const Uint32 *px;
+  unsigned int x, y;
+
+  for (y = rect->y; y < (unsigned int) rect->y + rect->h; y++) {
+    px = (const Uint32*) (_dm_gfxmem->screen.pixels
+                          + y * _dm_gfxmem->screen.pitch) + rect->x;
+
+    for (x = 0; x < rect->w; x++, dest += 3) {
+      dest[0] = (unsigned char) ((px[x] & DM_MEM_RMASK) >> 16);
+      dest[1] = (unsigned char) ((px[x] & DM_MEM_GMASK) >> 8);
+      dest[2] = (unsigned char) (px[x] & DM_MEM_BMASK);
+    }
+  }
+
+  return DM_SUCCESS;
+}
+
+void *dm_mem_blend_image_data(void *data, int blend)
+{
+  dm_GfxMemImage *img;
+  Uint32 *row;
+  unsigned int x, y;
+
+  img = (dm_GfxMemImage*) data;
+
+  if (img->magenta == DM_MEM_MAGENTA_BLENDED
+      || (img->magenta == DM_MEM_MAGENTA_KEYED && blend == DM_BLEND_KEYED))
+    dm_mem_key_magenta(img);
+
+  switch (blend) {
+  case DM_BLEND_KEYED:
+    break;
+  case DM_BLEND_OPAQUE:
+    /* Pixels on screen must stay opaque. */
+    for (y = 0; y < img->height; y++) {
+      row = (Uint32*) (img->pixels + y * img->pitch);
+
+      for (x = 0; x < img->width; x++)
+        row[x] |= DM_MEM_AMASK;
+    }
+
+    img->transparency = DM_MEM_OPAQUE;
+    break;
+  case DM_BLEND_ALPHA:
+  case DM_BLEND_ADDITIVE:
+    dm_pixel_premultiply(img->pixels, img->pitch, img->width, img->height);
+    /* Fall through. */
+  case DM_BLEND_PREMULTIPLIED:
+    img->transparency = (blend == DM_BLEND_ADDITIVE ? DM_MEM_ADDITIVE
+                         : DM_MEM_PREMULTIPLIED);
+    break;
+  default:
+    return NULL;
+  }
+
+  return data;
+}
+
+/* Allocate an image with aligned rows, leaving its pixels as they
+   are. */
+static dm_GfxMemImage *dm_mem_image_new(unsigned int width,
+                                        unsigned int height)
+{
+  dm_GfxMemImage *img;
+  unsigned long pitch, offset;
+
+  pitch = ((unsigned long) width * 4 + DM_MEM_ALIGN - 1)
+    & ~(unsigned long) (DM_MEM_ALIGN - 1);
+
+  img = malloc(sizeof(dm_GfxMemImage));
+
+  if (img == NULL)
+    return NULL;
+
+  img->block = malloc(pitch * (height ? height : 1) + DM_MEM_ALIGN - 1);
+
+  if (img->block == NULL) {
+    free(img);
+    return NULL;
+  }
+
+  offset = (unsigned long) img->block % DM_MEM_ALIGN;
+
+  img->pixels = (unsigned char*) img->block
+    + (offset ? DM_MEM_ALIGN - offset : 0);
+  img->width = width;
+  img->height = height;
+  img->pitch = pitch;
+  img->transparency = DM_MEM_OPAQUE;
+  img->magenta = DM_MEM_MAGENTA_DRAWN;
+
+  return img;
+}
+
+/* Make an image's magenta pixels transparent, and work out afresh
+   how it is drawn. */
+static void dm_mem_key_magenta(dm_GfxMemImage *img)
+{
+  Uint32 *row;
+  unsigned int x, y;
+
+  img->transparency = DM_MEM_OPAQUE;
+
+  for (y = 0; y < img->height; y++) {
+    row = (Uint32*) (img->pixels + y * img->pitch);
+
+    for (x = 0; x < img->width; x++) {
+      if ((row[x] & ~DM_MEM_AMASK) == (DM_MEM_RMASK | DM_MEM_BMASK))
+        row[x] = 0;
+
+      if (row[x] == 0) {
+        if (img->transparency == DM_MEM_OPAQUE)
+          img->transparency = DM_MEM_KEYED;
+      } else if ((row[x] & DM_MEM_AMASK) != DM_MEM_AMASK) {
+        img->transparency = DM_MEM_BLENDED;
+      }
+    }
+  }
+}
+
+/* Convert a surface to an image, making pixels equal to the key
+   transparent if keyed. */
+static dm_GfxMemImage *dm_mem_convert(SDL_Surface *src,
+                                      int keyed,
+                                      Uint32 key)
+{
+  dm_GfxMemImage *img;
+  Uint8 *srow, *p;
+  Uint32 *drow, px;
+  Uint8 r, g, b, a, bpp;
+  int x, y;
+
+  img = dm_mem_image_new(src->w, src->h);
+
+  if (img == NULL) {
+    dm_fatal("GFX-MEM: Couldn't convert image!");
+    return NULL;
+  }
+
+  bpp = src->format->BytesPerPixel;
+
+  SDL_LockSurface(src);
+
+  for (y = 0; y < src->h; y++) {
+    srow = (Uint8*) src->pixels + y * src->pitch;
+    drow = (Uint32*) (img->pixels + y * img->pitch);
+
+    for (x = 0; x < src->w; x++) {
+      switch (bpp) {
+      case 1:
+        px = srow[x];
+        break;
+      case 2:
+        px = ((Uint16*) srow)[x];
+        break;
+      case 3:
+        p = srow + x * 3;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+        px = ((Uint32) p[0] << 16) | ((Uint32) p[1] << 8) | p[2];
+#else
+        px = p[0] | ((Uint32) p[1] << 8) | ((Uint32) p[2] << 16);
+#endif
+        break;
+      default:
+        px = ((Uint32*) srow)[x];
+        break;
+      }
+
+      SDL_GetRGBA(px, src->format, &r, &g, &b, &a);
+
+      if (keyed && px == key)
+        r = g = b = a = 0;
+
+      /* Transparent pixels are all zero, so that keyed images can be
+         drawn with a plain colour-keyed blit.  Any that keep a colour
+         (as premultiplied images may, to add light) make the image
+         blended, which passes over them. */
+      if (a == 0 && r == 0 && g == 0 && b == 0) {
+        drow[x] = 0;
+        if (img->transparency == DM_MEM_OPAQUE)
+          img->transparency = DM_MEM_KEYED;
+      } else {
+        drow[x] = ((Uint32) a << 24) | ((Uint32) r << 16)
+          | ((Uint32) g << 8) | b;
+        if (a != 255)
+          img->transparency = DM_MEM_BLENDED;
+      }
+    }
+  }
+
+  SDL_UnlockSurface(src);
+
+  return img;
+}
+
+/* Blit part of an image to the screen, clipped as SDL_BlitSurface
+   would. */
+static void dm_mem_blit(dm_GfxMemImage *src,
+                        int sx, int sy, int dx, int dy, int w, int h)
+{
+  dm_GfxMemImage *screen;
+  const unsigned char *from;
+  unsigned char *to;
+
+  screen = &_dm_gfxmem->screen;
+
+  /* Clip to the source... */
+  if (sx < 0) {
+    w += sx;
+    dx -= sx;
+    sx = 0;
+  }
+  if (sy < 0) {
+    h += sy;
+    dy -= sy;
+    sy = 0;
+  }
+  if (sx + w > (int) src->width)
+    w = src->width - sx;
+  if (sy + h > (int) src->height)
+    h = src->height - sy;
+
+  /* ...then to the screen. */
+  if (dx < 0) {
+    w += dx;
+    sx -= dx;
+    dx = 0;
+  }
+  if (dy < 0) {
+    h += dy;
+    sy -= dy;
+    dy = 0;
+  }
+  if (dx + w > (int) screen->width)
+    w = screen->width - dx;
+  if (dy + h > (int) screen->height)
+    h = screen->height - dy;
+
+  if (w <= 0 || h <= 0)
+    return;
+
+  from = src->pixels + sy * src->pitch + sx * 4;
+  to = screen->pixels + dy * screen->pitch + dx * 4;
+
+  if (src->transparency == DM_MEM_OPAQUE)
+    dm_blit_copy(from, src->pitch, to, screen->pitch, w, h, 4);
+  else if (src->transparency == DM_MEM_KEYED)
+    dm_blit_keyed(from, src->pitch, to, screen->pitch, w, h, 4, 0);
+  else if (src->transparency == DM_MEM_PREMULTIPLIED)
+    dm_blit_blend(from, src->pitch, to, screen->pitch, w, h);
+  else if (src->transparency == DM_MEM_ADDITIVE)
+    dm_blit_add(from, src->pitch, to, screen->pitch, w, h);
+  else
+    dm_mem_blend(from, src->pitch, to, screen->pitch, w, h);
+}
+
+/* Blend translucent pixels onto opaque ones. */
+static void dm_mem_blend(const unsigned char *src,
+                         unsigned long src_pitch,
+                         unsigned char *dest,
+                         unsigned long dest_pitch,
+                         unsigned int width,
+                         unsigned int height)
+{
+  const Uint32 *s;
+  Uint32 *d, sp, dp, a, na;
+  unsigned int x, y;
+
+  for (y = 0; y < height; y++) {
+    s = (const Uint32*) (src + y * src_pitch);
+    d = (Uint32*) (dest + y * dest_pitch);
+
+    for (x = 0; x < width; x++) {
+      sp = s[x];
+      a = sp >> 24;
+
+      if (a == 255) {
+        d[x] = sp;
+      } else if (a != 0) {
+        dp = d[x];
+        na = 255 - a;
+        d[x] = (DM_MEM_AMASK
+                | ((((sp >> 16 & 0xFF) * a + (dp >> 16 & 0xFF) * na
+                     + 127) / 255) << 16)
+                | ((((sp >> 8 & 0xFF) * a + (dp >> 8 & 0xFF) * na
+                     + 127) / 255) << 8)
+                | (((sp & 0xFF) * a + (dp & 0xFF) * na + 127) / 255));
+      }
+    }
+  }
+}
+
+/* Fill a rectangle of the screen, clipped as SDL_FillRect would. */
+static void dm_mem_fill(int x, int y, int w, int h, Uint32 colour)
+{
+  dm_GfxMemImage *screen;
+  int x1, y1;
+
+  screen = &_dm_gfxmem->screen;
+
+  x1 = x + w;
+  y1 = y + h;
+
+  if (x < 0)
+    x = 0;
+  if (y < 0)
+    y = 0;
+  if (x1 > (int) screen->width)
+    x1 = screen->width;
+  if (y1 > (int) screen->height)
+    y1 = screen->height;
+
+  if (x1 <= x || y1 <= y)
+    return;
+
+  dm_blit_fill(screen->pixels + y * screen->pitch + x * 4, screen->pitch,
+               x1 - x, y1 - y, 4, colour);
+}
+
+/* Hash the screen's pixels, as bytes, row by row. */
+static unsigned long dm_mem_checksum(void)
+{
+  dm_GfxMemImage *screen;
+  const unsigned char *p, *end;
+  unsigned long h;
+  unsigned int y;
+
+  screen = &_dm_gfxmem->screen;
+  h = DM_GFX_HASH_BASIS;
+
+  for (y = 0; y < screen->height; y++) {
+    p = screen->pixels + y * screen->pitch;
+
+    for (end = p + screen->width * 4; p < end; p++)
+      h = ((h ^ *p) * DM_GFX_HASH_PRIME) & 0xFFFFFFFFUL;
+  }
+
+  return h;
+}
@@ -0,0 +1,337 @@
+/** @file     gfx/dm-gfx-memory.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for the in-memory framebuffer graphics driver.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_MEMORY_H__
+#define __DM_GFX_MEMORY_H__
+
+/* Masks of the driver's pixels, which are 32-bit ARGB.  Pixels on
+   screen are always opaque; image pixels with an alpha of zero are
+   transparent. */
+#define DM_MEM_AMASK 0xFF000000UL
+#define DM_MEM_RMASK 0x00FF0000UL
+#define DM_MEM_GMASK 0x0000FF00UL
+#define DM_MEM_BMASK 0x000000FFUL
+
+enum {
+  DM_MEM_ALIGN = 32, /**< Alignment of rows of pixels, in bytes. */
+  DM_MEM_DUMP_NAME = 256, /**< Size of a dumped frame's file name,
+                             including the terminator. */
+
+  /* Image transparency. */
+
+  DM_MEM_OPAQUE        = 0, /**< Every pixel is opaque. */
+  DM_MEM_KEYED         = 1, /**< Pixels are opaque or transparent. */
+  DM_MEM_BLENDED       = 2, /**< Some pixels are translucent. */
+  DM_MEM_PREMULTIPLIED = 3, /**< Pixels have premultiplied alpha, and
+                               are blended by it. */
+  DM_MEM_ADDITIVE      = 4, /**< Pixels have premultiplied alpha, and
+                               are added to the screen. */
+
+  /* Which blend modes make an image's magenta pixels transparent, as
+     the SDL driver's colour key does. */
+
+  DM_MEM_MAGENTA_DRAWN   = 0, /**< None (the image was not loaded from
+                                 a file). */
+  DM_MEM_MAGENTA_KEYED   = 1, /**< DM_BLEND_KEYED only, as the image
+                                 has an alpha channel. */
+  DM_MEM_MAGENTA_BLENDED = 2  /**< Every mode but DM_BLEND_OPAQUE, as
+                                 the image has no alpha channel. */
+};
+
+typedef struct dm_GfxMemImage dm_GfxMemImage;
+typedef struct dm_GfxMemData dm_GfxMemData;
+
+/** Image data for the memory driver. */
+struct dm_GfxMemImage {
+  unsigned int width;     /**< Width of the image. */
+  unsigned int height;    /**< Height of the image. */
+  unsigned long pitch;    /**< Bytes from one row to the next. */
+  unsigned char *pixels;  /**< The pixels, in rows aligned to
+                             DM_MEM_ALIGN bytes. */
+  void *block;            /**< The allocation pixels lies within. */
+  int transparency;       /**< How the image is drawn (one of the
+                             DM_MEM_ image transparencies). */
+  int magenta;            /**< Which blend modes key its magenta
+                             pixels (one of the DM_MEM_MAGENTA_
+                             values). */
+};
+
+struct dm_GfxMemData {
+  dm_GfxMemImage screen;  /**< The framebuffer. */
+  unsigned long frames;   /**< Number of frames presented. */
+  unsigned long checksum; /**< Checksum of the last frame presented. */
+  const char *dump;       /**< printf pattern, taking the frame number,
+                             of the PPM files to write each frame to,
+                             or NULL. */
+};
+
+
+/** Register the memory driver.
+ *
+ *  @param driver  The driver structure in which to store function
+ *  pointers, etc.
+ */
+
+void dm_gfx_memory_register(dm_GfxDriver *driver);
+
+
+/** Initialise the memory graphics system.
+ *
+ *  This needs no display: the screen is a buffer in memory, the size
+ *  of the one asked for in the configuration.
+ *
+ *  @param conf  A pointer to a dm_Config structure filled with
+ *  initial configuration values.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE for failure;
+ */
+
+int dm_gfx_memory_init(dm_Config *conf);
+
+/** Present a frame.
+ *
+ *  This takes the frame's checksum, and writes it out if frames are
+ *  being dumped.
+ */
+void dm_gfx_memory_update(void);
+
+/** De-initialise the memory graphics system.
+ */
+
+void dm_gfx_memory_cleanup(void);
+
+
+/** Retrieve the framebuffer.
+ *
+ *  @param width   Pointer to a variable to store the width in, or
+ *                 NULL.
+ *  @param height  Pointer to a variable to store the height in, or
+ *                 NULL.
+ *  @param pitch   Pointer to a variable to store the bytes from one
+ *                 row to the next in, or NULL.
+ *
+ *  @return the framebuffer's pixels, as 32-bit ARGB, or NULL if the
+ *  memory driver is not running.
+ */
+const unsigned char *dm_gfx_memory_pixels(unsigned int *width,
+                                          unsigned int *height,
+                                          unsigned long *pitch);
+
+/** Retrieve the checksum of the last frame presented.
+ *
+ *  The checksum is the 32-bit FNV-1a hash of the frame's pixels, row
+ *  by row, so equal frames have equal checksums whatever the pitch.
+ *
+ *  @return the checksum, or 0 if no frame has been presented.
+ */
+unsigned long dm_gfx_memory_checksum(void);
+
+/** Retrieve the number of frames presented so far.
+ *
+ *  @return the number of frames.
+ */
+unsigned long dm_gfx_memory_frames(void);
+
+/** Write the framebuffer to a binary PPM file.
+ *
+ *  @param filename  The file to write.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE for failure.
+ */
+int dm_gfx_memory_write_ppm(const char filename[]);
+
+/** Write every frame presented from now on to a PPM file.
+ *
+ *  @param pattern  printf pattern of the files' names, which is
+ *                  given the frame number as an unsigned long (eg
+ *                  "frame%04lu.ppm"), or NULL to stop writing
+ *                  frames.  It must outlive its use, and pass
+ *                  dm_check_frame_pattern() for names of
+ *                  DM_MEM_DUMP_NAME characters.
+ *
+ *  @return  DM_SUCCESS, or DM_FAILURE if the pattern is rejected
+ *           (frames are then written as before).
+ */
+int dm_gfx_memory_dump_frames(const char *pattern);
+
+
+/** Load an image into memory.
+ *
+ *  @see dm_load_image
+ *
+ *  @param filename  The path to the image file.
+ *
+ *  @return a pointer to the image data, or NULL on failure.
+ */
+void *dm_mem_load_image_data(const char filename[]);
+
+/** Decode an image file, safely on any thread.
+ *
+ *  @param filename  The path to the image file.
+ *
+ *  @return the decoded image data, or NULL on failure.
+ */
+void *dm_mem_decode_image_data(const char filename[]);
+
+/** Finish decoded image data.
+ *
+ *  @param decoded  Data returned by dm_mem_decode_image_data.
+ *
+ *  @return the image data, ready to draw.
+ */
+void *dm_mem_finish_image_data(void *decoded);
+
+/** Free image data.
+ *
+ *  @param data  The image data to free.
+ */
+void dm_mem_free_image_data(void *data);
+
+/** Create blank, fully transparent image data.
+ *
+ *  @param width   Width of the image.
+ *  @param height  Height of the image.
+ *
+ *  @return the image data, or NULL on failure.
+ */
+void *dm_mem_create_image_data(unsigned int width, unsigned int height);
+
+/** Copy pixels verbatim from one image's data to another's.
+ *
+ *  @see dm_GfxDriver
+ */
+int dm_mem_copy_image_data(void *dest,
+                           void *src,
+                           unsigned int src_x,
+                           unsigned int src_y,
+                           unsigned int dest_x,
+                           unsigned int dest_y,
+                           unsigned int width,
+                           unsigned int height);
+
+/** Get the dimensions of image data.
+ *
+ *  @param data    The image data.
+ *  @param width   Pointer to a variable to store the width in.
+ *  @param height  Pointer to a variable to store the height in.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE for failure.
+ */
+int dm_mem_image_data_size(void *data,
+                           unsigned int *width,
+                           unsigned int *height);
+
+/** Get the memory used by image data.
+ *
+ *  @param data  The image data.
+ *
+ *  @return the number of bytes.
+ */
+unsigned long dm_mem_image_data_bytes(void *data);
+
+/** Create a copy of image data enlarged by integer factors.
+ *
+ *  @param data      The image data to enlarge.
+ *  @param x_factor  Horizontal enlargement factor.
+ *  @param y_factor  Vertical enlargement factor.
+ *
+ *  @return the enlarged image data, or NULL on failure.
+ */
+void *dm_mem_scale_image_data(void *data,
+                              unsigned int x_factor,
+                              unsigned int y_factor);
+
+/** Create image data from pixels in memory.
+ *
+ *  The memory driver converts the pixels, so they need not outlive
+ *  the image data.
+ *
+ *  @see dm_GfxDriver
+ */
+void *dm_mem_image_data_from_pixels(const void *pixels,
+                                    unsigned int width,
+                                    unsigned int height,
+                                    unsigned int pitch,
+                                    const dm_GfxPixelFormat *format);
+
+/** Draw part of an image.
+ *
+ *  @see dm_draw_image
+ */
+int dm_mem_draw_image(struct dm_GfxImageNode *image,
+                      unsigned int image_x,
+                      unsigned int image_y,
+                      unsigned int screen_x,
+                      unsigned int screen_y,
+                      unsigned int width,
+                      unsigned int height);
+
+/** Fill a rectangle with the given RGB colour.
+ *
+ *  @see dm_fill_rect_rgb
+ */
+void dm_mem_fill_rect_rgb(unsigned int x,
+                          unsigned int y,
+                          unsigned int w,
+                          unsigned int h,
+                          unsigned int r,
+                          unsigned int g,
+                          unsigned int b);
+
+/** Draw a batch of queued commands.
+ *
+ *  @see dm_queue_flush
+ *
+ *  @param cmds   The commands, in the order to draw them.
+ *  @param count  The number of commands.
+ */
+void dm_mem_submit_batch(const dm_GfxCommand *cmds, unsigned long count);
+
+/** Read back part of the framebuffer.
+ *
+ *  @see dm_record_start
+ *
+ *  @param rect  The region to read.
+ *  @param dest  Buffer to store the pixels in, as red, green and blue
+ *               bytes, row after row.
+ *
+ *  @return DM_SUCCESS.
+ */
+int dm_mem_read_pixels(const dm_GfxRect *rect, unsigned char *dest);
+
+/** Prepare image data to be drawn with a blend mode.
+ *
+ *  Straight alpha is premultiplied in place.
+ *
+ *  @param data   The image data, as loaded.
+ *  @param blend  The blend mode (one of the DM_BLEND_ modes).
+ *
+ *  @return the image data, or NULL if the mode is unknown.
+ */
+void *dm_mem_blend_image_data(void *data, int blend);
+
+#endif /* __DM_GFX_MEMORY_H__ */
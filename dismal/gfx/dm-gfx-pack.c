@@ -0,0 +1,374 @@
+/** @file     gfx/dm-gfx-pack.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Asset pack support for the DISMAL graphics subsystem.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-pack.h"
+
+#ifdef DM_EMBED_ASSETS
+/* Defined by the source file dm-pack generates for DM_EMBED_ASSETS. */
+extern const unsigned char *const dm_embedded_pack;
+extern const unsigned long dm_embedded_pack_size;
+#endif /* DM_EMBED_ASSETS */
+
+static int dm_pack_add (const char name[], const void *map,
+                        unsigned long size, int mapped);
+static unsigned long dm_pack_u32 (const unsigned char *p);
+static unsigned long dm_pack_field (dm_GfxPack *pack,
+                                    unsigned long entry,
+                                    int field);
+static int dm_pack_host_order (void);
+static int dm_pack_validate (dm_GfxPack *pack);
+static void dm_pack_free (dm_GfxPack *pack);
+static unsigned long dm_pack_find (dm_GfxPack *pack, const char name[],
+                                   unsigned long hash);
+
+int
+dm_pack_mount (const char filename[])
+{
+  void *map;
+  unsigned long size;
+
+  map = dm_map_file (filename, &size);
+
+  if (map == NULL)
+    {
+      dm_fatal ("GFX: Could not map pack %s.", filename);
+      return DM_FAILURE;
+    }
+
+  return dm_pack_add (filename, map, size, DM_TRUE);
+}
+
+int
+dm_pack_mount_memory (const char name[], const void *data,
+                      unsigned long size)
+{
+  return dm_pack_add (name, data, size, DM_FALSE);
+}
+
+int
+dm_pack_mount_embedded (void)
+{
+#ifdef DM_EMBED_ASSETS
+  return dm_pack_mount_memory ("<embedded>", dm_embedded_pack,
+                               dm_embedded_pack_size);
+#else /* !DM_EMBED_ASSETS */
+  return DM_SUCCESS;
+#endif /* DM_EMBED_ASSETS */
+}
+
+int
+dm_pack_unmount (const char filename[])
+{
+  dm_GfxPack *pack, **pp;
+  struct dm_GfxImageNode *img;
+  int i;
+
+  for (pp = &dm_gfxdata->packs; *pp != NULL; pp = &(*pp)->next)
+    {
+      if (strcmp ((*pp)->filename, filename) == 0)
+        break;
+    }
+
+  pack = *pp;
+
+  if (pack == NULL)
+    return DM_FAILURE;
+
+  /* Nothing may point into the mapping once it is gone. */
+  for (i = 0; i < dm_gfxdata->handle_count; i++)
+    {
+      img = dm_gfxdata->handles[i];
+
+      if (img && img->pack == pack && img->state == DM_IMAGE_READY)
+        dm_image_evict (img);
+    }
+
+  *pp = pack->next;
+  dm_pack_free (pack);
+
+  return DM_SUCCESS;
+}
+
+void
+dm_pack_unmount_all (void)
+{
+  dm_GfxPack *next;
+
+  while (dm_gfxdata->packs)
+    {
+      next = dm_gfxdata->packs->next;
+      dm_pack_free (dm_gfxdata->packs);
+      dm_gfxdata->packs = next;
+    }
+}
+
+int
+dm_pack_contains (const char name[])
+{
+  dm_GfxPack *pack;
+  unsigned long hash;
+
+  hash = dm_ascii_hash (name);
+
+  for (pack = dm_gfxdata->packs; pack != NULL; pack = pack->next)
+    {
+      if (dm_pack_find (pack, name, hash) != pack->count)
+        return DM_TRUE;
+    }
+
+  return DM_FALSE;
+}
+
+void *
+dm_pack_load_image_data (const char name[], struct dm_GfxPack **pack)
+{
+  dm_GfxPack *p;
+  dm_GfxPixelFormat format;
+  unsigned long hash, e;
+  void *data;
+
+  *pack = NULL;
+
+  if (dm_gfxdata->packs == NULL
+      || dm_gfxdata->driver->image_data_from_pixels == NULL)
+    return NULL;
+
+  hash = dm_ascii_hash (name);
+
+  for (p = dm_gfxdata->packs; p != NULL; p = p->next)
+    {
+      e = dm_pack_find (p, name, hash);
+
+      if (e == p->count)
+        continue;
+
+      format.bits = dm_pack_field (p, e, DM_PACK_E_BITS);
+      format.rmask = dm_pack_field (p, e, DM_PACK_E_RMASK);
+      format.gmask = dm_pack_field (p, e, DM_PACK_E_GMASK);
+      format.bmask = dm_pack_field (p, e, DM_PACK_E_BMASK);
+      format.amask = dm_pack_field (p, e, DM_PACK_E_AMASK);
+      format.keyed = (dm_pack_field (p, e, DM_PACK_E_FLAGS)
+                      & DM_PACK_KEYED) ? DM_TRUE : DM_FALSE;
+      format.key = dm_pack_field (p, e, DM_PACK_E_KEY);
+
+      data = dm_gfxdata->driver->image_data_from_pixels
+        (p->map + dm_pack_field (p, e, DM_PACK_E_DATA),
+         dm_pack_field (p, e, DM_PACK_E_WIDTH),
+         dm_pack_field (p, e, DM_PACK_E_HEIGHT),
+         dm_pack_field (p, e, DM_PACK_E_PITCH),
+         &format);
+
+      if (data)
+        *pack = p;
+
+      return data;
+    }
+
+  return NULL;
+}
+
+/* Validate a pack and add it to the front of the mounted list.  The
+   pack is released here on failure. */
+static int
+dm_pack_add (const char name[], const void *map, unsigned long size,
+             int mapped)
+{
+  dm_GfxPack *pack;
+
+  pack = malloc (sizeof (dm_GfxPack));
+
+  if (pack)
+    pack->filename = malloc (strlen (name) + 1);
+
+  if (pack == NULL || pack->filename == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate pack %s.", name);
+      if (pack)
+        free (pack);
+      if (mapped)
+        dm_unmap_file ((void*) map, size);
+      return DM_FAILURE;
+    }
+
+  strcpy (pack->filename, name);
+  pack->map = (const unsigned char*) map;
+  pack->size = size;
+  pack->mapped = mapped;
+
+  if (dm_pack_validate (pack) == DM_FAILURE)
+    {
+      dm_fatal ("GFX: %s is not a usable pack.", name);
+      dm_pack_free (pack);
+      return DM_FAILURE;
+    }
+
+  dm_debug ("GFX: Mounted pack %s (%lu images).", name, pack->count);
+
+  pack->next = dm_gfxdata->packs;
+  dm_gfxdata->packs = pack;
+
+  return DM_SUCCESS;
+}
+
+/* Read a little-endian 32-bit value. */
+static unsigned long
+dm_pack_u32 (const unsigned char *p)
+{
+  return ((unsigned long) p[0]
+          | ((unsigned long) p[1] << 8)
+          | ((unsigned long) p[2] << 16)
+          | ((unsigned long) p[3] << 24));
+}
+
+/* Read a field of an index entry. */
+static unsigned long
+dm_pack_field (dm_GfxPack *pack, unsigned long entry, int field)
+{
+  return dm_pack_u32 (pack->map + DM_PACK_HEADER_SIZE
+                      + entry * DM_PACK_ENTRY_SIZE + field * 4);
+}
+
+/* Get the byte order of this machine's pixels. */
+static int
+dm_pack_host_order (void)
+{
+  unsigned int one;
+
+  one = 1;
+
+  if (*((unsigned char*) &one) == 1)
+    return DM_PACK_LITTLE_ENDIAN;
+  else
+    return DM_PACK_BIG_ENDIAN;
+}
+
+/* Check a pack's header and index, so that nothing later has to
+   worry about reading outside the mapping. */
+static int
+dm_pack_validate (dm_GfxPack *pack)
+{
+  unsigned long names, e, name, data, w, h, pitch, bits;
+
+  if (pack->size < DM_PACK_HEADER_SIZE
+      || memcmp (pack->map, DM_PACK_MAGIC, 4) != 0
+      || dm_pack_u32 (pack->map + DM_PACK_H_VERSION) != DM_PACK_VERSION)
+    return DM_FAILURE;
+
+  if (dm_pack_u32 (pack->map + DM_PACK_H_ORDER)
+      != (unsigned long) dm_pack_host_order ())
+    {
+      dm_fatal ("GFX: Pack pixels are in the wrong byte order.");
+      return DM_FAILURE;
+    }
+
+  pack->count = dm_pack_u32 (pack->map + DM_PACK_H_COUNT);
+  names = dm_pack_u32 (pack->map + DM_PACK_H_NAMES);
+
+  if (pack->count > (pack->size - DM_PACK_HEADER_SIZE) / DM_PACK_ENTRY_SIZE
+      || names < DM_PACK_HEADER_SIZE + pack->count * DM_PACK_ENTRY_SIZE
+      || names > pack->size)
+    return DM_FAILURE;
+
+  pack->names = (const char*) pack->map + names;
+  pack->names_len = pack->size - names;
+
+  for (e = 0; e < pack->count; e++)
+    {
+      name = dm_pack_field (pack, e, DM_PACK_E_NAME);
+      data = dm_pack_field (pack, e, DM_PACK_E_DATA);
+      w = dm_pack_field (pack, e, DM_PACK_E_WIDTH);
+      h = dm_pack_field (pack, e, DM_PACK_E_HEIGHT);
+      pitch = dm_pack_field (pack, e, DM_PACK_E_PITCH);
+      bits = dm_pack_field (pack, e, DM_PACK_E_BITS);
+
+      if (name >= pack->names_len
+          || memchr (pack->names + name, '\0',
+                     pack->names_len - name) == NULL)
+        return DM_FAILURE;
+
+      if (bits == 0 || bits % 8 != 0 || bits > 32
+          || w == 0 || h == 0 || pitch < w * (bits / 8)
+          || data % DM_PACK_ALIGN != 0 || data > pack->size
+          || h > (pack->size - data) / pitch)
+        return DM_FAILURE;
+
+      if (e > 0 && dm_pack_field (pack, e, DM_PACK_E_HASH)
+          < dm_pack_field (pack, e - 1, DM_PACK_E_HASH))
+        return DM_FAILURE;
+    }
+
+  return DM_SUCCESS;
+}
+
+/* Unmap and free a pack. */
+static void
+dm_pack_free (dm_GfxPack *pack)
+{
+  if (pack->mapped)
+    dm_unmap_file ((void*) pack->map, pack->size);
+
+  free (pack->filename);
+  free (pack);
+}
+
+/* Find an image in a pack's index by binary search on its hash,
+   returning pack->count if it is not there. */
+static unsigned long
+dm_pack_find (dm_GfxPack *pack, const char name[], unsigned long hash)
+{
+  unsigned long lo, hi, mid;
+
+  lo = 0;
+  hi = pack->count;
+
+  /* Find the first entry with the hash... */
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+
+      if (dm_pack_field (pack, mid, DM_PACK_E_HASH) < hash)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  /* ...then check the names of every entry that shares it. */
+  for (; lo < pack->count
+         && dm_pack_field (pack, lo, DM_PACK_E_HASH) == hash; lo++)
+    {
+      if (strcmp (pack->names + dm_pack_field (pack, lo, DM_PACK_E_NAME),
+                  name) == 0)
+        return lo;
+    }
+
+  return pack->count;
+}
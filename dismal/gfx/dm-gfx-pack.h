@@ -0,0 +1,201 @@
+/** @file     gfx/dm-gfx-pack.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for DISMAL asset packs.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_PACK_H__
+#define __DM_GFX_PACK_H__
+
+/* A pack holds images already converted to a screen pixel format, so
+   that they can be drawn straight out of a memory mapping of the pack
+   file.  Packs are made offline by tools/dm-pack.
+
+   All header and index fields are 32-bit little-endian values.  The
+   layout is:
+
+     header   magic ("DMPK"), version, pixel byte order, image count,
+              offset of the name table
+     index    one entry per image (see DM_PACK_E_*), sorted by the
+              dm_ascii_hash() of the image's name
+     names    NUL-terminated image names
+     pixels   each image's rows, starting on a DM_PACK_ALIGN boundary,
+              in the byte order given in the header */
+
+#define DM_PACK_MAGIC "DMPK" /**< The first four bytes of a pack. */
+
+enum {
+  DM_PACK_VERSION = 1, /**< Version of the pack format. */
+
+  DM_PACK_HEADER_SIZE = 20, /**< Size of the pack header, in bytes. */
+  DM_PACK_ALIGN = 16,       /**< Alignment of image pixel data in the
+                               pack, in bytes. */
+
+  /* Offsets of header fields. */
+
+  DM_PACK_H_VERSION = 4,  /**< Pack format version. */
+  DM_PACK_H_ORDER   = 8,  /**< Byte order of pixel data. */
+  DM_PACK_H_COUNT   = 12, /**< Number of images. */
+  DM_PACK_H_NAMES   = 16, /**< Offset of the name table. */
+
+  /* Pixel data byte orders. */
+
+  DM_PACK_LITTLE_ENDIAN = 0, /**< Pixels are little-endian. */
+  DM_PACK_BIG_ENDIAN    = 1, /**< Pixels are big-endian. */
+
+  /* Indices of the 32-bit fields of an index entry. */
+
+  DM_PACK_E_HASH   = 0,  /**< Hash of the image's name. */
+  DM_PACK_E_NAME   = 1,  /**< Offset of the name in the name table. */
+  DM_PACK_E_WIDTH  = 2,  /**< Width of the image, in pixels. */
+  DM_PACK_E_HEIGHT = 3,  /**< Height of the image, in pixels. */
+  DM_PACK_E_PITCH  = 4,  /**< Bytes from one row to the next. */
+  DM_PACK_E_DATA   = 5,  /**< Offset of the pixel data in the pack. */
+  DM_PACK_E_BITS   = 6,  /**< Bits per pixel. */
+  DM_PACK_E_RMASK  = 7,  /**< Red mask. */
+  DM_PACK_E_GMASK  = 8,  /**< Green mask. */
+  DM_PACK_E_BMASK  = 9,  /**< Blue mask. */
+  DM_PACK_E_AMASK  = 10, /**< Alpha mask. */
+  DM_PACK_E_FLAGS  = 11, /**< Flags (DM_PACK_KEYED). */
+  DM_PACK_E_KEY    = 12, /**< Colour key pixel value. */
+  DM_PACK_E_FIELDS = 13, /**< Number of fields in an entry. */
+
+  DM_PACK_ENTRY_SIZE = DM_PACK_E_FIELDS * 4, /**< Size of an index
+                                                entry, in bytes. */
+
+  /* Index entry flags. */
+
+  DM_PACK_KEYED = (1<<0) /**< The image uses its colour key. */
+};
+
+typedef struct dm_GfxPack dm_GfxPack;
+
+/** A mounted pack. */
+struct dm_GfxPack
+{
+  char *filename;               /**< Name the pack was mounted as. */
+  const unsigned char *map;     /**< Mapping of the pack file. */
+  unsigned long size;           /**< Size of the mapping, in bytes. */
+  int mapped;                   /**< Non-zero if the pack was mapped
+                                   from a file, rather than mounted
+                                   from memory. */
+  unsigned long count;          /**< Number of images in the pack. */
+  const char *names;            /**< The pack's name table. */
+  unsigned long names_len;      /**< Size of the name table. */
+  struct dm_GfxPack *next;      /**< The next mounted pack. */
+};
+
+
+/** Mount a pack, so that its images are used in preference to image
+ *  files of the same name.
+ *
+ *  Packs mounted later take precedence over those mounted earlier.
+ *  Images already loaded are not affected.
+ *
+ *  @param filename  The name of the pack file.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_pack_mount(const char filename[]);
+
+
+/** Mount a pack held in memory.
+ *
+ *  This is how assets embedded in the executable are mounted: see
+ *  DM_EMBED_ASSETS in DISMAL's Makefile.
+ *
+ *  @see dm_pack_mount
+ *
+ *  @param name  A name to mount the pack as, for dm_pack_unmount().
+ *  @param data  The pack, which must stay valid while it is mounted.
+ *  @param size  Size of the pack, in bytes.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_pack_mount_memory(const char name[], const void *data,
+                         unsigned long size);
+
+
+/** Mount the assets embedded in the executable, if there are any.
+ *
+ *  This should NOT be called outside dm_gfx_init.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_pack_mount_embedded(void);
+
+
+/** Unmount a pack.
+ *
+ *  Any loaded images drawn from the pack are evicted, and so will be
+ *  reloaded (from another pack, or from their files) when next
+ *  drawn.
+ *
+ *  @param filename  The name the pack was mounted as.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE if no such pack is
+ *  mounted.
+ */
+
+int dm_pack_unmount(const char filename[]);
+
+
+/** Unmount every pack.
+ *
+ *  This should NOT be called outside dm_gfx_cleanup, as it does not
+ *  evict images drawn from the packs.
+ */
+
+void dm_pack_unmount_all(void);
+
+
+/** Check whether an image is in any mounted pack.
+ *
+ *  @param name  The name of the image.
+ *
+ *  @return DM_TRUE if it is, DM_FALSE otherwise.
+ */
+
+int dm_pack_contains(const char name[]);
+
+
+/** Load an image's data from the mounted packs.
+ *
+ *  The data points directly into the pack's mapping, so nothing is
+ *  copied or decoded.
+ *
+ *  @param name  The name of the image.
+ *  @param pack  Pointer to store the pack the image was found in.
+ *
+ *  @return the image data, or NULL if no mounted pack holds the image
+ *  or the driver cannot use the image's pixels directly.
+ */
+
+void *dm_pack_load_image_data(const char name[],
+                              struct dm_GfxPack **pack);
+
+#endif /* __DM_GFX_PACK_H__ */
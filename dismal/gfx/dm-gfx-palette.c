@@ -0,0 +1,499 @@
+/** @file     gfx/dm-gfx-palette.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Logical palette and colour quantisation.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-palette.h"
+
+/* One band of lookup table cells, as handed to a worker.  A band with
+   no changed entries is built from scratch. */
+typedef struct dm_PaletteLutBand
+{
+  unsigned long first;
+  unsigned long count;
+  unsigned int changed_first;
+  unsigned int changed_count;
+} dm_PaletteLutBand;
+
+/* Where each component of a pixel format lies: red, green, blue and
+   alpha, in that order. */
+typedef struct dm_PaletteChannels
+{
+  unsigned int shift[4];
+  unsigned long max[4];
+} dm_PaletteChannels;
+
+/* One band of rows being remapped, as handed to a worker. */
+typedef struct dm_PaletteRemapBand
+{
+  const unsigned char *src;
+  unsigned long src_pitch;
+  unsigned char *dest;
+  unsigned long dest_pitch;
+  unsigned int width;
+  unsigned int height;
+  const dm_GfxPixelFormat *format;
+  const dm_PaletteChannels *channels;
+} dm_PaletteRemapBand;
+
+static void dm_palette_update_lut(unsigned int first, unsigned int count);
+static void dm_palette_lut_band(void *arg);
+static void dm_palette_remap_band(void *arg);
+static void dm_palette_channel(dm_PaletteChannels *ch, int i,
+                               unsigned long mask);
+static unsigned char dm_palette_component(const dm_PaletteChannels *ch,
+                                          int i, unsigned long pixel);
+static long dm_palette_distance(const dm_GfxColour *c,
+                                int r, int g, int b);
+
+int
+dm_palette_init (dm_Config *conf)
+{
+  dm_GfxColour *c;
+  unsigned int i;
+
+  c = dm_gfxdata->palette;
+
+  /* A 6x6x6 colour cube... */
+  for (i = 0; i < 216; i++, c++)
+    {
+      c->r = (unsigned char) ((i / 36) * 51);
+      c->g = (unsigned char) (((i / 6) % 6) * 51);
+      c->b = (unsigned char) ((i % 6) * 51);
+    }
+
+  /* ...a ramp of greys from black to white... */
+  for (i = 0; i < DM_PALETTE_KEY - 216; i++, c++)
+    c->r = c->g = c->b
+      = (unsigned char) (i * 255 / (DM_PALETTE_KEY - 217));
+
+  /* ...and the colour key. */
+  c->r = c->b = 255;
+  c->g = 0;
+
+  if (conf->gfx_flags & DM_GFX_PALETTED)
+    {
+      if (dm_gfxdata->driver->init_paletted
+          && dm_gfxdata->driver->init_paletted ())
+        {
+          dm_debug ("GFX: Drawing in 8-bit, with a logical palette.");
+
+          dm_gfxdata->palette_lut = malloc (DM_PALETTE_LUT_SIZE);
+
+          if (dm_gfxdata->palette_lut == NULL)
+            {
+              dm_fatal ("GFX: Could not allocate palette lookup table.");
+              return DM_FAILURE;
+            }
+
+          dm_palette_update_lut (0, DM_PALETTE_SIZE);
+        }
+      else
+        conf->gfx_flags &= ~DM_GFX_PALETTED;
+    }
+
+  if (dm_gfxdata->driver->set_palette)
+    dm_gfxdata->driver->set_palette (dm_gfxdata->palette, 0,
+                                     DM_PALETTE_SIZE);
+
+  return DM_SUCCESS;
+}
+
+void
+dm_palette_cleanup (void)
+{
+  if (dm_gfxdata->palette_lut)
+    {
+      free (dm_gfxdata->palette_lut);
+      dm_gfxdata->palette_lut = NULL;
+    }
+}
+
+int
+dm_palette_set (unsigned int first,
+                unsigned int count,
+                const dm_GfxColour colours[])
+{
+  if (first > DM_PALETTE_SIZE || count > DM_PALETTE_SIZE - first)
+    return DM_FAILURE;
+
+  /* Frames in flight are presented with the palette they were drawn
+     with. */
+  dm_pipeline_sync ();
+
+  memcpy (dm_gfxdata->palette + first, colours,
+          count * sizeof (dm_GfxColour));
+
+  if (dm_gfxdata->driver->set_palette)
+    dm_gfxdata->driver->set_palette (colours, first, count);
+
+  if (dm_gfxdata->palette_lut)
+    dm_palette_update_lut (first, count);
+
+  /* Everything drawn may use the changed entries, so the whole
+     screen has to be looked up again. */
+  if (dm_get_gfx_flag (DM_GFX_PALETTED))
+    dm_dirty_invalidate ();
+
+  return DM_SUCCESS;
+}
+
+int
+dm_palette_get (unsigned int first,
+                unsigned int count,
+                dm_GfxColour colours[])
+{
+  if (first > DM_PALETTE_SIZE || count > DM_PALETTE_SIZE - first)
+    return DM_FAILURE;
+
+  memcpy (colours, dm_gfxdata->palette + first,
+          count * sizeof (dm_GfxColour));
+
+  return DM_SUCCESS;
+}
+
+unsigned char
+dm_palette_nearest (unsigned char r, unsigned char g, unsigned char b)
+{
+  const dm_GfxColour *c;
+  long d, best_d;
+  unsigned int i, best;
+
+  best = 0;
+  best_d = 3L * 256 * 256;
+
+  for (i = 0, c = dm_gfxdata->palette; i < DM_PALETTE_SIZE; i++, c++)
+    {
+      if (i == DM_PALETTE_KEY)
+        continue;
+
+      d = dm_palette_distance (c, r, g, b);
+
+      if (d < best_d)
+        {
+          best_d = d;
+          best = i;
+
+          if (d == 0)
+            break;
+        }
+    }
+
+  return (unsigned char) best;
+}
+
+unsigned char
+dm_palette_lookup (unsigned char r, unsigned char g, unsigned char b)
+{
+  unsigned int shift;
+
+  if (dm_gfxdata->palette_lut == NULL)
+    return dm_palette_nearest (r, g, b);
+
+  shift = 8 - DM_PALETTE_LUT_BITS;
+
+  return dm_gfxdata->palette_lut[((unsigned long) (r >> shift)
+                                  << (2 * DM_PALETTE_LUT_BITS))
+                                 | ((g >> shift) << DM_PALETTE_LUT_BITS)
+                                 | (b >> shift)];
+}
+
+void
+dm_palette_remap (struct dm_Pool *pool,
+                  const unsigned char *src,
+                  unsigned long src_pitch,
+                  unsigned char *dest,
+                  unsigned long dest_pitch,
+                  unsigned int width,
+                  unsigned int height,
+                  const dm_GfxPixelFormat *format)
+{
+  dm_PaletteRemapBand bands[DM_PIXEL_BANDS_MAX];
+  dm_PaletteChannels channels;
+  dm_PoolGroup group;
+  unsigned long count;
+  unsigned int i, y;
+
+  dm_palette_channel (&channels, 0, format->rmask);
+  dm_palette_channel (&channels, 1, format->gmask);
+  dm_palette_channel (&channels, 2, format->bmask);
+  dm_palette_channel (&channels, 3, format->amask);
+
+  /* Split as dm_pixel_scale_nearest_bands() does. */
+  count = (unsigned long) dm_pool_size (pool) + 1;
+
+  if (count > (unsigned long) width * height / DM_PIXEL_BAND_PIXELS)
+    count = (unsigned long) width * height / DM_PIXEL_BAND_PIXELS;
+  if (count > DM_PIXEL_BANDS_MAX)
+    count = DM_PIXEL_BANDS_MAX;
+  if (count > height)
+    count = height;
+  if (count < 1)
+    count = 1;
+
+  dm_pool_group_init (&group);
+
+  for (i = 0, y = 0; i < count; i++)
+    {
+      bands[i].src = src + y * src_pitch;
+      bands[i].src_pitch = src_pitch;
+      bands[i].dest = dest + y * dest_pitch;
+      bands[i].dest_pitch = dest_pitch;
+      bands[i].width = width;
+      bands[i].height = (height - y) / (count - i);
+      bands[i].format = format;
+      bands[i].channels = &channels;
+
+      y += bands[i].height;
+
+      if (count == 1)
+        dm_palette_remap_band (&bands[i]);
+      else
+        dm_pool_submit (pool, &group, dm_palette_remap_band, &bands[i]);
+    }
+
+  dm_pool_wait (pool, &group);
+}
+
+/* Bring the lookup table up to date after count entries starting at
+   first have changed, splitting the cells between the worker pool
+   and this thread.  Small changes patch the table in place, which
+   only compares each cell against the changed entries. */
+static void
+dm_palette_update_lut (unsigned int first, unsigned int count)
+{
+  dm_PaletteLutBand bands[DM_PIXEL_BANDS_MAX];
+  dm_PoolGroup group;
+  dm_Pool *pool;
+  unsigned long bandc, cell;
+  unsigned int i;
+
+  pool = dm_get_pool ();
+
+  bandc = (unsigned long) dm_pool_size (pool) + 1;
+
+  if (bandc > DM_PIXEL_BANDS_MAX)
+    bandc = DM_PIXEL_BANDS_MAX;
+
+  dm_pool_group_init (&group);
+
+  for (i = 0, cell = 0; i < bandc; i++)
+    {
+      bands[i].first = cell;
+      bands[i].count = (DM_PALETTE_LUT_SIZE - cell) / (bandc - i);
+
+      if (count > DM_PALETTE_LUT_PATCH)
+        bands[i].changed_count = 0;
+      else
+        bands[i].changed_count = count;
+
+      bands[i].changed_first = first;
+
+      cell += bands[i].count;
+      dm_pool_submit (pool, &group, dm_palette_lut_band, &bands[i]);
+    }
+
+  dm_pool_wait (pool, &group);
+}
+
+/* Build or patch one band of the lookup table, on whichever thread
+   gets it. */
+static void
+dm_palette_lut_band (void *arg)
+{
+  dm_PaletteLutBand *band;
+  const dm_GfxColour *palette;
+  unsigned char *lut;
+  unsigned long cell, end;
+  unsigned int shift, mask, best, j, last;
+  long d, best_d;
+  int r, g, b;
+
+  band = (dm_PaletteLutBand *) arg;
+  palette = dm_gfxdata->palette;
+  lut = dm_gfxdata->palette_lut;
+  shift = 8 - DM_PALETTE_LUT_BITS;
+  mask = (1 << DM_PALETTE_LUT_BITS) - 1;
+  last = band->changed_first + band->changed_count;
+  end = band->first + band->count;
+
+  for (cell = band->first; cell < end; cell++)
+    {
+      /* Match against the centre of the cell. */
+      r = (int) (((cell >> (2 * DM_PALETTE_LUT_BITS)) & mask) << shift)
+        + (1 << shift) / 2;
+      g = (int) (((cell >> DM_PALETTE_LUT_BITS) & mask) << shift)
+        + (1 << shift) / 2;
+      b = (int) ((cell & mask) << shift) + (1 << shift) / 2;
+
+      /* A cell whose entry changed could now be closest to any
+         entry. */
+      if (band->changed_count == 0
+          || (lut[cell] >= band->changed_first && lut[cell] < last))
+        {
+          lut[cell] = dm_palette_nearest ((unsigned char) r,
+                                          (unsigned char) g,
+                                          (unsigned char) b);
+          continue;
+        }
+
+      /* Otherwise its entry is still the closest of the unchanged
+         ones, so only the changed ones can beat it.  Ties go to the
+         lowest index, as in a full search. */
+      best = lut[cell];
+      best_d = dm_palette_distance (&palette[best], r, g, b);
+
+      for (j = band->changed_first; j < last; j++)
+        {
+          if (j == DM_PALETTE_KEY)
+            continue;
+
+          d = dm_palette_distance (&palette[j], r, g, b);
+
+          if (d < best_d || (d == best_d && j < best))
+            {
+              best_d = d;
+              best = j;
+            }
+        }
+
+      lut[cell] = (unsigned char) best;
+    }
+}
+
+/* Remap one band of rows, on whichever thread gets it. */
+static void
+dm_palette_remap_band (void *arg)
+{
+  dm_PaletteRemapBand *band;
+  const dm_GfxPixelFormat *f;
+  const dm_PaletteChannels *ch;
+  const unsigned char *src;
+  unsigned char *dest, index;
+  unsigned long px, last;
+  unsigned short p16;
+  unsigned int p32, x, y, bpp;
+  unsigned char r, g, b;
+  int have_last;
+
+  band = (dm_PaletteRemapBand *) arg;
+  f = band->format;
+  ch = band->channels;
+  bpp = f->bits / 8;
+  last = 0;
+  index = 0;
+  have_last = DM_FALSE;
+
+  for (y = 0; y < band->height; y++)
+    {
+      src = band->src + y * band->src_pitch;
+      dest = band->dest + y * band->dest_pitch;
+
+      for (x = 0; x < band->width; x++, src += bpp)
+        {
+          if (bpp == 2)
+            {
+              memcpy (&p16, src, 2);
+              px = p16;
+            }
+          else
+            {
+              memcpy (&p32, src, 4);
+              px = p32;
+            }
+
+          /* Images are mostly runs of the same colour. */
+          if (!have_last || px != last)
+            {
+              r = dm_palette_component (ch, 0, px);
+              g = dm_palette_component (ch, 1, px);
+              b = dm_palette_component (ch, 2, px);
+
+              if ((f->keyed && px == f->key)
+                  || (f->amask && dm_palette_component (ch, 3, px) < 128)
+                  || (r == 255 && g == 0 && b == 255))
+                index = DM_PALETTE_KEY;
+              else
+                index = dm_palette_lookup (r, g, b);
+
+              last = px;
+              have_last = DM_TRUE;
+            }
+
+          dest[x] = index;
+        }
+    }
+}
+
+/* Work out where the component under mask lies in a pixel. */
+static void
+dm_palette_channel (dm_PaletteChannels *ch, int i, unsigned long mask)
+{
+  ch->shift[i] = 0;
+
+  while (mask != 0 && (mask & 1) == 0)
+    {
+      mask >>= 1;
+      ch->shift[i]++;
+    }
+
+  ch->max[i] = mask;
+}
+
+/* Extract component i of a pixel, widened to 8 bits. */
+static unsigned char
+dm_palette_component (const dm_PaletteChannels *ch, int i,
+                      unsigned long pixel)
+{
+  unsigned long v;
+
+  if (ch->max[i] == 0)
+    return 0;
+
+  v = (pixel >> ch->shift[i]) & ch->max[i];
+
+  if (ch->max[i] == 255)
+    return (unsigned char) v;
+
+  return (unsigned char) (v * 255 / ch->max[i]);
+}
+
+/* Squared distance between a palette entry and a colour. */
+static long
+dm_palette_distance (const dm_GfxColour *c, int r, int g, int b)
+{
+  long dr, dg, db;
+
+  dr = (long) c->r - r;
+  dg = (long) c->g - g;
+  db = (long) c->b - b;
+
+  return dr * dr + dg * dg + db * db;
+}
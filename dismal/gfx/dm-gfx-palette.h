@@ -0,0 +1,196 @@
+/** @file     gfx/dm-gfx-palette.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for the logical palette.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_PALETTE_H__
+#define __DM_GFX_PALETTE_H__
+
+struct dm_Pool;
+
+enum {
+  DM_PALETTE_SIZE = 256, /**< Number of entries in the logical
+                            palette. */
+  DM_PALETTE_KEY  = 255, /**< Palette index that images use for
+                            transparent pixels.  No image pixel is
+                            remapped to it, and dm_fill_rect_rgb()
+                            never picks it, but it can still be
+                            filled with dm_fill_rect_pal(). */
+
+  DM_PALETTE_LUT_BITS = 5, /**< Bits of each colour component used to
+                              index the quantisation lookup table. */
+  DM_PALETTE_LUT_SIZE = 1 << (3 * DM_PALETTE_LUT_BITS), /**< Number of
+                                                           cells in the
+                                                           lookup
+                                                           table. */
+  DM_PALETTE_LUT_PATCH = 16 /**< Most palette entries that can change
+                               at once with the lookup table patched
+                               in place; beyond this, it is rebuilt
+                               from scratch. */
+};
+
+typedef struct dm_GfxColour dm_GfxColour;
+
+/** An entry in the logical palette. */
+struct dm_GfxColour
+{
+  unsigned char r; /**< Red component. */
+  unsigned char g; /**< Green component. */
+  unsigned char b; /**< Blue component. */
+};
+
+
+/** Set up the logical palette, switching to 8-bit drawing if
+ *  DM_GFX_PALETTED is set and the driver can do it.
+ *
+ *  This should NOT be called outside dm_gfx_init.
+ *
+ *  @param conf  A pointer to the configuration structure.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_palette_init(dm_Config *conf);
+
+
+/** Free the quantisation lookup table.
+ *
+ *  This should NOT be called outside dm_gfx_cleanup.
+ */
+
+void dm_palette_cleanup(void);
+
+
+/** Change entries of the logical palette.
+ *
+ *  When working in 8-bit, everything on screen drawn with the changed
+ *  entries changes colour at the next dm_gfx_update(), so fades and
+ *  colour cycling need no redrawing.  Images already loaded keep
+ *  their indices; only images loaded afterwards are remapped to the
+ *  new colours.
+ *
+ *  The quantisation lookup table is patched for small changes, such
+ *  as cycling a few entries, and rebuilt for larger ones.
+ *
+ *  The palette starts as a 6x6x6 colour cube followed by a ramp of
+ *  greys, with DM_PALETTE_KEY set to magenta.
+ *
+ *  @param first    Index of the first entry to change.
+ *  @param count    Number of entries to change.
+ *  @param colours  The new colours of the entries.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE if the entries lie
+ *  outside the palette.
+ */
+
+int dm_palette_set(unsigned int first,
+                   unsigned int count,
+                   const dm_GfxColour colours[]);
+
+
+/** Retrieve entries of the logical palette.
+ *
+ *  @param first    Index of the first entry to retrieve.
+ *  @param count    Number of entries to retrieve.
+ *  @param colours  Array in which to store the entries' colours.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE if the entries lie
+ *  outside the palette.
+ */
+
+int dm_palette_get(unsigned int first,
+                   unsigned int count,
+                   dm_GfxColour colours[]);
+
+
+/** Find the logical palette entry closest to a colour, searching
+ *  the whole palette.
+ *
+ *  Closeness is by squared distance in RGB space, with ties going to
+ *  the lowest index.  DM_PALETTE_KEY is never picked.
+ *
+ *  @param r  Red component of the colour.
+ *  @param g  Green component of the colour.
+ *  @param b  Blue component of the colour.
+ *
+ *  @return the index of the closest entry.
+ */
+
+unsigned char dm_palette_nearest(unsigned char r,
+                                 unsigned char g,
+                                 unsigned char b);
+
+
+/** Find the logical palette entry closest to a colour, using the
+ *  quantisation lookup table.
+ *
+ *  The table holds the closest entry to the centre of each cell of
+ *  RGB space, DM_PALETTE_LUT_BITS bits per component wide, so this
+ *  may pick a slightly worse entry than dm_palette_nearest() does.
+ *  When not working in 8-bit there is no table, and this is the
+ *  same as dm_palette_nearest().
+ *
+ *  @param r  Red component of the colour.
+ *  @param g  Green component of the colour.
+ *  @param b  Blue component of the colour.
+ *
+ *  @return the index of the closest entry.
+ */
+
+unsigned char dm_palette_lookup(unsigned char r,
+                                unsigned char g,
+                                unsigned char b);
+
+
+/** Remap a block of pixels to logical palette indices, split into
+ *  bands of rows shared between a worker pool and the calling
+ *  thread.
+ *
+ *  Transparent pixels (keyed, magenta, or less than half opaque)
+ *  become DM_PALETTE_KEY; everything else becomes the entry
+ *  dm_palette_lookup() picks.
+ *
+ *  @param pool        The worker pool, or NULL to use only the
+ *                     calling thread.
+ *  @param src         Pointer to the first source pixel.
+ *  @param src_pitch   Bytes from one source row to the next.
+ *  @param dest        Pointer to the first destination index.
+ *  @param dest_pitch  Bytes from one destination row to the next.
+ *  @param width       Width of the block, in pixels.
+ *  @param height      Height of the block, in pixels.
+ *  @param format      Format of the source pixels, which must be
+ *                     16- or 32-bit.
+ */
+
+void dm_palette_remap(struct dm_Pool *pool,
+                      const unsigned char *src,
+                      unsigned long src_pitch,
+                      unsigned char *dest,
+                      unsigned long dest_pitch,
+                      unsigned int width,
+                      unsigned int height,
+                      const dm_GfxPixelFormat *format);
+
+#endif /* __DM_GFX_PALETTE_H__ */
@@ -0,0 +1,69 @@
+/** @file     gfx/dm-gfx-pattern.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Checking of frame file name patterns.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#include <ctype.h>
+#include <string.h>
+
+#include "../dismal.h"
+#include "dm-gfx-pattern.h"
+
+int
+dm_check_frame_pattern (const char *pattern, size_t size)
+{
+  const char *c;
+  int conversions;
+
+  conversions = 0;
+
+  for (c = pattern; *c != '\0'; c++)
+    {
+      if (*c != '%')
+        continue;
+
+      c++;
+      if (*c == '%')
+        continue;
+
+      if (*c == '0')
+        c++;
+      if (isdigit ((unsigned char) *c))
+        c++;
+      if (isdigit ((unsigned char) *c))
+        c++;
+
+      if (c[0] != 'l' || c[1] != 'u')
+        return DM_FAILURE;
+
+      c++;
+      conversions++;
+    }
+
+  if (conversions != 1 || strlen (pattern) + DM_PATTERN_SLACK >= size)
+    return DM_FAILURE;
+
+  return DM_SUCCESS;
+}
@@ -0,0 +1,59 @@
+/** @file     gfx/dm-gfx-pattern.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for checking frame file name patterns.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_PATTERN_H__
+#define __DM_GFX_PATTERN_H__
+
+#include <stddef.h>
+
+enum
+  {
+    DM_PATTERN_SLACK = 99  /**< Most characters a checked pattern's
+                              conversion can add to its length. */
+  };
+
+/** Check a printf pattern for the names of files holding frames.
+ *
+ *  The pattern must have exactly one conversion, %lu (given the frame
+ *  number), with at most a two-digit width and optionally the 0
+ *  flag, so no name it gives is more than DM_PATTERN_SLACK
+ *  characters longer than it; it may also have any number of %%.
+ *  This has no dependencies beyond the C library, so offline tools
+ *  can use it too.
+ *
+ *  @param pattern  The pattern to check.
+ *  @param size     The size of the buffer names are formatted into,
+ *                  including the terminator.
+ *
+ *  @return DM_SUCCESS if the pattern is valid and any name it gives
+ *  fits in size characters, DM_FAILURE otherwise.
+ */
+
+int
+dm_check_frame_pattern (const char *pattern, size_t size);
+
+#endif /* __DM_GFX_PATTERN_H__ */
@@ -0,0 +1,267 @@
+/** @file     gfx/dm-gfx-pipeline.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Render thread for the DISMAL graphics subsystem.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+/* With DM_GFX_PIPELINED set, dm_gfx_update() does not draw the frame
+   itself: it hands the frame's queued commands and dirty rectangles
+   to the render thread, which draws and presents them while the game
+   thread runs the logic of, and records, the next frame.
+
+   Frames in flight hold pointers to image data, and are drawn with
+   the palette as it is when they are presented, so anything that
+   frees image data, writes to it or changes the palette syncs with
+   the render thread first.  Most of that already goes through
+   dm_queue_flush(), which syncs before drawing anything still
+   queued. */
+
+#include <stdlib.h>
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-pipeline.h"
+
+static void dm_pipeline_free(dm_GfxPipeline *p);
+static int dm_pipeline_render(void *arg);
+
+int
+dm_pipeline_init (dm_Config *conf)
+{
+  dm_GfxPipeline *p;
+  int i, buffers;
+
+  if (!(conf->gfx_flags & DM_GFX_PIPELINED))
+    return DM_SUCCESS;
+
+  /* Frames are only recorded with deferred drawing, and some drivers
+     must present on the main thread. */
+  if (!(conf->gfx_flags & DM_GFX_DEFERRED)
+      || dm_gfxdata->driver->init_render_thread == NULL
+      || !dm_gfxdata->driver->init_render_thread ())
+    {
+      dm_debug ("GFX: Cannot use a render thread; presenting on the "
+                "main thread.");
+      conf->gfx_flags &= ~DM_GFX_PIPELINED;
+      return DM_SUCCESS;
+    }
+
+  buffers = conf->gfx_command_buffers;
+
+  if (buffers < 2)
+    buffers = DM_PIPELINE_BUFFERS;
+  if (buffers > DM_PIPELINE_BUFFERS_MAX)
+    buffers = DM_PIPELINE_BUFFERS_MAX;
+
+  p = calloc (1, sizeof (dm_GfxPipeline));
+
+  if (p == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate render thread.");
+      return DM_FAILURE;
+    }
+
+  /* The command queue's own buffer is the one being recorded. */
+  p->slots = buffers - 1;
+
+  for (i = 0; i < p->slots; i++)
+    {
+      p->frames[i].max = DM_GFX_QUEUE_INIT;
+      p->frames[i].cmds = malloc (sizeof (dm_GfxCommand)
+                                  * DM_GFX_QUEUE_INIT);
+
+      if (p->frames[i].cmds == NULL)
+        {
+          dm_fatal ("GFX: Could not allocate command buffers.");
+          dm_pipeline_free (p);
+          return DM_FAILURE;
+        }
+    }
+
+  p->lock = dm_mutex_create ();
+  p->ready = dm_cond_create ();
+  p->done = dm_cond_create ();
+
+  if (p->lock == NULL || p->ready == NULL || p->done == NULL)
+    {
+      dm_fatal ("GFX: Could not create render thread lock.");
+      dm_pipeline_free (p);
+      return DM_FAILURE;
+    }
+
+  p->thread = dm_thread_create (dm_pipeline_render, p);
+
+  if (p->thread == NULL)
+    {
+      dm_fatal ("GFX: Could not start render thread.");
+      dm_pipeline_free (p);
+      return DM_FAILURE;
+    }
+
+  dm_debug ("GFX: Presenting on a render thread, %d command buffers.",
+            buffers);
+
+  dm_gfxdata->pipeline = p;
+  return DM_SUCCESS;
+}
+
+void
+dm_pipeline_cleanup (void)
+{
+  dm_GfxPipeline *p;
+
+  p = dm_gfxdata->pipeline;
+
+  if (p == NULL)
+    return;
+
+  dm_mutex_lock (p->lock);
+  p->quit = DM_TRUE;
+  dm_cond_signal (p->ready);
+  dm_mutex_unlock (p->lock);
+
+  dm_thread_wait (p->thread);
+  p->thread = NULL;
+
+  dm_debug ("GFX: Render thread presented %lu frames; waited for it "
+            "%lu times, for %lu us.", p->submitted, p->stalls,
+            p->stalled_us);
+
+  dm_gfxdata->pipeline = NULL;
+  dm_pipeline_free (p);
+}
+
+void
+dm_pipeline_submit (void)
+{
+  dm_GfxPipeline *p;
+  dm_GfxFrame *frame;
+  unsigned long start;
+
+  p = dm_gfxdata->pipeline;
+
+  /* Wait for a free buffer, which bounds how far the picture can lag
+     behind the game. */
+  dm_mutex_lock (p->lock);
+
+  if (p->queued == p->slots)
+    {
+      start = dm_time_us ();
+
+      while (p->queued == p->slots)
+        dm_cond_wait (p->done, p->lock);
+
+      p->stalls++;
+      p->stalled_us += dm_time_us () - start;
+    }
+
+  frame = &p->frames[(p->head + p->queued) % p->slots];
+  dm_mutex_unlock (p->lock);
+
+  /* The frame is not in flight yet, so the render thread will not
+     touch it while it is filled. */
+  dm_queue_swap (&frame->cmds, &frame->count, &frame->max);
+  dm_dirty_take (&frame->dirty);
+
+  dm_mutex_lock (p->lock);
+  p->queued++;
+  p->submitted++;
+  dm_cond_signal (p->ready);
+  dm_mutex_unlock (p->lock);
+}
+
+void
+dm_pipeline_sync (void)
+{
+  dm_GfxPipeline *p;
+
+  p = dm_gfxdata->pipeline;
+
+  if (p == NULL)
+    return;
+
+  dm_mutex_lock (p->lock);
+
+  while (p->queued > 0)
+    dm_cond_wait (p->done, p->lock);
+
+  dm_mutex_unlock (p->lock);
+}
+
+/* Free a pipeline that has no thread running. */
+static void
+dm_pipeline_free (dm_GfxPipeline *p)
+{
+  int i;
+
+  for (i = 0; i < p->slots; i++)
+    free (p->frames[i].cmds);
+
+  if (p->lock)
+    dm_mutex_destroy (p->lock);
+
+  if (p->ready)
+    dm_cond_destroy (p->ready);
+
+  if (p->done)
+    dm_cond_destroy (p->done);
+
+  free (p);
+}
+
+/* Draw and present frames until told to quit, then finish the frames
+   still in flight. */
+static int
+dm_pipeline_render (void *arg)
+{
+  dm_GfxPipeline *p;
+  dm_GfxFrame *frame;
+
+  p = arg;
+
+  dm_mutex_lock (p->lock);
+
+  for (;;)
+    {
+      while (p->queued == 0 && !p->quit)
+        dm_cond_wait (p->ready, p->lock);
+
+      if (p->queued == 0)
+        break;
+
+      frame = &p->frames[p->head];
+      dm_mutex_unlock (p->lock);
+
+      dm_queue_draw (frame->cmds, frame->count);
+      dm_dirty_present_rects (&frame->dirty);
+
+      dm_mutex_lock (p->lock);
+      p->head = (p->head + 1) % p->slots;
+      p->queued--;
+      dm_cond_broadcast (p->done);
+    }
+
+  dm_mutex_unlock (p->lock);
+  return 0;
+}
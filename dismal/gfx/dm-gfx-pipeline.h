@@ -0,0 +1,129 @@
+/** @file     gfx/dm-gfx-pipeline.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for the render thread.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_PIPELINE_H__
+#define __DM_GFX_PIPELINE_H__
+
+#include "../dismal.h"
+
+enum {
+  DM_PIPELINE_BUFFERS     = 2, /**< Default number of command buffers:
+                                  one being recorded, and one frame in
+                                  flight. */
+  DM_PIPELINE_BUFFERS_MAX = 3  /**< Most command buffers. */
+};
+
+typedef struct dm_GfxFrame dm_GfxFrame;
+typedef struct dm_GfxPipeline dm_GfxPipeline;
+
+/** A frame handed to the render thread. */
+struct dm_GfxFrame
+{
+  dm_GfxCommand *cmds;   /**< The frame's draw commands. */
+  unsigned long count;   /**< Number of commands. */
+  unsigned long max;     /**< Allocated size of cmds. */
+  dm_GfxDirty dirty;     /**< Regions of the screen the frame drew
+                            to. */
+};
+
+/** State of the render thread.
+ *
+ *  Frames in flight wait in a ring, from head onwards; the one at
+ *  head is being drawn.  The game thread records the next frame into
+ *  the command queue, whose buffer is swapped with a free frame's
+ *  when the frame is handed over.
+ */
+struct dm_GfxPipeline
+{
+  dm_Thread *thread;     /**< The render thread. */
+  dm_Mutex *lock;        /**< Lock protecting head, queued and
+                            quit. */
+  dm_Cond *ready;        /**< Signalled when a frame is handed over,
+                            or the render thread should quit. */
+  dm_Cond *done;         /**< Broadcast when a frame has been
+                            presented. */
+  dm_GfxFrame frames[DM_PIPELINE_BUFFERS_MAX - 1]; /**< Ring of frames
+                                                      in flight. */
+  int slots;             /**< Most frames in flight. */
+  int head;              /**< Frame being drawn, if any. */
+  int queued;            /**< Number of frames in flight. */
+  int quit;              /**< Set to make the render thread finish. */
+  unsigned long submitted; /**< Frames handed over. */
+  unsigned long stalls;  /**< Frames the game thread had to wait to
+                            hand over. */
+  unsigned long stalled_us; /**< Microseconds spent waiting. */
+};
+
+
+/** Start the render thread, if DM_GFX_PIPELINED is set.
+ *
+ *  If the driver must present on the thread that initialised it, the
+ *  flag is cleared, and frames are presented by dm_gfx_update() as
+ *  usual.
+ *
+ *  This should NOT be called outside dm_gfx_init.
+ *
+ *  @param conf  The configuration.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_pipeline_init(dm_Config *conf);
+
+
+/** Stop the render thread, after it has presented every frame in
+ *  flight.
+ *
+ *  This should NOT be called outside dm_gfx_cleanup.
+ */
+
+void dm_pipeline_cleanup(void);
+
+
+/** Hand the frame recorded in the command queue to the render thread,
+ *  which draws and presents it, and start a new one.
+ *
+ *  If as many frames as there are command buffers to spare are
+ *  already in flight, this waits for the oldest to be presented, so
+ *  the picture never lags the game by more than that.
+ *
+ *  This should NOT be called outside dm_gfx_update.
+ */
+
+void dm_pipeline_submit(void);
+
+
+/** Wait for the render thread to present every frame in flight.
+ *
+ *  Anything that changes what frames in flight might draw with (such
+ *  as image data or the palette) must call this first.  It returns
+ *  straight away without a render thread.
+ */
+
+void dm_pipeline_sync(void);
+
+#endif /* __DM_GFX_PIPELINE_H__ */
@@ -0,0 +1,366 @@
+/** @file     gfx/dm-gfx-pixel.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Driver-independent pixel kernels.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-pixel.h"
+
+/* One band of an enlargement, as handed to a worker. */
+typedef struct dm_PixelBand
+{
+  const unsigned char *src;
+  unsigned long src_pitch;
+  unsigned char *dest;
+  unsigned long dest_pitch;
+  unsigned int width;
+  unsigned int height;
+  unsigned int bpp;
+  unsigned int x_factor;
+  unsigned int y_factor;
+  const unsigned short *x_map; /* Set for table enlargements. */
+  const unsigned short *y_map;
+} dm_PixelBand;
+
+static void dm_pixel_scale_band (void *arg);
+static void dm_pixel_split_bands (struct dm_Pool *pool,
+                                  dm_PixelBand *whole,
+                                  unsigned int rows,
+                                  unsigned int width);
+static void dm_pixel_stretch_row (const unsigned char *src,
+                                  unsigned char *dest,
+                                  unsigned int width,
+                                  unsigned int bpp,
+                                  unsigned int x_factor);
+
+void
+dm_pixel_scale_nearest (const unsigned char *src,
+                        unsigned long src_pitch,
+                        unsigned char *dest,
+                        unsigned long dest_pitch,
+                        unsigned int width,
+                        unsigned int height,
+                        unsigned int bpp,
+                        unsigned int x_factor,
+                        unsigned int y_factor)
+{
+  unsigned int y, i;
+  unsigned long row_bytes;
+
+  row_bytes = (unsigned long) width * x_factor * bpp;
+
+  for (y = 0; y < height; y++)
+    {
+      /* Stretch each source row once, then copy it for the rest of
+         its block. */
+      dm_pixel_stretch_row (src, dest, width, bpp, x_factor);
+
+      for (i = 1; i < y_factor; i++)
+        memcpy (dest + i * dest_pitch, dest, row_bytes);
+
+      src += src_pitch;
+      dest += dest_pitch * y_factor;
+    }
+}
+
+void
+dm_pixel_scale_nearest_bands (struct dm_Pool *pool,
+                              const unsigned char *src,
+                              unsigned long src_pitch,
+                              unsigned char *dest,
+                              unsigned long dest_pitch,
+                              unsigned int width,
+                              unsigned int height,
+                              unsigned int bpp,
+                              unsigned int x_factor,
+                              unsigned int y_factor)
+{
+  dm_PixelBand whole;
+
+  whole.src = src;
+  whole.src_pitch = src_pitch;
+  whole.dest = dest;
+  whole.dest_pitch = dest_pitch;
+  whole.width = width;
+  whole.height = height;
+  whole.bpp = bpp;
+  whole.x_factor = x_factor;
+  whole.y_factor = y_factor;
+  whole.x_map = whole.y_map = NULL;
+
+  dm_pixel_split_bands (pool, &whole, height, width);
+}
+
+void
+dm_pixel_scale_table (const unsigned char *src,
+                      unsigned long src_pitch,
+                      unsigned char *dest,
+                      unsigned long dest_pitch,
+                      unsigned int width,
+                      unsigned int height,
+                      unsigned int bpp,
+                      const unsigned short x_map[],
+                      const unsigned short y_map[])
+{
+  const unsigned char *row;
+  unsigned long row_bytes;
+  unsigned int x, y;
+
+  row_bytes = (unsigned long) width * bpp;
+
+  for (y = 0; y < height; y++, dest += dest_pitch)
+    {
+      /* Rows taken from the same source row as the last are copies
+         of it. */
+      if (y > 0 && y_map[y] == y_map[y - 1])
+        {
+          memcpy (dest, dest - dest_pitch, row_bytes);
+          continue;
+        }
+
+      row = src + y_map[y] * src_pitch;
+
+      switch (bpp)
+        {
+        case 4:
+          for (x = 0; x < width; x++)
+            memcpy (dest + x * 4, row + x_map[x] * 4, 4);
+          break;
+        case 2:
+          for (x = 0; x < width; x++)
+            memcpy (dest + x * 2, row + x_map[x] * 2, 2);
+          break;
+        default:
+          for (x = 0; x < width; x++)
+            memcpy (dest + x * bpp, row + x_map[x] * bpp, bpp);
+          break;
+        }
+    }
+}
+
+void
+dm_pixel_scale_table_bands (struct dm_Pool *pool,
+                            const unsigned char *src,
+                            unsigned long src_pitch,
+                            unsigned char *dest,
+                            unsigned long dest_pitch,
+                            unsigned int width,
+                            unsigned int height,
+                            unsigned int bpp,
+                            const unsigned short x_map[],
+                            const unsigned short y_map[])
+{
+  dm_PixelBand whole;
+
+  whole.src = src;
+  whole.src_pitch = src_pitch;
+  whole.dest = dest;
+  whole.dest_pitch = dest_pitch;
+  whole.width = width;
+  whole.height = height;
+  whole.bpp = bpp;
+  whole.x_factor = whole.y_factor = 1;
+  whole.x_map = x_map;
+  whole.y_map = y_map;
+
+  dm_pixel_split_bands (pool, &whole, height, width);
+}
+
+void
+dm_pixel_premultiply (unsigned char *pixels,
+                      unsigned long pitch,
+                      unsigned int width,
+                      unsigned int height)
+{
+  unsigned int x, y, px, a;
+
+  /* This is done once, at load time, so it need not be quick. */
+  for (y = 0; y < height; y++, pixels += pitch)
+    for (x = 0; x < width; x++)
+      {
+        memcpy (&px, pixels + x * 4, 4);
+        a = px >> 24;
+
+        if (a == 0)
+          px = 0;
+        else if (a != 255)
+          px = ((a << 24)
+                | ((((px >> 16) & 0xFF) * a + 127) / 255) << 16
+                | ((((px >> 8) & 0xFF) * a + 127) / 255) << 8
+                | ((px & 0xFF) * a + 127) / 255);
+
+        memcpy (pixels + x * 4, &px, 4);
+      }
+}
+
+/* Enlarge one band, on whichever thread gets it. */
+static void
+dm_pixel_scale_band (void *arg)
+{
+  dm_PixelBand *b;
+
+  b = (dm_PixelBand *) arg;
+
+  if (b->y_map)
+    dm_pixel_scale_table (b->src, b->src_pitch, b->dest, b->dest_pitch,
+                          b->width, b->height, b->bpp, b->x_map,
+                          b->y_map);
+  else
+    dm_pixel_scale_nearest (b->src, b->src_pitch, b->dest,
+                            b->dest_pitch, b->width, b->height, b->bpp,
+                            b->x_factor, b->y_factor);
+}
+
+/* Split an enlargement into bands of its rows, which are source rows
+   for block enlargements and destination rows for table ones, and
+   enlarge them between a worker pool and the calling thread. */
+static void
+dm_pixel_split_bands (struct dm_Pool *pool,
+                      dm_PixelBand *whole,
+                      unsigned int rows,
+                      unsigned int width)
+{
+  dm_PixelBand bands[DM_PIXEL_BANDS_MAX];
+  dm_PoolGroup group;
+  unsigned long count;
+  unsigned int i, y;
+
+  /* One band for each worker, and one for this thread, which works
+     through the queue while it waits. */
+  count = (unsigned long) dm_pool_size (pool) + 1;
+
+  if (count > (unsigned long) width * rows / DM_PIXEL_BAND_PIXELS)
+    count = (unsigned long) width * rows / DM_PIXEL_BAND_PIXELS;
+  if (count > DM_PIXEL_BANDS_MAX)
+    count = DM_PIXEL_BANDS_MAX;
+  if (count > rows)
+    count = rows;
+
+  if (count <= 1)
+    {
+      dm_pixel_scale_band (whole);
+      return;
+    }
+
+  dm_pool_group_init (&group);
+
+  for (i = 0, y = 0; i < count; i++)
+    {
+      bands[i] = *whole;
+      bands[i].height = (rows - y) / (count - i);
+
+      if (whole->y_map)
+        {
+          bands[i].dest = whole->dest + y * whole->dest_pitch;
+          bands[i].y_map = whole->y_map + y;
+        }
+      else
+        {
+          bands[i].src = whole->src + y * whole->src_pitch;
+          bands[i].dest = (whole->dest
+                           + y * whole->y_factor * whole->dest_pitch);
+        }
+
+      y += bands[i].height;
+      dm_pool_submit (pool, &group, dm_pixel_scale_band, &bands[i]);
+    }
+
+  dm_pool_wait (pool, &group);
+}
+
+/* Stretch one row of pixels horizontally. */
+static void
+dm_pixel_stretch_row (const unsigned char *src,
+                      unsigned char *dest,
+                      unsigned int width,
+                      unsigned int bpp,
+                      unsigned int x_factor)
+{
+  unsigned int x, i;
+
+#ifdef __SSE2__
+  __m128i v, p;
+  int pixel;
+
+  if (bpp == 4 && x_factor == 2)
+    {
+      /* Four pixels in, eight out: interleave the vector with
+         itself. */
+      for (x = 0; x + 4 <= width; x += 4, src += 16, dest += 32)
+        {
+          v = _mm_loadu_si128 ((const __m128i *) src);
+          _mm_storeu_si128 ((__m128i *) dest, _mm_unpacklo_epi32 (v, v));
+          _mm_storeu_si128 ((__m128i *) (dest + 16),
+                            _mm_unpackhi_epi32 (v, v));
+        }
+
+      width -= x;
+    }
+  else if (bpp == 2 && x_factor == 2)
+    {
+      for (x = 0; x + 8 <= width; x += 8, src += 16, dest += 32)
+        {
+          v = _mm_loadu_si128 ((const __m128i *) src);
+          _mm_storeu_si128 ((__m128i *) dest, _mm_unpacklo_epi16 (v, v));
+          _mm_storeu_si128 ((__m128i *) (dest + 16),
+                            _mm_unpackhi_epi16 (v, v));
+        }
+
+      width -= x;
+    }
+  else if (bpp == 4 && x_factor >= 4)
+    {
+      /* Broadcast each pixel across a vector and store it as many
+         times as it fits in the pixel's block. */
+      for (x = 0; x < width; x++, src += 4)
+        {
+          memcpy (&pixel, src, 4);
+          p = _mm_set1_epi32 (pixel);
+
+          for (i = 0; i + 4 <= x_factor; i += 4, dest += 16)
+            _mm_storeu_si128 ((__m128i *) dest, p);
+
+          for (; i < x_factor; i++, dest += 4)
+            memcpy (dest, src, 4);
+        }
+
+      return;
+    }
+#endif /* __SSE2__ */
+
+  /* Whatever remains is done a pixel at a time. */
+  for (x = 0; x < width; x++, src += bpp)
+    {
+      for (i = 0; i < x_factor; i++, dest += bpp)
+        memcpy (dest, src, bpp);
+    }
+}
@@ -0,0 +1,196 @@
+/** @file     gfx/dm-gfx-pixel.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for driver-independent pixel kernels.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_PIXEL_H__
+#define __DM_GFX_PIXEL_H__
+
+struct dm_Pool;
+
+enum
+  {
+    DM_PIXEL_BANDS_MAX = 16,      /**< Most bands an enlargement is
+                                     split into. */
+    DM_PIXEL_BAND_PIXELS = 4096   /**< Fewest source pixels worth
+                                     giving a band of their own. */
+  };
+
+typedef struct dm_GfxPixelFormat dm_GfxPixelFormat;
+
+/** A description of a packed-pixel format. */
+struct dm_GfxPixelFormat
+{
+  unsigned int bits;   /**< Bits per pixel. */
+  unsigned long rmask; /**< Mask of the red bits of a pixel. */
+  unsigned long gmask; /**< Mask of the green bits of a pixel. */
+  unsigned long bmask; /**< Mask of the blue bits of a pixel. */
+  unsigned long amask; /**< Mask of the alpha bits of a pixel, or 0
+                          if the format has no alpha channel. */
+  int keyed;           /**< If non-zero, pixels equal to key are
+                          transparent. */
+  unsigned long key;   /**< The colour key pixel value. */
+};
+
+/** Enlarge a block of pixels by integer factors, using nearest
+ *  neighbour sampling (each pixel becomes an x_factor by y_factor
+ *  block).
+ *
+ *  Pixels are treated as opaque bytes, so this works for any pixel
+ *  format; 16- and 32-bit pixels take a SIMD path where one is
+ *  available.
+ *
+ *  @param src         Pointer to the first source pixel.
+ *  @param src_pitch   Bytes from one source row to the next.
+ *  @param dest        Pointer to the first destination pixel.  The
+ *                     destination must hold width * x_factor by
+ *                     height * y_factor pixels.
+ *  @param dest_pitch  Bytes from one destination row to the next.
+ *  @param width       Width of the source, in pixels.
+ *  @param height      Height of the source, in pixels.
+ *  @param bpp         Bytes per pixel.
+ *  @param x_factor    Horizontal enlargement factor.
+ *  @param y_factor    Vertical enlargement factor.
+ */
+
+void
+dm_pixel_scale_nearest (const unsigned char *src,
+                        unsigned long src_pitch,
+                        unsigned char *dest,
+                        unsigned long dest_pitch,
+                        unsigned int width,
+                        unsigned int height,
+                        unsigned int bpp,
+                        unsigned int x_factor,
+                        unsigned int y_factor);
+
+
+/** Enlarge a block of pixels as dm_pixel_scale_nearest does, split
+ *  into bands of rows shared between a worker pool and the calling
+ *  thread.
+ *
+ *  Blocks too small to be worth splitting are enlarged on the calling
+ *  thread.
+ *
+ *  @param pool        The worker pool, or NULL to use only the
+ *                     calling thread.
+ *  @param src         Pointer to the first source pixel.
+ *  @param src_pitch   Bytes from one source row to the next.
+ *  @param dest        Pointer to the first destination pixel.
+ *  @param dest_pitch  Bytes from one destination row to the next.
+ *  @param width       Width of the source, in pixels.
+ *  @param height      Height of the source, in pixels.
+ *  @param bpp         Bytes per pixel.
+ *  @param x_factor    Horizontal enlargement factor.
+ *  @param y_factor    Vertical enlargement factor.
+ */
+
+void
+dm_pixel_scale_nearest_bands (struct dm_Pool *pool,
+                              const unsigned char *src,
+                              unsigned long src_pitch,
+                              unsigned char *dest,
+                              unsigned long dest_pitch,
+                              unsigned int width,
+                              unsigned int height,
+                              unsigned int bpp,
+                              unsigned int x_factor,
+                              unsigned int y_factor);
+
+
+/** Enlarge (or shrink) a block of pixels by any factor, using
+ *  nearest neighbour sampling through tables giving the source
+ *  column and row of each destination column and row.
+ *
+ *  Pixels are treated as opaque bytes, as with
+ *  dm_pixel_scale_nearest.  Destination rows taken from the same
+ *  source row as the one above are copied from it.
+ *
+ *  @param src         Pointer to the source pixel that the tables
+ *                     count from.
+ *  @param src_pitch   Bytes from one source row to the next.
+ *  @param dest        Pointer to the first destination pixel.
+ *  @param dest_pitch  Bytes from one destination row to the next.
+ *  @param width       Width of the destination, in pixels.
+ *  @param height      Height of the destination, in pixels.
+ *  @param bpp         Bytes per pixel.
+ *  @param x_map       Source column of each destination column.
+ *  @param y_map       Source row of each destination row.
+ */
+
+void
+dm_pixel_scale_table (const unsigned char *src,
+                      unsigned long src_pitch,
+                      unsigned char *dest,
+                      unsigned long dest_pitch,
+                      unsigned int width,
+                      unsigned int height,
+                      unsigned int bpp,
+                      const unsigned short x_map[],
+                      const unsigned short y_map[]);
+
+
+/** Enlarge a block of pixels as dm_pixel_scale_table does, split
+ *  into bands of destination rows as dm_pixel_scale_nearest_bands
+ *  splits its source rows.
+ *
+ *  @param pool  The worker pool, or NULL to use only the calling
+ *               thread.
+ *
+ *  @see dm_pixel_scale_table for the other parameters.
+ */
+
+void
+dm_pixel_scale_table_bands (struct dm_Pool *pool,
+                            const unsigned char *src,
+                            unsigned long src_pitch,
+                            unsigned char *dest,
+                            unsigned long dest_pitch,
+                            unsigned int width,
+                            unsigned int height,
+                            unsigned int bpp,
+                            const unsigned short x_map[],
+                            const unsigned short y_map[]);
+
+
+/** Multiply the colour channels of a block of 32-bit pixels by their
+ *  alpha, in place, for drawing with dm_blit_blend or dm_blit_add.
+ *
+ *  Alpha is the top 8 bits of each pixel, and the other three
+ *  channels may be in any order.
+ *
+ *  @param pixels  Pointer to the first pixel.
+ *  @param pitch   Bytes from one row to the next.
+ *  @param width   Width of the block, in pixels.
+ *  @param height  Height of the block, in pixels.
+ */
+
+void
+dm_pixel_premultiply (unsigned char *pixels,
+                      unsigned long pitch,
+                      unsigned int width,
+                      unsigned int height);
+
+#endif /* __DM_GFX_PIXEL_H__ */
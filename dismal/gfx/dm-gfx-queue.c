@@ -0,0 +1,473 @@
+/** @file     gfx/dm-gfx-queue.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Deferred draw command queue for the DISMAL graphics subsystem.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+/* With DM_GFX_DEFERRED set, draws are recorded here rather than sent
+   straight to the driver, and dm_gfx_update() submits the whole frame
+   at once.
+
+   To keep the picture the same as immediate drawing, each command is
+   given a layer one above the highest layer of any earlier command it
+   might overlap, tracked on a coarse grid of screen cells.  Commands
+   in one layer therefore never overlap each other, and may be sorted
+   freely within it: by source image, so that blits from one image run
+   together, and by position, so that abutting fills of one colour sit
+   next to each other and can be merged. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-queue.h"
+
+enum {
+  DM_GFX_QUEUE_MAX_LAYER  = 0xFFFF, /**< Highest layer number. */
+  DM_GFX_QUEUE_MAX_EXTENT = 0xFFFF  /**< Largest width or height of a
+                                       merged fill. */
+};
+
+static int dm_queue_add(dm_GfxCommand *cmd);
+static unsigned short dm_queue_layer(const dm_GfxCommand *cmd);
+static int dm_queue_compare_batch(const dm_GfxCommand *a,
+                                  const dm_GfxCommand *b);
+static int dm_queue_compare_rows(const void *a, const void *b);
+static int dm_queue_compare_columns(const void *a, const void *b);
+static unsigned long dm_queue_merge_fills(dm_GfxCommand *cmds,
+                                          unsigned long count,
+                                          int vertical);
+
+int
+dm_queue_init (void)
+{
+  dm_GfxQueue *q;
+
+  q = malloc (sizeof (dm_GfxQueue));
+
+  if (q == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate command queue.");
+      return DM_FAILURE;
+    }
+
+  q->count = 0;
+  q->max = DM_GFX_QUEUE_INIT;
+  q->cells_w = ((dm_gfxdata->width + DM_GFX_QUEUE_CELL - 1)
+                 / DM_GFX_QUEUE_CELL);
+  q->cells_h = ((dm_gfxdata->height + DM_GFX_QUEUE_CELL - 1)
+                 / DM_GFX_QUEUE_CELL);
+
+  q->cmds = malloc (sizeof (dm_GfxCommand) * q->max);
+  q->cells = calloc ((size_t) q->cells_w * q->cells_h + 1,
+                     sizeof (unsigned short));
+
+  if (q->cmds == NULL || q->cells == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate command queue.");
+      if (q->cmds)
+        free (q->cmds);
+      if (q->cells)
+        free (q->cells);
+      free (q);
+      return DM_FAILURE;
+    }
+
+  dm_gfxdata->queue = q;
+  return DM_SUCCESS;
+}
+
+void
+dm_queue_cleanup (void)
+{
+  if (dm_gfxdata->queue == NULL)
+    return;
+
+  free (dm_gfxdata->queue->cmds);
+  free (dm_gfxdata->queue->cells);
+  free (dm_gfxdata->queue);
+
+  dm_gfxdata->queue = NULL;
+}
+
+int
+dm_queue_image (struct dm_GfxImageNode *image,
+                unsigned short image_x,
+                unsigned short image_y,
+                unsigned short screen_x,
+                unsigned short screen_y,
+                unsigned short width,
+                unsigned short height)
+{
+  dm_GfxCommand cmd;
+
+  cmd.type = DM_GFX_CMD_IMAGE;
+  cmd.image = image;
+  cmd.key = (unsigned long) image->handle;
+  cmd.image_x = image_x;
+  cmd.image_y = image_y;
+  cmd.screen_x = screen_x;
+  cmd.screen_y = screen_y;
+  cmd.width = width;
+  cmd.height = height;
+  cmd.r = cmd.g = cmd.b = 0;
+
+  return dm_queue_add (&cmd);
+}
+
+int
+dm_queue_fill (unsigned short x,
+               unsigned short y,
+               unsigned short w,
+               unsigned short h,
+               unsigned char r,
+               unsigned char g,
+               unsigned char b)
+{
+  dm_GfxCommand cmd;
+
+  cmd.type = DM_GFX_CMD_FILL;
+  cmd.image = NULL;
+  cmd.key = ((unsigned long) r << 16) | ((unsigned long) g << 8) | b;
+  cmd.image_x = cmd.image_y = 0;
+  cmd.screen_x = x;
+  cmd.screen_y = y;
+  cmd.width = w;
+  cmd.height = h;
+  cmd.r = r;
+  cmd.g = g;
+  cmd.b = b;
+
+  return dm_queue_add (&cmd);
+}
+
+int
+dm_queue_fill_pal (unsigned short x,
+                   unsigned short y,
+                   unsigned short w,
+                   unsigned short h,
+                   unsigned char index)
+{
+  dm_GfxCommand cmd;
+
+  cmd.type = DM_GFX_CMD_FILL_PAL;
+  cmd.image = NULL;
+  cmd.key = index;
+  cmd.image_x = cmd.image_y = 0;
+  cmd.screen_x = x;
+  cmd.screen_y = y;
+  cmd.width = w;
+  cmd.height = h;
+  cmd.r = cmd.g = cmd.b = 0;
+
+  return dm_queue_add (&cmd);
+}
+
+void
+dm_queue_flush (void)
+{
+  dm_GfxQueue *q;
+
+  if (dm_gfxdata == NULL || dm_gfxdata->queue == NULL)
+    return;
+
+  /* Whatever needed the queue drawn may also need frames the render
+     thread has in flight to be out of the way. */
+  dm_pipeline_sync ();
+
+  q = dm_gfxdata->queue;
+
+  if (q->count == 0)
+    return;
+
+  dm_queue_draw (q->cmds, q->count);
+
+  q->count = 0;
+  memset (q->cells, 0,
+          sizeof (unsigned short) * ((size_t) q->cells_w * q->cells_h + 1));
+}
+
+void
+dm_queue_swap (dm_GfxCommand **cmds,
+               unsigned long *count,
+               unsigned long *max)
+{
+  dm_GfxQueue *q;
+  dm_GfxCommand *swap_cmds;
+  unsigned long swap_max;
+
+  q = dm_gfxdata->queue;
+
+  swap_cmds = q->cmds;
+  swap_max = q->max;
+  q->cmds = *cmds;
+  q->max = *max;
+  *cmds = swap_cmds;
+  *max = swap_max;
+  *count = q->count;
+
+  q->count = 0;
+  memset (q->cells, 0,
+          sizeof (unsigned short) * ((size_t) q->cells_w * q->cells_h + 1));
+}
+
+void
+dm_queue_draw (dm_GfxCommand *cmds, unsigned long count)
+{
+  dm_GfxCommand *cmd;
+  unsigned long i;
+
+  if (count == 0)
+    return;
+
+  /* Merge runs of fills along rows, then down columns. */
+  qsort (cmds, count, sizeof (dm_GfxCommand), dm_queue_compare_rows);
+  count = dm_queue_merge_fills (cmds, count, DM_FALSE);
+
+  qsort (cmds, count, sizeof (dm_GfxCommand), dm_queue_compare_columns);
+  count = dm_queue_merge_fills (cmds, count, DM_TRUE);
+
+  if (dm_gfxdata->driver->submit_batch)
+    dm_gfxdata->driver->submit_batch (cmds, count);
+  else
+    {
+      for (i = 0, cmd = cmds; i < count; i++, cmd++)
+        {
+          if (cmd->type == DM_GFX_CMD_IMAGE)
+            dm_gfxdata->driver->draw_image (cmd->image,
+                                            cmd->image_x, cmd->image_y,
+                                            cmd->screen_x, cmd->screen_y,
+                                            cmd->width, cmd->height);
+          else if (cmd->type == DM_GFX_CMD_FILL_PAL)
+            dm_gfxdata->driver->fill_rect_pal (cmd->screen_x,
+                                               cmd->screen_y,
+                                               cmd->width, cmd->height,
+                                               cmd->key);
+          else
+            dm_gfxdata->driver->fill_rect_rgb (cmd->screen_x,
+                                               cmd->screen_y,
+                                               cmd->width, cmd->height,
+                                               cmd->r, cmd->g, cmd->b);
+        }
+    }
+}
+
+/* Append a command to the queue, dropping it if nothing of it would
+   be visible. */
+static int
+dm_queue_add (dm_GfxCommand *cmd)
+{
+  dm_GfxQueue *q;
+  dm_GfxCommand *cmds;
+
+  q = dm_gfxdata->queue;
+
+  if (cmd->width == 0 || cmd->height == 0
+      || cmd->screen_x >= dm_gfxdata->width
+      || cmd->screen_y >= dm_gfxdata->height)
+    return DM_SUCCESS;
+
+  if (q->count == q->max)
+    {
+      cmds = realloc (q->cmds, sizeof (dm_GfxCommand) * q->max * 2);
+
+      if (cmds == NULL)
+        {
+          dm_fatal ("GFX: Could not grow command queue.");
+          return DM_FAILURE;
+        }
+
+      q->cmds = cmds;
+      q->max *= 2;
+    }
+
+  cmd->layer = dm_queue_layer (cmd);
+
+  /* Out of layers: draw what there is, and start again. */
+  if (cmd->layer == 0)
+    {
+      dm_queue_flush ();
+      cmd->layer = dm_queue_layer (cmd);
+    }
+
+  cmd->seq = q->count;
+  q->cmds[q->count++] = *cmd;
+
+  return DM_SUCCESS;
+}
+
+/* Work out the layer of a new command, and mark its cells as drawn
+   to in that layer.  Returns 0 if the layers have run out. */
+static unsigned short
+dm_queue_layer (const dm_GfxCommand *cmd)
+{
+  dm_GfxQueue *q;
+  unsigned short layer, *row;
+  int x0, y0, x1, y1, x, y;
+  unsigned long right, bottom;
+
+  q = dm_gfxdata->queue;
+
+  right = (unsigned long) cmd->screen_x + cmd->width;
+  bottom = (unsigned long) cmd->screen_y + cmd->height;
+
+  if (right > (unsigned long) dm_gfxdata->width)
+    right = dm_gfxdata->width;
+  if (bottom > (unsigned long) dm_gfxdata->height)
+    bottom = dm_gfxdata->height;
+
+  x0 = cmd->screen_x / DM_GFX_QUEUE_CELL;
+  y0 = cmd->screen_y / DM_GFX_QUEUE_CELL;
+  x1 = (int) ((right - 1) / DM_GFX_QUEUE_CELL);
+  y1 = (int) ((bottom - 1) / DM_GFX_QUEUE_CELL);
+
+  layer = 0;
+
+  for (y = y0; y <= y1; y++)
+    {
+      row = q->cells + y * q->cells_w;
+
+      for (x = x0; x <= x1; x++)
+        {
+          if (row[x] > layer)
+            layer = row[x];
+        }
+    }
+
+  if (layer == DM_GFX_QUEUE_MAX_LAYER)
+    return 0;
+
+  layer++;
+
+  for (y = y0; y <= y1; y++)
+    {
+      row = q->cells + y * q->cells_w;
+
+      for (x = x0; x <= x1; x++)
+        row[x] = layer;
+    }
+
+  return layer;
+}
+
+/* Compare the parts of two commands' sort keys that come before
+   position: layer, then type, then image or colour. */
+static int
+dm_queue_compare_batch (const dm_GfxCommand *a, const dm_GfxCommand *b)
+{
+  if (a->layer != b->layer)
+    return (a->layer < b->layer) ? -1 : 1;
+  if (a->type != b->type)
+    return (a->type < b->type) ? -1 : 1;
+  if (a->key != b->key)
+    return (a->key < b->key) ? -1 : 1;
+
+  return 0;
+}
+
+/* Sort by batch, then top to bottom, then left to right. */
+static int
+dm_queue_compare_rows (const void *a, const void *b)
+{
+  const dm_GfxCommand *ca, *cb;
+  int c;
+
+  ca = (const dm_GfxCommand*) a;
+  cb = (const dm_GfxCommand*) b;
+
+  if ((c = dm_queue_compare_batch (ca, cb)) != 0)
+    return c;
+  if (ca->screen_y != cb->screen_y)
+    return (ca->screen_y < cb->screen_y) ? -1 : 1;
+  if (ca->screen_x != cb->screen_x)
+    return (ca->screen_x < cb->screen_x) ? -1 : 1;
+
+  return (ca->seq < cb->seq) ? -1 : (ca->seq > cb->seq);
+}
+
+/* Sort by batch, then left to right, then top to bottom. */
+static int
+dm_queue_compare_columns (const void *a, const void *b)
+{
+  const dm_GfxCommand *ca, *cb;
+  int c;
+
+  ca = (const dm_GfxCommand*) a;
+  cb = (const dm_GfxCommand*) b;
+
+  if ((c = dm_queue_compare_batch (ca, cb)) != 0)
+    return c;
+  if (ca->screen_x != cb->screen_x)
+    return (ca->screen_x < cb->screen_x) ? -1 : 1;
+  if (ca->screen_y != cb->screen_y)
+    return (ca->screen_y < cb->screen_y) ? -1 : 1;
+
+  return (ca->seq < cb->seq) ? -1 : (ca->seq > cb->seq);
+}
+
+/* Merge each fill into the one before it where the two are the same
+   colour (or palette entry), in the same layer, and together form a
+   rectangle.  Returns the new number of commands. */
+static unsigned long
+dm_queue_merge_fills (dm_GfxCommand *cmds, unsigned long count,
+                      int vertical)
+{
+  dm_GfxCommand *p, *c;
+  unsigned long i, out;
+
+  for (i = 0, out = 0; i < count; i++)
+    {
+      c = &cmds[i];
+      p = (out > 0) ? &cmds[out - 1] : NULL;
+
+      if (p && c->type != DM_GFX_CMD_IMAGE
+          && dm_queue_compare_batch (p, c) == 0)
+        {
+          if (!vertical && p->screen_y == c->screen_y
+              && p->height == c->height
+              && (unsigned long) p->screen_x + p->width == c->screen_x
+              && (unsigned long) p->width + c->width
+                 <= DM_GFX_QUEUE_MAX_EXTENT)
+            {
+              p->width += c->width;
+              continue;
+            }
+
+          if (vertical && p->screen_x == c->screen_x
+              && p->width == c->width
+              && (unsigned long) p->screen_y + p->height == c->screen_y
+              && (unsigned long) p->height + c->height
+                 <= DM_GFX_QUEUE_MAX_EXTENT)
+            {
+              p->height += c->height;
+              continue;
+            }
+        }
+
+      cmds[out++] = *c;
+    }
+
+  return out;
+}
@@ -0,0 +1,199 @@
+/** @file     gfx/dm-gfx-queue.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for the deferred draw command queue.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_QUEUE_H__
+#define __DM_GFX_QUEUE_H__
+
+enum {
+  /* Command types. */
+
+  DM_GFX_CMD_IMAGE = 0, /**< Draw part of an image. */
+  DM_GFX_CMD_FILL  = 1, /**< Fill a rectangle with a colour. */
+  DM_GFX_CMD_FILL_PAL = 2, /**< Fill a rectangle with a logical
+                              palette entry. */
+
+  DM_GFX_QUEUE_INIT = 256, /**< Initial size of the command queue; it
+                              doubles whenever it fills. */
+  DM_GFX_QUEUE_CELL = 32   /**< Width and height, in screen pixels, of
+                              the cells used to track which commands
+                              overlap. */
+};
+
+typedef struct dm_GfxCommand dm_GfxCommand;
+typedef struct dm_GfxQueue dm_GfxQueue;
+
+/** A queued draw command.
+ *
+ *  Coordinates are screen (high-res) coordinates, already translated
+ *  and clipped to the source image, exactly as they would have been
+ *  passed to the driver.
+ */
+struct dm_GfxCommand
+{
+  struct dm_GfxImageNode *image; /**< Image to draw, or NULL for a
+                                    fill. */
+  unsigned long key;     /**< Batching key: the image's handle, the
+                            fill colour, or the palette index of a
+                            palette fill. */
+  unsigned long seq;     /**< Position of the command in the frame. */
+  unsigned short layer;  /**< Commands in the same layer never
+                            overlap, so may be drawn in any order. */
+  unsigned short image_x;  /**< X coordinate within the image. */
+  unsigned short image_y;  /**< Y coordinate within the image. */
+  unsigned short screen_x; /**< X coordinate on screen. */
+  unsigned short screen_y; /**< Y coordinate on screen. */
+  unsigned short width;    /**< Width of the rectangle. */
+  unsigned short height;   /**< Height of the rectangle. */
+  unsigned char type;    /**< DM_GFX_CMD_IMAGE, DM_GFX_CMD_FILL or
+                            DM_GFX_CMD_FILL_PAL. */
+  unsigned char r;       /**< Red component of a fill. */
+  unsigned char g;       /**< Green component of a fill. */
+  unsigned char b;       /**< Blue component of a fill. */
+};
+
+/** The deferred draw command queue. */
+struct dm_GfxQueue
+{
+  dm_GfxCommand *cmds;   /**< Commands queued this frame. */
+  unsigned long count;   /**< Number of commands queued. */
+  unsigned long max;     /**< Allocated size of cmds. */
+  unsigned short *cells; /**< Highest layer drawn to in each cell. */
+  int cells_w;           /**< Width of the cell grid. */
+  int cells_h;           /**< Height of the cell grid. */
+};
+
+
+/** Initialise the deferred draw command queue.
+ *
+ *  This should NOT be called outside dm_gfx_init.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_queue_init(void);
+
+
+/** Shut down the command queue, throwing away any queued commands.
+ *
+ *  This should NOT be called outside dm_gfx_cleanup.
+ */
+
+void dm_queue_cleanup(void);
+
+
+/** Queue an image draw.
+ *
+ *  @see dm_GfxDriver's draw_image, which takes the same parameters.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_queue_image(struct dm_GfxImageNode *image,
+                   unsigned short image_x,
+                   unsigned short image_y,
+                   unsigned short screen_x,
+                   unsigned short screen_y,
+                   unsigned short width,
+                   unsigned short height);
+
+
+/** Queue a rectangle fill.
+ *
+ *  @see dm_GfxDriver's fill_rect_rgb, which takes the same
+ *  parameters.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_queue_fill(unsigned short x,
+                  unsigned short y,
+                  unsigned short w,
+                  unsigned short h,
+                  unsigned char r,
+                  unsigned char g,
+                  unsigned char b);
+
+
+/** Queue a rectangle fill with a logical palette entry.
+ *
+ *  This should only be used if the driver has fill_rect_pal.
+ *
+ *  @see dm_GfxDriver's fill_rect_pal, which takes the same
+ *  parameters.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_queue_fill_pal(unsigned short x,
+                      unsigned short y,
+                      unsigned short w,
+                      unsigned short h,
+                      unsigned char index);
+
+
+/** Sort, merge and submit every queued command to the driver.
+ *
+ *  Commands are grouped by source image, with fills of the same
+ *  colour or palette entry that abut merged, but never reordered
+ *  relative to commands that they overlap.  dm_gfx_update() calls this every frame.
+ */
+
+void dm_queue_flush(void);
+
+
+/** Exchange the queue's command buffer for another, taking the
+ *  commands queued so far and leaving the queue empty.
+ *
+ *  The render thread's frames are recorded this way (see
+ *  DM_GFX_PIPELINED).
+ *
+ *  @param cmds   Pointer to the buffer to give the queue, which is
+ *                set to the queue's old buffer.
+ *  @param count  Pointer to store the number of commands in the old
+ *                buffer.
+ *  @param max    Pointer to the allocated size of the buffer to give
+ *                the queue, which is set to that of the old buffer.
+ */
+
+void dm_queue_swap(dm_GfxCommand **cmds,
+                   unsigned long *count,
+                   unsigned long *max);
+
+
+/** Sort, merge and submit commands taken from the queue to the
+ *  driver.
+ *
+ *  @see dm_queue_flush
+ *
+ *  @param cmds   The commands, in the order they were queued.  They
+ *                are reordered in place.
+ *  @param count  The number of commands.
+ */
+
+void dm_queue_draw(dm_GfxCommand *cmds, unsigned long count);
+
+#endif /* __DM_GFX_QUEUE_H__ */
@@ -0,0 +1,515 @@
+/** @file     gfx/dm-gfx-record.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Frame recording for the DISMAL graphics subsystem.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-record.h"
+
+/* Statistics of the last recording, kept once it has stopped. */
+static dm_GfxRecordStats dm_record_last;
+
+static void dm_record_free(dm_GfxRecorder *r);
+static int dm_record_writer(void *arg);
+static unsigned long dm_record_encode(dm_GfxRecorder *r,
+                                      const dm_GfxRecordFrame *frame);
+static unsigned char *dm_record_runs(dm_GfxRecorder *r,
+                                     const dm_GfxRect *rect,
+                                     const unsigned char *src,
+                                     unsigned char *out);
+static unsigned char *dm_record_put16(unsigned char *out,
+                                      unsigned long value);
+static unsigned char *dm_record_put32(unsigned char *out,
+                                      unsigned long value);
+
+int
+dm_record_start (const char filename[], int buffers)
+{
+  dm_GfxRecorder *r;
+  unsigned char header[DM_RECORD_HEADER_SIZE], *p;
+  unsigned long frame_bytes;
+  int i;
+
+  if (dm_gfxdata->recorder)
+    {
+      dm_fatal ("GFX: Already recording.");
+      return DM_FAILURE;
+    }
+
+  if (dm_gfxdata->driver->read_pixels == NULL)
+    {
+      dm_fatal ("GFX: This driver cannot record.");
+      return DM_FAILURE;
+    }
+
+  if (buffers <= 0)
+    buffers = DM_RECORD_BUFFERS;
+
+  /* The render thread captures the frames it presents. */
+  dm_pipeline_sync ();
+
+  r = calloc (1, sizeof (dm_GfxRecorder));
+
+  if (r == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate recorder.");
+      return DM_FAILURE;
+    }
+
+  r->width = dm_gfxdata->width;
+  r->height = dm_gfxdata->height;
+  r->slots = buffers;
+  frame_bytes = (unsigned long) r->width * r->height * 3;
+
+  /* The writer's buffer must hold the worst case: every pixel
+     changed, in runs of one, in every rectangle. */
+  r->ring = calloc (buffers, sizeof (dm_GfxRecordFrame));
+  r->picture = calloc (frame_bytes ? frame_bytes : 1, 1);
+  r->out = malloc (DM_RECORD_FRAME_SIZE
+                   + DM_GFX_DIRTY_MAX * (DM_RECORD_RECT_SIZE
+                                         + DM_RECORD_RUN_SIZE)
+                   + frame_bytes / 3 * (DM_RECORD_RUN_SIZE + 3));
+
+  if (r->ring == NULL || r->picture == NULL || r->out == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate recording buffers.");
+      dm_record_free (r);
+      return DM_FAILURE;
+    }
+
+  for (i = 0; i < buffers; i++)
+    {
+      r->ring[i].pixels = malloc (frame_bytes ? frame_bytes : 1);
+
+      if (r->ring[i].pixels == NULL)
+        {
+          dm_fatal ("GFX: Could not allocate recording buffers.");
+          dm_record_free (r);
+          return DM_FAILURE;
+        }
+    }
+
+  r->file = fopen (filename, "wb");
+
+  if (r->file == NULL)
+    {
+      dm_fatal ("GFX: Could not open %s for recording.", filename);
+      dm_record_free (r);
+      return DM_FAILURE;
+    }
+
+  memcpy (header, DM_RECORD_MAGIC, 4);
+  p = dm_record_put32 (header + 4, DM_RECORD_VERSION);
+  p = dm_record_put32 (p, r->width);
+  dm_record_put32 (p, r->height);
+
+  if (fwrite (header, DM_RECORD_HEADER_SIZE, 1, r->file) != 1)
+    {
+      dm_fatal ("GFX: Could not write to %s.", filename);
+      dm_record_free (r);
+      return DM_FAILURE;
+    }
+
+  r->lock = dm_mutex_create ();
+  r->ready = dm_cond_create ();
+
+  if (r->lock == NULL || r->ready == NULL)
+    {
+      dm_fatal ("GFX: Could not create recorder lock.");
+      dm_record_free (r);
+      return DM_FAILURE;
+    }
+
+  /* The first frame must set every pixel, as nothing precedes it. */
+  r->resync = DM_TRUE;
+  r->start = dm_time_us ();
+  r->thread = dm_thread_create (dm_record_writer, r);
+
+  if (r->thread == NULL)
+    {
+      dm_fatal ("GFX: Could not start recording thread.");
+      dm_record_free (r);
+      return DM_FAILURE;
+    }
+
+  r->stats.bytes = DM_RECORD_HEADER_SIZE;
+  dm_gfxdata->recorder = r;
+
+  dm_debug ("GFX: Recording %ux%u frames to %s, %d buffers.",
+            r->width, r->height, filename, buffers);
+  return DM_SUCCESS;
+}
+
+void
+dm_record_stop (void)
+{
+  dm_GfxRecorder *r;
+  unsigned char trailer[DM_RECORD_TRAILER_SIZE], *p;
+
+  r = dm_gfxdata->recorder;
+
+  if (r == NULL)
+    return;
+
+  dm_pipeline_sync ();
+
+  dm_mutex_lock (r->lock);
+  r->quit = DM_TRUE;
+  dm_cond_signal (r->ready);
+  dm_mutex_unlock (r->lock);
+
+  dm_thread_wait (r->thread);
+  r->thread = NULL;
+
+  /* The trailer lets readers count frames dropped after the last one
+     written. */
+  if (!r->failed)
+    {
+      p = dm_record_put32 (trailer, DM_RECORD_END);
+      p = dm_record_put32 (p, r->stats.frames);
+      dm_record_put32 (p, dm_time_us () - r->start);
+
+      if (fwrite (trailer, DM_RECORD_TRAILER_SIZE, 1, r->file) == 1
+          && fflush (r->file) == 0)
+        r->stats.bytes += DM_RECORD_TRAILER_SIZE;
+      else
+        dm_fatal ("GFX: Could not write recording trailer.");
+    }
+
+  dm_record_last = r->stats;
+  dm_debug ("GFX: Recorded %lu of %lu frames (%lu dropped), "
+            "%lu bytes.", r->stats.written, r->stats.frames,
+            r->stats.dropped, r->stats.bytes);
+
+  dm_gfxdata->recorder = NULL;
+  dm_record_free (r);
+}
+
+void
+dm_record_stats (dm_GfxRecordStats *stats)
+{
+  dm_GfxRecorder *r;
+
+  r = dm_gfxdata->recorder;
+
+  if (r == NULL)
+    {
+      *stats = dm_record_last;
+      return;
+    }
+
+  dm_mutex_lock (r->lock);
+  *stats = r->stats;
+  dm_mutex_unlock (r->lock);
+}
+
+void
+dm_record_frame (const dm_GfxDirty *dirty)
+{
+  dm_GfxRecorder *r;
+  dm_GfxRecordFrame *frame;
+  unsigned char *pixels;
+  int i, ok;
+
+  r = dm_gfxdata->recorder;
+
+  if (r == NULL)
+    return;
+
+  /* Find a free buffer, dropping the frame rather than waiting for
+     the writer if there is none. */
+  dm_mutex_lock (r->lock);
+
+  r->stats.frames++;
+
+  if (r->failed || r->queued == r->slots)
+    {
+      r->stats.dropped++;
+      r->resync = DM_TRUE;
+      dm_mutex_unlock (r->lock);
+      return;
+    }
+
+  frame = &r->ring[(r->head + r->queued) % r->slots];
+  dm_mutex_unlock (r->lock);
+
+  /* The buffer is not queued yet, so the writer will not touch it
+     while it is filled. */
+  frame->number = r->stats.frames - 1;
+  frame->time = dm_time_us () - r->start;
+
+  if (r->resync || dirty->full)
+    {
+      frame->count = 1;
+      frame->rects[0].x = frame->rects[0].y = 0;
+      frame->rects[0].w = r->width;
+      frame->rects[0].h = r->height;
+    }
+  else
+    {
+      frame->count = dirty->count;
+
+      for (i = 0; i < dirty->count; i++)
+        frame->rects[i] = dirty->rects[i];
+    }
+
+  ok = DM_TRUE;
+  pixels = frame->pixels;
+
+  for (i = 0; i < frame->count && ok; i++)
+    {
+      ok = dm_gfxdata->driver->read_pixels (&frame->rects[i], pixels);
+      pixels += (unsigned long) frame->rects[i].w * frame->rects[i].h * 3;
+    }
+
+  dm_mutex_lock (r->lock);
+
+  if (ok)
+    {
+      r->queued++;
+      r->stats.captured++;
+      r->resync = DM_FALSE;
+      dm_cond_signal (r->ready);
+    }
+  else
+    {
+      r->stats.dropped++;
+      r->resync = DM_TRUE;
+    }
+
+  dm_mutex_unlock (r->lock);
+}
+
+/* Free a recorder that has no thread running. */
+static void
+dm_record_free (dm_GfxRecorder *r)
+{
+  int i;
+
+  if (r->file)
+    fclose (r->file);
+
+  if (r->ring)
+    {
+      for (i = 0; i < r->slots; i++)
+        free (r->ring[i].pixels);
+
+      free (r->ring);
+    }
+
+  if (r->lock)
+    dm_mutex_destroy (r->lock);
+
+  if (r->ready)
+    dm_cond_destroy (r->ready);
+
+  free (r->picture);
+  free (r->out);
+  free (r);
+}
+
+/* Write queued frames until told to quit, then write whatever is
+   still queued. */
+static int
+dm_record_writer (void *arg)
+{
+  dm_GfxRecorder *r;
+  dm_GfxRecordFrame *frame;
+  unsigned long bytes;
+  int ok;
+
+  r = arg;
+
+  dm_mutex_lock (r->lock);
+
+  for (;;)
+    {
+      while (r->queued == 0 && !r->quit)
+        dm_cond_wait (r->ready, r->lock);
+
+      if (r->queued == 0)
+        break;
+
+      frame = &r->ring[r->head];
+      dm_mutex_unlock (r->lock);
+
+      /* Once writing has failed, frames are only thrown away. */
+      ok = DM_FALSE;
+      bytes = 0;
+
+      if (!r->failed)
+        {
+          bytes = dm_record_encode (r, frame);
+          ok = (fwrite (r->out, 1, bytes, r->file) == bytes);
+        }
+
+      dm_mutex_lock (r->lock);
+
+      r->head = (r->head + 1) % r->slots;
+      r->queued--;
+
+      if (ok)
+        {
+          r->stats.written++;
+          r->stats.bytes += bytes;
+        }
+      else
+        {
+          if (!r->failed)
+            dm_fatal ("GFX: Could not write recording; "
+                      "dropping the rest.");
+
+          r->failed = DM_TRUE;
+          r->stats.dropped++;
+        }
+    }
+
+  dm_mutex_unlock (r->lock);
+
+  if (!r->failed && fflush (r->file) != 0)
+    dm_fatal ("GFX: Could not write recording.");
+
+  return 0;
+}
+
+/* Encode a frame into the writer's buffer, bringing the picture up to
+   date with it.  Returns the number of bytes encoded. */
+static unsigned long
+dm_record_encode (dm_GfxRecorder *r, const dm_GfxRecordFrame *frame)
+{
+  const unsigned char *src;
+  unsigned char *out, *rect_out, *runs;
+  int i;
+
+  out = dm_record_put32 (r->out, frame->number);
+  out = dm_record_put32 (out, frame->time);
+  out = dm_record_put32 (out, frame->count);
+
+  src = frame->pixels;
+
+  for (i = 0; i < frame->count; i++)
+    {
+      rect_out = out;
+      runs = rect_out + DM_RECORD_RECT_SIZE;
+
+      out = dm_record_runs (r, &frame->rects[i], src, runs);
+
+      rect_out = dm_record_put16 (rect_out, frame->rects[i].x);
+      rect_out = dm_record_put16 (rect_out, frame->rects[i].y);
+      rect_out = dm_record_put16 (rect_out, frame->rects[i].w);
+      rect_out = dm_record_put16 (rect_out, frame->rects[i].h);
+      dm_record_put32 (rect_out, (unsigned long) (out - runs));
+
+      src += (unsigned long) frame->rects[i].w * frame->rects[i].h * 3;
+    }
+
+  return (unsigned long) (out - r->out);
+}
+
+/* Encode a rectangle's pixels as runs of unchanged and changed
+   pixels, returning the end of the runs. */
+static unsigned char *
+dm_record_runs (dm_GfxRecorder *r,
+                const dm_GfxRect *rect,
+                const unsigned char *src,
+                unsigned char *out)
+{
+  unsigned char *counts, *pic;
+  unsigned long row_skip;
+  unsigned int x, y;
+  unsigned long same, changed;
+
+  pic = r->picture + ((unsigned long) rect->y * r->width + rect->x) * 3;
+  row_skip = (unsigned long) (r->width - rect->w) * 3;
+
+  counts = out;
+  out += DM_RECORD_RUN_SIZE;
+  same = changed = 0;
+
+  for (y = 0; y < rect->h; y++, pic += row_skip)
+    for (x = 0; x < rect->w; x++, src += 3, pic += 3)
+      {
+        if (src[0] == pic[0] && src[1] == pic[1] && src[2] == pic[2])
+          {
+            /* An unchanged pixel after changed ones starts a new
+               run. */
+            if (changed || same == DM_RECORD_RUN_MAX)
+              {
+                dm_record_put16 (dm_record_put16 (counts, same),
+                                 changed);
+                counts = out;
+                out += DM_RECORD_RUN_SIZE;
+                same = changed = 0;
+              }
+
+            same++;
+          }
+        else
+          {
+            if (changed == DM_RECORD_RUN_MAX)
+              {
+                dm_record_put16 (dm_record_put16 (counts, same),
+                                 changed);
+                counts = out;
+                out += DM_RECORD_RUN_SIZE;
+                same = changed = 0;
+              }
+
+            pic[0] = out[0] = src[0];
+            pic[1] = out[1] = src[1];
+            pic[2] = out[2] = src[2];
+            out += 3;
+            changed++;
+          }
+      }
+
+  /* Finish the last run, or drop it if it is empty. */
+  if (same || changed)
+    dm_record_put16 (dm_record_put16 (counts, same), changed);
+  else
+    out = counts;
+
+  return out;
+}
+
+static unsigned char *
+dm_record_put16 (unsigned char *out, unsigned long value)
+{
+  out[0] = (unsigned char) (value & 0xFF);
+  out[1] = (unsigned char) ((value >> 8) & 0xFF);
+  return out + 2;
+}
+
+static unsigned char *
+dm_record_put32 (unsigned char *out, unsigned long value)
+{
+  out = dm_record_put16 (out, value & 0xFFFF);
+  return dm_record_put16 (out, (value >> 16) & 0xFFFF);
+}
@@ -0,0 +1,196 @@
+/** @file     gfx/dm-gfx-record.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for frame recording.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_RECORD_H__
+#define __DM_GFX_RECORD_H__
+
+#include "../dismal.h"
+
+/* A recording holds every frame presented while recording, as the
+   regions of the screen presented that frame, each delta-compressed
+   against the picture the frames before it built up.  Recordings are
+   turned back into images by tools/dm-unrecord.
+
+   All fields are little-endian.  The layout is:
+
+     header   magic ("DMRV"), then 32-bit version, width and height
+     frames   one after another, each being
+
+       frame  32-bit frame number (counting from 0 when recording
+              started, so dropped frames leave gaps), 32-bit time of
+              capture in microseconds since recording started,
+              32-bit rectangle count
+       rects  for each rectangle, 16-bit x, y, width and height, and
+              the 32-bit size of its runs, in bytes
+       runs   covering the rectangle's pixels row by row, each being a
+              16-bit count of pixels unchanged since the last frame, a
+              16-bit count of changed pixels, then the changed pixels
+              as red, green and blue bytes
+     trailer  32-bit DM_RECORD_END, which no frame number reaches,
+              32-bit count of frames presented while recording
+              (so frames dropped after the last one written can be
+              counted), and 32-bit time recording stopped, in
+              microseconds since it started
+
+   The picture is black before the first frame.  A recording whose
+   writing failed, or that was never stopped, has no trailer. */
+
+#define DM_RECORD_MAGIC "DMRV" /**< The first four bytes of a
+                                  recording. */
+#define DM_RECORD_END 0xFFFFFFFFUL /**< Where a frame number would
+                                      be, marks the trailer. */
+
+enum {
+  DM_RECORD_VERSION = 2,       /**< Version of the recording format. */
+
+  DM_RECORD_HEADER_SIZE = 16,  /**< Size of the header, in bytes. */
+  DM_RECORD_FRAME_SIZE  = 12,  /**< Size of a frame's header. */
+  DM_RECORD_RECT_SIZE   = 12,  /**< Size of a rectangle's header. */
+  DM_RECORD_TRAILER_SIZE = 12, /**< Size of the trailer, which is the
+                                  size of a frame's header. */
+  DM_RECORD_RUN_SIZE    = 4,   /**< Size of a run's counts. */
+  DM_RECORD_RUN_MAX     = 0xFFFF, /**< Longest run of either kind. */
+
+  DM_RECORD_BUFFERS = 8        /**< Default number of frames that can
+                                  wait to be written. */
+};
+
+typedef struct dm_GfxRecordFrame dm_GfxRecordFrame;
+typedef struct dm_GfxRecordStats dm_GfxRecordStats;
+typedef struct dm_GfxRecorder dm_GfxRecorder;
+
+/** A captured frame, waiting to be written. */
+struct dm_GfxRecordFrame
+{
+  unsigned long number;   /**< Frame number. */
+  unsigned long time;     /**< Time of capture, in microseconds since
+                             recording started. */
+  dm_GfxRect rects[DM_GFX_DIRTY_MAX]; /**< Regions captured. */
+  int count;              /**< Number of regions captured. */
+  unsigned char *pixels;  /**< The regions' pixels, one after
+                             another, as red, green and blue bytes. */
+};
+
+/** Statistics of the recording in progress, or the last one. */
+struct dm_GfxRecordStats
+{
+  unsigned long frames;   /**< Frames presented while recording. */
+  unsigned long captured; /**< Frames captured. */
+  unsigned long dropped;  /**< Frames dropped, because every buffer
+                             was waiting to be written or writing
+                             had failed. */
+  unsigned long written;  /**< Frames written to the recording. */
+  unsigned long bytes;    /**< Bytes written to the recording. */
+};
+
+/** State of the recorder.
+ *
+ *  Captured frames wait in a ring of buffers, from head onwards, for
+ *  the writer thread; the main thread fills the buffers after them.
+ *  If every buffer is waiting when a frame is presented, the frame is
+ *  dropped, and the next frame captured is the whole screen, so that
+ *  the recording catches up.
+ */
+struct dm_GfxRecorder
+{
+  FILE *file;              /**< The recording. */
+  dm_Thread *thread;       /**< The writer thread. */
+  dm_Mutex *lock;          /**< Lock protecting head, queued, quit,
+                              failed and the writer's statistics. */
+  dm_Cond *ready;          /**< Signalled when a frame is queued, or
+                              the writer should quit. */
+  dm_GfxRecordFrame *ring; /**< Ring of frame buffers. */
+  int slots;               /**< Number of buffers in the ring. */
+  int head;                /**< Oldest buffer waiting to be written. */
+  int queued;              /**< Number of buffers waiting. */
+  int quit;                /**< Set to make the writer finish. */
+  int failed;              /**< Set if writing failed. */
+  int resync;              /**< Set if the next frame captured must be
+                              the whole screen. */
+  unsigned int width;      /**< Width of the frames. */
+  unsigned int height;     /**< Height of the frames. */
+  unsigned long start;     /**< dm_time_us() when recording
+                              started. */
+  unsigned char *picture;  /**< The picture written so far, which
+                              frames are compared against.  Only
+                              touched by the writer. */
+  unsigned char *out;      /**< Buffer the writer encodes frames
+                              into. */
+  dm_GfxRecordStats stats; /**< Statistics. */
+};
+
+
+/** Start recording every frame presented.
+ *
+ *  Frames are captured as they are presented, at the size they are
+ *  drawn at (so at low-res with DM_GFX_LOWRES_BUFFER), and written by
+ *  a background thread.  Only the regions presented each frame are
+ *  captured.
+ *
+ *  This needs a driver that can read back what it presented, and
+ *  threads.
+ *
+ *  @param filename  The file to record to.
+ *  @param buffers   The number of frames that can wait to be written
+ *                   before frames are dropped, or 0 for
+ *                   DM_RECORD_BUFFERS.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_record_start(const char filename[], int buffers);
+
+
+/** Stop recording.
+ *
+ *  This waits for every captured frame to be written.  It does
+ *  nothing if not recording.
+ */
+
+void dm_record_stop(void);
+
+
+/** Retrieve the statistics of the recording in progress, or of the
+ *  last one.
+ *
+ *  @param stats  Structure to store the statistics in.
+ */
+
+void dm_record_stats(dm_GfxRecordStats *stats);
+
+
+/** Capture the frame just presented, if recording.
+ *
+ *  dm_dirty_present() calls this, so there is no need to call it
+ *  directly.
+ *
+ *  @param dirty  The regions of the screen presented.
+ */
+
+void dm_record_frame(const dm_GfxDirty *dirty);
+
+#endif /* __DM_GFX_RECORD_H__ */
@@ -0,0 +1,872 @@
+/** @file     gfx/dm-gfx-sdl-opengl.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    SDL OpenGL graphics driver.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+/* Images are uploaded once, as textures, and every draw and fill
+   becomes a quad in a batch of client-side vertex arrays.  The batch
+   is drawn in one call whenever the texture it draws from changes,
+   so atlas pages and the deferred queue's image sorting both mean
+   fewer calls.  Fills draw from a white texel, so runs of fills
+   batch together too.
+
+   DISMAL expects the picture to persist between frames, which a
+   swapped back buffer does not, so drawing goes to a texture
+   (through a framebuffer object where there is one, or by copying
+   the back buffer into it otherwise) that is shown each frame.
+
+   Only OpenGL 1.1 and, optionally, EXT_framebuffer_object are
+   needed, so the driver runs on software rasterisers such as Mesa's
+   llvmpipe. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL/SDL.h"
+#include "SDL/SDL_image.h"
+#include "SDL/SDL_opengl.h"
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-sdl-opengl.h"
+
+/* Masks of 32-bit pixels whose bytes are red, green, blue and alpha
+   in memory, which is what GL_RGBA with GL_UNSIGNED_BYTE reads. */
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+#define DM_GL_RMASK 0xFF000000
+#define DM_GL_GMASK 0x00FF0000
+#define DM_GL_BMASK 0x0000FF00
+#define DM_GL_AMASK 0x000000FF
+#else
+#define DM_GL_RMASK 0x000000FF
+#define DM_GL_GMASK 0x0000FF00
+#define DM_GL_BMASK 0x00FF0000
+#define DM_GL_AMASK 0xFF000000
+#endif
+
+static dm_GfxGLData *_dm_gfxgl;
+
+/* Framebuffer object entry points, looked up at run time. */
+static PFNGLGENFRAMEBUFFERSEXTPROC dm_glGenFramebuffers;
+static PFNGLDELETEFRAMEBUFFERSEXTPROC dm_glDeleteFramebuffers;
+static PFNGLBINDFRAMEBUFFEREXTPROC dm_glBindFramebuffer;
+static PFNGLFRAMEBUFFERTEXTURE2DEXTPROC dm_glFramebufferTexture2D;
+static PFNGLCHECKFRAMEBUFFERSTATUSEXTPROC dm_glCheckFramebufferStatus;
+
+static int dm_gl_has_extension(const char *name);
+static unsigned int dm_gl_texture_size(unsigned int size);
+static SDL_Surface *dm_gl_convert(SDL_Surface *src,
+                                  int magenta,
+                                  int keyed,
+                                  Uint32 key);
+static dm_GfxGLImage *dm_gl_image_new(SDL_Surface *pixels);
+static int dm_gl_upload(dm_GfxGLTexture *texture);
+static void dm_gl_update_texture(dm_GfxGLTexture *texture,
+                                 unsigned int x,
+                                 unsigned int y,
+                                 unsigned int w,
+                                 unsigned int h);
+static void dm_gl_init_target(void);
+static void dm_gl_draw_target(void);
+static void dm_gl_quad(unsigned int texture,
+                       float x, float y, float w, float h,
+                       float u0, float v0, float u1, float v1,
+                       unsigned char r, unsigned char g,
+                       unsigned char b);
+static void dm_gl_flush(void);
+
+void dm_gfx_sdl_opengl_register(dm_GfxDriver *driver)
+{
+  driver->init = dm_gfx_gl_init;
+  driver->update = dm_gfx_gl_update;
+  driver->cleanup = dm_gfx_gl_cleanup;
+  driver->load_image_data = dm_gl_load_image_data;
+  driver->free_image_data = dm_gl_free_image_data;
+  driver->draw_image = dm_gl_draw_image;
+  driver->fill_rect_rgb = dm_gl_fill_rect_rgb;
+  driver->create_image_data = dm_gl_create_image_data;
+  driver->copy_image_data = dm_gl_copy_image_data;
+  driver->image_data_size = dm_gl_image_data_size;
+  driver->decode_image_data = dm_gl_decode_image_data;
+  driver->finish_image_data = dm_gl_finish_image_data;
+  driver->image_data_bytes = dm_gl_image_data_bytes;
+  driver->scale_image_data = dm_gl_scale_image_data;
+  driver->image_data_from_pixels = dm_gl_image_data_from_pixels;
+}
+
+
+int dm_gfx_gl_init(dm_Config *conf)
+{
+  const char *version;
+  GLubyte white[4];
+  GLuint id;
+
+  dm_debug("GFX-GL: Initialising.");
+
+  if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
+    dm_fatal("GFX-GL: Could not initialise SDL-GFX subsystem.");
+    return DM_FAILURE;
+  }
+
+  _dm_gfxgl = calloc(1, sizeof(dm_GfxGLData));
+
+  if (_dm_gfxgl == NULL) {
+    dm_fatal("GFX-GL: Could not initialise driver structure.");
+    return DM_FAILURE;
+  }
+
+  _dm_gfxgl->vertices = malloc(sizeof(dm_GfxGLVertex) * 6
+                               * DM_GL_BATCH_QUADS);
+
+  if (_dm_gfxgl->vertices == NULL) {
+    dm_fatal("GFX-GL: Could not allocate vertex batch.");
+    return DM_FAILURE;
+  }
+
+  SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+
+  _dm_gfxgl->screen = SDL_SetVideoMode(conf->gfx_screen_width,
+                                       conf->gfx_screen_height,
+                                       conf->gfx_screen_depth,
+                                       SDL_OPENGL);
+
+  if (_dm_gfxgl->screen == NULL) {
+    dm_fatal("GFX-GL: Could not initialise screen.");
+    return DM_FAILURE;
+  }
+
+  _dm_gfxgl->width = conf->gfx_screen_width;
+  _dm_gfxgl->height = conf->gfx_screen_height;
+
+  version = (const char*) glGetString(GL_VERSION);
+  dm_debug("GFX-GL: OpenGL %s.", version ? version : "(unknown)");
+
+  _dm_gfxgl->npot =
+    ((version && atoi(version) >= 2)
+     || dm_gl_has_extension("GL_ARB_texture_non_power_of_two"));
+
+  /* One unit is one pixel, with the origin at the top left. */
+  glViewport(0, 0, _dm_gfxgl->width, _dm_gfxgl->height);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glOrtho(0, _dm_gfxgl->width, _dm_gfxgl->height, 0, -1, 1);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+
+  /* Colour-keyed pixels have an alpha of zero, and are dropped by the
+     alpha test; anything else is blended, as SDL would. */
+  glDisable(GL_DEPTH_TEST);
+  glEnable(GL_TEXTURE_2D);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+  glEnable(GL_ALPHA_TEST);
+  glAlphaFunc(GL_GREATER, 0.0f);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(2, GL_FLOAT, sizeof(dm_GfxGLVertex),
+                  &_dm_gfxgl->vertices[0].x);
+  glTexCoordPointer(2, GL_FLOAT, sizeof(dm_GfxGLVertex),
+                    &_dm_gfxgl->vertices[0].u);
+  glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(dm_GfxGLVertex),
+                 &_dm_gfxgl->vertices[0].r);
+
+  white[0] = white[1] = white[2] = white[3] = 255;
+
+  glGenTextures(1, &id);
+  glBindTexture(GL_TEXTURE_2D, id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, white);
+  _dm_gfxgl->white = id;
+
+  dm_gl_init_target();
+
+  return DM_SUCCESS;
+}
+
+void dm_gfx_gl_update(void)
+{
+  dm_gl_flush();
+
+  if (_dm_gfxgl->framebuffer) {
+    dm_glBindFramebuffer(GL_FRAMEBUFFER_EXT, 0);
+    dm_gl_draw_target();
+  } else {
+    glBindTexture(GL_TEXTURE_2D, _dm_gfxgl->target.id);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0,
+                        _dm_gfxgl->width, _dm_gfxgl->height);
+  }
+
+  SDL_GL_SwapBuffers();
+
+  /* The back buffer is undefined after a swap, so either go back to
+     drawing into the target, or put the picture back. */
+  if (_dm_gfxgl->framebuffer)
+    dm_glBindFramebuffer(GL_FRAMEBUFFER_EXT, _dm_gfxgl->framebuffer);
+  else
+    dm_gl_draw_target();
+}
+
+void dm_gfx_gl_cleanup(void)
+{
+  if (_dm_gfxgl) {
+    if (_dm_gfxgl->screen) {
+      if (_dm_gfxgl->framebuffer) {
+        dm_glBindFramebuffer(GL_FRAMEBUFFER_EXT, 0);
+        dm_glDeleteFramebuffers(1, &_dm_gfxgl->framebuffer);
+      }
+
+      if (_dm_gfxgl->target.id)
+        glDeleteTextures(1, &_dm_gfxgl->target.id);
+      if (_dm_gfxgl->white)
+        glDeleteTextures(1, &_dm_gfxgl->white);
+    }
+
+    if (_dm_gfxgl->vertices)
+      free(_dm_gfxgl->vertices);
+
+    free(_dm_gfxgl);
+    _dm_gfxgl = NULL;
+  }
+
+  SDL_QuitSubSystem(SDL_INIT_VIDEO);
+}
+
+void *dm_gl_load_image_data(const char filename[])
+{
+  void *decoded;
+
+  decoded = dm_gl_decode_image_data(filename);
+
+  if (decoded == NULL)
+    return NULL;
+
+  return dm_gl_finish_image_data(decoded);
+}
+
+void *dm_gl_decode_image_data(const char filename[])
+{
+  SDL_Surface *surf, *pixels;
+  dm_GfxGLImage *img;
+
+  /* No GL here; this may be running on a worker thread. */
+  surf = IMG_Load(filename);
+
+  if (surf == NULL) {
+    dm_fatal("GFX-GL: Couldn't load %s!\n", filename);
+    return NULL;
+  }
+
+  /* Magenta is transparent, as with the SDL driver. */
+  pixels = dm_gl_convert(surf, DM_TRUE, DM_FALSE, 0);
+  SDL_FreeSurface(surf);
+
+  if (pixels == NULL)
+    return NULL;
+
+  img = dm_gl_image_new(pixels);
+
+  if (img == NULL)
+    SDL_FreeSurface(pixels);
+
+  return (void*) img;
+}
+
+void *dm_gl_finish_image_data(void *decoded)
+{
+  dm_GfxGLImage *img;
+
+  img = (dm_GfxGLImage*) decoded;
+
+  if (dm_gl_upload(img->texture) == DM_FAILURE) {
+    dm_gl_free_image_data(img);
+    return NULL;
+  }
+
+  return (void*) img;
+}
+
+void dm_gl_free_image_data(void *data)
+{
+  dm_GfxGLImage *img;
+  dm_GfxGLTexture *texture;
+
+  if (data == NULL)
+    return;
+
+  img = (dm_GfxGLImage*) data;
+  texture = img->texture;
+  free(img);
+
+  if (--texture->refs > 0)
+    return;
+
+  /* The batch may still draw from the texture. */
+  if (texture->id) {
+    dm_gl_flush();
+    glDeleteTextures(1, &texture->id);
+  }
+
+  SDL_FreeSurface(texture->pixels);
+  free(texture);
+}
+
+void *dm_gl_create_image_data(unsigned int width, unsigned int height)
+{
+  SDL_Surface *pixels;
+  dm_GfxGLImage *img;
+
+  pixels = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32,
+                                DM_GL_RMASK, DM_GL_GMASK, DM_GL_BMASK,
+                                DM_GL_AMASK);
+
+  if (pixels == NULL) {
+    dm_fatal("GFX-GL: Couldn't create %ux%u image!", width, height);
+    return NULL;
+  }
+
+  /* Zero alpha is transparent. */
+  SDL_FillRect(pixels, NULL, 0);
+
+  img = dm_gl_image_new(pixels);
+
+  if (img == NULL) {
+    SDL_FreeSurface(pixels);
+    return NULL;
+  }
+
+  return dm_gl_finish_image_data(img);
+}
+
+int dm_gl_copy_image_data(void *dest,
+                          void *src,
+                          unsigned int src_x,
+                          unsigned int src_y,
+                          unsigned int dest_x,
+                          unsigned int dest_y,
+                          unsigned int width,
+                          unsigned int height)
+{
+  dm_GfxGLImage *d, *s;
+  SDL_Surface *dp, *sp;
+  unsigned int y;
+
+  d = (dm_GfxGLImage*) dest;
+  s = (dm_GfxGLImage*) src;
+
+  /* Enlarged images have no pixels of their own to copy. */
+  if (d->x_scale != 1 || d->y_scale != 1
+      || s->x_scale != 1 || s->y_scale != 1)
+    return DM_FAILURE;
+
+  dp = d->texture->pixels;
+  sp = s->texture->pixels;
+
+  if (src_x >= (unsigned int) sp->w || src_y >= (unsigned int) sp->h
+      || dest_x >= (unsigned int) dp->w || dest_y >= (unsigned int) dp->h)
+    return DM_FAILURE;
+
+  if (src_x + width > (unsigned int) sp->w)
+    width = sp->w - src_x;
+  if (src_y + height > (unsigned int) sp->h)
+    height = sp->h - src_y;
+  if (dest_x + width > (unsigned int) dp->w)
+    width = dp->w - dest_x;
+  if (dest_y + height > (unsigned int) dp->h)
+    height = dp->h - dest_y;
+
+  for (y = 0; y < height; y++)
+    memcpy((Uint8*) dp->pixels + (dest_y + y) * dp->pitch + dest_x * 4,
+           (Uint8*) sp->pixels + (src_y + y) * sp->pitch + src_x * 4,
+           width * 4);
+
+  /* The batch may still draw from the old pixels. */
+  dm_gl_flush();
+  dm_gl_update_texture(d->texture, dest_x, dest_y, width, height);
+
+  return DM_SUCCESS;
+}
+
+int dm_gl_image_data_size(void *data,
+                          unsigned int *width,
+                          unsigned int *height)
+{
+  if (data) {
+    *width = ((dm_GfxGLImage*) data)->width;
+    *height = ((dm_GfxGLImage*) data)->height;
+    return DM_SUCCESS;
+  }
+
+  return DM_FAILURE;
+}
+
+unsigned long dm_gl_image_data_bytes(void *data)
+{
+  dm_GfxGLImage *img;
+  dm_GfxGLTexture *texture;
+
+  img = (dm_GfxGLImage*) data;
+  texture = img->texture;
+
+  if (img->x_scale != 1 || img->y_scale != 1)
+    return 0;
+
+  return ((unsigned long) texture->pixels->pitch * texture->pixels->h
+          + (unsigned long) texture->tex_w * texture->tex_h * 4);
+}
+
+void *dm_gl_scale_image_data(void *data,
+                             unsigned int x_factor,
+                             unsigned int y_factor)
+{
+  dm_GfxGLImage *src, *img;
+
+  src = (dm_GfxGLImage*) data;
+  img = malloc(sizeof(dm_GfxGLImage));
+
+  if (img == NULL) {
+    dm_fatal("GFX-GL: Couldn't create enlarged image!");
+    return NULL;
+  }
+
+  img->texture = src->texture;
+  img->texture->refs++;
+  img->width = src->width * x_factor;
+  img->height = src->height * y_factor;
+  img->x_scale = src->x_scale * x_factor;
+  img->y_scale = src->y_scale * y_factor;
+
+  return (void*) img;
+}
+
+void *dm_gl_image_data_from_pixels(const void *pixels,
+                                   unsigned int width,
+                                   unsigned int height,
+                                   unsigned int pitch,
+                                   const dm_GfxPixelFormat *format)
+{
+  SDL_Surface *surf, *converted;
+  dm_GfxGLImage *img;
+
+  /* The pixels are only read, to convert them. */
+  surf = SDL_CreateRGBSurfaceFrom((void*) pixels, width, height,
+                                  format->bits, pitch,
+                                  format->rmask, format->gmask,
+                                  format->bmask, format->amask);
+
+  if (surf == NULL) {
+    dm_fatal("GFX-GL: Couldn't create surface from pixels!");
+    return NULL;
+  }
+
+  converted = dm_gl_convert(surf, DM_FALSE, format->keyed,
+                            (Uint32) format->key);
+  SDL_FreeSurface(surf);
+
+  if (converted == NULL)
+    return NULL;
+
+  img = dm_gl_image_new(converted);
+
+  if (img == NULL) {
+    SDL_FreeSurface(converted);
+    return NULL;
+  }
+
+  return dm_gl_finish_image_data(img);
+}
+
+int dm_gl_draw_image(struct dm_GfxImageNode *image,
+                     unsigned int image_x,
+                     unsigned int image_y,
+                     unsigned int screen_x,
+                     unsigned int screen_y,
+                     unsigned int width,
+                     unsigned int height)
+{
+  dm_GfxGLImage *img;
+  float tw, th;
+
+  img = (dm_GfxGLImage*) image->data;
+
+  if (img == NULL || img->texture->id == 0)
+    return DM_FAILURE;
+
+  /* Enlarged images are scaled here, by their texture co-ordinates. */
+  tw = (float) (img->x_scale * img->texture->tex_w);
+  th = (float) (img->y_scale * img->texture->tex_h);
+
+  dm_gl_quad(img->texture->id,
+             (float) screen_x, (float) screen_y,
+             (float) width, (float) height,
+             image_x / tw, image_y / th,
+             (image_x + width) / tw, (image_y + height) / th,
+             255, 255, 255);
+
+  return DM_SUCCESS;
+}
+
+void dm_gl_fill_rect_rgb(unsigned int x,
+                         unsigned int y,
+                         unsigned int w,
+                         unsigned int h,
+                         unsigned int r,
+                         unsigned int g,
+                         unsigned int b)
+{
+  dm_gl_quad(_dm_gfxgl->white,
+             (float) x, (float) y, (float) w, (float) h,
+             0.0f, 0.0f, 1.0f, 1.0f,
+             (unsigned char) r, (unsigned char) g, (unsigned char) b);
+}
+
+/* Check for an OpenGL extension by its full name. */
+static int dm_gl_has_extension(const char *name)
+{
+  const char *list, *p;
+  size_t len;
+
+  list = (const char*) glGetString(GL_EXTENSIONS);
+
+  if (list == NULL)
+    return DM_FALSE;
+
+  len = strlen(name);
+
+  for (p = strstr(list, name); p; p = strstr(p + len, name)) {
+    if ((p == list || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0'))
+      return DM_TRUE;
+  }
+
+  return DM_FALSE;
+}
+
+/* Find the texture size needed to hold an image dimension. */
+static unsigned int dm_gl_texture_size(unsigned int size)
+{
+  unsigned int pot;
+
+  if (_dm_gfxgl->npot)
+    return size;
+
+  for (pot = 1; pot < size; pot <<= 1)
+    ;
+
+  return pot;
+}
+
+/* Convert a surface into 32-bit RGBA, in byte order, making keyed
+   pixels transparent: either magenta ones, or ones whose raw value
+   is key. */
+static SDL_Surface *dm_gl_convert(SDL_Surface *src,
+                                  int magenta,
+                                  int keyed,
+                                  Uint32 key)
+{
+  SDL_Surface *dest;
+  Uint8 *srow, *p;
+  Uint32 *drow, px;
+  Uint8 r, g, b, a, bpp;
+  int x, y;
+
+  dest = SDL_CreateRGBSurface(SDL_SWSURFACE, src->w, src->h, 32,
+                              DM_GL_RMASK, DM_GL_GMASK, DM_GL_BMASK,
+                              DM_GL_AMASK);
+
+  if (dest == NULL) {
+    dm_fatal("GFX-GL: Couldn't convert image to RGBA!");
+    return NULL;
+  }
+
+  bpp = src->format->BytesPerPixel;
+
+  SDL_LockSurface(src);
+  SDL_LockSurface(dest);
+
+  for (y = 0; y < src->h; y++) {
+    srow = (Uint8*) src->pixels + y * src->pitch;
+    drow = (Uint32*) ((Uint8*) dest->pixels + y * dest->pitch);
+
+    for (x = 0; x < src->w; x++) {
+      switch (bpp) {
+      case 1:
+        px = srow[x];
+        break;
+      case 2:
+        px = ((Uint16*) srow)[x];
+        break;
+      case 3:
+        p = srow + x * 3;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+        px = ((Uint32) p[0] << 16) | ((Uint32) p[1] << 8) | p[2];
+#else
+        px = p[0] | ((Uint32) p[1] << 8) | ((Uint32) p[2] << 16);
+#endif
+        break;
+      default:
+        px = ((Uint32*) srow)[x];
+        break;
+      }
+
+      SDL_GetRGBA(px, src->format, &r, &g, &b, &a);
+
+      if ((magenta && r == 255 && g == 0 && b == 255)
+          || (keyed && px == key))
+        a = 0;
+
+      drow[x] = SDL_MapRGBA(dest->format, r, g, b, a);
+    }
+  }
+
+  SDL_UnlockSurface(dest);
+  SDL_UnlockSurface(src);
+
+  return dest;
+}
+
+/* Wrap RGBA pixels in image data, not yet uploaded. */
+static dm_GfxGLImage *dm_gl_image_new(SDL_Surface *pixels)
+{
+  dm_GfxGLImage *img;
+  dm_GfxGLTexture *texture;
+
+  img = malloc(sizeof(dm_GfxGLImage));
+  texture = malloc(sizeof(dm_GfxGLTexture));
+
+  if (img == NULL || texture == NULL) {
+    dm_fatal("GFX-GL: Couldn't allocate image data!");
+    if (img)
+      free(img);
+    if (texture)
+      free(texture);
+    return NULL;
+  }
+
+  texture->id = 0;
+  texture->tex_w = texture->tex_h = 0;
+  texture->pixels = pixels;
+  texture->refs = 1;
+
+  img->texture = texture;
+  img->width = pixels->w;
+  img->height = pixels->h;
+  img->x_scale = img->y_scale = 1;
+
+  return img;
+}
+
+/* Create a texture for a texture's pixels, and upload them. */
+static int dm_gl_upload(dm_GfxGLTexture *texture)
+{
+  GLuint id;
+
+  texture->tex_w = dm_gl_texture_size(texture->pixels->w);
+  texture->tex_h = dm_gl_texture_size(texture->pixels->h);
+
+  /* Binding a texture would upset the batch. */
+  dm_gl_flush();
+
+  glGenTextures(1, &id);
+  glBindTexture(GL_TEXTURE_2D, id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture->tex_w,
+               texture->tex_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+  if (glGetError() != GL_NO_ERROR) {
+    dm_fatal("GFX-GL: Couldn't create %ux%u texture!",
+             texture->tex_w, texture->tex_h);
+    glDeleteTextures(1, &id);
+    return DM_FAILURE;
+  }
+
+  texture->id = id;
+  dm_gl_update_texture(texture, 0, 0, texture->pixels->w,
+                       texture->pixels->h);
+
+  return DM_SUCCESS;
+}
+
+/* Upload part of a texture's pixels.  The batch must be empty. */
+static void dm_gl_update_texture(dm_GfxGLTexture *texture,
+                                 unsigned int x,
+                                 unsigned int y,
+                                 unsigned int w,
+                                 unsigned int h)
+{
+  SDL_Surface *pixels;
+
+  if (w == 0 || h == 0)
+    return;
+
+  pixels = texture->pixels;
+
+  glBindTexture(GL_TEXTURE_2D, texture->id);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, pixels->pitch / 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA,
+                  GL_UNSIGNED_BYTE,
+                  (Uint8*) pixels->pixels + y * pixels->pitch + x * 4);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+/* Create the texture holding the picture, and a framebuffer object
+   to draw into it if the extension is there. */
+static void dm_gl_init_target(void)
+{
+  dm_GfxGLTexture *target;
+  GLuint id;
+
+  target = &_dm_gfxgl->target;
+  target->tex_w = dm_gl_texture_size(_dm_gfxgl->width);
+  target->tex_h = dm_gl_texture_size(_dm_gfxgl->height);
+  target->pixels = NULL;
+  target->refs = 1;
+
+  glGenTextures(1, &id);
+  glBindTexture(GL_TEXTURE_2D, id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, target->tex_w, target->tex_h,
+               0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  target->id = id;
+
+  /* Stored through data pointers, as ISO C does not convert them to
+     function pointers. */
+  if (dm_gl_has_extension("GL_EXT_framebuffer_object")) {
+    *(void**) &dm_glGenFramebuffers =
+      SDL_GL_GetProcAddress("glGenFramebuffersEXT");
+    *(void**) &dm_glDeleteFramebuffers =
+      SDL_GL_GetProcAddress("glDeleteFramebuffersEXT");
+    *(void**) &dm_glBindFramebuffer =
+      SDL_GL_GetProcAddress("glBindFramebufferEXT");
+    *(void**) &dm_glFramebufferTexture2D =
+      SDL_GL_GetProcAddress("glFramebufferTexture2DEXT");
+    *(void**) &dm_glCheckFramebufferStatus =
+      SDL_GL_GetProcAddress("glCheckFramebufferStatusEXT");
+  }
+
+  if (dm_glGenFramebuffers && dm_glDeleteFramebuffers
+      && dm_glBindFramebuffer && dm_glFramebufferTexture2D
+      && dm_glCheckFramebufferStatus) {
+    dm_glGenFramebuffers(1, &id);
+    dm_glBindFramebuffer(GL_FRAMEBUFFER_EXT, id);
+    dm_glFramebufferTexture2D(GL_FRAMEBUFFER_EXT,
+                              GL_COLOR_ATTACHMENT0_EXT,
+                              GL_TEXTURE_2D, target->id, 0);
+
+    if (dm_glCheckFramebufferStatus(GL_FRAMEBUFFER_EXT)
+        == GL_FRAMEBUFFER_COMPLETE_EXT) {
+      _dm_gfxgl->framebuffer = id;
+    } else {
+      dm_glBindFramebuffer(GL_FRAMEBUFFER_EXT, 0);
+      dm_glDeleteFramebuffers(1, &id);
+    }
+  }
+
+  dm_debug("GFX-GL: Drawing %s.", (_dm_gfxgl->framebuffer
+                                   ? "through a framebuffer object"
+                                   : "to the back buffer"));
+
+  /* Start from black, as the SDL driver's screen does. */
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+}
+
+/* Draw the picture held in the target texture over the whole of the
+   current framebuffer.  Its rows run bottom to top, as read from a
+   framebuffer. */
+static void dm_gl_draw_target(void)
+{
+  glDisable(GL_BLEND);
+  glDisable(GL_ALPHA_TEST);
+
+  dm_gl_quad(_dm_gfxgl->target.id,
+             0.0f, 0.0f,
+             (float) _dm_gfxgl->width, (float) _dm_gfxgl->height,
+             0.0f, (float) _dm_gfxgl->height / _dm_gfxgl->target.tex_h,
+             (float) _dm_gfxgl->width / _dm_gfxgl->target.tex_w, 0.0f,
+             255, 255, 255);
+  dm_gl_flush();
+
+  glEnable(GL_ALPHA_TEST);
+  glEnable(GL_BLEND);
+}
+
+/* Add a quad to the batch, drawing whatever was batched first if it
+   draws from another texture or the batch is full.  (u0, v0) is the
+   texture co-ordinate of the top-left corner. */
+static void dm_gl_quad(unsigned int texture,
+                       float x, float y, float w, float h,
+                       float u0, float v0, float u1, float v1,
+                       unsigned char r, unsigned char g,
+                       unsigned char b)
+{
+  dm_GfxGLVertex *v;
+  int i;
+
+  if (_dm_gfxgl->quads > 0
+      && (_dm_gfxgl->bound != texture
+          || _dm_gfxgl->quads == DM_GL_BATCH_QUADS))
+    dm_gl_flush();
+
+  _dm_gfxgl->bound = texture;
+
+  /* Two triangles: top-left, top-right, bottom-right, then top-left,
+     bottom-right, bottom-left. */
+  v = &_dm_gfxgl->vertices[_dm_gfxgl->quads * 6];
+
+  v[0].x = x;     v[0].y = y;     v[0].u = u0; v[0].v = v0;
+  v[1].x = x + w; v[1].y = y;     v[1].u = u1; v[1].v = v0;
+  v[2].x = x + w; v[2].y = y + h; v[2].u = u1; v[2].v = v1;
+  v[3] = v[0];
+  v[4] = v[2];
+  v[5].x = x;     v[5].y = y + h; v[5].u = u0; v[5].v = v1;
+
+  for (i = 0; i < 6; i++) {
+    v[i].r = r;
+    v[i].g = g;
+    v[i].b = b;
+    v[i].a = 255;
+  }
+
+  _dm_gfxgl->quads++;
+}
+
+/* Draw everything batched, in one call. */
+static void dm_gl_flush(void)
+{
+  if (_dm_gfxgl == NULL || _dm_gfxgl->quads == 0)
+    return;
+
+  glBindTexture(GL_TEXTURE_2D, _dm_gfxgl->bound);
+  glDrawArrays(GL_TRIANGLES, 0, _dm_gfxgl->quads * 6);
+
+  _dm_gfxgl->quads = 0;
+}
@@ -0,0 +1,317 @@
+/** @file     gfx/dm-gfx-sdl-opengl.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for the SDL OpenGL graphics driver.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_SDL_OPENGL_H__
+#define __DM_GFX_SDL_OPENGL_H__
+
+enum {
+  DM_GL_BATCH_QUADS = 1024 /**< Most quads drawn in one call. */
+};
+
+typedef struct dm_GfxGLTexture dm_GfxGLTexture;
+typedef struct dm_GfxGLImage dm_GfxGLImage;
+typedef struct dm_GfxGLVertex dm_GfxGLVertex;
+typedef struct dm_GfxGLData dm_GfxGLData;
+
+/** A texture, and the copy of its pixels kept in memory.
+ *
+ *  Texture names are declared as unsigned int, which is what GLuint
+ *  is, to keep the GL headers out of this one.
+ */
+struct dm_GfxGLTexture {
+  unsigned int id;             /**< GL texture name, or 0 if the
+                                  pixels have not been uploaded. */
+  unsigned int tex_w;          /**< Width of the texture, which may be
+                                  padded past the pixels' width. */
+  unsigned int tex_h;          /**< Height of the texture. */
+  struct SDL_Surface *pixels;  /**< The pixels, as 32-bit RGBA in byte
+                                  order. */
+  int refs;                    /**< Number of images using the
+                                  texture. */
+};
+
+/** Image data for the OpenGL driver.
+ *
+ *  Enlarged images (DM_GFX_LOWRES_IMAGES) share their original's
+ *  texture, and are enlarged as they are drawn by scaling their
+ *  texture coordinates.
+ */
+struct dm_GfxGLImage {
+  dm_GfxGLTexture *texture;    /**< The image's texture. */
+  unsigned int width;          /**< Width of the image as drawn. */
+  unsigned int height;         /**< Height of the image as drawn. */
+  unsigned int x_scale;        /**< Drawn pixels per texel across. */
+  unsigned int y_scale;        /**< Drawn pixels per texel down. */
+};
+
+/** A vertex in the batch. */
+struct dm_GfxGLVertex {
+  float x;                     /**< X co-ordinate on screen. */
+  float y;                     /**< Y co-ordinate on screen. */
+  float u;                     /**< Texture co-ordinate across. */
+  float v;                     /**< Texture co-ordinate down. */
+  unsigned char r;             /**< Red component. */
+  unsigned char g;             /**< Green component. */
+  unsigned char b;             /**< Blue component. */
+  unsigned char a;             /**< Alpha component. */
+};
+
+struct dm_GfxGLData {
+  struct SDL_Surface *screen;  /**< Pointer to the screen SDL surface. */
+  unsigned int width;          /**< Width of the screen. */
+  unsigned int height;         /**< Height of the screen. */
+  int npot;                    /**< Non-zero if textures may have any
+                                  size, not just powers of two. */
+  unsigned int white;          /**< 1x1 white texture, used for
+                                  fills. */
+  dm_GfxGLTexture target;      /**< Texture holding the picture, which
+                                  persists between frames. */
+  unsigned int framebuffer;    /**< Framebuffer object drawing into
+                                  target, or 0 if the driver draws to
+                                  the back buffer and copies it into
+                                  target instead. */
+  dm_GfxGLVertex *vertices;    /**< Batched vertices. */
+  int quads;                   /**< Number of quads batched. */
+  unsigned int bound;          /**< Texture the batch draws from. */
+};
+
+
+/** Register the SDL OpenGL driver.
+ *
+ *  @param driver  The driver structure in which to store function
+ *  pointers, etc.
+ */
+
+void dm_gfx_sdl_opengl_register(dm_GfxDriver *driver);
+
+
+/** Initialise the SDL OpenGL graphics system.
+ *
+ *  @param conf  A pointer to a dm_Config structure filled with
+ *  initial configuration values.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE for failure;
+ */
+
+int dm_gfx_gl_init(dm_Config *conf);
+
+
+/** Draw everything batched, and show the picture.
+ */
+
+void dm_gfx_gl_update(void);
+
+
+/** De-initialise the SDL OpenGL graphics system.
+ */
+
+void dm_gfx_gl_cleanup(void);
+
+
+/** Load an image as a texture.
+ *
+ *  @param filename  Name of the file to load.
+ *
+ *  @return  a void pointer to the image data, or NULL on failure.
+ */
+
+void *dm_gl_load_image_data(const char filename[]);
+
+
+/** Decode an image file into pixels ready to upload as a texture.
+ *
+ *  This is safe to call from any thread.
+ *
+ *  @param filename  Name of the file to load.
+ *
+ *  @return  a void pointer to the image data, or NULL on failure.
+ */
+
+void *dm_gl_decode_image_data(const char filename[]);
+
+
+/** Upload decoded image data as a texture.
+ *
+ *  @param decoded  A void pointer to image data from
+ *                  dm_gl_decode_image_data.
+ *
+ *  @return  a void pointer to the image data, or NULL on failure.
+ */
+
+void *dm_gl_finish_image_data(void *decoded);
+
+
+/** Free image data, and its texture if no other image uses it.
+ *
+ *  @param data  A void pointer to the image data.
+ */
+
+void dm_gl_free_image_data(void *data);
+
+
+/** Create a blank, fully transparent texture.
+ *
+ *  @param width   Width of the texture.
+ *  @param height  Height of the texture.
+ *
+ *  @return  a void pointer to the image data, or NULL on failure.
+ */
+
+void *dm_gl_create_image_data(unsigned int width, unsigned int height);
+
+
+/** Copy pixels verbatim from one texture to another.
+ *
+ *  Enlarged images can be neither copied from nor to.
+ *
+ *  @param dest    A void pointer to the destination image data.
+ *  @param src     A void pointer to the source image data.
+ *  @param src_x   X co-ordinate of the rectangle in the source.
+ *  @param src_y   Y co-ordinate of the rectangle in the source.
+ *  @param dest_x  X co-ordinate of the rectangle in the destination.
+ *  @param dest_y  Y co-ordinate of the rectangle in the destination.
+ *  @param width   Width of the rectangle.
+ *  @param height  Height of the rectangle.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_gl_copy_image_data(void *dest,
+                          void *src,
+                          unsigned int src_x,
+                          unsigned int src_y,
+                          unsigned int dest_x,
+                          unsigned int dest_y,
+                          unsigned int width,
+                          unsigned int height);
+
+
+/** Retrieve the size of an image as drawn.
+ *
+ *  @param data    A void pointer to the image data.
+ *  @param width   Pointer to store the width in.
+ *  @param height  Pointer to store the height in.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_gl_image_data_size(void *data,
+                          unsigned int *width,
+                          unsigned int *height);
+
+
+/** Get the memory used by an image's pixels and texture.
+ *
+ *  Enlarged images share their original's texture, so count as
+ *  using none.
+ *
+ *  @param data  A void pointer to the image data.
+ *
+ *  @return  the size of the image's pixels and texture, in bytes.
+ */
+
+unsigned long dm_gl_image_data_bytes(void *data);
+
+
+/** Enlarge an image by integer factors.
+ *
+ *  No pixels are copied: the enlarged image shares the original's
+ *  texture, and scales its texture co-ordinates instead.
+ *
+ *  @param data      A void pointer to the image data.
+ *  @param x_factor  Horizontal enlargement factor.
+ *  @param y_factor  Vertical enlargement factor.
+ *
+ *  @return  a void pointer to the enlarged image data, or NULL on
+ *           failure.
+ */
+
+void *dm_gl_scale_image_data(void *data,
+                             unsigned int x_factor,
+                             unsigned int y_factor);
+
+
+/** Upload pixels in a given format as a texture.
+ *
+ *  @param pixels  The pixels.
+ *  @param width   Width of the image.
+ *  @param height  Height of the image.
+ *  @param pitch   Bytes from the start of one row to the next.
+ *  @param format  Format of the pixels.
+ *
+ *  @return  a void pointer to the image data, or NULL on failure.
+ */
+
+void *dm_gl_image_data_from_pixels(const void *pixels,
+                                   unsigned int width,
+                                   unsigned int height,
+                                   unsigned int pitch,
+                                   const dm_GfxPixelFormat *format);
+
+
+/** Batch part of an image to be drawn.
+ *
+ *  @param image     The image node.
+ *  @param image_x   X co-ordinate of the rectangle in the image.
+ *  @param image_y   Y co-ordinate of the rectangle in the image.
+ *  @param screen_x  X co-ordinate on screen.
+ *  @param screen_y  Y co-ordinate on screen.
+ *  @param width     Width of the rectangle.
+ *  @param height    Height of the rectangle.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_gl_draw_image(struct dm_GfxImageNode *image,
+                     unsigned int image_x,
+                     unsigned int image_y,
+                     unsigned int screen_x,
+                     unsigned int screen_y,
+                     unsigned int width,
+                     unsigned int height);
+
+
+/** Batch a rectangle fill.
+ *
+ *  @param x  X co-ordinate of the rectangle.
+ *  @param y  Y co-ordinate of the rectangle.
+ *  @param w  Width of the rectangle.
+ *  @param h  Height of the rectangle.
+ *  @param r  Red component of the colour.
+ *  @param g  Green component of the colour.
+ *  @param b  Blue component of the colour.
+ */
+
+void dm_gl_fill_rect_rgb(unsigned int x,
+                         unsigned int y,
+                         unsigned int w,
+                         unsigned int h,
+                         unsigned int r,
+                         unsigned int g,
+                         unsigned int b);
+
+#endif /* __DM_GFX_SDL_OPENGL_H__ */
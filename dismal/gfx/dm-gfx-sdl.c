@@ -25,15 +25,43 @@
  *                                                                        *
  **************************************************************************/
 
+#include <string.h>
+
 #include "SDL/SDL.h"
 #include "SDL/SDL_image.h"
 
 #include "../dismal.h"
 #include "dm-gfx.h"
 #include "dm-gfx-sdl.h"
+#include "../base/dm-base-sdl.h"
+
+/* One band of a batch, drawn by a render thread. */
+typedef struct dm_SDLBand {
+  const dm_GfxCommand *cmds; /* The whole batch. */
+  unsigned long count;       /* Number of commands in the batch. */
+  SDL_Rect clip;             /* Part of the target in the band. */
+  dm_GfxBandTiming *timing;  /* Where to record how long it took. */
+} dm_SDLBand;
 
 static dm_GfxSDLData *_dm_gfxsdl;
 
+static int dm_sdl_can_blit(SDL_Surface *surf, int blend);
+static int dm_sdl_can_split(const dm_GfxCommand *cmds,
+                            unsigned long count);
+static unsigned long dm_sdl_draw_commands(const dm_GfxCommand *cmds,
+                                          unsigned long count,
+                                          SDL_Rect *clip);
+static void dm_sdl_draw_band(void *arg);
+static void dm_sdl_blit(SDL_Surface *src, int blend, SDL_Rect *srcrect,
+                        SDL_Rect *destrect, SDL_Rect *clip);
+static void dm_sdl_fill(SDL_Rect *rect, Uint32 colour, SDL_Rect *clip);
+static void dm_sdl_enlarge(SDL_Rect *rect);
+static void dm_sdl_expand(const SDL_Rect *rect);
+static void dm_sdl_present(SDL_Rect *rect);
+static Uint32 dm_sdl_map_rgb(unsigned int r, unsigned int g,
+                             unsigned int b);
+static SDL_Surface *dm_sdl_remap(SDL_Surface *surf);
+
 void dm_gfx_sdl_register(dm_GfxDriver *driver)
 {
   driver->init = dm_gfx_sdl_init;
@@ -43,11 +71,31 @@ void dm_gfx_sdl_register(dm_GfxDriver *driver)
   driver->free_image_data = dm_sdl_free_image_data;
   driver->draw_image = dm_sdl_draw_image;
   driver->fill_rect_rgb = dm_sdl_fill_rect_rgb;
+  driver->fill_rect_pal = dm_sdl_fill_rect_pal;
+  driver->create_image_data = dm_sdl_create_image_data;
+  driver->copy_image_data = dm_sdl_copy_image_data;
+  driver->image_data_size = dm_sdl_image_data_size;
+  driver->decode_image_data = dm_sdl_decode_image_data;
+  driver->finish_image_data = dm_sdl_finish_image_data;
+  driver->image_data_bytes = dm_sdl_image_data_bytes;
+  driver->scale_image_data = dm_sdl_scale_image_data;
+  driver->image_data_from_pixels = dm_sdl_image_data_from_pixels;
+  driver->submit_batch = dm_sdl_submit_batch;
+  driver->update_rects = dm_sdl_update_rects;
+  driver->init_lowres_buffer = dm_sdl_init_lowres_buffer;
+  driver->init_paletted = dm_sdl_init_paletted;
+  driver->set_palette = dm_sdl_set_palette;
+  driver->band_timings = dm_sdl_band_timings;
+  driver->read_pixels = dm_sdl_read_pixels;
+  driver->init_render_thread = dm_sdl_init_render_thread;
+  driver->blend_image_data = dm_sdl_blend_image_data;
 }
 
 
 int dm_gfx_sdl_init(dm_Config *conf)
 {
+  unsigned int features;
+
   dm_debug("GFX-SDL: Initialising.");
 
   if (SDL_InitSubSystem(SDL_INIT_VIDEO) == 0) {
@@ -63,6 +111,20 @@ int dm_gfx_sdl_init(dm_Config *conf)
                                             conf->gfx_screen_depth,
                                             SDL_SWSURFACE|SDL_ANYFORMAT);
       if (_dm_gfxsdl->screen) {
+        _dm_gfxsdl->target = _dm_gfxsdl->screen;
+        _dm_gfxsdl->lowres = _dm_gfxsdl->indexed = NULL;
+        _dm_gfxsdl->band_count = 0;
+        features = dm_blit_init();
+        dm_debug("GFX-SDL: Using %s blit kernels.",
+                 ((features & DM_BLIT_AVX2) ? "AVX2"
+                  : (features & DM_BLIT_SSE2) ? "SSE2" : "scalar"));
+
+        /* Without render threads, batches are drawn on this thread
+           alone. */
+        _dm_gfxsdl->render_pool = dm_pool_create(conf->gfx_render_threads);
+        if (_dm_gfxsdl->render_pool)
+          dm_debug("GFX-SDL: Drawing batches on %d render threads.",
+                   dm_pool_size(_dm_gfxsdl->render_pool));
         return DM_SUCCESS;
       } else {
         dm_fatal("GFX-SDL: Could not initialise screen.");
@@ -78,12 +140,157 @@ int dm_gfx_sdl_init(dm_Config *conf)
 
 void dm_gfx_sdl_update(void)
 {
+  SDL_Rect all;
+
+  if (_dm_gfxsdl->target != _dm_gfxsdl->screen) {
+    all.x = all.y = 0;
+    all.w = _dm_gfxsdl->target->w;
+    all.h = _dm_gfxsdl->target->h;
+    dm_sdl_present(&all);
+  }
+
+  dm_base_sdl_video_lock();
   SDL_Flip(_dm_gfxsdl->screen);
+  dm_base_sdl_video_unlock();
+}
+
+void dm_sdl_update_rects(const dm_GfxRect *rects, int count)
+{
+  SDL_Rect sdlrects[DM_GFX_DIRTY_MAX];
+  int i;
+
+  if (count > DM_GFX_DIRTY_MAX) {
+    dm_gfx_sdl_update();
+    return;
+  }
+
+  for (i = 0; i < count; i++) {
+    sdlrects[i].x = rects[i].x;
+    sdlrects[i].y = rects[i].y;
+    sdlrects[i].w = rects[i].w;
+    sdlrects[i].h = rects[i].h;
+
+    /* Only the dirty parts of the buffers need presenting. */
+    if (_dm_gfxsdl->target != _dm_gfxsdl->screen)
+      dm_sdl_present(&sdlrects[i]);
+  }
+
+  /* Page-flipped screens can only be presented whole. */
+  dm_base_sdl_video_lock();
+
+  if (_dm_gfxsdl->screen->flags & SDL_DOUBLEBUF)
+    SDL_Flip(_dm_gfxsdl->screen);
+  else
+    SDL_UpdateRects(_dm_gfxsdl->screen, count, sdlrects);
+
+  dm_base_sdl_video_unlock();
+}
+
+int dm_sdl_init_lowres_buffer(unsigned int width,
+                              unsigned int height,
+                              const dm_GfxViewport *viewport)
+{
+  SDL_Surface *buffer;
+  SDL_PixelFormat *fmt;
+
+  fmt = _dm_gfxsdl->screen->format;
+
+  if (width > DM_LOWRES_WIDTH || height > DM_LOWRES_HEIGHT
+      || viewport->x_table[width] > (unsigned int) _dm_gfxsdl->screen->w
+      || viewport->y_table[height] > (unsigned int) _dm_gfxsdl->screen->h)
+    return DM_FAILURE;
+
+  buffer = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
+                                fmt->BitsPerPixel, fmt->Rmask,
+                                fmt->Gmask, fmt->Bmask, 0);
+
+  if (buffer == NULL) {
+    dm_fatal("GFX-SDL: Couldn't create %ux%u backbuffer!", width, height);
+    return DM_FAILURE;
+  }
+
+  /* The buffer's pixels are enlarged onto the screen as raw values,
+     so they must mean the same colours. */
+  if (fmt->palette)
+    SDL_SetColors(buffer, fmt->palette->colors, 0, fmt->palette->ncolors);
+
+  _dm_gfxsdl->target = _dm_gfxsdl->lowres = buffer;
+  _dm_gfxsdl->viewport = viewport;
+
+  return DM_SUCCESS;
+}
+
+int dm_sdl_init_render_thread(void)
+{
+  /* Software surfaces can be drawn to and presented from any thread,
+     but hardware ones have to be locked on the thread that set the
+     video mode. */
+  if (_dm_gfxsdl->screen->flags & SDL_HWSURFACE)
+    return DM_FAILURE;
+
+  return DM_SUCCESS;
+}
+
+int dm_sdl_init_paletted(void)
+{
+  SDL_Surface *buffer;
+  unsigned int bpp;
+
+  /* Indices are only looked up into 16- or 32-bit pixels. */
+  bpp = _dm_gfxsdl->screen->format->BytesPerPixel;
+
+  if (bpp != 2 && bpp != 4)
+    return DM_FAILURE;
+
+  buffer = SDL_CreateRGBSurface(SDL_SWSURFACE, _dm_gfxsdl->target->w,
+                                _dm_gfxsdl->target->h, 8, 0, 0, 0, 0);
+
+  if (buffer == NULL) {
+    dm_fatal("GFX-SDL: Couldn't create indexed buffer!");
+    return DM_FAILURE;
+  }
+
+  _dm_gfxsdl->target = _dm_gfxsdl->indexed = buffer;
+
+  return DM_SUCCESS;
+}
+
+void dm_sdl_set_palette(const dm_GfxColour colours[],
+                        unsigned int first,
+                        unsigned int count)
+{
+  SDL_Color sdlcolours[DM_PALETTE_SIZE];
+  unsigned int i;
+
+  for (i = 0; i < count; i++) {
+    _dm_gfxsdl->palette[first + i] =
+      SDL_MapRGB(_dm_gfxsdl->screen->format,
+                 colours[i].r, colours[i].g, colours[i].b);
+
+    sdlcolours[i].r = colours[i].r;
+    sdlcolours[i].g = colours[i].g;
+    sdlcolours[i].b = colours[i].b;
+    sdlcolours[i].unused = 0;
+  }
+
+  /* SDL matches colours against this when it draws anything not
+     already in indices. */
+  if (_dm_gfxsdl->indexed)
+    SDL_SetColors(_dm_gfxsdl->indexed, sdlcolours, first, count);
 }
 
 void dm_gfx_sdl_cleanup(void)
 {
   if (_dm_gfxsdl) {
+    if (_dm_gfxsdl->render_pool)
+      dm_pool_destroy(_dm_gfxsdl->render_pool);
+
+    if (_dm_gfxsdl->indexed)
+      SDL_FreeSurface(_dm_gfxsdl->indexed);
+
+    if (_dm_gfxsdl->lowres)
+      SDL_FreeSurface(_dm_gfxsdl->lowres);
+
     free(_dm_gfxsdl);
     _dm_gfxsdl = NULL;
   }
@@ -93,19 +300,74 @@ void dm_gfx_sdl_cleanup(void)
 
 void *dm_sdl_load_image_data(const char filename[])
 { 
+  void *decoded;
+
+  decoded = dm_sdl_decode_image_data(filename);
+
+  if (decoded == NULL)
+    return NULL;
+
+  return dm_sdl_finish_image_data(decoded);
+}
+
+void *dm_sdl_decode_image_data(const char filename[])
+{
   SDL_Surface *surf;
 
+  /* Only decode here; this may be running on a worker thread. */
   surf = IMG_Load(filename);
 
-  if (surf) {
-    /* TODO: make this flaggable or something */
-    SDL_SetColorKey(surf,
-                    SDL_SRCCOLORKEY | SDL_RLEACCEL, 
-                    SDL_MapRGB(_dm_gfxsdl->screen->format, 255, 0, 255));;
-  } else {
+  if (surf == NULL)
     dm_fatal("GFX-SDL: Couldn't load %s!\n", filename);
+
+  return (void*) surf;
+}
+
+void *dm_sdl_finish_image_data(void *decoded)
+{
+
+  SDL_Surface *surf, *converted;
+  SDL_PixelFormat *fmt;
+  Uint32 flags;
+
+  surf = (SDL_Surface*) decoded;
+
+  /* In paletted mode, images are remapped to indices once, here. */
+  if (_dm_gfxsdl->indexed) {
+    converted = dm_sdl_remap(surf);
+
+    if (converted) {
+      SDL_FreeSurface(surf);
+      SDL_SetColorKey(converted, SDL_SRCCOLORKEY, DM_PALETTE_KEY);
+      return (void*) converted;
+    }
+  }
+
+  fmt = surf->format;
+
+  /* Opaque, non-paletted images are converted to the screen format
+     once, here, so drawing them is a plain copy that DISMAL's own
+     blitters can do. */
+  if (fmt->BytesPerPixel > 1 && fmt->Amask == 0
+      && !dm_sdl_can_blit(surf, DM_BLEND_KEYED)) {
+    converted = SDL_DisplayFormat(surf);
+
+    if (converted) {
+      SDL_FreeSurface(surf);
+      surf = converted;
+    }
   }
 
+  /* RLE only helps if SDL is doing the drawing. */
+  flags = SDL_SRCCOLORKEY;
+
+  if (!dm_sdl_can_blit(surf, DM_BLEND_KEYED))
+    flags |= SDL_RLEACCEL;
+
+  /* TODO: make this flaggable or something */
+  SDL_SetColorKey(surf, flags,
+                  SDL_MapRGB(_dm_gfxsdl->screen->format, 255, 0, 255));
+
   return (void*) surf;
 }
 
@@ -117,6 +379,344 @@ void dm_sdl_free_image_data(void *data)
   }
 }
 
+void *dm_sdl_create_image_data(unsigned int width, unsigned int height)
+{
+  SDL_Surface *surf;
+  SDL_PixelFormat *fmt;
+  Uint32 key;
+
+  fmt = _dm_gfxsdl->target->format;
+
+  surf = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
+                              fmt->BitsPerPixel, fmt->Rmask, fmt->Gmask,
+                              fmt->Bmask, 0);
+
+  if (surf) {
+    /* Fill with the colour key, so unused space is transparent. */
+    if (_dm_gfxsdl->indexed)
+      key = DM_PALETTE_KEY;
+    else
+      key = SDL_MapRGB(surf->format, 255, 0, 255);
+
+    SDL_FillRect(surf, NULL, key);
+    SDL_SetColorKey(surf, (dm_sdl_can_blit(surf, DM_BLEND_KEYED)
+                           ? SDL_SRCCOLORKEY
+                           : SDL_SRCCOLORKEY | SDL_RLEACCEL), key);
+  } else {
+    dm_fatal("GFX-SDL: Couldn't create %ux%u surface!", width, height);
+  }
+
+  return (void*) surf;
+}
+
+/* Check whether any pixel in a surface is less than fully opaque. */
+static int dm_sdl_has_translucency(SDL_Surface *surf)
+{
+  int x, y, found;
+  Uint8 *row;
+  Uint32 px;
+  Uint8 bpp;
+
+  if (surf->format->Amask == 0)
+    return DM_FALSE;
+
+  found = DM_FALSE;
+  bpp = surf->format->BytesPerPixel;
+
+  SDL_LockSurface(surf);
+
+  for (y = 0; y < surf->h && !found; y++) {
+    row = (Uint8*) surf->pixels + y * surf->pitch;
+
+    for (x = 0; x < surf->w; x++) {
+      if (bpp == 4)
+        px = ((Uint32*) row)[x];
+      else
+        px = ((Uint16*) row)[x];
+
+      if ((px & surf->format->Amask) != surf->format->Amask) {
+        found = DM_TRUE;
+        break;
+      }
+    }
+  }
+
+  SDL_UnlockSurface(surf);
+
+  return found;
+}
+
+int dm_sdl_copy_image_data(void *dest,
+                           void *src,
+                           unsigned int src_x,
+                           unsigned int src_y,
+                           unsigned int dest_x,
+                           unsigned int dest_y,
+                           unsigned int width,
+                           unsigned int height)
+{
+  SDL_Surface *ssrc, *sdest;
+  SDL_Rect srcrect, destrect;
+  Uint32 flags, key;
+  Uint8 alpha;
+  int ret;
+
+  ssrc = (SDL_Surface*) src;
+  sdest = (SDL_Surface*) dest;
+
+  /* Indices are copied as they are, whatever palettes SDL thinks the
+     surfaces have. */
+  if (_dm_gfxsdl->indexed && ssrc->format->BytesPerPixel == 1
+      && sdest->format->BytesPerPixel == 1) {
+    if (src_x + width > (unsigned int) ssrc->w
+        || src_y + height > (unsigned int) ssrc->h
+        || dest_x + width > (unsigned int) sdest->w
+        || dest_y + height > (unsigned int) sdest->h)
+      return DM_FAILURE;
+
+    dm_blit_copy((Uint8*) ssrc->pixels + src_y * ssrc->pitch + src_x,
+                 ssrc->pitch,
+                 (Uint8*) sdest->pixels + dest_y * sdest->pitch + dest_x,
+                 sdest->pitch, width, height, 1);
+    return DM_SUCCESS;
+  }
+
+  if (dm_sdl_has_translucency(ssrc))
+    return DM_FAILURE;
+
+  srcrect.x = src_x;
+  srcrect.y = src_y;
+  destrect.x = dest_x;
+  destrect.y = dest_y;
+  srcrect.w = destrect.w = width;
+  srcrect.h = destrect.h = height;
+
+  /* Turn off keying and blending so the pixels are copied as-is. */
+  flags = ssrc->flags;
+  key = ssrc->format->colorkey;
+  alpha = ssrc->format->alpha;
+
+  SDL_SetColorKey(ssrc, 0, 0);
+  SDL_SetAlpha(ssrc, 0, 255);
+
+  ret = SDL_BlitSurface(ssrc, &srcrect, sdest, &destrect);
+
+  SDL_SetColorKey(ssrc, flags & (SDL_SRCCOLORKEY | SDL_RLEACCEL), key);
+  SDL_SetAlpha(ssrc, flags & SDL_SRCALPHA, alpha);
+
+  return (ret == 0) ? DM_SUCCESS : DM_FAILURE;
+}
+
+int dm_sdl_image_data_size(void *data,
+                           unsigned int *width,
+                           unsigned int *height)
+{
+  if (data) {
+    *width = ((SDL_Surface*) data)->w;
+    *height = ((SDL_Surface*) data)->h;
+    return DM_SUCCESS;
+  }
+
+  return DM_FAILURE;
+}
+
+unsigned long dm_sdl_image_data_bytes(void *data)
+{
+  SDL_Surface *surf;
+
+  surf = (SDL_Surface*) data;
+
+  return (unsigned long) surf->pitch * surf->h;
+}
+
+void *dm_sdl_scale_image_data(void *data,
+                              unsigned int x_factor,
+                              unsigned int y_factor)
+{
+  SDL_Surface *src, *surf;
+  SDL_PixelFormat *fmt;
+
+  src = (SDL_Surface*) data;
+  fmt = src->format;
+
+  surf = SDL_CreateRGBSurface(SDL_SWSURFACE,
+                              src->w * x_factor, src->h * y_factor,
+                              fmt->BitsPerPixel, fmt->Rmask, fmt->Gmask,
+                              fmt->Bmask, fmt->Amask);
+
+  if (surf == NULL) {
+    dm_fatal("GFX-SDL: Couldn't create enlarged surface!");
+    return NULL;
+  }
+
+  if (fmt->palette)
+    SDL_SetColors(surf, fmt->palette->colors, 0, fmt->palette->ncolors);
+
+  /* Same format, so the pixels can be copied as raw bytes. */
+  SDL_LockSurface(src);
+  SDL_LockSurface(surf);
+
+  dm_pixel_scale_nearest((const unsigned char*) src->pixels, src->pitch,
+                         (unsigned char*) surf->pixels, surf->pitch,
+                         src->w, src->h, fmt->BytesPerPixel,
+                         x_factor, y_factor);
+
+  SDL_UnlockSurface(surf);
+  SDL_UnlockSurface(src);
+
+  /* Carry over the source's transparency. */
+  if (src->flags & SDL_SRCCOLORKEY)
+    SDL_SetColorKey(surf, src->flags & (SDL_SRCCOLORKEY | SDL_RLEACCEL),
+                    fmt->colorkey);
+
+  /* SDL turns blending on for any new surface with an alpha channel,
+     so match the source's, lest surfaces prepared for the alpha blend
+     modes get blended by SDL. */
+  SDL_SetAlpha(surf, src->flags & (SDL_SRCALPHA | SDL_RLEACCEL),
+               fmt->alpha);
+
+  return (void*) surf;
+}
+
+void *dm_sdl_image_data_from_pixels(const void *pixels,
+                                    unsigned int width,
+                                    unsigned int height,
+                                    unsigned int pitch,
+                                    const dm_GfxPixelFormat *format)
+{
+  SDL_Surface *surf;
+
+  /* SDL never writes to the pixels of a surface we do not lock for
+     writing, so the const can go. */
+  surf = SDL_CreateRGBSurfaceFrom((void*) pixels, width, height,
+                                  format->bits, pitch,
+                                  format->rmask, format->gmask,
+                                  format->bmask, format->amask);
+
+  if (surf == NULL) {
+    dm_fatal("GFX-SDL: Couldn't create surface from pixels!");
+    return NULL;
+  }
+
+  /* No RLE acceleration: that would keep a second, encoded copy of
+     the pixels. */
+  if (format->keyed)
+    SDL_SetColorKey(surf, SDL_SRCCOLORKEY, format->key);
+
+  return (void*) surf;
+}
+
+void *dm_sdl_blend_image_data(void *data, int blend)
+{
+  SDL_Surface *surf, *out;
+  SDL_PixelFormat *sf, *df;
+  Uint8 *srow, *p;
+  Uint32 *drow, px;
+  Uint8 r, g, b, a;
+  int x, y;
+
+  surf = (SDL_Surface*) data;
+  df = _dm_gfxsdl->target->format;
+
+  switch (blend) {
+  case DM_BLEND_KEYED:
+    return data;
+  case DM_BLEND_OPAQUE:
+    /* As with keyed images, convert to the screen format once, here,
+       so DISMAL's blitters can copy it. */
+    if (!_dm_gfxsdl->indexed && !dm_sdl_can_blit(surf, blend)) {
+      out = SDL_DisplayFormat(surf);
+
+      if (out) {
+        SDL_FreeSurface(surf);
+        surf = out;
+      }
+    }
+
+    SDL_SetColorKey(surf, 0, 0);
+    SDL_SetAlpha(surf, 0, 255);
+    return (void*) surf;
+  case DM_BLEND_ALPHA:
+  case DM_BLEND_PREMULTIPLIED:
+  case DM_BLEND_ADDITIVE:
+    break;
+  default:
+    return NULL;
+  }
+
+  /* DISMAL's blitters blend 32-bit pixels with alpha in the top byte,
+     so the target must leave that byte free.  (Paletted targets also
+     fail this, and their images have lost their alpha anyway.) */
+  if (df->BytesPerPixel != 4
+      || ((df->Rmask | df->Gmask | df->Bmask) & 0xFF000000UL) != 0)
+    return NULL;
+
+  out = SDL_CreateRGBSurface(SDL_SWSURFACE, surf->w, surf->h, 32,
+                             df->Rmask, df->Gmask, df->Bmask,
+                             0xFF000000UL);
+
+  if (out == NULL) {
+    dm_fatal("GFX-SDL: Couldn't create %dx%d blended surface!",
+             surf->w, surf->h);
+    return NULL;
+  }
+
+  sf = surf->format;
+
+  SDL_LockSurface(surf);
+
+  for (y = 0; y < surf->h; y++) {
+    srow = (Uint8*) surf->pixels + y * surf->pitch;
+    drow = (Uint32*) ((Uint8*) out->pixels + y * out->pitch);
+
+    for (x = 0; x < surf->w; x++) {
+      switch (sf->BytesPerPixel) {
+      case 1:
+        px = srow[x];
+        break;
+      case 2:
+        px = ((Uint16*) srow)[x];
+        break;
+      case 3:
+        p = srow + x * 3;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+        px = ((Uint32) p[0] << 16) | ((Uint32) p[1] << 8) | p[2];
+#else
+        px = p[0] | ((Uint32) p[1] << 8) | ((Uint32) p[2] << 16);
+#endif
+        break;
+      default:
+        px = ((Uint32*) srow)[x];
+        break;
+      }
+
+      SDL_GetRGBA(px, sf, &r, &g, &b, &a);
+
+      /* Keyed pixels of images with no alpha channel are still
+         transparent, and black, as premultiplied images are never
+         premultiplied here. */
+      if ((surf->flags & SDL_SRCCOLORKEY) && sf->Amask == 0
+          && px == sf->colorkey)
+        r = g = b = a = 0;
+
+      drow[x] = ((Uint32) a << 24) | ((Uint32) r << df->Rshift)
+        | ((Uint32) g << df->Gshift) | ((Uint32) b << df->Bshift);
+    }
+  }
+
+  SDL_UnlockSurface(surf);
+  SDL_FreeSurface(surf);
+
+  if (blend != DM_BLEND_PREMULTIPLIED)
+    dm_pixel_premultiply((unsigned char*) out->pixels, out->pitch,
+                         out->w, out->h);
+
+  /* DISMAL blends these itself; SDL must never try. */
+  SDL_SetAlpha(out, 0, 255);
+
+  return (void*) out;
+}
+
 int dm_sdl_draw_image(struct dm_GfxImageNode *image,
                       unsigned int image_x,
                       unsigned int image_y,
@@ -140,7 +740,8 @@ int dm_sdl_draw_image(struct dm_GfxImageNode *image,
   srcrect.h = destrect.h = height;
 
   if (ptex) {
-    SDL_BlitSurface(ptex, &srcrect, _dm_gfxsdl->screen, &destrect);
+    dm_sdl_blit(ptex, image->blend, &srcrect, &destrect,
+                &_dm_gfxsdl->target->clip_rect);
     return DM_SUCCESS;
   } else {
     return DM_FAILURE;
@@ -148,6 +749,223 @@ int dm_sdl_draw_image(struct dm_GfxImageNode *image,
 }
 
 
+void dm_sdl_submit_batch(const dm_GfxCommand *cmds, unsigned long count)
+{
+  dm_SDLBand bands[DM_GFX_BANDS_MAX];
+  dm_PoolGroup group;
+  SDL_Rect *clip;
+  int i, n, y;
+
+  clip = &_dm_gfxsdl->target->clip_rect;
+  _dm_gfxsdl->band_count = 0;
+
+  /* One band for each render thread, and one for this thread, which
+     works through the queue while it waits; no band is shorter than
+     DM_GFX_BAND_ROWS. */
+  n = 0;
+  if (_dm_gfxsdl->render_pool && dm_sdl_can_split(cmds, count)) {
+    n = dm_pool_size(_dm_gfxsdl->render_pool) + 1;
+
+    if (n > clip->h / DM_GFX_BAND_ROWS)
+      n = clip->h / DM_GFX_BAND_ROWS;
+    if (n > DM_GFX_BANDS_MAX)
+      n = DM_GFX_BANDS_MAX;
+  }
+
+  if (n <= 1) {
+    dm_sdl_draw_commands(cmds, count, clip);
+    return;
+  }
+
+  dm_pool_group_init(&group);
+
+  for (i = 0, y = clip->y; i < n; i++) {
+    bands[i].cmds = cmds;
+    bands[i].count = count;
+    bands[i].clip.x = clip->x;
+    bands[i].clip.y = y;
+    bands[i].clip.w = clip->w;
+    bands[i].clip.h = (clip->y + clip->h - y) / (n - i);
+    bands[i].timing = &_dm_gfxsdl->bands[i];
+
+    y += bands[i].clip.h;
+    dm_pool_submit(_dm_gfxsdl->render_pool, &group, dm_sdl_draw_band,
+                   &bands[i]);
+  }
+
+  dm_pool_wait(_dm_gfxsdl->render_pool, &group);
+  _dm_gfxsdl->band_count = n;
+}
+
+int dm_sdl_band_timings(dm_GfxBandTiming timings[], int max)
+{
+  int i;
+
+  for (i = 0; i < _dm_gfxsdl->band_count && i < max; i++)
+    timings[i] = _dm_gfxsdl->bands[i];
+
+  return i;
+}
+
+int dm_sdl_read_pixels(const dm_GfxRect *rect, unsigned char *dest)
+{
+  SDL_Surface *src;
+  SDL_PixelFormat *fmt;
+  const Uint8 *row, *p;
+  Uint32 pixel;
+  unsigned int x, y, bpp;
+  int rgb;
+
+  /* What was presented is left in the backbuffer if there is one, and
+     on the screen otherwise; paletted frames have already been looked
+     up into one or the other. */
+  src = _dm_gfxsdl->lowres ? _dm_gfxsdl->lowres : _dm_gfxsdl->screen;
+  fmt = src->format;
+  bpp = fmt->BytesPerPixel;
+  rgb = (bpp == 4 && fmt->Rmask == 0xFF0000 && fmt->Gmask == 0xFF00
+         && fmt->Bmask == 0xFF);
+
+  if (SDL_MUSTLOCK(src))
+    SDL_LockSurface(src);
+
+  for (y = 0; y < rect->h; y++) {
+    row = ((const Uint8*) src->pixels + (rect->y + y) * src->pitch
+           + rect->x * bpp);
+
+    if (rgb) {
+      for (x = 0; x < rect->w; x++, dest += 3) {
+        pixel = ((const Uint32*) row)[x];
+        dest[0] = (Uint8) (pixel >> 16);
+        dest[1] = (Uint8) (pixel >> 8);
+        dest[2] = (Uint8) pixel;
+      }
+      continue;
+    }
+
+    for (x = 0, p = row; x < rect->w; x++, p += bpp, dest += 3) {
+      switch (bpp) {
+      case 1:
+        pixel = *p;
+        break;
+      case 2:
+        pixel = *(const Uint16*) p;
+        break;
+      case 3:
+        if (SDL_BYTEORDER == SDL_LIL_ENDIAN)
+          pixel = p[0] | (p[1] << 8) | ((Uint32) p[2] << 16);
+        else
+          pixel = ((Uint32) p[0] << 16) | (p[1] << 8) | p[2];
+        break;
+      default:
+        pixel = *(const Uint32*) p;
+        break;
+      }
+
+      SDL_GetRGB(pixel, fmt, dest, dest + 1, dest + 2);
+    }
+  }
+
+  if (SDL_MUSTLOCK(src))
+    SDL_UnlockSurface(src);
+
+  return DM_SUCCESS;
+}
+
+/* Check whether a batch can be split between the render threads.
+   Each band is drawn with DISMAL's own blitters, clipped to the band,
+   so that the bands never touch the same pixels; SDL's blitters
+   cannot be clipped that way, nor run on several threads at once, so
+   batches that need them are drawn whole. */
+static int dm_sdl_can_split(const dm_GfxCommand *cmds,
+                            unsigned long count)
+{
+  SDL_Surface *target;
+  unsigned long i;
+
+  target = _dm_gfxsdl->target;
+
+  if (target->format->BytesPerPixel == 3 || SDL_MUSTLOCK(target))
+    return DM_FALSE;
+
+  for (i = 0; i < count; i++, cmds++)
+    if (cmds->type == DM_GFX_CMD_IMAGE && cmds->image->data
+        && !dm_sdl_can_blit((SDL_Surface*) cmds->image->data,
+                            cmds->image->blend))
+      return DM_FALSE;
+
+  return DM_TRUE;
+}
+
+/* Draw the part of a batch that lies within a clipping rectangle,
+   returning the number of commands that touched it. */
+static unsigned long dm_sdl_draw_commands(const dm_GfxCommand *cmds,
+                                          unsigned long count,
+                                          SDL_Rect *clip)
+{
+  SDL_Rect srcrect, destrect;
+  unsigned long i, key, drawn;
+  Uint32 colour;
+
+  key = 0;
+  colour = dm_sdl_map_rgb(0, 0, 0);
+  drawn = 0;
+
+  for (i = 0; i < count; i++, cmds++) {
+    if (cmds->screen_y >= clip->y + clip->h
+        || cmds->screen_y + cmds->height <= clip->y
+        || cmds->screen_x >= clip->x + clip->w
+        || cmds->screen_x + cmds->width <= clip->x)
+      continue;
+
+    destrect.x = cmds->screen_x;
+    destrect.y = cmds->screen_y;
+    destrect.w = cmds->width;
+    destrect.h = cmds->height;
+
+    if (cmds->type == DM_GFX_CMD_FILL) {
+      /* Fills come grouped by colour, so only map it when it
+         changes. */
+      if (cmds->key != key) {
+        key = cmds->key;
+        colour = dm_sdl_map_rgb(cmds->r, cmds->g, cmds->b);
+      }
+
+      dm_sdl_fill(&destrect, colour, clip);
+    } else if (cmds->type == DM_GFX_CMD_FILL_PAL) {
+      dm_sdl_fill(&destrect, (_dm_gfxsdl->indexed ? cmds->key
+                              : _dm_gfxsdl->palette[cmds->key]), clip);
+    } else if (cmds->image->data) {
+      srcrect.x = cmds->image_x;
+      srcrect.y = cmds->image_y;
+      srcrect.w = cmds->width;
+      srcrect.h = cmds->height;
+
+      dm_sdl_blit((SDL_Surface*) cmds->image->data, cmds->image->blend,
+                  &srcrect, &destrect, clip);
+    }
+
+    drawn++;
+  }
+
+  return drawn;
+}
+
+/* Draw one band of a batch, on whichever thread gets it. */
+static void dm_sdl_draw_band(void *arg)
+{
+  dm_SDLBand *band;
+  unsigned long start;
+
+  band = (dm_SDLBand*) arg;
+  start = dm_time_us();
+
+  band->timing->commands = dm_sdl_draw_commands(band->cmds, band->count,
+                                                &band->clip);
+  band->timing->usecs = dm_time_us() - start;
+  band->timing->y = band->clip.y;
+  band->timing->height = band->clip.h;
+}
+
 void dm_sdl_fill_rect_rgb(unsigned int x,
                           unsigned int y,
                           unsigned int w,
@@ -163,7 +981,359 @@ void dm_sdl_fill_rect_rgb(unsigned int x,
   rect.w = w;
   rect.h = h;
 
-  SDL_FillRect(_dm_gfxsdl->screen, &rect,
-               SDL_MapRGB(_dm_gfxsdl->screen->format, 
-                          r, g, b));
+  dm_sdl_fill(&rect, dm_sdl_map_rgb(r, g, b),
+              &_dm_gfxsdl->target->clip_rect);
+}
+
+void dm_sdl_fill_rect_pal(unsigned int x,
+                          unsigned int y,
+                          unsigned int w,
+                          unsigned int h,
+                          unsigned int index)
+{
+  SDL_Rect rect;
+
+  rect.x = x;
+  rect.y = y;
+  rect.w = w;
+  rect.h = h;
+
+  dm_sdl_fill(&rect, (_dm_gfxsdl->indexed ? index
+                      : _dm_gfxsdl->palette[index]),
+              &_dm_gfxsdl->target->clip_rect);
+}
+
+/* Check whether DISMAL's blitters can draw a surface to the target
+   with a blend mode: it must be in the target's format, with no alpha
+   or RLE encoding for SDL to deal with (surfaces prepared for the
+   alpha modes carry their own alpha, which DISMAL blends), and the
+   target in a format they handle. */
+static int dm_sdl_can_blit(SDL_Surface *surf, int blend)
+{
+  SDL_PixelFormat *sf, *df;
+
+  sf = surf->format;
+  df = _dm_gfxsdl->target->format;
+
+  if (df->BytesPerPixel == 3 || sf->BytesPerPixel != df->BytesPerPixel)
+    return DM_FALSE;
+
+  if (surf->flags & (SDL_SRCALPHA | SDL_RLEACCEL)
+      || (sf->Amask != 0 && blend < DM_BLEND_ALPHA))
+    return DM_FALSE;
+
+  /* In paletted mode, all 8-bit image data holds logical palette
+     indices... */
+  if (_dm_gfxsdl->indexed)
+    return DM_TRUE;
+
+  /* ...otherwise paletted pixels are only the same colours with the
+     same palette. */
+  if (df->palette || sf->palette)
+    return (df->palette && sf->palette
+            && df->palette->ncolors == sf->palette->ncolors
+            && memcmp(df->palette->colors, sf->palette->colors,
+                      df->palette->ncolors * sizeof(SDL_Color)) == 0);
+
+  return (sf->Rmask == df->Rmask && sf->Gmask == df->Gmask
+          && sf->Bmask == df->Bmask);
+}
+
+/* Blit a surface to the drawing target, clipped as SDL_BlitSurface
+   would but to the given clipping rectangle (which must lie within
+   the target's), with DISMAL's blitters if they can draw it and SDL,
+   clipping to the target's own rectangle, otherwise. */
+static void dm_sdl_blit(SDL_Surface *src, int blend, SDL_Rect *srcrect,
+                        SDL_Rect *destrect, SDL_Rect *clip)
+{
+  SDL_Surface *target;
+  Uint8 *from, *to;
+  int sx, sy, dx, dy, w, h, over;
+  unsigned int bpp;
+
+  target = _dm_gfxsdl->target;
+
+  if (!dm_sdl_can_blit(src, blend)) {
+    SDL_BlitSurface(src, srcrect, target, destrect);
+    return;
+  }
+
+  sx = srcrect->x;
+  sy = srcrect->y;
+  dx = destrect->x;
+  dy = destrect->y;
+  w = srcrect->w;
+  h = srcrect->h;
+
+  /* Clip to the source... */
+  if (sx < 0) {
+    w += sx;
+    dx -= sx;
+    sx = 0;
+  }
+  if (sy < 0) {
+    h += sy;
+    dy -= sy;
+    sy = 0;
+  }
+  if (sx + w > src->w)
+    w = src->w - sx;
+  if (sy + h > src->h)
+    h = src->h - sy;
+
+  /* ...then to the target. */
+  if ((over = clip->x - dx) > 0) {
+    w -= over;
+    sx += over;
+    dx = clip->x;
+  }
+  if ((over = clip->y - dy) > 0) {
+    h -= over;
+    sy += over;
+    dy = clip->y;
+  }
+  if ((over = dx + w - (clip->x + clip->w)) > 0)
+    w -= over;
+  if ((over = dy + h - (clip->y + clip->h)) > 0)
+    h -= over;
+
+  if (w <= 0 || h <= 0)
+    return;
+
+  bpp = target->format->BytesPerPixel;
+
+  if (SDL_MUSTLOCK(target))
+    SDL_LockSurface(target);
+
+  from = (Uint8*) src->pixels + sy * src->pitch + sx * bpp;
+  to = (Uint8*) target->pixels + dy * target->pitch + dx * bpp;
+
+  if (blend == DM_BLEND_ALPHA || blend == DM_BLEND_PREMULTIPLIED)
+    dm_blit_blend(from, src->pitch, to, target->pitch, w, h);
+  else if (blend == DM_BLEND_ADDITIVE)
+    dm_blit_add(from, src->pitch, to, target->pitch, w, h);
+  else if (src->flags & SDL_SRCCOLORKEY)
+    dm_blit_keyed(from, src->pitch, to, target->pitch, w, h, bpp,
+                  src->format->colorkey);
+  else
+    dm_blit_copy(from, src->pitch, to, target->pitch, w, h, bpp);
+
+  if (SDL_MUSTLOCK(target))
+    SDL_UnlockSurface(target);
+}
+
+/* Fill a rectangle of the target, clipped as SDL_FillRect would but
+   to the given clipping rectangle (which must lie within the
+   target's). */
+static void dm_sdl_fill(SDL_Rect *rect, Uint32 colour, SDL_Rect *clip)
+{
+  SDL_Surface *target;
+  int x0, y0, x1, y1;
+  unsigned int bpp;
+
+  target = _dm_gfxsdl->target;
+  bpp = target->format->BytesPerPixel;
+
+  if (bpp == 3) {
+    SDL_FillRect(target, rect, colour);
+    return;
+  }
+
+  x0 = (rect->x > clip->x) ? rect->x : clip->x;
+  y0 = (rect->y > clip->y) ? rect->y : clip->y;
+  x1 = rect->x + rect->w;
+  y1 = rect->y + rect->h;
+
+  if (x1 > clip->x + clip->w)
+    x1 = clip->x + clip->w;
+  if (y1 > clip->y + clip->h)
+    y1 = clip->y + clip->h;
+
+  if (x1 <= x0 || y1 <= y0)
+    return;
+
+  if (SDL_MUSTLOCK(target))
+    SDL_LockSurface(target);
+
+  dm_blit_fill((Uint8*) target->pixels + y0 * target->pitch + x0 * bpp,
+               target->pitch, x1 - x0, y1 - y0, bpp, colour);
+
+  if (SDL_MUSTLOCK(target))
+    SDL_UnlockSurface(target);
+}
+
+/* Enlarge part of the backbuffer onto the screen, changing the
+   rectangle given to the part of the screen drawn to. */
+static void dm_sdl_enlarge(SDL_Rect *rect)
+{
+  SDL_Surface *buffer, *screen;
+  const dm_GfxViewport *v;
+  unsigned int bpp, factor;
+  Uint16 x, y, w, h;
+  Uint8 *dest;
+
+  buffer = _dm_gfxsdl->lowres;
+  screen = _dm_gfxsdl->screen;
+  v = _dm_gfxsdl->viewport;
+  bpp = screen->format->BytesPerPixel;
+
+  x = v->x_table[rect->x];
+  y = v->y_table[rect->y];
+  w = v->x_table[rect->x + rect->w] - x;
+  h = v->y_table[rect->y + rect->h] - y;
+  dest = (Uint8*) screen->pixels + y * screen->pitch + x * bpp;
+
+  if (SDL_MUSTLOCK(screen))
+    SDL_LockSurface(screen);
+
+  /* Whole factors take the quicker block enlargement; fractions pick
+     each screen pixel's source through the inverse tables. */
+  if ((v->scale & ((1UL << DM_VIEWPORT_SHIFT) - 1)) == 0) {
+    factor = v->scale >> DM_VIEWPORT_SHIFT;
+
+    dm_pixel_scale_nearest_bands(dm_get_pool(),
+                                 ((Uint8*) buffer->pixels
+                                  + rect->y * buffer->pitch
+                                  + rect->x * bpp),
+                                 buffer->pitch, dest, screen->pitch,
+                                 rect->w, rect->h, bpp, factor, factor);
+  } else {
+    dm_pixel_scale_table_bands(dm_get_pool(),
+                               (Uint8*) buffer->pixels, buffer->pitch,
+                               dest, screen->pitch, w, h, bpp,
+                               v->x_inverse + x, v->y_inverse + y);
+  }
+
+  if (SDL_MUSTLOCK(screen))
+    SDL_UnlockSurface(screen);
+
+  rect->x = x;
+  rect->y = y;
+  rect->w = w;
+  rect->h = h;
+}
+
+/* Look up part of the indexed buffer in the palette, into the low-res
+   backbuffer if there is one and the screen otherwise. */
+static void dm_sdl_expand(const SDL_Rect *rect)
+{
+  SDL_Surface *indexed, *dest;
+  unsigned int bpp;
+
+  indexed = _dm_gfxsdl->indexed;
+  dest = _dm_gfxsdl->lowres ? _dm_gfxsdl->lowres : _dm_gfxsdl->screen;
+  bpp = dest->format->BytesPerPixel;
+
+  if (SDL_MUSTLOCK(dest))
+    SDL_LockSurface(dest);
+
+  dm_blit_expand(((Uint8*) indexed->pixels
+                  + rect->y * indexed->pitch + rect->x),
+                 indexed->pitch,
+                 ((Uint8*) dest->pixels
+                  + rect->y * dest->pitch + rect->x * bpp),
+                 dest->pitch, rect->w, rect->h, bpp,
+                 _dm_gfxsdl->palette);
+
+  if (SDL_MUSTLOCK(dest))
+    SDL_UnlockSurface(dest);
+}
+
+/* Bring part of what is drawn to onto the screen, changing the
+   rectangle given to the part of the screen drawn to. */
+static void dm_sdl_present(SDL_Rect *rect)
+{
+  if (_dm_gfxsdl->indexed)
+    dm_sdl_expand(rect);
+
+  if (_dm_gfxsdl->lowres)
+    dm_sdl_enlarge(rect);
+}
+
+/* Map a colour to a pixel value of the target: in paletted mode, the
+   index of the closest palette entry. */
+static Uint32 dm_sdl_map_rgb(unsigned int r, unsigned int g,
+                             unsigned int b)
+{
+  if (_dm_gfxsdl->indexed)
+    return dm_palette_lookup(r, g, b);
+
+  return SDL_MapRGB(_dm_gfxsdl->target->format, r, g, b);
+}
+
+/* Remap a surface to logical palette indices, as a new 8-bit surface.
+   Transparent pixels become DM_PALETTE_KEY. */
+static SDL_Surface *dm_sdl_remap(SDL_Surface *surf)
+{
+  SDL_Surface *out, *wide;
+  SDL_PixelFormat *fmt;
+  SDL_Color *c;
+  dm_GfxPixelFormat format;
+  Uint8 map[DM_PALETTE_SIZE];
+  Uint8 *src, *dest;
+  int x, y, i;
+
+  fmt = surf->format;
+
+  /* 24-bit pixels are widened to the screen's format first. */
+  if (fmt->BytesPerPixel == 3) {
+    wide = SDL_ConvertSurface(surf, _dm_gfxsdl->screen->format,
+                              SDL_SWSURFACE);
+
+    if (wide == NULL)
+      return NULL;
+
+    out = dm_sdl_remap(wide);
+    SDL_FreeSurface(wide);
+    return out;
+  }
+
+  out = SDL_CreateRGBSurface(SDL_SWSURFACE, surf->w, surf->h, 8,
+                             0, 0, 0, 0);
+
+  if (out == NULL) {
+    dm_fatal("GFX-SDL: Couldn't create %dx%d indexed surface!",
+             surf->w, surf->h);
+    return NULL;
+  }
+
+  SDL_LockSurface(surf);
+
+  if (fmt->BytesPerPixel == 1) {
+    /* Paletted images only need their own palette remapping. */
+    for (i = 0; i < DM_PALETTE_SIZE; i++) {
+      c = &fmt->palette->colors[i < fmt->palette->ncolors ? i : 0];
+
+      if (((surf->flags & SDL_SRCCOLORKEY)
+           && (Uint32) i == fmt->colorkey)
+          || (c->r == 255 && c->g == 0 && c->b == 255))
+        map[i] = DM_PALETTE_KEY;
+      else
+        map[i] = dm_palette_lookup(c->r, c->g, c->b);
+    }
+
+    for (y = 0; y < surf->h; y++) {
+      src = (Uint8*) surf->pixels + y * surf->pitch;
+      dest = (Uint8*) out->pixels + y * out->pitch;
+
+      for (x = 0; x < surf->w; x++)
+        dest[x] = map[src[x]];
+    }
+  } else {
+    format.bits = fmt->BitsPerPixel;
+    format.rmask = fmt->Rmask;
+    format.gmask = fmt->Gmask;
+    format.bmask = fmt->Bmask;
+    format.amask = fmt->Amask;
+    format.keyed = surf->flags & SDL_SRCCOLORKEY;
+    format.key = fmt->colorkey;
+
+    dm_palette_remap(dm_get_pool(), (const Uint8*) surf->pixels,
+                     surf->pitch, (Uint8*) out->pixels, out->pitch,
+                     surf->w, surf->h, &format);
+  }
+
+  SDL_UnlockSurface(surf);
+
+  return out;
 }
@@ -32,6 +32,27 @@ typedef struct dm_GfxSDLData dm_GfxSDLData;
 
 struct dm_GfxSDLData {
   struct SDL_Surface *screen; /**< Pointer to the screen SDL surface. */
+  struct SDL_Surface *target; /**< Surface drawn to: the screen, the
+                                 low-res backbuffer, or the indexed
+                                 buffer. */
+  struct SDL_Surface *lowres; /**< The low-res backbuffer, in the
+                                 screen's format, or NULL. */
+  struct SDL_Surface *indexed; /**< 8-bit buffer of logical palette
+                                  indices drawn to in paletted mode,
+                                  or NULL. */
+  const dm_GfxViewport *viewport; /**< Enlargement from the
+                                     backbuffer to the screen, if
+                                     there is one. */
+  unsigned int palette[DM_PALETTE_SIZE]; /**< Screen pixel value of
+                                            each logical palette
+                                            entry. */
+  struct dm_Pool *render_pool; /**< Render threads that batches are
+                                  split between, or NULL. */
+  dm_GfxBandTiming bands[DM_GFX_BANDS_MAX]; /**< Timings of the bands
+                                               the last batch was
+                                               drawn in. */
+  int band_count;             /**< Number of entries in bands, or 0 if
+                                 the last batch was not split. */
 };
 
 /** Register the SDL driver.
@@ -74,6 +95,30 @@ void dm_gfx_sdl_cleanup(void);
 void *dm_sdl_load_image_data(const char filename[]);
 
 
+/** Decode an image file into a SDL surface, without preparing it for
+ *  drawing.
+ *
+ *  This is safe to call from any thread.
+ *
+ *  @param filename  Name of the file to load.
+ *
+ *  @return  a void pointer to the SDL surface, or NULL on failure.
+ */
+void *dm_sdl_decode_image_data(const char filename[]);
+
+
+/** Prepare a decoded SDL surface for drawing.
+ *
+ *  This must be called on the main thread.
+ *
+ *  @param decoded  A void pointer to a surface from
+ *                  dm_sdl_decode_image_data.
+ *
+ *  @return  a void pointer to the prepared SDL surface.
+ */
+void *dm_sdl_finish_image_data(void *decoded);
+
+
 /** Free an image as a SDL surface.
  *
  *  @param data  A void pointer to the SDL surface to free.
@@ -81,6 +126,98 @@ void *dm_sdl_load_image_data(const char filename[]);
 void dm_sdl_free_image_data(void *data);
 
 
+/** Create a blank, fully transparent SDL surface in the screen
+ *  format.
+ *
+ *  @param width   Width of the surface.
+ *  @param height  Height of the surface.
+ *
+ *  @return  a void pointer to the SDL surface, or NULL on failure.
+ */
+void *dm_sdl_create_image_data(unsigned int width, unsigned int height);
+
+
+/** Copy pixels verbatim from one SDL surface to another.
+ *
+ *  Colour keys are copied as ordinary pixels, so a keyed source stays
+ *  keyed in a destination with the same key.  Sources with
+ *  translucent pixels are refused, as the destination cannot hold
+ *  per-pixel alpha.
+ *
+ *  @param dest    A void pointer to the destination SDL surface.
+ *  @param src     A void pointer to the source SDL surface.
+ *  @param src_x   X co-ordinate of the rectangle in the source.
+ *  @param src_y   Y co-ordinate of the rectangle in the source.
+ *  @param dest_x  X co-ordinate of the rectangle in the destination.
+ *  @param dest_y  Y co-ordinate of the rectangle in the destination.
+ *  @param width   Width of the rectangle.
+ *  @param height  Height of the rectangle.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+int dm_sdl_copy_image_data(void *dest,
+                           void *src,
+                           unsigned int src_x,
+                           unsigned int src_y,
+                           unsigned int dest_x,
+                           unsigned int dest_y,
+                           unsigned int width,
+                           unsigned int height);
+
+
+/** Retrieve the size of an SDL surface.
+ *
+ *  @param data    A void pointer to the SDL surface.
+ *  @param width   Pointer to store the width in.
+ *  @param height  Pointer to store the height in.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+int dm_sdl_image_data_size(void *data,
+                           unsigned int *width,
+                           unsigned int *height);
+
+
+/** Get the memory used by a SDL surface's pixels.
+ *
+ *  @param data  A void pointer to the SDL surface.
+ *
+ *  @return  the size of the surface's pixels, in bytes.
+ */
+unsigned long dm_sdl_image_data_bytes(void *data);
+
+
+/** Create a copy of a SDL surface enlarged by integer factors, using
+ *  nearest neighbour sampling.
+ *
+ *  @param data      A void pointer to the SDL surface.
+ *  @param x_factor  Horizontal enlargement factor.
+ *  @param y_factor  Vertical enlargement factor.
+ *
+ *  @return  a void pointer to the new SDL surface, or NULL on failure.
+ */
+void *dm_sdl_scale_image_data(void *data,
+                              unsigned int x_factor,
+                              unsigned int y_factor);
+
+
+/** Create a SDL surface that uses the given pixels in place.
+ *
+ *  @param pixels  The pixels, which must outlive the surface.
+ *  @param width   Width of the image, in pixels.
+ *  @param height  Height of the image, in pixels.
+ *  @param pitch   Bytes from one row of pixels to the next.
+ *  @param format  The format of the pixels.
+ *
+ *  @return  a void pointer to the SDL surface, or NULL on failure.
+ */
+void *dm_sdl_image_data_from_pixels(const void *pixels,
+                                    unsigned int width,
+                                    unsigned int height,
+                                    unsigned int pitch,
+                                    const dm_GfxPixelFormat *format);
+
+
 /** Draw an image on-screen using SDL.
  *
  *  @see dm_draw_image
@@ -106,6 +243,107 @@ int dm_sdl_draw_image(struct dm_GfxImageNode *image,
                       unsigned int width,
                       unsigned int height);
 
+/** Present only the given regions of the screen using SDL.
+ *
+ *  @param rects  The regions to present.
+ *  @param count  The number of regions.
+ */
+void dm_sdl_update_rects(const dm_GfxRect *rects, int count);
+
+
+/** Draw into a low-res backbuffer rather than the screen, enlarging
+ *  it onto the screen when presenting.
+ *
+ *  @param width   Width of the backbuffer.
+ *  @param height  Height of the backbuffer.
+ *  @param viewport  How the backbuffer maps onto the screen.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE if the enlarged
+ *           backbuffer does not fit the screen or cannot be created.
+ */
+int dm_sdl_init_lowres_buffer(unsigned int width,
+                              unsigned int height,
+                              const dm_GfxViewport *viewport);
+
+
+/** Draw 8-bit logical palette indices into a buffer the size of
+ *  what is drawn to, looking them up in the palette when presenting.
+ *
+ *  Images loaded from then on are remapped to the palette.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE if the screen is not
+ *           16- or 32-bit or the buffer cannot be created.
+ */
+int dm_sdl_init_paletted(void);
+
+
+/** Allow drawing and presenting from a render thread.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE if the screen is a
+ *           hardware surface.
+ */
+int dm_sdl_init_render_thread(void);
+
+
+/** Change entries of the logical palette using SDL.
+ *
+ *  @see dm_palette_set
+ *
+ *  @param colours  The new colours of the entries.
+ *  @param first    Index of the first entry to change.
+ *  @param count    Number of entries to change.
+ */
+void dm_sdl_set_palette(const dm_GfxColour colours[],
+                        unsigned int first,
+                        unsigned int count);
+
+
+/** Draw a batch of queued commands using SDL.
+ *
+ *  @see dm_queue_flush
+ *
+ *  @param cmds   The commands, in the order to draw them.
+ *  @param count  The number of commands.
+ */
+void dm_sdl_submit_batch(const dm_GfxCommand *cmds, unsigned long count);
+
+/** Retrieve the timings of the bands the last batch was drawn in.
+ *
+ *  @see dm_gfx_band_timings
+ *
+ *  @param timings  Array to fill with the timings, top band first.
+ *  @param max      Number of entries in timings.
+ *
+ *  @return the number of entries filled.
+ */
+int dm_sdl_band_timings(dm_GfxBandTiming timings[], int max);
+
+/** Read back part of the last frame presented.
+ *
+ *  @see dm_record_start
+ *
+ *  @param rect  The region to read, in the co-ordinates drawn to.
+ *  @param dest  Buffer to store the pixels in, as red, green and blue
+ *               bytes, row after row.
+ *
+ *  @return DM_SUCCESS.
+ */
+int dm_sdl_read_pixels(const dm_GfxRect *rect, unsigned char *dest);
+
+/** Prepare image data to be drawn with a blend mode.
+ *
+ *  Images for the alpha modes are converted to 32-bit pixels in the
+ *  target's format, with premultiplied alpha in the top byte, for
+ *  DISMAL's blitters to blend.
+ *
+ *  @param data   The image data, as loaded.
+ *  @param blend  The blend mode (one of the DM_BLEND_ modes).
+ *
+ *  @return the prepared image data, which replaces data, or NULL if
+ *  the mode is unknown or the target's format cannot be blended.
+ */
+void *dm_sdl_blend_image_data(void *data, int blend);
+
 /** Fill a rectangle with the given RGB colour using SDL.
  *
  *  @see dm_fill_rect_rgb
@@ -126,4 +364,23 @@ void dm_sdl_fill_rect_rgb(unsigned int x,
                           unsigned int g,
                           unsigned int b);
 
+
+/** Fill a rectangle with a logical palette entry using SDL.
+ *
+ *  @see dm_fill_rect_pal
+ *
+ *  @param x      X co-ordinate of the top-left corner of the
+ *                rectangle.
+ *  @param y      Y co-ordinate of the top-left corner of the
+ *                rectangle.
+ *  @param w      Width of the rectangle.
+ *  @param h      Height of the rectangle.
+ *  @param index  Index of the palette entry to fill with.
+ */
+void dm_sdl_fill_rect_pal(unsigned int x,
+                          unsigned int y,
+                          unsigned int w,
+                          unsigned int h,
+                          unsigned int index);
+
 #endif /* __DM_GFX_H__ */
@@ -0,0 +1,548 @@
+/** @file     gfx/dm-gfx-sheet.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Sprite sheets and frame animation.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-sheet.h"
+
+static dm_SpriteSheet *dm_sheet_new (dm_ImageHandle image);
+static int dm_sheet_add_grid (dm_SpriteSheet *sheet,
+                              unsigned short frame_w,
+                              unsigned short frame_h,
+                              int cols,
+                              int count,
+                              unsigned short x,
+                              unsigned short y);
+static int dm_sheet_add_anim (dm_SpriteSheet *sheet,
+                              const char name[],
+                              unsigned long frame_ms,
+                              unsigned char flags,
+                              char *frames);
+static int dm_sheet_parse (dm_SpriteSheet **sheetp, char *line);
+static int dm_sheet_translate (dm_SpriteSheet *sheet);
+
+static dm_SpriteSheet *
+dm_sheet_new (dm_ImageHandle image)
+{
+  dm_SpriteSheet *sheet;
+
+  sheet = malloc (sizeof (dm_SpriteSheet));
+
+  if (sheet == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate sprite sheet.");
+      return NULL;
+    }
+
+  sheet->image = image;
+  sheet->frame_count = 0;
+  sheet->frames = NULL;
+  sheet->translated = NULL;
+  sheet->anim_count = 0;
+  sheet->anims = NULL;
+  sheet->sequences = NULL;
+
+  return sheet;
+}
+
+static int
+dm_sheet_add_grid (dm_SpriteSheet *sheet,
+                   unsigned short frame_w,
+                   unsigned short frame_h,
+                   int cols,
+                   int count,
+                   unsigned short x,
+                   unsigned short y)
+{
+  dm_SheetRect *frames;
+  int i;
+
+  if (cols <= 0 || count <= 0)
+    {
+      dm_fatal ("GFX: Sprite sheet grid dimensions must be positive.");
+      return DM_FAILURE;
+    }
+
+  frames = realloc (sheet->frames, ((size_t) sheet->frame_count + count)
+                                   * sizeof (dm_SheetRect));
+
+  if (frames == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate sprite sheet frames.");
+      return DM_FAILURE;
+    }
+
+  sheet->frames = frames;
+  frames += sheet->frame_count;
+
+  for (i = 0; i < count; i++)
+    {
+      frames[i].x = (unsigned short) (x + (i % cols) * frame_w);
+      frames[i].y = (unsigned short) (y + (i / cols) * frame_h);
+      frames[i].w = frame_w;
+      frames[i].h = frame_h;
+    }
+
+  sheet->frame_count += count;
+  return DM_SUCCESS;
+}
+
+static int
+dm_sheet_add_anim (dm_SpriteSheet *sheet,
+                   const char name[],
+                   unsigned long frame_ms,
+                   unsigned char flags,
+                   char *frames)
+{
+  dm_SheetAnim *anims, *anim;
+  int *sequences;
+  int first, length, frame;
+  char *token;
+
+  if (strlen (name) >= DM_SHEET_NAME_LEN)
+    {
+      dm_fatal ("GFX: Animation name %s is too long.", name);
+      return DM_FAILURE;
+    }
+
+  anims = realloc (sheet->anims, ((size_t) sheet->anim_count + 1)
+                                 * sizeof (dm_SheetAnim));
+
+  if (anims == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate animation.");
+      return DM_FAILURE;
+    }
+
+  sheet->anims = anims;
+
+  /* Animations lie one after another in the sequences. */
+  first = 0;
+  if (sheet->anim_count > 0)
+    first = anims[sheet->anim_count - 1].first
+      + anims[sheet->anim_count - 1].length;
+
+  length = 0;
+
+  for (token = strtok (frames, " \t"); token != NULL;
+       token = strtok (NULL, " \t"))
+    {
+      frame = atoi (token);
+
+      if (frame < 0 || frame >= sheet->frame_count)
+        {
+          dm_fatal ("GFX: Animation %s has no frame %s.", name, token);
+          return DM_FAILURE;
+        }
+
+      sequences = realloc (sheet->sequences,
+                           ((size_t) first + length + 1) * sizeof (int));
+
+      if (sequences == NULL)
+        {
+          dm_fatal ("GFX: Could not allocate animation frames.");
+          return DM_FAILURE;
+        }
+
+      sheet->sequences = sequences;
+      sequences[first + length] = frame;
+      length++;
+    }
+
+  if (length == 0)
+    {
+      dm_fatal ("GFX: Animation %s has no frames.", name);
+      return DM_FAILURE;
+    }
+
+  anim = &anims[sheet->anim_count];
+  strcpy (anim->name, name);
+  anim->first = first;
+  anim->length = length;
+  anim->frame_us = frame_ms * 1000;
+  anim->flags = flags;
+
+  sheet->anim_count++;
+  return DM_SUCCESS;
+}
+
+static int
+dm_sheet_parse (dm_SpriteSheet **sheetp, char *line)
+{
+  char *directive;
+  char name[DM_SHEET_LINE_LEN];
+  char mode[DM_SHEET_LINE_LEN];
+  unsigned int w, h, x, y;
+  unsigned long ms;
+  int cols, count, end, fields;
+  dm_ImageHandle image;
+
+  directive = strtok (line, " \t");
+  line = strtok (NULL, "");
+
+  if (line == NULL)
+    line = (char *) "";
+
+  if (strcmp (directive, "image") == 0)
+    {
+      if (*sheetp != NULL)
+        {
+          dm_fatal ("GFX: Sprite sheet has more than one image.");
+          return DM_FAILURE;
+        }
+
+      /* The name runs to the end of the line, which has no trailing
+         whitespace. */
+      line += strspn (line, " \t");
+      image = dm_image_acquire (line);
+
+      if (image == DM_IMAGE_NONE)
+        return DM_FAILURE;
+
+      *sheetp = dm_sheet_new (image);
+      return (*sheetp == NULL ? DM_FAILURE : DM_SUCCESS);
+    }
+
+  if (*sheetp == NULL)
+    {
+      dm_fatal ("GFX: Sprite sheet must name its image first.");
+      return DM_FAILURE;
+    }
+
+  if (strcmp (directive, "grid") == 0)
+    {
+      x = y = 0;
+      fields = sscanf (line, "%u %u %d %d %u %u", &w, &h, &cols, &count,
+                       &x, &y);
+
+      if (fields == 4 || fields == 6)
+        return dm_sheet_add_grid (*sheetp,
+                                  (unsigned short) w, (unsigned short) h,
+                                  cols, count,
+                                  (unsigned short) x, (unsigned short) y);
+    }
+  else if (strcmp (directive, "frame") == 0)
+    {
+      if (sscanf (line, "%u %u %u %u", &x, &y, &w, &h) == 4)
+        return dm_sheet_add_grid (*sheetp,
+                                  (unsigned short) w, (unsigned short) h,
+                                  1, 1,
+                                  (unsigned short) x, (unsigned short) y);
+    }
+  else if (strcmp (directive, "anim") == 0)
+    {
+      end = 0;
+      sscanf (line, "%s %lu %s %n", name, &ms, mode, &end);
+
+      if (end > 0 && strcmp (mode, "loop") == 0)
+        return dm_sheet_add_anim (*sheetp, name, ms, DM_ANIM_LOOP,
+                                  line + end);
+      if (end > 0 && strcmp (mode, "once") == 0)
+        return dm_sheet_add_anim (*sheetp, name, ms, 0, line + end);
+    }
+  else
+    {
+      dm_fatal ("GFX: Unknown sprite sheet directive %s.", directive);
+      return DM_FAILURE;
+    }
+
+  dm_fatal ("GFX: Malformed sprite sheet %s directive.", directive);
+  return DM_FAILURE;
+}
+
+static int
+dm_sheet_translate (dm_SpriteSheet *sheet)
+{
+  dm_SheetRect *t;
+  int i;
+
+  sheet->translated = malloc ((size_t) sheet->frame_count
+                              * sizeof (dm_SheetRect));
+
+  if (sheet->translated == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate sprite sheet frames.");
+      return DM_FAILURE;
+    }
+
+  memcpy (sheet->translated, sheet->frames,
+          (size_t) sheet->frame_count * sizeof (dm_SheetRect));
+
+  for (i = 0, t = sheet->translated; i < sheet->frame_count; i++, t++)
+    {
+      dm_coord_translate (&t->x, &t->y, DM_FALSE);
+      dm_coord_translate (&t->w, &t->h, DM_FALSE);
+    }
+
+  return DM_SUCCESS;
+}
+
+dm_SpriteSheet *
+dm_sheet_create_grid (dm_ImageHandle image,
+                      unsigned short frame_w,
+                      unsigned short frame_h,
+                      int cols,
+                      int count)
+{
+  dm_SpriteSheet *sheet;
+
+  sheet = dm_sheet_new (image);
+
+  if (sheet == NULL)
+    return NULL;
+
+  if (dm_sheet_add_grid (sheet, frame_w, frame_h, cols, count, 0, 0)
+      == DM_FAILURE
+      || dm_sheet_translate (sheet) == DM_FAILURE)
+    {
+      dm_sheet_destroy (sheet);
+      return NULL;
+    }
+
+  return sheet;
+}
+
+dm_SpriteSheet *
+dm_sheet_load (const char filename[])
+{
+  FILE *file;
+  char line[DM_SHEET_LINE_LEN];
+  char *p;
+  dm_SpriteSheet *sheet;
+  int result;
+
+  file = fopen (filename, "r");
+
+  if (file == NULL)
+    {
+      dm_fatal ("GFX: Could not open sprite sheet %s.", filename);
+      return NULL;
+    }
+
+  sheet = NULL;
+  result = DM_SUCCESS;
+
+  while (result == DM_SUCCESS && fgets (line, sizeof (line), file))
+    {
+      /* Strip the line ending and any whitespace around the line. */
+      for (p = line; *p != '\0' && *p != '\n' && *p != '\r'; p++)
+        ;
+      while (p > line && (p[-1] == ' ' || p[-1] == '\t'))
+        p--;
+      *p = '\0';
+
+      p = line + strspn (line, " \t");
+
+      if (*p == '\0' || *p == '#')
+        continue;
+
+      result = dm_sheet_parse (&sheet, p);
+    }
+
+  fclose (file);
+
+  if (result == DM_SUCCESS && (sheet == NULL || sheet->frame_count == 0))
+    {
+      dm_fatal ("GFX: Sprite sheet %s has no frames.", filename);
+      result = DM_FAILURE;
+    }
+
+  if (result == DM_SUCCESS)
+    result = dm_sheet_translate (sheet);
+
+  if (result == DM_FAILURE)
+    {
+      dm_sheet_destroy (sheet);
+      return NULL;
+    }
+
+  return sheet;
+}
+
+void
+dm_sheet_destroy (dm_SpriteSheet *sheet)
+{
+  if (sheet == NULL)
+    return;
+
+  free (sheet->frames);
+  free (sheet->translated);
+  free (sheet->anims);
+  free (sheet->sequences);
+  free (sheet);
+}
+
+int
+dm_sheet_find_anim (const dm_SpriteSheet *sheet, const char name[])
+{
+  int i;
+
+  for (i = 0; i < sheet->anim_count; i++)
+    if (strcmp (sheet->anims[i].name, name) == 0)
+      return i;
+
+  return -1;
+}
+
+int
+dm_sheet_draw (const dm_SpriteSheet *sheet,
+               int frame,
+               unsigned short screen_x,
+               unsigned short screen_y)
+{
+  struct dm_GfxImageNode *img;
+  const dm_SheetRect *t;
+
+  if (frame < 0 || frame >= sheet->frame_count)
+    return DM_FAILURE;
+
+  img = dm_image_node (sheet->image);
+
+  if (img == NULL)
+    return DM_FAILURE;
+
+  img = dm_image_drawable (img);
+
+  if (img == NULL)
+    return DM_FAILURE;
+
+  /* Only the screen position is left to translate. */
+  t = &sheet->translated[frame];
+  dm_coord_translate (&screen_x, &screen_y, DM_TRUE);
+
+  return dm_draw_image_translated (img, t->x, t->y, screen_x, screen_y,
+                                   t->w, t->h);
+}
+
+int
+dm_sheet_set_sprite (const dm_SpriteSheet *sheet,
+                     int frame,
+                     dm_Sprite sprite)
+{
+  const dm_SheetRect *f;
+
+  if (frame < 0 || frame >= sheet->frame_count)
+    return DM_FAILURE;
+
+  /* Sprites keep drawing coordinates, so they can redraw parts of
+     themselves. */
+  f = &sheet->frames[frame];
+  dm_sprite_set_image (sprite, sheet->image);
+  dm_sprite_set_rect (sprite, f->x, f->y, f->w, f->h);
+
+  return DM_SUCCESS;
+}
+
+int
+dm_anim_start (dm_Anim *player,
+               const dm_SpriteSheet *sheet,
+               int anim)
+{
+  if (anim < 0 || anim >= sheet->anim_count)
+    return DM_FAILURE;
+
+  player->sheet = sheet;
+  player->anim = anim;
+  player->step = 0;
+  player->started = DM_FALSE;
+  player->start = 0;
+
+  return DM_SUCCESS;
+}
+
+int
+dm_anim_update (dm_Anim *player, unsigned long now)
+{
+  const dm_SheetAnim *anim;
+  unsigned long elapsed, period;
+  int step;
+
+  anim = &player->sheet->anims[player->anim];
+
+  if (player->started == DM_FALSE)
+    {
+      player->started = DM_TRUE;
+      player->start = now;
+    }
+
+  /* The clock wraps, but the difference between readings does
+     not. */
+  elapsed = now - player->start;
+
+  if (anim->frame_us == 0)
+    step = anim->length - 1;
+  else if (anim->flags & DM_ANIM_LOOP)
+    {
+      /* Move the start up to the current run, so the elapsed time
+         stays well short of wrapping however long the loop plays. */
+      period = anim->frame_us * anim->length;
+      player->start += elapsed - elapsed % period;
+      step = (int) ((elapsed % period) / anim->frame_us);
+    }
+  else if (elapsed / anim->frame_us >= (unsigned long) anim->length)
+    step = anim->length - 1;
+  else
+    step = (int) (elapsed / anim->frame_us);
+
+  if (step == player->step)
+    return DM_FALSE;
+
+  player->step = step;
+  return DM_TRUE;
+}
+
+int
+dm_anim_frame (const dm_Anim *player)
+{
+  const dm_SheetAnim *anim;
+
+  anim = &player->sheet->anims[player->anim];
+  return player->sheet->sequences[anim->first + player->step];
+}
+
+int
+dm_anim_finished (const dm_Anim *player)
+{
+  const dm_SheetAnim *anim;
+
+  anim = &player->sheet->anims[player->anim];
+  return (!(anim->flags & DM_ANIM_LOOP)
+          && player->step == anim->length - 1);
+}
+
+int
+dm_anim_draw (const dm_Anim *player,
+              unsigned short screen_x,
+              unsigned short screen_y)
+{
+  return dm_sheet_draw (player->sheet, dm_anim_frame (player),
+                        screen_x, screen_y);
+}
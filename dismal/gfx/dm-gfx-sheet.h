@@ -0,0 +1,276 @@
+/** @file     gfx/dm-gfx-sheet.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Sprite sheets and frame animation.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_SHEET_H__
+#define __DM_GFX_SHEET_H__
+
+#include "../dismal.h"
+
+enum {
+  DM_SHEET_LINE_LEN = 256,  /**< Longest line of a sheet file,
+                               including the line ending. */
+  DM_SHEET_NAME_LEN = 32,   /**< Longest animation name, including
+                               the terminator. */
+
+  /* Animation flags. */
+  DM_ANIM_LOOP = (1<<0)     /**< Start again after the last frame,
+                               rather than stopping on it. */
+};
+
+typedef struct dm_SheetRect dm_SheetRect;
+typedef struct dm_SheetAnim dm_SheetAnim;
+typedef struct dm_SpriteSheet dm_SpriteSheet;
+typedef struct dm_Anim dm_Anim;
+
+/** A rectangle of a sprite sheet's image. */
+struct dm_SheetRect
+{
+  unsigned short x;         /**< X coordinate of the rectangle. */
+  unsigned short y;         /**< Y coordinate of the rectangle. */
+  unsigned short w;         /**< Width of the rectangle. */
+  unsigned short h;         /**< Height of the rectangle. */
+};
+
+/** A named sequence of a sprite sheet's frames. */
+struct dm_SheetAnim
+{
+  char name[DM_SHEET_NAME_LEN]; /**< Name of the animation. */
+  int first;                /**< Index in the sheet's sequences of
+                               the animation's first frame. */
+  int length;               /**< Number of frames in the animation. */
+  unsigned long frame_us;   /**< How long each frame is shown, in
+                               microseconds. */
+  unsigned char flags;      /**< DM_ANIM_* flags. */
+};
+
+/** An image cut into numbered frames, with named animations over
+ *  them.
+ *
+ *  Each frame's rectangle is kept both in drawing coordinates and
+ *  translated, once, when the sheet is created, so drawing a frame
+ *  only has to translate where it goes on-screen.  Sheets must
+ *  therefore be created after the graphics subsystem is
+ *  initialised.
+ */
+struct dm_SpriteSheet
+{
+  dm_ImageHandle image;     /**< Image holding the frames. */
+  int frame_count;          /**< Number of frames. */
+  dm_SheetRect *frames;     /**< Rectangle of each frame, in drawing
+                               coordinates. */
+  dm_SheetRect *translated; /**< Rectangle of each frame, translated. */
+  int anim_count;           /**< Number of animations. */
+  dm_SheetAnim *anims;      /**< The animations. */
+  int *sequences;           /**< Frame numbers of every animation,
+                               one after another. */
+};
+
+/** A player for one of a sprite sheet's animations.
+ *
+ *  Players belong to the caller, and may be embedded in other
+ *  structures; they hold nothing that needs freeing.
+ */
+struct dm_Anim
+{
+  const dm_SpriteSheet *sheet; /**< Sheet the animation is from. */
+  int anim;                 /**< Index of the animation. */
+  int step;                 /**< Position in the animation of the
+                               current frame. */
+  int started;              /**< Non-zero once the player has seen
+                               the clock. */
+  unsigned long start;      /**< Clock reading at which the
+                               current run of the animation began. */
+};
+
+
+/** Create a sprite sheet whose frames lie in a grid.
+ *
+ *  Frame n is the n-th frame-sized cell of the image, counting along
+ *  rows of cols frames.  The sheet has no animations.
+ *
+ *  @param image    The image holding the frames.
+ *  @param frame_w  The width of each frame.
+ *  @param frame_h  The height of each frame.
+ *  @param cols     The number of frames in each row of the image.
+ *  @param count    The number of frames.
+ *
+ *  @return  the new sheet, or NULL if it could not be created.
+ */
+
+dm_SpriteSheet *dm_sheet_create_grid(dm_ImageHandle image,
+                                     unsigned short frame_w,
+                                     unsigned short frame_h,
+                                     int cols,
+                                     int count);
+
+
+/** Load a sprite sheet from a sheet file.
+ *
+ *  A sheet file is a text file of one directive per line, with any
+ *  whitespace around it ignored; blank lines and lines starting with
+ *  '#' are ignored too.  The directives are:
+ *
+ *  - image FILENAME: the image holding the frames, which is acquired
+ *    with dm_image_acquire().  This must come first.
+ *  - grid W H COLS COUNT [X Y]: add COUNT frames of W by H, laid out
+ *    in rows of COLS from (X, Y), or the image's corner.
+ *  - frame X Y W H: add one frame.
+ *  - anim NAME MS loop|once FRAME...: add an animation showing the
+ *    numbered frames for MS milliseconds each.
+ *
+ *  Frames are numbered from 0 in the order they are added.
+ *
+ *  @param filename  The path to the sheet file.
+ *
+ *  @return  the new sheet, or NULL if it could not be loaded.
+ */
+
+dm_SpriteSheet *dm_sheet_load(const char filename[]);
+
+
+/** Destroy a sprite sheet.
+ *
+ *  This does not release the sheet's image.  Players of the sheet's
+ *  animations must not be used afterwards.
+ *
+ *  @param sheet  The sheet to destroy.
+ */
+
+void dm_sheet_destroy(dm_SpriteSheet *sheet);
+
+
+/** Find one of a sprite sheet's animations by name.
+ *
+ *  @param sheet  The sheet.
+ *  @param name   The animation's name.
+ *
+ *  @return  the animation's index, or -1 if there is no such
+ *           animation.
+ */
+
+int dm_sheet_find_anim(const dm_SpriteSheet *sheet, const char name[]);
+
+
+/** Draw a frame of a sprite sheet.
+ *
+ *  @param sheet     The sheet.
+ *  @param frame     The frame number.
+ *  @param screen_x  The X-coordinate on-screen to draw the frame at.
+ *  @param screen_y  The Y-coordinate on-screen to draw the frame at.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE otherwise (for
+ *           example, if there is no such frame).
+ */
+
+int dm_sheet_draw(const dm_SpriteSheet *sheet,
+                  int frame,
+                  unsigned short screen_x,
+                  unsigned short screen_y);
+
+
+/** Show a frame of a sprite sheet on a sprite.
+ *
+ *  @param sheet   The sheet.
+ *  @param frame   The frame number.
+ *  @param sprite  The sprite to change.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE if there is no such
+ *           frame.
+ */
+
+int dm_sheet_set_sprite(const dm_SpriteSheet *sheet,
+                        int frame,
+                        dm_Sprite sprite);
+
+
+/** Start playing an animation from its first frame.
+ *
+ *  The animation's clock starts at the player's next dm_anim_update().
+ *
+ *  @param player  The player.
+ *  @param sheet   The sheet the animation is from.
+ *  @param anim    The index of the animation (see
+ *                 dm_sheet_find_anim()).
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE if there is no such
+ *           animation.
+ */
+
+int dm_anim_start(dm_Anim *player,
+                  const dm_SpriteSheet *sheet,
+                  int anim);
+
+
+/** Move an animation on to the frame due at a given time.
+ *
+ *  Frames are worked out from the time since the animation started,
+ *  so they never drift however often this is called.
+ *
+ *  @param player  The player.
+ *  @param now     The time, as read from dm_time_us().
+ *
+ *  @return  non-zero if the frame changed.
+ */
+
+int dm_anim_update(dm_Anim *player, unsigned long now);
+
+
+/** Get the frame an animation is showing.
+ *
+ *  @param player  The player.
+ *
+ *  @return  the frame number in the player's sheet.
+ */
+
+int dm_anim_frame(const dm_Anim *player);
+
+
+/** Find whether an animation that does not loop has reached its last
+ *  frame.
+ *
+ *  @param player  The player.
+ *
+ *  @return  non-zero if the animation has finished.
+ */
+
+int dm_anim_finished(const dm_Anim *player);
+
+
+/** Draw the frame an animation is showing.
+ *
+ *  @param player    The player.
+ *  @param screen_x  The X-coordinate on-screen to draw the frame at.
+ *  @param screen_y  The Y-coordinate on-screen to draw the frame at.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_anim_draw(const dm_Anim *player,
+                 unsigned short screen_x,
+                 unsigned short screen_y);
+
+#endif /* __DM_GFX_SHEET_H__ */
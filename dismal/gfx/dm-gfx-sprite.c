@@ -0,0 +1,779 @@
+/** @file     gfx/dm-gfx-sprite.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Retained-mode sprite layer.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+/* Sprites are kept from frame to frame, and the setters note which
+   ones actually changed.  Each frame, the rectangles a changed sprite
+   left and now covers are damaged; every sprite drawn over a damaged
+   rectangle is found through a uniform grid of screen cells, and
+   redrawn, clipped to it, over the background colour.  Sprites that
+   did not change, and do not overlap one that did, cost nothing. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-sprite.h"
+
+enum {
+  DM_GFX_SPRITE_CELL_INIT = 4,  /**< Initial size of a cell's sprite
+                                   list. */
+  DM_GFX_SPRITE_DAMAGE_INIT = 32 /**< Initial size of the damage
+                                    list. */
+};
+
+static int dm_sprite_valid(dm_Sprite sprite);
+static void dm_sprite_touch(dm_Sprite sprite);
+static int dm_sprite_grow(void);
+static void *dm_sprite_carve(char **block, size_t size);
+static void dm_sprite_cell_range(unsigned short x, unsigned short y,
+                                 unsigned short w, unsigned short h,
+                                 int *cx0, int *cy0,
+                                 int *cx1, int *cy1);
+static int dm_sprite_grid_insert(dm_Sprite sprite);
+static void dm_sprite_grid_remove(dm_Sprite sprite);
+static int dm_sprite_damage(const dm_GfxRect *rect);
+static void dm_sprite_redraw(const dm_GfxRect *rect);
+static int dm_sprite_overlap(const dm_GfxRect *a, const dm_GfxRect *b);
+static void dm_sprite_union(dm_GfxRect *a, const dm_GfxRect *b);
+static int dm_sprite_compare(const void *a, const void *b);
+
+int
+dm_sprite_init (void)
+{
+  dm_GfxSprites *s;
+
+  s = calloc (1, sizeof (dm_GfxSprites));
+
+  if (s == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate sprite store.");
+      return DM_FAILURE;
+    }
+
+  s->free_list = DM_SPRITE_NONE;
+  s->cells_w = ((dm_gfxdata->width + DM_GFX_SPRITE_CELL - 1)
+                 / DM_GFX_SPRITE_CELL);
+  s->cells_h = ((dm_gfxdata->height + DM_GFX_SPRITE_CELL - 1)
+                 / DM_GFX_SPRITE_CELL);
+
+  if (s->cells_w == 0)
+    s->cells_w = 1;
+  if (s->cells_h == 0)
+    s->cells_h = 1;
+
+  s->cells = calloc ((size_t) s->cells_w * s->cells_h,
+                     sizeof (dm_GfxSpriteCell));
+
+  if (s->cells == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate sprite grid.");
+      free (s);
+      return DM_FAILURE;
+    }
+
+  dm_gfxdata->sprites = s;
+  return DM_SUCCESS;
+}
+
+void
+dm_sprite_cleanup (void)
+{
+  dm_GfxSprites *s;
+  int i;
+
+  s = dm_gfxdata->sprites;
+
+  if (s == NULL)
+    return;
+
+  for (i = 0; i < s->cells_w * s->cells_h; i++)
+    {
+      if (s->cells[i].sprites)
+        free (s->cells[i].sprites);
+    }
+
+  free (s->cells);
+
+  if (s->block)
+    free (s->block);
+  if (s->damage)
+    free (s->damage);
+
+  free (s);
+  dm_gfxdata->sprites = NULL;
+}
+
+dm_Sprite
+dm_sprite_create (dm_ImageHandle image,
+                  unsigned short image_x,
+                  unsigned short image_y,
+                  unsigned short width,
+                  unsigned short height,
+                  unsigned short screen_x,
+                  unsigned short screen_y)
+{
+  dm_GfxSprites *s;
+  dm_Sprite i;
+
+  s = dm_gfxdata->sprites;
+
+  /* Reuse a destroyed sprite if there is one. */
+  if (s->free_list != DM_SPRITE_NONE)
+    {
+      i = s->free_list;
+      s->free_list = s->next_free[i];
+    }
+  else
+    {
+      if (s->count == s->max && dm_sprite_grow () == DM_FAILURE)
+        {
+          dm_fatal ("GFX: Could not grow sprite store.");
+          return DM_SPRITE_NONE;
+        }
+
+      i = s->count++;
+    }
+
+  s->image[i] = image;
+  s->image_x[i] = image_x;
+  s->image_y[i] = image_y;
+  s->width[i] = width;
+  s->height[i] = height;
+  s->x[i] = screen_x;
+  s->y[i] = screen_y;
+  s->stamp[i] = 0;
+  s->flags[i] = DM_SPRITE_LIVE | DM_SPRITE_VISIBLE;
+
+  dm_sprite_touch (i);
+  return i;
+}
+
+void
+dm_sprite_destroy (dm_Sprite sprite)
+{
+  if (dm_sprite_valid (sprite) == DM_FALSE)
+    return;
+
+  /* The sprite is only put up for reuse once the next frame has
+     removed it from the screen. */
+  dm_gfxdata->sprites->flags[sprite] &= ~DM_SPRITE_LIVE;
+  dm_sprite_touch (sprite);
+}
+
+void
+dm_sprite_set_image (dm_Sprite sprite, dm_ImageHandle image)
+{
+  dm_GfxSprites *s;
+
+  if (dm_sprite_valid (sprite) == DM_FALSE)
+    return;
+
+  s = dm_gfxdata->sprites;
+
+  if (s->image[sprite] != image)
+    {
+      s->image[sprite] = image;
+      dm_sprite_touch (sprite);
+    }
+}
+
+void
+dm_sprite_set_rect (dm_Sprite sprite,
+                    unsigned short image_x,
+                    unsigned short image_y,
+                    unsigned short width,
+                    unsigned short height)
+{
+  dm_GfxSprites *s;
+
+  if (dm_sprite_valid (sprite) == DM_FALSE)
+    return;
+
+  s = dm_gfxdata->sprites;
+
+  if (s->image_x[sprite] != image_x || s->image_y[sprite] != image_y
+      || s->width[sprite] != width || s->height[sprite] != height)
+    {
+      s->image_x[sprite] = image_x;
+      s->image_y[sprite] = image_y;
+      s->width[sprite] = width;
+      s->height[sprite] = height;
+      dm_sprite_touch (sprite);
+    }
+}
+
+void
+dm_sprite_set_position (dm_Sprite sprite,
+                        unsigned short screen_x,
+                        unsigned short screen_y)
+{
+  dm_GfxSprites *s;
+
+  if (dm_sprite_valid (sprite) == DM_FALSE)
+    return;
+
+  s = dm_gfxdata->sprites;
+
+  if (s->x[sprite] != screen_x || s->y[sprite] != screen_y)
+    {
+      s->x[sprite] = screen_x;
+      s->y[sprite] = screen_y;
+      dm_sprite_touch (sprite);
+    }
+}
+
+void
+dm_sprite_set_visible (dm_Sprite sprite, int visible)
+{
+  dm_GfxSprites *s;
+  unsigned char flag;
+
+  if (dm_sprite_valid (sprite) == DM_FALSE)
+    return;
+
+  s = dm_gfxdata->sprites;
+  flag = visible ? DM_SPRITE_VISIBLE : 0;
+
+  if ((s->flags[sprite] & DM_SPRITE_VISIBLE) != flag)
+    {
+      s->flags[sprite] ^= DM_SPRITE_VISIBLE;
+      dm_sprite_touch (sprite);
+    }
+}
+
+void
+dm_sprite_background (unsigned char r,
+                      unsigned char g,
+                      unsigned char b)
+{
+  dm_GfxSprites *s;
+
+  s = dm_gfxdata->sprites;
+
+  s->r = r;
+  s->g = g;
+  s->b = b;
+  s->full = DM_TRUE;
+}
+
+void
+dm_sprite_invalidate (void)
+{
+  if (dm_gfxdata && dm_gfxdata->sprites)
+    dm_gfxdata->sprites->full = DM_TRUE;
+}
+
+void
+dm_sprite_render (void)
+{
+  dm_GfxSprites *s;
+  dm_GfxRect old, cur;
+  dm_Sprite i;
+  int k, n, had_old, has_new;
+
+  s = dm_gfxdata->sprites;
+
+  if (s->full)
+    {
+      for (i = 0; i < s->count; i++)
+        {
+          if (s->flags[i] & DM_SPRITE_DRAWN)
+            dm_sprite_touch (i);
+        }
+
+      s->full = DM_FALSE;
+    }
+
+  if (s->changed_count == 0)
+    return;
+
+  /* Move each changed sprite in the grid, damaging both where it was
+     and where it now is. */
+  n = s->changed_count;
+  s->changed_count = 0;
+
+  for (k = 0; k < n; k++)
+    {
+      i = s->changed[k];
+      s->flags[i] &= ~DM_SPRITE_CHANGED;
+
+      had_old = (s->flags[i] & DM_SPRITE_DRAWN) != 0;
+
+      if (had_old)
+        {
+          old.x = s->drawn_x[i];
+          old.y = s->drawn_y[i];
+          old.w = s->drawn_w[i];
+          old.h = s->drawn_h[i];
+
+          dm_sprite_grid_remove (i);
+          s->flags[i] &= ~DM_SPRITE_DRAWN;
+        }
+
+      has_new = ((s->flags[i] & DM_SPRITE_LIVE)
+                 && (s->flags[i] & DM_SPRITE_VISIBLE)
+                 && s->width[i] != 0 && s->height[i] != 0);
+
+      if (has_new)
+        {
+          cur.x = s->drawn_x[i] = s->x[i];
+          cur.y = s->drawn_y[i] = s->y[i];
+          cur.w = s->drawn_w[i] = s->width[i];
+          cur.h = s->drawn_h[i] = s->height[i];
+
+          if (dm_sprite_grid_insert (i) == DM_SUCCESS)
+            s->flags[i] |= DM_SPRITE_DRAWN;
+          else
+            has_new = DM_FALSE;
+        }
+
+      /* A sprite that moved only a little damages one rectangle
+         rather than two. */
+      if (had_old && has_new && dm_sprite_overlap (&old, &cur))
+        {
+          dm_sprite_union (&old, &cur);
+          has_new = DM_FALSE;
+        }
+
+      if (had_old)
+        dm_sprite_damage (&old);
+      if (has_new)
+        dm_sprite_damage (&cur);
+
+      if ((s->flags[i] & DM_SPRITE_LIVE) == 0)
+        {
+          s->next_free[i] = s->free_list;
+          s->free_list = i;
+        }
+    }
+
+  for (k = 0; k < s->damage_count; k++)
+    dm_sprite_redraw (&s->damage[k]);
+
+  s->damage_count = 0;
+}
+
+/* Check that a sprite handle refers to a live sprite. */
+static int
+dm_sprite_valid (dm_Sprite sprite)
+{
+  dm_GfxSprites *s;
+
+  s = dm_gfxdata->sprites;
+
+  return (sprite >= 0 && sprite < s->count
+          && (s->flags[sprite] & DM_SPRITE_LIVE));
+}
+
+/* Add a sprite to the changed list, if it is not already there. */
+static void
+dm_sprite_touch (dm_Sprite sprite)
+{
+  dm_GfxSprites *s;
+
+  s = dm_gfxdata->sprites;
+
+  if ((s->flags[sprite] & DM_SPRITE_CHANGED) == 0)
+    {
+      s->flags[sprite] |= DM_SPRITE_CHANGED;
+      s->changed[s->changed_count++] = sprite;
+    }
+}
+
+/* Double the size of every array in the store.  The arrays share one
+   allocation, widest elements first so that each stays aligned. */
+static int
+dm_sprite_grow (void)
+{
+  dm_GfxSprites *s, n;
+  char *block;
+  size_t per_sprite;
+  int max;
+
+  s = dm_gfxdata->sprites;
+  max = (s->max == 0) ? DM_GFX_SPRITES_INIT : s->max * 2;
+
+  per_sprite = (sizeof (unsigned long)
+                + sizeof (dm_ImageHandle)
+                + sizeof (dm_Sprite) * 3
+                + sizeof (unsigned short) * 10
+                + sizeof (unsigned char));
+
+  block = malloc (per_sprite * max);
+
+  if (block == NULL)
+    return DM_FAILURE;
+
+  n.block = block;
+  n.stamp = dm_sprite_carve (&block, sizeof (unsigned long) * max);
+  n.image = dm_sprite_carve (&block, sizeof (dm_ImageHandle) * max);
+  n.found = dm_sprite_carve (&block, sizeof (dm_Sprite) * max);
+  n.changed = dm_sprite_carve (&block, sizeof (dm_Sprite) * max);
+  n.next_free = dm_sprite_carve (&block, sizeof (dm_Sprite) * max);
+  n.image_x = dm_sprite_carve (&block, sizeof (unsigned short) * max);
+  n.image_y = dm_sprite_carve (&block, sizeof (unsigned short) * max);
+  n.width = dm_sprite_carve (&block, sizeof (unsigned short) * max);
+  n.height = dm_sprite_carve (&block, sizeof (unsigned short) * max);
+  n.x = dm_sprite_carve (&block, sizeof (unsigned short) * max);
+  n.y = dm_sprite_carve (&block, sizeof (unsigned short) * max);
+  n.drawn_x = dm_sprite_carve (&block, sizeof (unsigned short) * max);
+  n.drawn_y = dm_sprite_carve (&block, sizeof (unsigned short) * max);
+  n.drawn_w = dm_sprite_carve (&block, sizeof (unsigned short) * max);
+  n.drawn_h = dm_sprite_carve (&block, sizeof (unsigned short) * max);
+  n.flags = dm_sprite_carve (&block, sizeof (unsigned char) * max);
+
+  if (s->block)
+    {
+      memcpy (n.stamp, s->stamp, sizeof (unsigned long) * s->count);
+      memcpy (n.image, s->image, sizeof (dm_ImageHandle) * s->count);
+      memcpy (n.changed, s->changed,
+              sizeof (dm_Sprite) * s->changed_count);
+      memcpy (n.next_free, s->next_free, sizeof (dm_Sprite) * s->count);
+      memcpy (n.image_x, s->image_x, sizeof (unsigned short) * s->count);
+      memcpy (n.image_y, s->image_y, sizeof (unsigned short) * s->count);
+      memcpy (n.width, s->width, sizeof (unsigned short) * s->count);
+      memcpy (n.height, s->height, sizeof (unsigned short) * s->count);
+      memcpy (n.x, s->x, sizeof (unsigned short) * s->count);
+      memcpy (n.y, s->y, sizeof (unsigned short) * s->count);
+      memcpy (n.drawn_x, s->drawn_x, sizeof (unsigned short) * s->count);
+      memcpy (n.drawn_y, s->drawn_y, sizeof (unsigned short) * s->count);
+      memcpy (n.drawn_w, s->drawn_w, sizeof (unsigned short) * s->count);
+      memcpy (n.drawn_h, s->drawn_h, sizeof (unsigned short) * s->count);
+      memcpy (n.flags, s->flags, sizeof (unsigned char) * s->count);
+
+      free (s->block);
+    }
+
+  s->block = n.block;
+  s->stamp = n.stamp;
+  s->image = n.image;
+  s->found = n.found;
+  s->changed = n.changed;
+  s->next_free = n.next_free;
+  s->image_x = n.image_x;
+  s->image_y = n.image_y;
+  s->width = n.width;
+  s->height = n.height;
+  s->x = n.x;
+  s->y = n.y;
+  s->drawn_x = n.drawn_x;
+  s->drawn_y = n.drawn_y;
+  s->drawn_w = n.drawn_w;
+  s->drawn_h = n.drawn_h;
+  s->flags = n.flags;
+  s->max = max;
+
+  return DM_SUCCESS;
+}
+
+/* Take size bytes from the front of a block. */
+static void *
+dm_sprite_carve (char **block, size_t size)
+{
+  void *p;
+
+  p = *block;
+  *block += size;
+  return p;
+}
+
+/* Find the range of grid cells a rectangle covers.  Anything past the
+   edge of the grid lies in its last row or column. */
+static void
+dm_sprite_cell_range (unsigned short x,
+                      unsigned short y,
+                      unsigned short w,
+                      unsigned short h,
+                      int *cx0,
+                      int *cy0,
+                      int *cx1,
+                      int *cy1)
+{
+  dm_GfxSprites *s;
+
+  s = dm_gfxdata->sprites;
+
+  *cx0 = x / DM_GFX_SPRITE_CELL;
+  *cy0 = y / DM_GFX_SPRITE_CELL;
+  *cx1 = (int) (((unsigned long) x + w - 1) / DM_GFX_SPRITE_CELL);
+  *cy1 = (int) (((unsigned long) y + h - 1) / DM_GFX_SPRITE_CELL);
+
+  if (*cx0 >= s->cells_w)
+    *cx0 = s->cells_w - 1;
+  if (*cy0 >= s->cells_h)
+    *cy0 = s->cells_h - 1;
+  if (*cx1 >= s->cells_w)
+    *cx1 = s->cells_w - 1;
+  if (*cy1 >= s->cells_h)
+    *cy1 = s->cells_h - 1;
+}
+
+/* Add a sprite to every cell its drawn rectangle covers. */
+static int
+dm_sprite_grid_insert (dm_Sprite sprite)
+{
+  dm_GfxSprites *s;
+  dm_GfxSpriteCell *cell;
+  dm_Sprite *sprites;
+  int cx, cy, cx0, cy0, cx1, cy1, max;
+
+  s = dm_gfxdata->sprites;
+
+  dm_sprite_cell_range (s->drawn_x[sprite], s->drawn_y[sprite],
+                        s->drawn_w[sprite], s->drawn_h[sprite],
+                        &cx0, &cy0, &cx1, &cy1);
+
+  for (cy = cy0; cy <= cy1; cy++)
+    {
+      for (cx = cx0; cx <= cx1; cx++)
+        {
+          cell = &s->cells[cy * s->cells_w + cx];
+
+          if (cell->count == cell->max)
+            {
+              if (cell->max == 0)
+                max = DM_GFX_SPRITE_CELL_INIT;
+              else
+                max = cell->max * 2;
+
+              sprites = realloc (cell->sprites, sizeof (dm_Sprite) * max);
+
+              if (sprites == NULL)
+                {
+                  dm_fatal ("GFX: Could not grow sprite grid cell.");
+
+                  /* Undo the cells already added to. */
+                  dm_sprite_grid_remove (sprite);
+                  return DM_FAILURE;
+                }
+
+              cell->sprites = sprites;
+              cell->max = max;
+            }
+
+          cell->sprites[cell->count++] = sprite;
+        }
+    }
+
+  return DM_SUCCESS;
+}
+
+/* Remove a sprite from every cell its drawn rectangle covers. */
+static void
+dm_sprite_grid_remove (dm_Sprite sprite)
+{
+  dm_GfxSprites *s;
+  dm_GfxSpriteCell *cell;
+  int i, cx, cy, cx0, cy0, cx1, cy1;
+
+  s = dm_gfxdata->sprites;
+
+  dm_sprite_cell_range (s->drawn_x[sprite], s->drawn_y[sprite],
+                        s->drawn_w[sprite], s->drawn_h[sprite],
+                        &cx0, &cy0, &cx1, &cy1);
+
+  for (cy = cy0; cy <= cy1; cy++)
+    {
+      for (cx = cx0; cx <= cx1; cx++)
+        {
+          cell = &s->cells[cy * s->cells_w + cx];
+
+          for (i = 0; i < cell->count; i++)
+            {
+              if (cell->sprites[i] == sprite)
+                {
+                  cell->sprites[i] = cell->sprites[--cell->count];
+                  break;
+                }
+            }
+        }
+    }
+}
+
+/* Add a rectangle to the damage list. */
+static int
+dm_sprite_damage (const dm_GfxRect *rect)
+{
+  dm_GfxSprites *s;
+  dm_GfxRect *damage;
+  int max;
+
+  s = dm_gfxdata->sprites;
+
+  if (s->damage_count == s->damage_max)
+    {
+      if (s->damage_max == 0)
+        max = DM_GFX_SPRITE_DAMAGE_INIT;
+      else
+        max = s->damage_max * 2;
+
+      damage = realloc (s->damage, sizeof (dm_GfxRect) * max);
+
+      if (damage == NULL)
+        {
+          dm_fatal ("GFX: Could not grow sprite damage list.");
+          return DM_FAILURE;
+        }
+
+      s->damage = damage;
+      s->damage_max = max;
+    }
+
+  s->damage[s->damage_count++] = *rect;
+  return DM_SUCCESS;
+}
+
+/* Repaint a damaged rectangle: fill it with the background, then
+   draw every sprite over it, bottom first, clipped to it. */
+static void
+dm_sprite_redraw (const dm_GfxRect *rect)
+{
+  dm_GfxSprites *s;
+  dm_GfxSpriteCell *cell;
+  dm_GfxImageNode *img;
+  dm_GfxRect drawn;
+  dm_Sprite j;
+  unsigned long left, top, right, bottom;
+  int i, n, cx, cy, cx0, cy0, cx1, cy1;
+
+  s = dm_gfxdata->sprites;
+  s->pass++;
+  n = 0;
+
+  dm_sprite_cell_range (rect->x, rect->y, rect->w, rect->h,
+                        &cx0, &cy0, &cx1, &cy1);
+
+  for (cy = cy0; cy <= cy1; cy++)
+    {
+      for (cx = cx0; cx <= cx1; cx++)
+        {
+          cell = &s->cells[cy * s->cells_w + cx];
+
+          for (i = 0; i < cell->count; i++)
+            {
+              j = cell->sprites[i];
+
+              if (s->stamp[j] == s->pass)
+                continue;
+
+              s->stamp[j] = s->pass;
+
+              drawn.x = s->drawn_x[j];
+              drawn.y = s->drawn_y[j];
+              drawn.w = s->drawn_w[j];
+              drawn.h = s->drawn_h[j];
+
+              if (dm_sprite_overlap (rect, &drawn))
+                s->found[n++] = j;
+            }
+        }
+    }
+
+  if (n > 1)
+    qsort (s->found, n, sizeof (dm_Sprite), dm_sprite_compare);
+
+  dm_fill_rect_rgb (rect->x, rect->y, rect->w, rect->h,
+                    s->r, s->g, s->b);
+
+  for (i = 0; i < n; i++)
+    {
+      j = s->found[i];
+
+      left = (s->drawn_x[j] > rect->x) ? s->drawn_x[j] : rect->x;
+      top = (s->drawn_y[j] > rect->y) ? s->drawn_y[j] : rect->y;
+      right = (unsigned long) s->drawn_x[j] + s->drawn_w[j];
+      bottom = (unsigned long) s->drawn_y[j] + s->drawn_h[j];
+
+      if (right > (unsigned long) rect->x + rect->w)
+        right = (unsigned long) rect->x + rect->w;
+      if (bottom > (unsigned long) rect->y + rect->h)
+        bottom = (unsigned long) rect->y + rect->h;
+
+      dm_draw_image_h (s->image[j],
+                       (unsigned short) (s->image_x[j]
+                                         + (left - s->drawn_x[j])),
+                       (unsigned short) (s->image_y[j]
+                                         + (top - s->drawn_y[j])),
+                       (unsigned short) left,
+                       (unsigned short) top,
+                       (unsigned short) (right - left),
+                       (unsigned short) (bottom - top));
+
+      /* A sprite whose image is still loading in the background
+         shows the placeholder, so draw it again next frame. */
+      img = dm_image_node (s->image[j]);
+
+      if (img && img->state == DM_IMAGE_LOADING)
+        dm_sprite_touch (j);
+    }
+}
+
+/* Check whether two rectangles overlap. */
+static int
+dm_sprite_overlap (const dm_GfxRect *a, const dm_GfxRect *b)
+{
+  return ((unsigned long) a->x < (unsigned long) b->x + b->w
+          && (unsigned long) b->x < (unsigned long) a->x + a->w
+          && (unsigned long) a->y < (unsigned long) b->y + b->h
+          && (unsigned long) b->y < (unsigned long) a->y + a->h);
+}
+
+/* Grow a to the bounding box of a and b. */
+static void
+dm_sprite_union (dm_GfxRect *a, const dm_GfxRect *b)
+{
+  unsigned long right, bottom;
+
+  right = (unsigned long) a->x + a->w;
+  bottom = (unsigned long) a->y + a->h;
+
+  if ((unsigned long) b->x + b->w > right)
+    right = (unsigned long) b->x + b->w;
+  if ((unsigned long) b->y + b->h > bottom)
+    bottom = (unsigned long) b->y + b->h;
+
+  if (b->x < a->x)
+    a->x = b->x;
+  if (b->y < a->y)
+    a->y = b->y;
+
+  a->w = (unsigned short) (right - a->x);
+  a->h = (unsigned short) (bottom - a->y);
+}
+
+/* Order sprites by handle, so that higher handles draw on top. */
+static int
+dm_sprite_compare (const void *a, const void *b)
+{
+  dm_Sprite x, y;
+
+  x = *(const dm_Sprite *) a;
+  y = *(const dm_Sprite *) b;
+
+  return (x > y) - (x < y);
+}
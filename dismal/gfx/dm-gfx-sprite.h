@@ -0,0 +1,266 @@
+/** @file     gfx/dm-gfx-sprite.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for the retained-mode sprite layer.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_SPRITE_H__
+#define __DM_GFX_SPRITE_H__
+
+#include "../dismal.h"
+
+/** A handle to a sprite. */
+typedef int dm_Sprite;
+
+enum {
+  DM_SPRITE_NONE = -1,  /**< Handle value returned when a sprite could
+                           not be created. */
+
+  DM_GFX_SPRITES_INIT = 64, /**< Initial size of the sprite store; it
+                               doubles whenever it fills. */
+  DM_GFX_SPRITE_CELL  = 32, /**< Width and height, in drawing
+                               coordinates, of the cells of the
+                               sprite grid. */
+
+  /* Sprite flags. */
+  DM_SPRITE_LIVE    = (1<<0), /**< The sprite has not been destroyed. */
+  DM_SPRITE_VISIBLE = (1<<1), /**< The sprite should be drawn. */
+  DM_SPRITE_CHANGED = (1<<2), /**< The sprite is in the changed list. */
+  DM_SPRITE_DRAWN   = (1<<3)  /**< The sprite is on screen, in the
+                                 grid, at its drawn rectangle. */
+};
+
+typedef struct dm_GfxSpriteCell dm_GfxSpriteCell;
+typedef struct dm_GfxSprites dm_GfxSprites;
+
+/** A cell of the sprite grid, listing the sprites drawn over it. */
+struct dm_GfxSpriteCell
+{
+  dm_Sprite *sprites; /**< Sprites whose drawn rectangle overlaps the
+                         cell, in no particular order. */
+  int count;          /**< Number of sprites in the cell. */
+  int max;            /**< Allocated size of sprites. */
+};
+
+/** The sprite store.
+ *
+ *  Each sprite attribute lives in its own array, indexed by sprite
+ *  handle, so that the per-frame passes only touch the attributes
+ *  they need.
+ */
+struct dm_GfxSprites
+{
+  dm_ImageHandle *image;    /**< Image each sprite shows. */
+  unsigned short *image_x;  /**< X coordinate within the image. */
+  unsigned short *image_y;  /**< Y coordinate within the image. */
+  unsigned short *width;    /**< Width of each sprite. */
+  unsigned short *height;   /**< Height of each sprite. */
+  unsigned short *x;        /**< X coordinate on screen. */
+  unsigned short *y;        /**< Y coordinate on screen. */
+  unsigned short *drawn_x;  /**< X coordinate last drawn at. */
+  unsigned short *drawn_y;  /**< Y coordinate last drawn at. */
+  unsigned short *drawn_w;  /**< Width last drawn at. */
+  unsigned short *drawn_h;  /**< Height last drawn at. */
+  unsigned char *flags;     /**< DM_SPRITE_* flags. */
+  unsigned long *stamp;     /**< Redraw pass that last found each
+                               sprite, so that sprites spanning
+                               several cells are found once. */
+  dm_Sprite *found;         /**< Sprites found by the current redraw
+                               pass. */
+  dm_Sprite *changed;       /**< Sprites changed since the last
+                               frame. */
+  dm_Sprite *next_free;     /**< For each destroyed sprite, the next
+                               destroyed sprite to reuse. */
+  void *block;              /**< Single allocation holding every
+                               array above. */
+  int count;                /**< Number of sprite handles issued. */
+  int max;                  /**< Allocated size of the arrays. */
+  int changed_count;        /**< Number of sprites in changed. */
+  dm_Sprite free_list;      /**< First sprite to reuse, or
+                               DM_SPRITE_NONE. */
+
+  dm_GfxSpriteCell *cells;  /**< The sprite grid. */
+  int cells_w;              /**< Width of the grid, in cells. */
+  int cells_h;              /**< Height of the grid, in cells. */
+  unsigned long pass;       /**< Number of the current redraw pass. */
+
+  dm_GfxRect *damage;       /**< Regions to redraw this frame. */
+  int damage_count;         /**< Number of regions in damage. */
+  int damage_max;           /**< Allocated size of damage. */
+
+  int full;                 /**< If non-zero, redraw every sprite. */
+  unsigned char r;          /**< Red component of the background. */
+  unsigned char g;          /**< Green component of the background. */
+  unsigned char b;          /**< Blue component of the background. */
+};
+
+
+/** Initialise the sprite layer.
+ *
+ *  This should NOT be called outside dm_gfx_init.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_sprite_init(void);
+
+
+/** Destroy every sprite and shut down the sprite layer.
+ *
+ *  This should NOT be called outside dm_gfx_cleanup.
+ */
+
+void dm_sprite_cleanup(void);
+
+
+/** Create a sprite.
+ *
+ *  Sprites are retained: once created, a sprite is drawn by
+ *  dm_gfx_update() until it is destroyed, and only redrawn when it,
+ *  or a sprite overlapping it, changes.  Where sprites overlap, the
+ *  one with the higher handle is drawn on top.
+ *
+ *  The sprite layer owns the parts of the screen its sprites have
+ *  covered: when a sprite moves away, the space it leaves is filled
+ *  with the background colour (see dm_sprite_background()).  Mixing
+ *  sprites with dm_draw_image() in the same region will not keep
+ *  the sprites up to date; call dm_sprite_invalidate() after
+ *  drawing over them.
+ *
+ *  Coordinates are drawing coordinates, translated in the same way
+ *  as dm_draw_image()'s.
+ *
+ *  @param image     The image to show.
+ *  @param image_x   The X-coordinate of the on-image rectangle to
+ *                   show.
+ *  @param image_y   The Y-coordinate of the on-image rectangle to
+ *                   show.
+ *  @param width     The width of the rectangle.
+ *  @param height    The height of the rectangle.
+ *  @param screen_x  The X-coordinate on-screen to show the sprite at.
+ *  @param screen_y  The Y-coordinate on-screen to show the sprite at.
+ *
+ *  @return  the sprite's handle, or DM_SPRITE_NONE if it could not
+ *           be created.
+ */
+
+dm_Sprite dm_sprite_create(dm_ImageHandle image,
+                           unsigned short image_x,
+                           unsigned short image_y,
+                           unsigned short width,
+                           unsigned short height,
+                           unsigned short screen_x,
+                           unsigned short screen_y);
+
+
+/** Destroy a sprite, removing it from the screen.
+ *
+ *  The handle may be reissued by a later dm_sprite_create().
+ *
+ *  @param sprite  The sprite to destroy.
+ */
+
+void dm_sprite_destroy(dm_Sprite sprite);
+
+
+/** Change the image a sprite shows.
+ *
+ *  @param sprite  The sprite to change.
+ *  @param image   The image to show.
+ */
+
+void dm_sprite_set_image(dm_Sprite sprite, dm_ImageHandle image);
+
+
+/** Change the rectangle of its image that a sprite shows.
+ *
+ *  @param sprite   The sprite to change.
+ *  @param image_x  The X-coordinate of the on-image rectangle.
+ *  @param image_y  The Y-coordinate of the on-image rectangle.
+ *  @param width    The width of the rectangle.
+ *  @param height   The height of the rectangle.
+ */
+
+void dm_sprite_set_rect(dm_Sprite sprite,
+                        unsigned short image_x,
+                        unsigned short image_y,
+                        unsigned short width,
+                        unsigned short height);
+
+
+/** Move a sprite.
+ *
+ *  @param sprite    The sprite to move.
+ *  @param screen_x  The X-coordinate on-screen to show the sprite at.
+ *  @param screen_y  The Y-coordinate on-screen to show the sprite at.
+ */
+
+void dm_sprite_set_position(dm_Sprite sprite,
+                            unsigned short screen_x,
+                            unsigned short screen_y);
+
+
+/** Show or hide a sprite.
+ *
+ *  @param sprite   The sprite to change.
+ *  @param visible  Non-zero to show the sprite, zero to hide it.
+ */
+
+void dm_sprite_set_visible(dm_Sprite sprite, int visible);
+
+
+/** Set the colour left behind by sprites that move or disappear.
+ *
+ *  This redraws every sprite on the next frame.
+ *
+ *  @param r  Red component of the background.
+ *  @param g  Green component of the background.
+ *  @param b  Blue component of the background.
+ */
+
+void dm_sprite_background(unsigned char r,
+                          unsigned char g,
+                          unsigned char b);
+
+
+/** Redraw every sprite next frame.
+ *
+ *  Call this after drawing over sprites by other means, such as
+ *  clearing the screen.
+ */
+
+void dm_sprite_invalidate(void);
+
+
+/** Redraw whatever has changed since the last frame.
+ *
+ *  The old and new rectangles of every changed sprite are filled
+ *  with the background colour, and every sprite overlapping them
+ *  is redrawn, in handle order, clipped to them.  dm_gfx_update()
+ *  calls this every frame.
+ */
+
+void dm_sprite_render(void);
+
+#endif /* __DM_GFX_SPRITE_H__ */
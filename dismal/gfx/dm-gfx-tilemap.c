@@ -0,0 +1,233 @@
+/** @file     gfx/dm-gfx-tilemap.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Tilemap renderer.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-tilemap.h"
+
+dm_Tilemap *
+dm_tilemap_create (dm_ImageHandle tileset,
+                   int tileset_cols,
+                   unsigned short tile_w,
+                   unsigned short tile_h,
+                   int cols,
+                   int rows)
+{
+  dm_Tilemap *map;
+  size_t count;
+
+  if (tileset_cols <= 0 || cols <= 0 || rows <= 0)
+    {
+      dm_fatal ("GFX: Tilemap dimensions must be positive.");
+      return NULL;
+    }
+
+  map = malloc (sizeof (dm_Tilemap));
+
+  if (map == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate tilemap.");
+      return NULL;
+    }
+
+  count = (size_t) cols * rows;
+
+  /* The shorts go first, so that the one allocation keeps them
+     aligned. */
+  map->cells = calloc (count, (sizeof (unsigned short) * 2
+                               + sizeof (unsigned char) * 2));
+
+  if (map->cells == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate tilemap cells.");
+      free (map);
+      return NULL;
+    }
+
+  map->drawn = map->cells + count;
+  map->flags = (unsigned char *) (map->drawn + count);
+  map->drawn_flags = map->flags + count;
+
+  map->tileset = tileset;
+  map->tileset_cols = tileset_cols;
+  map->tile_w = tile_w;
+  map->tile_h = tile_h;
+  map->cols = cols;
+  map->rows = rows;
+  map->x = map->y = 0;
+  map->highlight_x = map->highlight_y = 0;
+  map->full = DM_TRUE;
+  map->clear = DM_FALSE;
+  map->r = map->g = map->b = 0;
+
+  return map;
+}
+
+void
+dm_tilemap_destroy (dm_Tilemap *map)
+{
+  if (map == NULL)
+    return;
+
+  free (map->cells);
+  free (map);
+}
+
+void
+dm_tilemap_set_cell (dm_Tilemap *map, int col, int row,
+                     unsigned short tile)
+{
+  if (col >= 0 && col < map->cols && row >= 0 && row < map->rows)
+    map->cells[row * map->cols + col] = tile;
+}
+
+void
+dm_tilemap_set_flags (dm_Tilemap *map, int col, int row,
+                      unsigned char flags)
+{
+  if (col >= 0 && col < map->cols && row >= 0 && row < map->rows)
+    map->flags[row * map->cols + col] = flags;
+}
+
+void
+dm_tilemap_set_position (dm_Tilemap *map,
+                         unsigned short screen_x,
+                         unsigned short screen_y)
+{
+  if (map->x != screen_x || map->y != screen_y)
+    {
+      map->x = screen_x;
+      map->y = screen_y;
+      map->full = DM_TRUE;
+    }
+}
+
+void
+dm_tilemap_set_highlight (dm_Tilemap *map,
+                          unsigned short image_x,
+                          unsigned short image_y)
+{
+  map->highlight_x = image_x;
+  map->highlight_y = image_y;
+  map->full = DM_TRUE;
+}
+
+void
+dm_tilemap_background (dm_Tilemap *map,
+                       unsigned char r,
+                       unsigned char g,
+                       unsigned char b)
+{
+  map->clear = DM_TRUE;
+  map->r = r;
+  map->g = g;
+  map->b = b;
+  map->full = DM_TRUE;
+}
+
+void
+dm_tilemap_invalidate (dm_Tilemap *map)
+{
+  map->full = DM_TRUE;
+}
+
+int
+dm_tilemap_draw (dm_Tilemap *map)
+{
+  struct dm_GfxImageNode *img;
+  unsigned short tile_w, tile_h, x, y, hx, hy, image_x, image_y;
+  unsigned short screen_x, screen_y;
+  unsigned short tile;
+  unsigned char flags;
+  int col, row, i;
+
+  img = dm_image_node (map->tileset);
+
+  if (img == NULL)
+    return DM_FAILURE;
+
+  img = dm_image_drawable (img);
+
+  if (img == NULL)
+    return DM_FAILURE;
+
+  /* Translate the map's geometry once, rather than every cell's. */
+  tile_w = map->tile_w;
+  tile_h = map->tile_h;
+  x = map->x;
+  y = map->y;
+  hx = map->highlight_x;
+  hy = map->highlight_y;
+
+  dm_coord_translate (&tile_w, &tile_h, DM_FALSE);
+  dm_coord_translate (&x, &y, DM_TRUE);
+  dm_coord_translate (&hx, &hy, DM_FALSE);
+
+  /* Walk the cells in the order they lie in memory. */
+  for (row = 0, i = 0, screen_y = y; row < map->rows;
+       row++, screen_y += tile_h)
+    {
+      for (col = 0, screen_x = x; col < map->cols;
+           col++, i++, screen_x += tile_w)
+        {
+          tile = map->cells[i];
+          flags = map->flags[i];
+
+          if (map->full == DM_FALSE && tile == map->drawn[i]
+              && flags == map->drawn_flags[i])
+            continue;
+
+          image_x = (unsigned short) ((tile % map->tileset_cols) * tile_w);
+          image_y = (unsigned short) ((tile / map->tileset_cols) * tile_h);
+
+          if (flags & DM_TILE_HIGHLIGHT)
+            {
+              image_x += hx;
+              image_y += hy;
+            }
+
+          if (map->clear)
+            dm_fill_rect_translated (screen_x, screen_y, tile_w, tile_h,
+                                     map->r, map->g, map->b);
+
+          dm_draw_image_translated (img, image_x, image_y,
+                                    screen_x, screen_y, tile_w, tile_h);
+
+          map->drawn[i] = tile;
+          map->drawn_flags[i] = flags;
+        }
+    }
+
+  /* If the tileset is still loading, the placeholder was drawn, so
+     draw the real tiles once they arrive. */
+  map->full = (img->handle != map->tileset);
+
+  return DM_SUCCESS;
+}
@@ -0,0 +1,211 @@
+/** @file     gfx/dm-gfx-tilemap.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Header for the tilemap renderer.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_TILEMAP_H__
+#define __DM_GFX_TILEMAP_H__
+
+#include "../dismal.h"
+
+enum {
+  /* Tilemap cell flags. */
+  DM_TILE_HIGHLIGHT = (1<<0)  /**< Draw the cell's tile from the
+                                 highlighted part of the tileset. */
+};
+
+typedef struct dm_Tilemap dm_Tilemap;
+
+/** A grid of tiles drawn from one tileset image.
+ *
+ *  Tile n of the tileset is the n-th tile-sized cell of the image,
+ *  counting along rows of tileset_cols tiles.
+ *
+ *  Games may write to cells and flags directly; dm_tilemap_draw()
+ *  compares them with what it last drew to find the cells to redraw.
+ */
+struct dm_Tilemap
+{
+  dm_ImageHandle tileset;   /**< Image holding the tiles. */
+  int tileset_cols;         /**< Number of tiles in each row of the
+                               tileset. */
+  unsigned short tile_w;    /**< Width of one tile. */
+  unsigned short tile_h;    /**< Height of one tile. */
+  int cols;                 /**< Width of the map, in cells. */
+  int rows;                 /**< Height of the map, in cells. */
+  unsigned short x;         /**< X coordinate of the map on screen. */
+  unsigned short y;         /**< Y coordinate of the map on screen. */
+  unsigned short highlight_x; /**< X offset within the tileset of the
+                                 highlighted tiles. */
+  unsigned short highlight_y; /**< Y offset within the tileset of the
+                                 highlighted tiles. */
+
+  unsigned short *cells;    /**< Tile number of each cell, row by
+                               row. */
+  unsigned char *flags;     /**< DM_TILE_* flags of each cell. */
+  unsigned short *drawn;    /**< Tile number last drawn in each
+                               cell. */
+  unsigned char *drawn_flags; /**< Flags each cell was last drawn
+                                 with. */
+
+  int full;                 /**< If non-zero, redraw every cell. */
+  int clear;                /**< If non-zero, fill cells with the
+                               background before drawing them. */
+  unsigned char r;          /**< Red component of the background. */
+  unsigned char g;          /**< Green component of the background. */
+  unsigned char b;          /**< Blue component of the background. */
+};
+
+
+/** Create a tilemap.
+ *
+ *  Every cell starts as tile 0, unflagged, and is drawn on the first
+ *  dm_tilemap_draw().
+ *
+ *  @param tileset       The image holding the tiles.
+ *  @param tileset_cols  The number of tiles in each row of the
+ *                       tileset.
+ *  @param tile_w        The width of one tile.
+ *  @param tile_h        The height of one tile.
+ *  @param cols          The width of the map, in cells.
+ *  @param rows          The height of the map, in cells.
+ *
+ *  @return  the new tilemap, or NULL if it could not be created.
+ */
+
+dm_Tilemap *dm_tilemap_create(dm_ImageHandle tileset,
+                              int tileset_cols,
+                              unsigned short tile_w,
+                              unsigned short tile_h,
+                              int cols,
+                              int rows);
+
+
+/** Destroy a tilemap.
+ *
+ *  This does not erase the map from the screen.
+ *
+ *  @param map  The tilemap to destroy.
+ */
+
+void dm_tilemap_destroy(dm_Tilemap *map);
+
+
+/** Set the tile in a cell.
+ *
+ *  @param map   The tilemap.
+ *  @param col   The column of the cell.
+ *  @param row   The row of the cell.
+ *  @param tile  The tile number.
+ */
+
+void dm_tilemap_set_cell(dm_Tilemap *map, int col, int row,
+                         unsigned short tile);
+
+
+/** Set the flags of a cell.
+ *
+ *  @param map    The tilemap.
+ *  @param col    The column of the cell.
+ *  @param row    The row of the cell.
+ *  @param flags  The DM_TILE_* flags.
+ */
+
+void dm_tilemap_set_flags(dm_Tilemap *map, int col, int row,
+                          unsigned char flags);
+
+
+/** Move a tilemap.
+ *
+ *  The whole map is redrawn at its new position on the next
+ *  dm_tilemap_draw(); erasing it from its old one is up to the
+ *  caller.
+ *
+ *  @param map       The tilemap.
+ *  @param screen_x  The X-coordinate on-screen of the map's top-left
+ *                   corner.
+ *  @param screen_y  The Y-coordinate on-screen of the map's top-left
+ *                   corner.
+ */
+
+void dm_tilemap_set_position(dm_Tilemap *map,
+                             unsigned short screen_x,
+                             unsigned short screen_y);
+
+
+/** Set where the highlighted tiles lie in the tileset.
+ *
+ *  Cells flagged DM_TILE_HIGHLIGHT draw their tile offset by this
+ *  much within the tileset.
+ *
+ *  @param map      The tilemap.
+ *  @param image_x  The X offset of the highlighted tiles.
+ *  @param image_y  The Y offset of the highlighted tiles.
+ */
+
+void dm_tilemap_set_highlight(dm_Tilemap *map,
+                              unsigned short image_x,
+                              unsigned short image_y);
+
+
+/** Fill cells with a colour before drawing tiles over them.
+ *
+ *  This is only needed if the tileset has transparent parts, which
+ *  would otherwise show the tile previously drawn in the cell.
+ *
+ *  @param map  The tilemap.
+ *  @param r    Red component of the background.
+ *  @param g    Green component of the background.
+ *  @param b    Blue component of the background.
+ */
+
+void dm_tilemap_background(dm_Tilemap *map,
+                           unsigned char r,
+                           unsigned char g,
+                           unsigned char b);
+
+
+/** Redraw every cell of a tilemap on its next dm_tilemap_draw().
+ *
+ *  @param map  The tilemap.
+ */
+
+void dm_tilemap_invalidate(dm_Tilemap *map);
+
+
+/** Draw a tilemap.
+ *
+ *  Only cells whose tile or flags have changed since the last call
+ *  are drawn.  Coordinates are translated once for the whole map,
+ *  in the same way as dm_draw_image()'s.
+ *
+ *  @param map  The tilemap.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int dm_tilemap_draw(dm_Tilemap *map);
+
+#endif /* __DM_GFX_TILEMAP_H__ */
@@ -0,0 +1,194 @@
+/** @file     gfx/dm-gfx-viewport.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Mapping of the logical screen onto the real one.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
+#include "../dismal.h"
+#include "dm-gfx.h"
+#include "dm-gfx-viewport.h"
+
+static void dm_viewport_build (unsigned short table[],
+                               unsigned short inverse[],
+                               unsigned short logical,
+                               unsigned short screen,
+                               unsigned long scale,
+                               unsigned short offset);
+
+int
+dm_viewport_init (dm_GfxViewport *viewport,
+                  unsigned short screen_w,
+                  unsigned short screen_h)
+{
+  unsigned long x_fit, y_fit;
+
+  free (viewport->x_inverse);
+  free (viewport->y_inverse);
+
+  viewport->screen_w = screen_w;
+  viewport->screen_h = screen_h;
+  viewport->x_inverse = malloc (sizeof (unsigned short)
+                                * (screen_w ? screen_w : 1));
+  viewport->y_inverse = malloc (sizeof (unsigned short)
+                                * (screen_h ? screen_h : 1));
+
+  if (viewport->x_inverse == NULL || viewport->y_inverse == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate viewport tables.");
+      dm_viewport_cleanup (viewport);
+      return DM_FAILURE;
+    }
+
+  /* Enlarge by the same amount both ways, so the logical screen keeps
+     its shape, leaving bars along the sides of the screen that has
+     room to spare. */
+  x_fit = ((unsigned long) screen_w << DM_VIEWPORT_SHIFT)
+    / DM_LOWRES_WIDTH;
+  y_fit = ((unsigned long) screen_h << DM_VIEWPORT_SHIFT)
+    / DM_LOWRES_HEIGHT;
+
+  dm_viewport_set_scale (viewport, (x_fit < y_fit) ? x_fit : y_fit);
+  return DM_SUCCESS;
+}
+
+void
+dm_viewport_set_scale (dm_GfxViewport *viewport, unsigned long scale)
+{
+  viewport->scale = scale;
+  viewport->width = dm_viewport_scale (DM_LOWRES_WIDTH, scale);
+  viewport->height = dm_viewport_scale (DM_LOWRES_HEIGHT, scale);
+  viewport->x_offset = (viewport->screen_w - viewport->width) / 2;
+  viewport->y_offset = (viewport->screen_h - viewport->height) / 2;
+
+  dm_viewport_build (viewport->x_table, viewport->x_inverse,
+                     DM_LOWRES_WIDTH, viewport->screen_w, scale,
+                     viewport->x_offset);
+  dm_viewport_build (viewport->y_table, viewport->y_inverse,
+                     DM_LOWRES_HEIGHT, viewport->screen_h, scale,
+                     viewport->y_offset);
+}
+
+void
+dm_viewport_cleanup (dm_GfxViewport *viewport)
+{
+  free (viewport->x_inverse);
+  free (viewport->y_inverse);
+
+  viewport->x_inverse = viewport->y_inverse = NULL;
+}
+
+unsigned short
+dm_viewport_scale (unsigned short value, unsigned long scale)
+{
+  unsigned long whole, fraction;
+
+  /* Split the scale, so that neither product can overflow, and
+     round the fractional part. */
+  whole = scale >> DM_VIEWPORT_SHIFT;
+  fraction = scale & ((1UL << DM_VIEWPORT_SHIFT) - 1);
+
+  return (unsigned short) (value * whole
+                           + ((value * fraction + 0x8000UL)
+                              >> DM_VIEWPORT_SHIFT));
+}
+
+void
+dm_viewport_scale_array (unsigned short values[],
+                         unsigned long count,
+                         unsigned long scale,
+                         unsigned short offset)
+{
+  unsigned long i;
+
+#ifdef __SSE2__
+  __m128i v, lo, r, whole, fraction, off;
+
+  /* The scalar sum, in 16-bit lanes: the fraction's rounded product
+     is the high half of the full product, plus one if the low half
+     reaches a half. */
+  whole = _mm_set1_epi16 ((short) (scale >> DM_VIEWPORT_SHIFT));
+  fraction = _mm_set1_epi16 ((short) (scale & 0xFFFF));
+  off = _mm_set1_epi16 ((short) offset);
+
+  for (i = 0; i + 8 <= count; i += 8)
+    {
+      v = _mm_loadu_si128 ((const __m128i *) (values + i));
+      lo = _mm_mullo_epi16 (v, fraction);
+      r = _mm_add_epi16 (_mm_mullo_epi16 (v, whole),
+                         _mm_mulhi_epu16 (v, fraction));
+      r = _mm_add_epi16 (r, _mm_srli_epi16 (lo, 15));
+      r = _mm_add_epi16 (r, off);
+      _mm_storeu_si128 ((__m128i *) (values + i), r);
+    }
+#else /* __SSE2__ */
+  i = 0;
+#endif /* __SSE2__ */
+
+  for (; i < count; i++)
+    values[i] = (unsigned short) (dm_viewport_scale (values[i], scale)
+                                  + offset);
+}
+
+void
+dm_viewport_lookup_array (unsigned short values[],
+                          unsigned long count,
+                          const unsigned short table[],
+                          unsigned short size)
+{
+  unsigned long i;
+
+  for (i = 0; i < count; i++)
+    values[i] = table[(values[i] < size) ? values[i] : size - 1];
+}
+
+/* Fill in one axis's forward table, and the inverse table mapping
+   each pixel back to the logical co-ordinate covering it.  Pixels in
+   the bars map to the nearest edge. */
+static void
+dm_viewport_build (unsigned short table[],
+                   unsigned short inverse[],
+                   unsigned short logical,
+                   unsigned short screen,
+                   unsigned long scale,
+                   unsigned short offset)
+{
+  unsigned short u, c;
+
+  for (u = 0; u <= logical; u++)
+    table[u] = (unsigned short) (dm_viewport_scale (u, scale) + offset);
+
+  for (c = 0, u = 0; c < screen; c++)
+    {
+      while (u + 1 < logical && table[u + 1] <= c)
+        u++;
+
+      inverse[c] = u;
+    }
+}
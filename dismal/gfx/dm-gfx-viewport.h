@@ -0,0 +1,129 @@
+/** @file     gfx/dm-gfx-viewport.h
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Mapping of the logical screen onto the real one.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef __DM_GFX_VIEWPORT_H__
+#define __DM_GFX_VIEWPORT_H__
+
+enum
+  {
+    DM_VIEWPORT_SHIFT = 16  /**< Fraction bits of viewport scales. */
+  };
+
+/** Set up a viewport for a screen, enlarging the logical screen as
+ *  far as it will go.
+ *
+ *  The scale found need not be a whole number; use
+ *  dm_viewport_set_scale() to round it down when drawing directly to
+ *  the screen.
+ *
+ *  This should NOT be called outside dm_gfx_init.
+ *
+ *  @param viewport  The viewport, whose inverse tables must be NULL
+ *                   or from an earlier call.
+ *  @param screen_w  Width of the real screen, in pixels.
+ *  @param screen_h  Height of the real screen, in pixels.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE otherwise.
+ */
+
+int
+dm_viewport_init (dm_GfxViewport *viewport,
+                  unsigned short screen_w,
+                  unsigned short screen_h);
+
+
+/** Change a viewport's scale, re-centring it and rebuilding its
+ *  tables.
+ *
+ *  @param viewport  The viewport, set up by dm_viewport_init().
+ *  @param scale     The new scale, in 16.16 fixed point.  This must
+ *                   not be larger than the viewport's initial scale.
+ */
+
+void
+dm_viewport_set_scale (dm_GfxViewport *viewport, unsigned long scale);
+
+
+/** Free a viewport's inverse tables.
+ *
+ *  @param viewport  The viewport.
+ */
+
+void
+dm_viewport_cleanup (dm_GfxViewport *viewport);
+
+
+/** Scale one co-ordinate by a 16.16 fixed point factor, rounding to
+ *  the nearest pixel.
+ *
+ *  Results are kept to 16 bits, as with the integer translations.
+ *
+ *  @param value  The co-ordinate.
+ *  @param scale  The factor.
+ *
+ *  @return the scaled co-ordinate.
+ */
+
+unsigned short
+dm_viewport_scale (unsigned short value, unsigned long scale);
+
+
+/** Scale an array of co-ordinates, in place, as dm_viewport_scale
+ *  does, then add an offset to each.
+ *
+ *  This takes 8 co-ordinates at a time where SSE2 is available.
+ *
+ *  @param values  The co-ordinates.
+ *  @param count   The number of co-ordinates.
+ *  @param scale   The factor, in 16.16 fixed point.
+ *  @param offset  The offset to add.
+ */
+
+void
+dm_viewport_scale_array (unsigned short values[],
+                         unsigned long count,
+                         unsigned long scale,
+                         unsigned short offset);
+
+
+/** Look each of an array of co-ordinates up in a table, in place.
+ *
+ *  Co-ordinates past the end of the table take its last entry.
+ *
+ *  @param values  The co-ordinates.
+ *  @param count   The number of co-ordinates.
+ *  @param table   The table.
+ *  @param size    The number of entries in the table.
+ */
+
+void
+dm_viewport_lookup_array (unsigned short values[],
+                          unsigned long count,
+                          const unsigned short table[],
+                          unsigned short size);
+
+#endif /* __DM_GFX_VIEWPORT_H__ */
@@ -36,6 +36,14 @@
 #include "dm-gfx-sdl.h"
 #endif
 
+#ifdef DM_GFX_SDL_OPENGL
+#include "dm-gfx-sdl-opengl.h"
+#endif
+
+#ifdef DM_GFX_MEMORY
+#include "dm-gfx-memory.h"
+#endif
+
 static const dm_GfxDriverSpec dm_driver_specs[] = {
 
   /* -- Drivers using SDL base -- */
@@ -46,9 +54,13 @@ static const dm_GfxDriverSpec dm_driver_specs[] = {
 #endif /* DM_GFX_SDL */
 
 #ifdef DM_GFX_SDL_OPENGL
-  {"sdl-opengl", dm_gfx_sdl_register},
+  {"sdl-opengl", dm_gfx_sdl_opengl_register},
 #endif /* DM_GFX_SDL_OPENGL */
 
+#ifdef DM_GFX_MEMORY
+  {"memory", dm_gfx_memory_register},
+#endif /* DM_GFX_MEMORY */
+
 #endif /* DM_BASE_SDL */
 
   /* -- Drivers using Classic Amiga base -- */
@@ -61,6 +73,22 @@ static const dm_GfxDriverSpec dm_driver_specs[] = {
 
 dm_GfxData *dm_gfxdata;
 
+static int dm_draw_image_node(struct dm_GfxImageNode *img,
+                              unsigned short image_x,
+                              unsigned short image_y,
+                              unsigned short screen_x,
+                              unsigned short screen_y,
+                              unsigned short width,
+                              unsigned short height);
+static dm_ImageHandle dm_image_add_handle(struct dm_GfxImageNode *img);
+static void dm_image_free_data(struct dm_GfxImageNode *node);
+static int dm_image_reload(struct dm_GfxImageNode *node);
+static void dm_image_enforce_budget(struct dm_GfxImageNode *keep);
+static unsigned long dm_image_data_bytes(void *data);
+static void dm_image_enlarge(struct dm_GfxImageNode *node);
+static void dm_image_prepare_blend(struct dm_GfxImageNode *node);
+static int dm_gfx_init_scale(dm_Config *conf);
+
 int
 dm_gfx_init (dm_Config *conf)
 {
@@ -74,8 +102,33 @@ dm_gfx_init (dm_Config *conf)
     }
 
   dm_gfxdata->conf = conf;
-
-  dm_gfxdata->driver = malloc (sizeof (dm_GfxDriver));
+  dm_gfxdata->images = NULL;
+  dm_gfxdata->names = NULL;
+  dm_gfxdata->atlas = NULL;
+  dm_gfxdata->loader = NULL;
+  dm_gfxdata->packs = NULL;
+  dm_gfxdata->queue = NULL;
+  dm_gfxdata->sprites = NULL;
+  dm_gfxdata->text = NULL;
+  dm_gfxdata->palette_lut = NULL;
+  dm_gfxdata->viewport.x_inverse = dm_gfxdata->viewport.y_inverse = NULL;
+
+  /* Nothing has been presented yet, so the first frame is presented
+     in full. */
+  dm_gfxdata->dirty.count = 0;
+  dm_gfxdata->dirty.area = 0;
+  dm_gfxdata->dirty.full = DM_TRUE;
+  dm_gfxdata->placeholder = DM_IMAGE_NONE;
+  dm_gfxdata->handles = NULL;
+  dm_gfxdata->handle_count = dm_gfxdata->handle_max = 0;
+  dm_gfxdata->image_bytes = 0;
+  dm_gfxdata->clock_hand = 0;
+  dm_gfxdata->recorder = NULL;
+  dm_gfxdata->pipeline = NULL;
+
+  /* Zero the table so that optional driver functions default to
+     NULL. */
+  dm_gfxdata->driver = calloc (1, sizeof (dm_GfxDriver));
 
   if (dm_gfxdata->driver == NULL)
     {
@@ -83,7 +136,7 @@ dm_gfx_init (dm_Config *conf)
       return DM_FAILURE;
     }
 
-  if (dm_gfx_select_driver () == DM_FAILURE)
+  if (dm_gfx_select_driver (conf->gfx_driver) == DM_FAILURE)
     {
       dm_fatal ("GFX: Could not select graphics driver.");
       return DM_FAILURE;
@@ -95,16 +148,46 @@ dm_gfx_init (dm_Config *conf)
       return DM_FAILURE;
     }
 
+  if (dm_gfx_init_scale (conf) == DM_FAILURE)
+    return DM_FAILURE;
+
+  if (dm_palette_init (conf) == DM_FAILURE)
+    return DM_FAILURE;
+
   /* Initialise image slots */
 
-  memset (dm_gfxdata->images, (int) NULL, 
-          sizeof (struct dm_GfxImageNode*) * DM_GFX_HASH_VALS);
+  dm_gfxdata->image_count = 0;
+  dm_gfxdata->image_slots = DM_GFX_HASH_MIN_SLOTS;
+  dm_gfxdata->images = calloc (dm_gfxdata->image_slots,
+                               sizeof (dm_GfxImageEntry));
 
-  return DM_SUCCESS;
+  dm_gfxdata->names_len = dm_gfxdata->names_dead = 0;
+  dm_gfxdata->names_max = DM_GFX_NAMES_INIT;
+  dm_gfxdata->names = malloc (dm_gfxdata->names_max);
+
+  if (dm_gfxdata->images == NULL || dm_gfxdata->names == NULL)
+    {
+      dm_fatal ("GFX: Could not allocate image table.");
+      return DM_FAILURE;
+    }
+
+  if (dm_queue_init () == DM_FAILURE
+      || dm_sprite_init () == DM_FAILURE
+      || dm_text_init () == DM_FAILURE
+      || dm_pipeline_init (conf) == DM_FAILURE)
+    return DM_FAILURE;
+
+  if (dm_pack_mount_embedded () == DM_FAILURE)
+    {
+      dm_fatal ("GFX: Could not mount embedded assets.");
+      return DM_FAILURE;
+    }
+
+  return dm_load_init ();
 }
 
 int
-dm_gfx_select_driver (void)
+dm_gfx_select_driver (const char *name)
 {
   int i, max, firstdri, prefdri;
 
@@ -122,20 +205,19 @@ dm_gfx_select_driver (void)
         {
           if (firstdri == -1)
             firstdri = i;
-      
-
-          /* TEST CODE - replace me */
-          if (strcmp (dm_driver_specs[i].name, "sdl") == 0)
-            {
-              dm_debug ("Selected driver: %s", dm_driver_specs[i].name);
-              prefdri = i;
-            }
+
+          if (prefdri == -1 && name != NULL
+              && strcmp (dm_driver_specs[i].name, name) == 0)
+            prefdri = i;
         }
     }
 
   /* No preferred driver - select first driver defined instead. */
   if (prefdri == -1)
     {
+      if (name != NULL)
+        dm_debug ("GFX: Driver %s is not compiled in.", name);
+
       /* No first driver available - this means no drivers are available! */
       if (firstdri == -1)
         {
@@ -146,6 +228,8 @@ dm_gfx_select_driver (void)
       prefdri = firstdri;
     }
 
+  dm_debug ("GFX: Selected driver: %s", dm_driver_specs[prefdri].name);
+
   dm_driver_specs[prefdri].reg (dm_gfxdata->driver);
 
   return DM_SUCCESS;
@@ -154,14 +238,54 @@ dm_gfx_select_driver (void)
 DM_INLINE void
 dm_gfx_update (void)
 {
-  dm_gfxdata->driver->update();
+  dm_load_poll ();
+  dm_sprite_render ();
+
+  /* With a render thread, the frame is drawn and presented while the
+     game gets on with the next one. */
+  if (dm_gfxdata->pipeline && dm_get_gfx_flag (DM_GFX_DEFERRED))
+    dm_pipeline_submit ();
+  else
+    {
+      dm_queue_flush ();
+      dm_dirty_present ();
+    }
+}
+
+int
+dm_gfx_band_timings (dm_GfxBandTiming timings[], int max)
+{
+  if (dm_gfxdata->driver->band_timings == NULL)
+    return 0;
+
+  dm_pipeline_sync ();
+
+  return dm_gfxdata->driver->band_timings (timings, max);
 }
 
 void
 dm_gfx_cleanup (void)
 {
   if (dm_gfxdata) {
-    dm_clear_images();
+    /* Present the frames in flight, and finish any background loads
+       before their nodes go away. */
+    dm_pipeline_cleanup();
+    dm_load_cleanup();
+
+    /* The screen is going away, so queued draws, sprites and cached
+       text can simply go too. */
+    dm_queue_cleanup();
+    dm_sprite_cleanup();
+    dm_text_cleanup();
+
+    /* Finish writing the recording while the driver is still up. */
+    dm_record_stop();
+
+    if (dm_gfxdata->images)
+      dm_clear_images();
+
+    dm_pack_unmount_all();
+    dm_palette_cleanup();
 
     if (dm_gfxdata->driver) {
       dm_gfxdata->driver->cleanup();
@@ -169,27 +293,55 @@ dm_gfx_cleanup (void)
       free(dm_gfxdata->driver);
     }
 
+    dm_viewport_cleanup(&dm_gfxdata->viewport);
+
+    if (dm_gfxdata->images)
+      free (dm_gfxdata->images);
+
+    if (dm_gfxdata->names)
+      free (dm_gfxdata->names);
+
+    if (dm_gfxdata->handles)
+      free (dm_gfxdata->handles);
+
     free(dm_gfxdata);
     dm_gfxdata = NULL;
   }
 }
 
 struct dm_GfxImageNode *dm_load_image(const char filename[])
+{
+  return dm_load_image_blend(filename, DM_BLEND_KEYED);
+}
+
+struct dm_GfxImageNode *dm_load_image_blend(const char filename[],
+                                            int blend)
 {
   struct dm_GfxImageNode *ptr;
 
   ptr = malloc(sizeof(struct dm_GfxImageNode));
 
   if (ptr) {
-    /* Load data. */
-    strncpy(ptr->name, filename, DM_GFX_HASH_NAME_LEN);
-    ptr->data = dm_gfxdata->driver->load_image_data(filename);
+    /* Load data, from a pack if possible. */
+    ptr->data = dm_pack_load_image_data(filename, &ptr->pack);
+
+    if (ptr->data == NULL)
+      ptr->data = dm_gfxdata->driver->load_image_data(filename);
+    ptr->page = NULL;
+    ptr->x = ptr->y = ptr->w = ptr->h = 0;
+    ptr->lowres = NULL;
+    ptr->pinned = DM_FALSE;
+    ptr->blend = (unsigned char) blend;
+    ptr->size = 0;
 
     if (ptr->data) {
+      dm_image_loaded(ptr);
+
       /* Store the image. */
       return dm_get_image(filename, ptr);
     } else {
       dm_fatal("GFX: Could not load data for image %s", filename);
+      free(ptr);
       return NULL;
     }
   } else {
@@ -201,10 +353,271 @@ struct dm_GfxImageNode *dm_load_image(const char filename[])
 
 void dm_free_image(struct dm_GfxImageNode *node)
 {
-  dm_gfxdata->driver->free_image_data(node->data);
+  dm_image_free_data(node);
   free(node);
 }
 
+/* Free an image's data, or its space in its atlas page. */
+static void dm_image_free_data(struct dm_GfxImageNode *node)
+{
+  /* Queued draws may still need the data. */
+  dm_queue_flush();
+
+  if (node->state == DM_IMAGE_LOADING)
+    dm_load_cancel(node);
+
+  if (node->page)
+    dm_atlas_release(node);
+  else if (node->data)
+    dm_gfxdata->driver->free_image_data(node->data);
+
+  if (node->lowres)
+    dm_gfxdata->driver->free_image_data(node->lowres);
+
+  dm_gfxdata->image_bytes -= node->size;
+  node->lowres = NULL;
+  node->size = 0;
+}
+
+void dm_image_loaded(struct dm_GfxImageNode *node)
+{
+  unsigned int w, h;
+  void *mapped;
+
+  node->page = NULL;
+  node->lowres = NULL;
+  node->size = 0;
+
+  mapped = node->data;
+  dm_image_prepare_blend(node);
+
+  /* Images from packs are drawn straight from the pack's mapping, so
+     they are neither copied into the atlas nor counted against the
+     budget, unless preparing them for their blend mode copied them;
+     the pack should have been made at the right scale. */
+  if (node->pack == NULL && dm_get_gfx_flag(DM_GFX_LOWRES_IMAGES))
+    dm_image_enlarge(node);
+
+  if (dm_gfxdata->driver->image_data_size
+      && dm_gfxdata->driver->image_data_size(node->data, &w, &h)) {
+    node->w = (unsigned short) w;
+    node->h = (unsigned short) h;
+
+    /* Pack the image into an atlas page if it is small enough.  Pages
+       are colour keyed, so only keyed images can share them. */
+    if (node->pack == NULL && node->blend == DM_BLEND_KEYED)
+      dm_atlas_insert(node);
+  }
+
+  /* Images with their own data count against the budget, as do
+     kept low-res originals. */
+  if (node->page == NULL && (node->pack == NULL || node->data != mapped))
+    node->size += dm_image_data_bytes(node->data);
+
+  if (node->lowres)
+    node->size += dm_image_data_bytes(node->lowres);
+
+  dm_gfxdata->image_bytes += node->size;
+
+  node->state = DM_IMAGE_READY;
+  node->used = DM_TRUE;
+
+  dm_image_enforce_budget(node);
+}
+
+int dm_image_pin(dm_ImageHandle handle, int pinned)
+{
+  struct dm_GfxImageNode *img;
+
+  img = dm_image_node(handle);
+
+  if (img == NULL)
+    return DM_FAILURE;
+
+  img->pinned = (pinned ? DM_TRUE : DM_FALSE);
+
+  /* Bring a pinned image back straight away if it was evicted. */
+  if (img->pinned && img->state == DM_IMAGE_EVICTED)
+    return dm_image_reload(img);
+
+  return DM_SUCCESS;
+}
+
+unsigned long dm_image_memory(void)
+{
+  return dm_gfxdata->image_bytes;
+}
+
+int dm_image_set_blend(dm_ImageHandle handle, int blend)
+{
+  struct dm_GfxImageNode *img;
+
+  img = dm_image_node(handle);
+
+  if (img == NULL || blend < DM_BLEND_KEYED || blend > DM_BLEND_ADDITIVE)
+    return DM_FAILURE;
+
+  if (img->blend == blend)
+    return DM_SUCCESS;
+
+  img->blend = (unsigned char) blend;
+
+  /* Images without data are prepared for the mode when they are
+     loaded.  Loaded data may already have been prepared for the old
+     mode, so it is loaded afresh. */
+  if (img->state != DM_IMAGE_READY)
+    return DM_SUCCESS;
+
+  dm_image_free_data(img);
+  img->data = NULL;
+
+  if (dm_image_reload(img) == DM_FAILURE)
+    return DM_FAILURE;
+
+  return (img->blend == blend) ? DM_SUCCESS : DM_FAILURE;
+}
+
+/* Prepare an image's freshly loaded data for its blend mode, colour
+   keying it instead if the driver cannot draw the mode. */
+static void dm_image_prepare_blend(struct dm_GfxImageNode *node)
+{
+  void *prepared;
+
+  if (dm_gfxdata->driver->blend_image_data == NULL) {
+    if (node->blend != DM_BLEND_KEYED)
+      dm_debug("GFX: Cannot draw an image with blend mode %d; "
+               "keying it.", node->blend);
+    node->blend = DM_BLEND_KEYED;
+    return;
+  }
+
+  prepared = dm_gfxdata->driver->blend_image_data(node->data,
+                                                  node->blend);
+
+  if (prepared == NULL && node->blend != DM_BLEND_KEYED) {
+    dm_debug("GFX: Cannot draw an image with blend mode %d; keying it.",
+             node->blend);
+    node->blend = DM_BLEND_KEYED;
+    prepared = dm_gfxdata->driver->blend_image_data(node->data,
+                                                    node->blend);
+  }
+
+  if (prepared)
+    node->data = prepared;
+}
+
+/* Load an evicted image's data again. */
+static int dm_image_reload(struct dm_GfxImageNode *node)
+{
+  const char *name;
+
+  name = dm_gfxdata->names + node->name;
+  node->data = dm_pack_load_image_data(name, &node->pack);
+
+  if (node->data == NULL)
+    node->data = dm_gfxdata->driver->load_image_data(name);
+
+  if (node->data == NULL) {
+    dm_fatal("GFX: Could not reload data for image %s", name);
+    node->state = DM_IMAGE_FAILED;
+    return DM_FAILURE;
+  }
+
+  dm_debug("GFX: Reloaded evicted image %s.", name);
+  dm_image_loaded(node);
+  return DM_SUCCESS;
+}
+
+void dm_image_evict(struct dm_GfxImageNode *node)
+{
+  dm_debug("GFX: Evicting image %s.", dm_gfxdata->names + node->name);
+
+  dm_image_free_data(node);
+  node->data = NULL;
+  node->state = DM_IMAGE_EVICTED;
+}
+
+/* Get the memory used by image data, assuming 32 bits per pixel if
+   the driver cannot say. */
+static unsigned long dm_image_data_bytes(void *data)
+{
+  unsigned int w, h;
+
+  if (dm_gfxdata->driver->image_data_bytes)
+    return dm_gfxdata->driver->image_data_bytes(data);
+
+  if (dm_gfxdata->driver->image_data_size
+      && dm_gfxdata->driver->image_data_size(data, &w, &h))
+    return (unsigned long) w * h * 4;
+
+  return 0;
+}
+
+/* Replace a low-res image's data with a copy enlarged by the
+   coordinate scaling factor, keeping the original alongside it.  The
+   draw path already scales image coordinates by the same factor, so
+   the enlarged copy can be blitted directly. */
+static void dm_image_enlarge(struct dm_GfxImageNode *node)
+{
+  unsigned short x_factor, y_factor;
+  void *scaled;
+
+  if (dm_gfxdata->driver->scale_image_data == NULL)
+    return;
+
+  x_factor = y_factor = 1;
+  dm_coord_translate(&x_factor, &y_factor, DM_FALSE);
+
+  if ((x_factor <= 1 && y_factor <= 1) || x_factor == 0 || y_factor == 0)
+    return;
+
+  scaled = dm_gfxdata->driver->scale_image_data(node->data,
+                                                x_factor, y_factor);
+
+  if (scaled == NULL) {
+    dm_fatal("GFX: Could not enlarge image; drawing it unscaled.");
+    return;
+  }
+
+  node->lowres = node->data;
+  node->data = scaled;
+}
+
+/* Evict images until the image data fits the budget, using the CLOCK
+   approximation of least-recently-used: the clock hand sweeps the
+   handle table, giving each recently drawn image a second chance by
+   clearing its used flag, and evicting the first image found that has
+   not been drawn since the hand last passed it. */
+static void dm_image_enforce_budget(struct dm_GfxImageNode *keep)
+{
+  struct dm_GfxImageNode *img;
+  unsigned long budget;
+  int scanned;
+
+  budget = dm_gfxdata->conf->gfx_image_budget;
+
+  /* Two sweeps clear every used flag, so if nothing can be evicted by
+     then, give up rather than spin. */
+  for (scanned = 0;
+       budget && dm_gfxdata->image_bytes > budget
+         && scanned < dm_gfxdata->handle_count * 2;
+       scanned++) {
+    if (dm_gfxdata->clock_hand >= dm_gfxdata->handle_count)
+      dm_gfxdata->clock_hand = 0;
+
+    img = dm_gfxdata->handles[dm_gfxdata->clock_hand++];
+
+    if (img == NULL || img == keep || img->pinned || img->size == 0
+        || img->state != DM_IMAGE_READY)
+      continue;
+
+    if (img->used)
+      img->used = DM_FALSE;
+    else
+      dm_image_evict(img);
+  }
+}
+
 int dm_draw_image(const char filename[],
                   unsigned short image_x,
                   unsigned short image_y,
@@ -217,9 +630,16 @@ int dm_draw_image(const char filename[],
 
   img = dm_get_image(filename, NULL);
 
-  /* Image not preloaded - try to load it now. */
+  /* Image not preloaded - try to load it now, or in the background if
+     the game asked for that. */
 
-  if (img == NULL) {
+  if (img == NULL && dm_get_gfx_flag(DM_GFX_ASYNC_AUTOLOAD)) {
+    img = dm_image_node(dm_load_image_async(filename));
+    if (img == NULL) {
+      dm_fatal("GFX: Cannot queue non-preloaded image.");
+      return DM_FAILURE;
+    }
+  } else if (img == NULL) {
     img = dm_load_image(filename);
     if (img == NULL) {
       dm_fatal("GFX: Cannot load non-preloaded image.");
@@ -227,14 +647,105 @@ int dm_draw_image(const char filename[],
     }
   }
 
+  return dm_draw_image_node(img, image_x, image_y, screen_x, screen_y,
+                            width, height);
+}
+
+int dm_draw_image_h(dm_ImageHandle handle,
+                    unsigned short image_x,
+                    unsigned short image_y,
+                    unsigned short screen_x,
+                    unsigned short screen_y,
+                    unsigned short width,
+                    unsigned short height)
+{
+  struct dm_GfxImageNode *img;
+
+  img = dm_image_node (handle);
+
+  if (img == NULL)
+    return DM_FAILURE;
+
+  return dm_draw_image_node(img, image_x, image_y, screen_x, screen_y,
+                            width, height);
+}
+
+static int dm_draw_image_node(struct dm_GfxImageNode *img,
+                              unsigned short image_x,
+                              unsigned short image_y,
+                              unsigned short screen_x,
+                              unsigned short screen_y,
+                              unsigned short width,
+                              unsigned short height)
+{
+  img = dm_image_drawable(img);
+
+  if (img == NULL)
+    return DM_FAILURE;
+
   /* Perform coordinate translation. */
 
   dm_coord_translate(&screen_x, &screen_y, DM_TRUE);
   dm_coord_translate(&image_x, &image_y, DM_FALSE);
   dm_coord_translate(&width, &height, DM_FALSE);
 
+  return dm_draw_image_translated(img, image_x, image_y, screen_x,
+                                  screen_y, width, height);
+}
+
+struct dm_GfxImageNode *dm_image_drawable(struct dm_GfxImageNode *img)
+{
+  /* Evicted images are reloaded on demand, while images still
+     loading in the background are stood in for by the placeholder,
+     if there is one. */
+
+  if (img->state == DM_IMAGE_EVICTED && dm_image_reload(img) == DM_FAILURE)
+    return NULL;
+
+  if (img->state != DM_IMAGE_READY) {
+    img = dm_image_node(dm_gfxdata->placeholder);
+
+    if (img == NULL || img->state != DM_IMAGE_READY)
+      return NULL;
+  }
+
+  img->used = DM_TRUE;
+  return img;
+}
+
+int dm_draw_image_translated(struct dm_GfxImageNode *img,
+                             unsigned short image_x,
+                             unsigned short image_y,
+                             unsigned short screen_x,
+                             unsigned short screen_y,
+                             unsigned short width,
+                             unsigned short height)
+{
+  /* Clip the source rectangle to the image, so that images sharing an
+     atlas page never bleed into each other, then move it to where
+     the image lies in its data. */
+
+  if (img->w) {
+    if (image_x >= img->w || image_y >= img->h)
+      return DM_SUCCESS;
+
+    if (image_x + width > img->w)
+      width = img->w - image_x;
+    if (image_y + height > img->h)
+      height = img->h - image_y;
+  }
+
+  image_x += img->x;
+  image_y += img->y;
+
   /* Then draw the image. >_> */
 
+  dm_dirty_add(screen_x, screen_y, width, height);
+
+  if (dm_get_gfx_flag(DM_GFX_DEFERRED))
+    return dm_queue_image(img, image_x, image_y, screen_x, screen_y,
+                          width, height);
+
   return dm_gfxdata->driver->draw_image(img,
                                         image_x,
                                         image_y,
@@ -244,6 +755,93 @@ int dm_draw_image(const char filename[],
                                         height);
 }
 
+dm_ImageHandle
+dm_image_acquire (const char filename[])
+{
+  struct dm_GfxImageNode *img;
+
+  img = dm_get_image (filename, NULL);
+
+  if (img == NULL)
+    img = dm_load_image (filename);
+
+  if (img == NULL)
+    return DM_IMAGE_NONE;
+
+  return img->handle;
+}
+
+dm_ImageHandle
+dm_image_acquire_blend (const char filename[], int blend)
+{
+  struct dm_GfxImageNode *img;
+
+  img = dm_get_image (filename, NULL);
+
+  if (img)
+    dm_image_set_blend (img->handle, blend);
+  else
+    img = dm_load_image_blend (filename, blend);
+
+  if (img == NULL)
+    return DM_IMAGE_NONE;
+
+  return img->handle;
+}
+
+struct dm_GfxImageNode *
+dm_image_node (dm_ImageHandle handle)
+{
+  if (handle < 0 || handle >= dm_gfxdata->handle_count)
+    return NULL;
+
+  return dm_gfxdata->handles[handle];
+}
+
+const char *
+dm_image_name (dm_ImageHandle handle)
+{
+  struct dm_GfxImageNode *img;
+
+  img = dm_image_node (handle);
+
+  if (img == NULL)
+    return NULL;
+
+  return dm_gfxdata->names + img->name;
+}
+
+static dm_ImageHandle
+dm_image_add_handle (struct dm_GfxImageNode *img)
+{
+  struct dm_GfxImageNode **handles;
+  int max;
+
+  /* Grow the handle table if it is full. */
+  if (dm_gfxdata->handle_count == dm_gfxdata->handle_max)
+    {
+      if (dm_gfxdata->handle_max == 0)
+        max = DM_GFX_HANDLES_INIT;
+      else
+        max = dm_gfxdata->handle_max * 2;
+
+      handles = realloc (dm_gfxdata->handles,
+                         sizeof (struct dm_GfxImageNode *) * max);
+
+      if (handles == NULL)
+        {
+          dm_fatal ("GFX: Could not grow image handle table.");
+          return DM_IMAGE_NONE;
+        }
+
+      dm_gfxdata->handles = handles;
+      dm_gfxdata->handle_max = max;
+    }
+
+  dm_gfxdata->handles[dm_gfxdata->handle_count] = img;
+  return dm_gfxdata->handle_count++;
+}
+
 void dm_fill_rect_rgb(unsigned short x,
                       unsigned short y,
                       unsigned short w,
@@ -255,159 +853,547 @@ void dm_fill_rect_rgb(unsigned short x,
   dm_coord_translate(&x, &y, DM_TRUE);
   dm_coord_translate(&w, &h, DM_FALSE);
 
-  dm_gfxdata->driver->fill_rect_rgb(x, y, w, h, r, g, b);
+  dm_fill_rect_translated(x, y, w, h, r, g, b);
 }
 
-int dm_ascii_hash(const char string[])
+void dm_fill_rect_translated(unsigned short x,
+                             unsigned short y,
+                             unsigned short w,
+                             unsigned short h,
+                             unsigned char r,
+                             unsigned char g,
+                             unsigned char b)
 {
-  unsigned char *p;
-  int h;
+  dm_dirty_add(x, y, w, h);
 
-  h = 0;
+  if (dm_get_gfx_flag(DM_GFX_DEFERRED))
+    dm_queue_fill(x, y, w, h, r, g, b);
+  else
+    dm_gfxdata->driver->fill_rect_rgb(x, y, w, h, r, g, b);
+}
+
+void dm_fill_rect_pal(unsigned short x,
+                      unsigned short y,
+                      unsigned short w,
+                      unsigned short h,
+                      unsigned char index)
+{
+  dm_GfxColour *c;
 
-  /* For each character in the string, multiply the current hash value by the 
-   * hash multiplier and then add the value of the next character.
-   *
-   *  (derived from Kernighan and Pike, ``The Practice of Programming'')
-   */
+  dm_coord_translate(&x, &y, DM_TRUE);
+  dm_coord_translate(&w, &h, DM_FALSE);
 
-  for (p = (unsigned char*) string; *p != '\0'; p++) {
-    h = (DM_GFX_HASH_MUL * h) + *p;
+  /* Drivers with no palette of their own just fill with the entry's
+     colour. */
+  if (dm_gfxdata->driver->fill_rect_pal == NULL) {
+    c = &dm_gfxdata->palette[index];
+    dm_fill_rect_translated(x, y, w, h, c->r, c->g, c->b);
+    return;
   }
 
-  /* Return the modulus so that the value is in between 0 and the hash 
-     value upper bound. */
-  return h % DM_GFX_HASH_VALS;
+  dm_dirty_add(x, y, w, h);
+
+  if (dm_get_gfx_flag(DM_GFX_DEFERRED))
+    dm_queue_fill_pal(x, y, w, h, index);
+  else
+    dm_gfxdata->driver->fill_rect_pal(x, y, w, h, index);
 }
 
-int dm_delete_image(const char name[])
+unsigned long dm_ascii_hash(const char string[])
 {
-  int h;
-  struct dm_GfxImageNode *img, *prev;
+  const unsigned char *p;
+  unsigned long h;
 
-  h = dm_ascii_hash(name);
-  prev = NULL;
-
-  /* Iterate through the hash bucket to find the correct image, then 
-     delete its data and node. */
-  for (img = dm_gfxdata->images[h]; img != NULL; img = prev->next) {
-    if (strcmp(name, img->name) == 0) {
-      if (prev == NULL) {
-        dm_gfxdata->images[h] = img->next;
-      } else {
-        prev->next = img->next;
-      }
-      dm_free_image(img);
-      return DM_SUCCESS;
-    }
+  h = DM_GFX_HASH_BASIS;
+
+  /* For each character in the string, XOR it into the hash value and 
+   * then multiply by the FNV prime.  The mask keeps the result at 32 
+   * bits where unsigned long is wider. */
+
+  for (p = (const unsigned char*) string; *p != '\0'; p++) {
+    h = ((h ^ *p) * DM_GFX_HASH_PRIME) & 0xFFFFFFFFUL;
   }
-  return DM_FAILURE;
+
+  return h;
+}
+
+/* Return how far the entry in the given slot is from its home slot. */
+static DM_INLINE unsigned long
+dm_image_probe_dist (unsigned long slot)
+{
+  unsigned long mask;
+
+  mask = dm_gfxdata->image_slots - 1;
+
+  return (slot - (dm_gfxdata->images[slot].hash & mask)) & mask;
+}
+
+/* Find the slot holding the image with the given name and hash, or 
+   return image_slots if there is none. */
+static unsigned long
+dm_image_find_slot (const char name[], unsigned long hash)
+{
+  dm_GfxImageEntry *e;
+  unsigned long slot, dist, mask;
+
+  mask = dm_gfxdata->image_slots - 1;
+
+  for (slot = hash & mask, dist = 0; ; slot = (slot + 1) & mask, dist++)
+    {
+      e = &dm_gfxdata->images[slot];
+
+      /* An empty slot, or one whose occupant is closer to home than 
+         we are, means the name cannot be further along. */
+      if (e->node == NULL || dm_image_probe_dist (slot) < dist)
+        return dm_gfxdata->image_slots;
+
+      if (e->hash == hash
+          && strcmp (name, dm_gfxdata->names + e->node->name) == 0)
+        return slot;
+    }
+}
+
+/* Insert a node known not to be in the table already, assuming there 
+   is at least one free slot. */
+static void
+dm_image_insert_entry (unsigned long hash, dm_GfxImageNode *node)
+{
+  dm_GfxImageEntry e, tmp;
+  unsigned long slot, dist, mask;
+
+  mask = dm_gfxdata->image_slots - 1;
+  e.hash = hash;
+  e.node = node;
+
+  for (slot = hash & mask, dist = 0; ; slot = (slot + 1) & mask, dist++)
+    {
+      if (dm_gfxdata->images[slot].node == NULL)
+        {
+          dm_gfxdata->images[slot] = e;
+          return;
+        }
+
+      /* Robin Hood: take the slot from any entry that is closer to 
+         its home than we are, and carry on inserting that one. */
+      if (dm_image_probe_dist (slot) < dist)
+        {
+          tmp = dm_gfxdata->images[slot];
+          dm_gfxdata->images[slot] = e;
+          e = tmp;
+          dist = dm_image_probe_dist (slot);
+        }
+    }
+}
+
+/* Double the size of the hash table and rehash everything into it. */
+static int
+dm_image_grow_table (void)
+{
+  dm_GfxImageEntry *old;
+  unsigned long i, old_slots;
+
+  old = dm_gfxdata->images;
+  old_slots = dm_gfxdata->image_slots;
+
+  dm_gfxdata->images = calloc (old_slots * 2, sizeof (dm_GfxImageEntry));
+
+  if (dm_gfxdata->images == NULL)
+    {
+      dm_gfxdata->images = old;
+      return DM_FAILURE;
+    }
+
+  dm_gfxdata->image_slots = old_slots * 2;
+
+  /* The stored hashes mean no names need to be rehashed. */
+  for (i = 0; i < old_slots; i++)
+    {
+      if (old[i].node)
+        dm_image_insert_entry (old[i].hash, old[i].node);
+    }
+
+  free (old);
+  return DM_SUCCESS;
+}
+
+/* Remove the entry in the given slot, shifting back any following 
+   entries that are displaced from their home slots. */
+static void
+dm_image_remove_slot (unsigned long slot)
+{
+  unsigned long next, mask;
+
+  mask = dm_gfxdata->image_slots - 1;
+
+  for (next = (slot + 1) & mask;
+       dm_gfxdata->images[next].node != NULL
+         && dm_image_probe_dist (next) != 0;
+       slot = next, next = (next + 1) & mask)
+    dm_gfxdata->images[slot] = dm_gfxdata->images[next];
+
+  dm_gfxdata->images[slot].node = NULL;
+  dm_gfxdata->image_count--;
+}
+
+/* Rebuild the name pool with only the names of live images. */
+static void
+dm_image_compact_names (void)
+{
+  char *names;
+  unsigned long len, i;
+  dm_GfxImageNode *img;
+
+  names = malloc (dm_gfxdata->names_max);
+
+  if (names == NULL)
+    return; /* Not fatal - the pool is just left fragmented. */
+
+  len = 0;
+
+  for (i = 0; i < dm_gfxdata->image_slots; i++)
+    {
+      img = dm_gfxdata->images[i].node;
+
+      if (img)
+        {
+          strcpy (names + len, dm_gfxdata->names + img->name);
+          img->name = len;
+          len += strlen (names + len) + 1;
+        }
+    }
+
+  free (dm_gfxdata->names);
+  dm_gfxdata->names = names;
+  dm_gfxdata->names_len = len;
+  dm_gfxdata->names_dead = 0;
+}
+
+/* Copy a name into the name pool, returning its offset in the pool or 
+   names_max on failure. */
+static unsigned long
+dm_image_intern_name (const char name[])
+{
+  unsigned long size, max, off;
+  char *names;
+
+  size = strlen (name) + 1;
+
+  /* Reclaim deleted names before growing, if they are worth it. */
+  if (dm_gfxdata->names_len + size > dm_gfxdata->names_max
+      && dm_gfxdata->names_dead > dm_gfxdata->names_max / 2)
+    dm_image_compact_names ();
+
+  if (dm_gfxdata->names_len + size > dm_gfxdata->names_max)
+    {
+      for (max = dm_gfxdata->names_max * 2;
+           dm_gfxdata->names_len + size > max;
+           max *= 2)
+        ;
+
+      names = realloc (dm_gfxdata->names, max);
+
+      if (names == NULL)
+        return dm_gfxdata->names_max;
+
+      dm_gfxdata->names = names;
+      dm_gfxdata->names_max = max;
+    }
+
+  off = dm_gfxdata->names_len;
+  memcpy (dm_gfxdata->names + off, name, size);
+  dm_gfxdata->names_len += size;
+
+  return off;
+}
+
+int dm_delete_image(const char name[])
+{
+  unsigned long slot;
+  struct dm_GfxImageNode *img;
+
+  slot = dm_image_find_slot(name, dm_ascii_hash(name));
+
+  if (slot == dm_gfxdata->image_slots)
+    return DM_FAILURE;
+
+  img = dm_gfxdata->images[slot].node;
+  dm_image_remove_slot(slot);
+
+  dm_gfxdata->names_dead += strlen(dm_gfxdata->names + img->name) + 1;
+
+  if (img->handle != DM_IMAGE_NONE)
+    dm_gfxdata->handles[img->handle] = NULL;
+  dm_free_image(img);
+
+  return DM_SUCCESS;
 }
 
 /* Delete all images. */
 void dm_clear_images(void)
 {
-  int i;
-  struct dm_GfxImageNode *p, *next;
+  unsigned long i;
   
-  for (i = 0; i < DM_GFX_HASH_VALS; i++) {
-    for (p = dm_gfxdata->images[i]; p != NULL; p = next) {
-      next = p->next;
+  for (i = 0; i < dm_gfxdata->image_slots; i++) {
+    if (dm_gfxdata->images[i].node) {
       /* Delete the image data and node */
-      dm_free_image(p);
+      dm_free_image(dm_gfxdata->images[i].node);
+      dm_gfxdata->images[i].node = NULL;
     }
-    dm_gfxdata->images[i] = NULL;
   }
+
+  dm_gfxdata->image_count = 0;
+  dm_gfxdata->names_len = dm_gfxdata->names_dead = 0;
+
+  /* Freeing each image released its atlas space, so the pages should
+     all be gone already; make sure of it. */
+  dm_atlas_clear();
+
+  /* Every image is gone, so the handles can be reissued. */
+  dm_gfxdata->handle_count = 0;
+  dm_gfxdata->clock_hand = 0;
 }
 
 struct dm_GfxImageNode *dm_get_image(const char name[], 
                                      struct dm_GfxImageNode *add_pointer)
 {
-  int h; 
+  unsigned long h, slot; 
   struct dm_GfxImageNode *img;
 
-  /* Get the hash of the image's filename so we can search in the correct 
-     bucket. */
+  /* Get the hash of the image's filename; it is compared before the 
+     name itself, so most mismatches never touch the name pool. */
   h = dm_ascii_hash(name);
 
   /* Now try to find the image. */
-  for (img = dm_gfxdata->images[h]; img != NULL; img = img->next) {
-    if (strcmp(name, img->name) == 0) {
+  slot = dm_image_find_slot(name, h);
+
+  if (slot != dm_gfxdata->image_slots) {
+    img = dm_gfxdata->images[slot].node;
+
+    /* If there is a pointer to add, then replace the found image's 
+       data with the new pointer's data. */
+
+    if (add_pointer) {
+      dm_image_free_data(img);
+      img->data = add_pointer->data;
+      img->page = add_pointer->page;
+      img->x = add_pointer->x;
+      img->y = add_pointer->y;
+      img->w = add_pointer->w;
+      img->h = add_pointer->h;
+      img->lowres = add_pointer->lowres;
+      img->pack = add_pointer->pack;
+      img->blend = add_pointer->blend;
+      img->state = add_pointer->state;
+      img->used = add_pointer->used;
+      img->size = add_pointer->size;
+      free(add_pointer);
+      dm_debug("GFX: Found existing image but have new pointer, overwriting.");
+    }
 
-      /* If there is a pointer to add, then replace the found image's 
-         data with the new pointer's data. */
+    return img;
+  }
 
-      if (add_pointer) {
-        dm_free_image(img->data);
-        img->data = add_pointer->data;
-        dm_debug("GFX: Found existing image but have new pointer, overwriting.");
-      }
+  /* Return NULL if there is nothing to add. */
+  if (add_pointer == NULL)
+    return NULL;
 
-      return img;
-    }
+  /* Otherwise, add the image, growing the table first if it would 
+     become too full. */
+  if ((dm_gfxdata->image_count + 1) * 100
+      > dm_gfxdata->image_slots * DM_GFX_HASH_MAX_LOAD
+      && dm_image_grow_table() == DM_FAILURE) {
+    dm_fatal("GFX: Could not grow image table for %s.", name);
+    dm_free_image(add_pointer);
+    return NULL;
   }
 
-  /* If we are given a pointer to add, and the image doesn't already 
-     exist, then add the image to the start of the linked list. */
-  if (add_pointer) {
-    add_pointer->next = dm_gfxdata->images[h];
-    dm_gfxdata->images[h] = add_pointer;
-    return dm_gfxdata->images[h];
+  add_pointer->name = dm_image_intern_name(name);
+
+  if (add_pointer->name == dm_gfxdata->names_max) {
+    dm_fatal("GFX: Could not store name of image %s.", name);
+    dm_free_image(add_pointer);
+    return NULL;
   }
 
-  /* Return NULL, if all else fails. */
-  return NULL;
+  add_pointer->handle = dm_image_add_handle(add_pointer);
+  dm_image_insert_entry(h, add_pointer);
+  dm_gfxdata->image_count++;
+
+  return add_pointer;
+}
+
+/* Work out how the logical screen fits onto the real one once,
+   rather than on every translation, and set up the low-res
+   backbuffer if asked to. */
+static int
+dm_gfx_init_scale (dm_Config *conf)
+{
+  dm_GfxViewport *v;
+  dm_GfxScale *s;
+
+  v = &dm_gfxdata->viewport;
+
+  if (dm_viewport_init (v, conf->gfx_screen_width,
+                        conf->gfx_screen_height) == DM_FAILURE)
+    return DM_FAILURE;
+
+  s = &dm_gfxdata->translate;
+  dm_gfxdata->width = conf->gfx_screen_width;
+  dm_gfxdata->height = conf->gfx_screen_height;
+
+  /* With the backbuffer, everything is drawn at low-res scale, and
+     only enlarged when presented, so the enlargement can be by any
+     fraction. */
+  if ((conf->gfx_flags & DM_GFX_LOWRES_BUFFER)
+      && (conf->gfx_flags & DM_GFX_AUTO_TRANSLATE)
+      && v->scale > 0
+      && dm_gfxdata->driver->init_lowres_buffer
+      && dm_gfxdata->driver->init_lowres_buffer (DM_LOWRES_WIDTH,
+                                                 DM_LOWRES_HEIGHT,
+                                                 v))
+    {
+      dm_debug ("GFX: Drawing to a low-res backbuffer, enlarged to "
+                "%ux%u.", v->width, v->height);
+
+      s->x_scale = s->y_scale = 1;
+      s->x_offset = s->y_offset = 0;
+      dm_gfxdata->width = DM_LOWRES_WIDTH;
+      dm_gfxdata->height = DM_LOWRES_HEIGHT;
+      return DM_SUCCESS;
+    }
+
+  /* Otherwise images are enlarged by whole factors, so the screen
+     must be too. */
+  dm_viewport_set_scale (v, v->scale & ~((1UL << DM_VIEWPORT_SHIFT) - 1));
+
+  s->x_scale = s->y_scale = (unsigned short) (v->scale
+                                              >> DM_VIEWPORT_SHIFT);
+  s->x_offset = v->x_offset;
+  s->y_offset = v->y_offset;
+
+  return DM_SUCCESS;
 }
 
 void
 dm_coord_translate (unsigned short *xp, unsigned short *yp, 
                     unsigned short centre)
 {
-  /* Work out screen width and height multiples of low-res width and 
-     height. */
-
-  div_t wdiv, hdiv;
+  dm_GfxScale *s;
 
-  wdiv = div (dm_gfxdata->conf->gfx_screen_width, DM_LOWRES_WIDTH);
-  hdiv = div (dm_gfxdata->conf->gfx_screen_height, DM_LOWRES_HEIGHT);
+  s = &dm_gfxdata->translate;
 
   if (centre)
     {
       /* Multiply and centre the coordinates. */
-      *xp = (*xp * wdiv.quot) + (wdiv.rem / 2);
-      *yp = (*yp * hdiv.quot) + (hdiv.rem / 2);
+      *xp = (*xp * s->x_scale) + s->x_offset;
+      *yp = (*yp * s->y_scale) + s->y_offset;
     }
   else
     {
       /* Just multiply the coordinates. */
-      *xp *= wdiv.quot;
-      *yp *= hdiv.quot;
+      *xp *= s->x_scale;
+      *yp *= s->y_scale;
   }
 }
 
+void
+dm_coord_translate_screen (unsigned short *xp, unsigned short *yp,
+                           unsigned short centre)
+{
+  dm_GfxViewport *v;
+
+  v = &dm_gfxdata->viewport;
+
+  if (centre && *xp <= DM_LOWRES_WIDTH)
+    *xp = v->x_table[*xp];
+  else
+    *xp = dm_viewport_scale (*xp, v->scale) + (centre ? v->x_offset : 0);
+
+  if (centre && *yp <= DM_LOWRES_HEIGHT)
+    *yp = v->y_table[*yp];
+  else
+    *yp = dm_viewport_scale (*yp, v->scale) + (centre ? v->y_offset : 0);
+}
+
 void
 dm_coord_detranslate (unsigned short *xp, unsigned short *yp, 
                       unsigned short decentre)
 {
-  /* Work out screen width and height multiples of low-res width and 
-     height. */
+  /* Input comes in real screen co-ordinates, whatever is drawn to. */
+  dm_coord_detranslate_array (xp, yp, 1, decentre);
+}
+
+void
+dm_coord_translate_array (unsigned short xs[],
+                          unsigned short ys[],
+                          unsigned long count,
+                          unsigned short centre)
+{
+  dm_GfxScale *s;
+
+  s = &dm_gfxdata->translate;
+
+  if (xs)
+    dm_viewport_scale_array (xs, count,
+                             (unsigned long) s->x_scale
+                             << DM_VIEWPORT_SHIFT,
+                             centre ? s->x_offset : 0);
+  if (ys)
+    dm_viewport_scale_array (ys, count,
+                             (unsigned long) s->y_scale
+                             << DM_VIEWPORT_SHIFT,
+                             centre ? s->y_offset : 0);
+}
+
+void
+dm_coord_translate_screen_array (unsigned short xs[],
+                                 unsigned short ys[],
+                                 unsigned long count,
+                                 unsigned short centre)
+{
+  dm_GfxViewport *v;
 
-  div_t wdiv, hdiv;
+  v = &dm_gfxdata->viewport;
 
-  wdiv = div(dm_gfxdata->conf->gfx_screen_width, DM_LOWRES_WIDTH);
-  hdiv = div(dm_gfxdata->conf->gfx_screen_height, DM_LOWRES_HEIGHT);
+  if (xs)
+    dm_viewport_scale_array (xs, count, v->scale,
+                             centre ? v->x_offset : 0);
+  if (ys)
+    dm_viewport_scale_array (ys, count, v->scale,
+                             centre ? v->y_offset : 0);
+}
+
+void
+dm_coord_detranslate_array (unsigned short xs[],
+                            unsigned short ys[],
+                            unsigned long count,
+                            unsigned short decentre)
+{
+  dm_GfxViewport *v;
+  unsigned long i;
+
+  v = &dm_gfxdata->viewport;
 
   if (decentre)
     {
-      /* De-centre and divide the coordinates. */
-      *xp = (*xp - (wdiv.rem / 2)) / wdiv.quot;
-      *yp = (*yp - (hdiv.rem / 2)) / hdiv.quot;
+      /* Positions are looked up in the inverse tables. */
+      if (xs)
+        dm_viewport_lookup_array (xs, count, v->x_inverse, v->screen_w);
+      if (ys)
+        dm_viewport_lookup_array (ys, count, v->y_inverse, v->screen_h);
     }
-  else
+  else if (v->scale > 0)
     {
       /* Just divide the coordinates. */
-      *xp /= wdiv.quot;
-      *xp /= hdiv.quot;
+      for (i = 0; i < count; i++)
+        {
+          if (xs)
+            xs[i] = (unsigned short) (((unsigned long) xs[i]
+                                       << DM_VIEWPORT_SHIFT) / v->scale);
+          if (ys)
+            ys[i] = (unsigned short) (((unsigned long) ys[i]
+                                       << DM_VIEWPORT_SHIFT) / v->scale);
+        }
     }
 }
 
@@ -426,8 +1412,8 @@ dm_coord_map (unsigned short *xp, unsigned short *yp,
     }
   else
     {
-      width = dm_gfxdata->conf->gfx_screen_width;
-      height = dm_gfxdata->conf->gfx_screen_height;
+      width = dm_gfxdata->width;
+      height = dm_gfxdata->height;
     }
 
   switch (refpoint)
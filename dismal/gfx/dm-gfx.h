@@ -29,15 +29,38 @@
 #define __DM_GFX_H__
 
 #include "../dismal.h"
+#include "dm-gfx-pixel.h"
+#include "dm-gfx-blit.h"
+#include "dm-gfx-queue.h"
+#include "dm-gfx-dirty.h"
+#include "dm-gfx-palette.h"
 
 typedef struct dm_GfxImageNode dm_GfxImageNode;
+typedef struct dm_GfxImageEntry dm_GfxImageEntry;
 typedef struct dm_GfxData dm_GfxData;
 typedef struct dm_GfxDriver dm_GfxDriver;
 typedef struct dm_GfxDriverSpec dm_GfxDriverSpec;
+typedef struct dm_GfxScale dm_GfxScale;
+typedef struct dm_GfxViewport dm_GfxViewport;
+typedef struct dm_GfxBandTiming dm_GfxBandTiming;
+
+/** A handle to a loaded image.
+ *
+ *  Handles are small integers indexing the image handle table, so
+ *  drawing through a handle costs an array lookup rather than a hash
+ *  of the image's filename.
+ */
+typedef int dm_ImageHandle;
 
 /* Global variables */
 extern dm_GfxData *dm_gfxdata;
 
+/* Image name hash constants.  These are the 32-bit FNV-1a offset
+   basis and prime; they do not fit in an int, so cannot live in the
+   enumeration below. */
+#define DM_GFX_HASH_BASIS 2166136261UL
+#define DM_GFX_HASH_PRIME 16777619UL
+
 enum {
   /* Low-res reference screen dimensions. */
   DM_LOWRES_WIDTH = 320, /**< Width of LowRes screen. */
@@ -47,23 +70,112 @@ enum {
                                      images will be assumed low-res and 
                                      automatically scaled up to fill a
                                      high-res screen. */
+  DM_GFX_ASYNC_AUTOLOAD = (1<<1), /**< If set, drawing an image that has
+                                     not been loaded queues it for
+                                     loading in the background and
+                                     skips the draw, instead of loading
+                                     it there and then. */
+  DM_GFX_LOWRES_IMAGES  = (1<<2), /**< If set, images are assumed to
+                                     be drawn at low-res scale, and
+                                     are enlarged once at load time
+                                     by the coordinate scaling factor,
+                                     so that drawing them needs no
+                                     scaling.  Leave this unset if
+                                     images are already drawn at the
+                                     screen's scale. */
+  DM_GFX_DEFERRED       = (1<<3), /**< If set, draws are queued, and
+                                     submitted to the driver in one
+                                     sorted and merged batch by
+                                     dm_gfx_update(). */
+  DM_GFX_LOWRES_BUFFER  = (1<<4), /**< If set when the graphics
+                                     subsystem starts, along with
+                                     DM_GFX_AUTO_TRANSLATE, drawing
+                                     goes to a 320x200 backbuffer at
+                                     low-res scale, and
+                                     dm_gfx_update() enlarges it onto
+                                     the screen in one pass, by as
+                                     much as fits, even if that is a
+                                     fraction.  Images are drawn at
+                                     their own size, so they must be
+                                     low-res ones.  This is ignored
+                                     if the driver cannot do it. */
+  DM_GFX_PALETTED       = (1<<5), /**< If set when the graphics
+                                     subsystem starts, drawing is
+                                     done in 8-bit, as indices into
+                                     the logical palette, which
+                                     dm_gfx_update() looks up to
+                                     present them.  Images are
+                                     remapped to the palette when
+                                     loaded, and changing the palette
+                                     recolours the whole screen
+                                     without redrawing it.  This is
+                                     cleared if the driver cannot do
+                                     it. */
+  DM_GFX_PIPELINED      = (1<<6), /**< If set when the graphics
+                                     subsystem starts, along with
+                                     DM_GFX_DEFERRED, dm_gfx_update()
+                                     hands each frame to a render
+                                     thread, which draws and presents
+                                     it while the game gets on with
+                                     the next (see
+                                     gfx_command_buffers in
+                                     dm_Config).  This is cleared if
+                                     the driver must present on the
+                                     main thread. */
+
+  DM_GFX_HASH_MIN_SLOTS = 16, /**< Initial number of slots in the
+                                 image hash table.  This must be a
+                                 power of two. */
+
+  DM_GFX_HASH_MAX_LOAD = 80, /**< Maximum load factor of the image
+                                hash table, as a percentage of its
+                                slots; the table doubles in size
+                                when an insertion would exceed it. */
+
+  DM_GFX_NAMES_INIT = 256, /**< Initial size of the image name pool,
+                              in bytes; it doubles whenever it fills. */
 
-  DM_GFX_HASH_NAME_LEN = 100, /**< Maximum size of the part of the
-                                 image filename used by the hashing
-                                 function. If the filename (relative
-                                 to the image directory) is larger,
-                                 then an error will be tripped. */
+  DM_IMAGE_NONE = -1, /**< Handle value returned when an image could
+                         not be acquired. */
 
-  DM_GFX_HASH_VALS = 10, /**< Number of hash values used in the image
-                            hash table, and therefore the number of
-                            separate linked lists. Increasing this
-                            may increase performance. */
+  /* Image node states. */
 
-  DM_GFX_HASH_MUL  = 31, /**< Hash value used in the image hash table
-                            algorithms. This value is taken from
-                            Kernighan and Pike's ``The Practice of
-                            Programming'', as is the algorithmic
-                            concept. */
+  DM_IMAGE_READY   = 0, /**< The image is loaded and can be drawn. */
+  DM_IMAGE_LOADING = 1, /**< The image is being loaded in the
+                           background, and has no data yet. */
+  DM_IMAGE_FAILED  = 2, /**< The image failed to load in the
+                           background, and has no data. */
+  DM_IMAGE_EVICTED = 3, /**< The image's data was evicted to stay
+                           within the image memory budget, and will
+                           be reloaded when next drawn. */
+
+  /* Image blend modes. */
+
+  DM_BLEND_KEYED    = 0, /**< Pixels of the colour key (magenta) are
+                            transparent, and the rest are drawn as
+                            they are.  Images are loaded this way
+                            unless asked otherwise. */
+  DM_BLEND_OPAQUE   = 1, /**< Every pixel is drawn as it is. */
+  DM_BLEND_ALPHA    = 2, /**< Pixels are blended by the alpha channel
+                            of the image file, whose colours are not
+                            multiplied by it (straight alpha); they
+                            are premultiplied once, at load time. */
+  DM_BLEND_PREMULTIPLIED = 3, /**< As DM_BLEND_ALPHA, but the image
+                                 file's colours are already multiplied
+                                 by its alpha. */
+  DM_BLEND_ADDITIVE = 4, /**< Pixels, multiplied by their straight
+                            alpha, are added to what lies beneath
+                            them. */
+
+  DM_GFX_HANDLES_INIT = 16, /**< Initial size of the image handle
+                               table; it doubles whenever it fills. */
+
+  DM_GFX_BANDS_MAX = 16, /**< Most horizontal bands a batch of deferred
+                            draws is split into for the render
+                            threads. */
+  DM_GFX_BAND_ROWS = 16, /**< Fewest rows of the screen in a band;
+                            screens too short to give every thread a
+                            band this tall get fewer bands. */
 
   /* Coordinate reference point IDs.*/
 
@@ -82,10 +194,119 @@ enum {
  */
 struct dm_GfxImageNode
 {
-  char name[DM_GFX_HASH_NAME_LEN]; /**< Name used to identify the
-                                      image. */
-  void *data;                   /**< Driver-dependent image data. */
-  struct dm_GfxImageNode *next; /**< The next node, if any. */
+  unsigned long name;    /**< Offset of the name used to identify the
+                            image in the image name pool.  Use
+                            dm_image_name() to read it. */
+  void *data;            /**< Driver-dependent image data.  If the
+                            image is in an atlas page, this is the
+                            page's data. */
+  void *lowres;          /**< The image's original data, if data
+                            holds an enlarged copy of it made for
+                            DM_GFX_LOWRES_IMAGES; NULL otherwise. */
+  dm_ImageHandle handle; /**< Handle of this image in the handle
+                            table. */
+  unsigned short x;      /**< X offset of the image within data. */
+  unsigned short y;      /**< Y offset of the image within data. */
+  unsigned short w;      /**< Width of the image, or 0 if unknown. */
+  unsigned short h;      /**< Height of the image, or 0 if unknown. */
+  struct dm_GfxAtlasPage *page; /**< Atlas page holding the image, or
+                                   NULL if the image has its own
+                                   data. */
+  struct dm_GfxPack *pack; /**< Mounted pack the image's pixels lie
+                              in, or NULL if it was loaded from a
+                              file. */
+  unsigned char state;   /**< State of the image (DM_IMAGE_READY,
+                            DM_IMAGE_LOADING, DM_IMAGE_FAILED or
+                            DM_IMAGE_EVICTED). */
+  unsigned char used;    /**< Set whenever the image is drawn, and
+                            cleared as the eviction clock passes. */
+  unsigned char pinned;  /**< If non-zero, the image is never
+                            evicted. */
+  unsigned char blend;   /**< How the image is drawn (one of the
+                            DM_BLEND_ modes). */
+  unsigned long size;    /**< Bytes of image data counted against the
+                            image memory budget: the image's own
+                            data, unless it is in an atlas page, plus
+                            any low-res original.  Images with a size
+                            of 0 are never evicted. */
+};
+
+
+/** A mapping from the low-res logical screen to pixels: each
+ *  co-ordinate is multiplied by the scale, and screen positions also
+ *  have the offset added to centre them.
+ */
+struct dm_GfxScale
+{
+  unsigned short x_scale;  /**< Horizontal scaling factor. */
+  unsigned short y_scale;  /**< Vertical scaling factor. */
+  unsigned short x_offset; /**< Horizontal centring offset. */
+  unsigned short y_offset; /**< Vertical centring offset. */
+};
+
+
+/** The mapping from the low-res logical screen onto the real one,
+ *  worked out once when the screen is set up.
+ *
+ *  The logical screen is enlarged equally both ways, so it keeps its
+ *  shape, and centred.  The scale is in 16.16 fixed point; it is only
+ *  fractional when drawing to the low-res backbuffer, as images
+ *  drawn straight to the screen are enlarged by whole factors.
+ *
+ *  The tables give, for each logical co-ordinate (and one past the
+ *  last), the real one at its top-left; and for each real
+ *  co-ordinate, the logical one shown there.
+ */
+struct dm_GfxViewport
+{
+  unsigned long scale;      /**< Real pixels per logical pixel, in
+                               16.16 fixed point. */
+  unsigned short x_offset;  /**< Horizontal centring offset. */
+  unsigned short y_offset;  /**< Vertical centring offset. */
+  unsigned short width;     /**< Width of the enlarged logical
+                               screen. */
+  unsigned short height;    /**< Height of the enlarged logical
+                               screen. */
+  unsigned short screen_w;  /**< Width of the real screen. */
+  unsigned short screen_h;  /**< Height of the real screen. */
+  unsigned short x_table[DM_LOWRES_WIDTH + 1]; /**< Real X
+                                                  co-ordinate of each
+                                                  logical one. */
+  unsigned short y_table[DM_LOWRES_HEIGHT + 1]; /**< Real Y
+                                                   co-ordinate of
+                                                   each logical
+                                                   one. */
+  unsigned short *x_inverse; /**< Logical X co-ordinate of each real
+                                one (screen_w entries). */
+  unsigned short *y_inverse; /**< Logical Y co-ordinate of each real
+                                one (screen_h entries). */
+};
+
+
+/** A slot in the open-addressed image hash table.
+ *
+ *  The table uses Robin Hood linear probing: the full hash is kept in
+ *  the slot so that lookups can reject most non-matching slots, and
+ *  compute probe distances, without touching the node or its name.
+ */
+struct dm_GfxImageEntry
+{
+  unsigned long hash;    /**< Full hash of the image's name. */
+  dm_GfxImageNode *node; /**< The image node, or NULL if the slot is
+                            empty. */
+};
+
+
+/** How long it took to draw one band of a batch of deferred draws,
+ *  when the batch was split between the render threads.
+ */
+struct dm_GfxBandTiming
+{
+  unsigned short y;       /**< Top row of the band. */
+  unsigned short height;  /**< Number of rows in the band. */
+  unsigned long commands; /**< Number of draw commands that touched
+                             the band. */
+  unsigned long usecs;    /**< Microseconds spent drawing the band. */
 };
 
 
@@ -93,7 +314,54 @@ struct dm_GfxData
 {
   dm_Config *conf;      /**< Pointer to the configuration structure. */
   dm_GfxDriver *driver; /**< Pointer to the driver function table. */
-  dm_GfxImageNode *images[DM_GFX_HASH_VALS]; /**< Image hash table. */
+  unsigned short width;  /**< Width of what is drawn to: the screen,
+                            or the low-res backbuffer. */
+  unsigned short height; /**< Height of what is drawn to. */
+  dm_GfxScale translate; /**< Mapping applied to drawing
+                            co-ordinates by dm_coord_translate(). */
+  dm_GfxViewport viewport; /**< Mapping from the logical screen to
+                              the real one, used for input. */
+  dm_GfxColour palette[DM_PALETTE_SIZE]; /**< The logical palette. */
+  unsigned char *palette_lut; /**< Closest palette entry to each cell
+                                 of RGB space, or NULL when not
+                                 drawing in 8-bit. */
+  dm_GfxImageEntry *images; /**< Image hash table. */
+  unsigned long image_slots; /**< Number of slots in the image hash
+                                table (always a power of two). */
+  unsigned long image_count; /**< Number of images in the table. */
+  char *names;               /**< Image name pool.  Names are stored
+                                end to end, each NUL-terminated. */
+  unsigned long names_len;   /**< Bytes of the name pool in use. */
+  unsigned long names_max;   /**< Allocated size of the name pool. */
+  unsigned long names_dead;  /**< Bytes of the name pool belonging to
+                                deleted images, reclaimed when the
+                                pool is next compacted. */
+  struct dm_GfxAtlasPage *atlas; /**< Linked list of atlas pages. */
+  struct dm_GfxLoader *loader;   /**< Background image loader. */
+  struct dm_GfxPack *packs;      /**< Linked list of mounted packs,
+                                    newest first. */
+  struct dm_GfxQueue *queue;     /**< Deferred draw command queue. */
+  dm_GfxDirty dirty;             /**< Regions of the screen drawn to
+                                    this frame. */
+  struct dm_GfxSprites *sprites; /**< Retained sprite store. */
+  struct dm_GfxTextCache *text;  /**< Cache of rendered strings. */
+  dm_ImageHandle placeholder;    /**< Image drawn in place of images
+                                    that are not yet loaded, or
+                                    DM_IMAGE_NONE. */
+  dm_GfxImageNode **handles; /**< Image handle table, indexed by
+                                dm_ImageHandle.  Deleted images leave
+                                a NULL entry. */
+  int handle_count; /**< Number of handles issued so far. */
+  int handle_max;   /**< Allocated size of the handle table. */
+  unsigned long image_bytes; /**< Bytes of image data counted against
+                                the image memory budget. */
+  int clock_hand;   /**< Handle the eviction clock will examine
+                       next. */
+  struct dm_GfxRecorder *recorder; /**< Frame recorder, or NULL when
+                                      not recording. */
+  struct dm_GfxPipeline *pipeline; /**< Render thread, or NULL when
+                                      frames are presented by
+                                      dm_gfx_update(). */
 };
 
 
@@ -110,6 +378,60 @@ struct dm_GfxDriverSpec
 
 
 /** A function table for a graphics driver.
+ *
+ *  decode_image_data loads image data from a file and must be safe
+ *  to call from any thread, while finish_image_data prepares the
+ *  decoded data for drawing on the main thread (load_image_data
+ *  should be equivalent to the two in turn); decoded data can be
+ *  freed with free_image_data.
+ *
+ *  create_image_data creates blank, fully transparent image data;
+ *  copy_image_data copies pixels verbatim (ignoring transparency)
+ *  from one image's data to another's, failing if the source cannot
+ *  be represented in the destination; image_data_size retrieves the
+ *  dimensions of image data; image_data_bytes retrieves the memory
+ *  used by image data, in bytes; scale_image_data creates a copy of
+ *  image data enlarged by integer factors; image_data_from_pixels
+ *  creates image data that uses the given pixels in place (they
+ *  must not be written to, and outlive the data); submit_batch
+ *  draws a frame's worth of queued commands (DM_GFX_DEFERRED), in the
+ *  order given; update_rects presents only the given regions of the
+ *  screen, rather than all of it as update does; init_lowres_buffer
+ *  makes everything draw into a width by height buffer instead of
+ *  the screen, which update and update_rects enlarge onto the screen
+ *  through the viewport's tables (the viewport outlives the
+ *  buffer); init_paletted makes everything draw as 8-bit logical
+ *  palette indices (DM_GFX_PALETTED), which update and update_rects
+ *  look up in the palette last given to set_palette.
+ *
+ *  fill_rect_pal fills with a logical palette entry; set_palette
+ *  tells the driver that count entries of the logical palette,
+ *  starting at first, have changed to the given colours.
+ *
+ *  band_timings retrieves, top first, the timings of the bands that
+ *  the last batch given to submit_batch was split into for the render
+ *  threads, returning how many it filled (0 if the batch was not
+ *  split).
+ *
+ *  read_pixels reads back a region of what was last presented, in the
+ *  co-ordinates drawn to, as red, green and blue bytes row after row;
+ *  it is used to record frames (dm_record_start).
+ *
+ *  init_render_thread prepares for update, update_rects,
+ *  submit_batch and read_pixels to be called from a render thread
+ *  rather than the one that initialised the driver
+ *  (DM_GFX_PIPELINED), failing if the driver cannot allow that; the
+ *  other functions stay on the main thread, and are never called
+ *  while the render thread is drawing.
+ *
+ *  blend_image_data prepares image data, as loaded, to be drawn with
+ *  the given DM_BLEND_ mode (premultiplying straight alpha, for
+ *  instance), returning the prepared data, which may replace and free
+ *  the original, or NULL, leaving the original untouched, if the
+ *  driver cannot draw that mode; draw_image and submit_batch then
+ *  find the mode in the image node.  Every image loaded is passed to
+ *  it, in DM_BLEND_KEYED mode too, which it must accept, so that
+ *  drivers can colour key images only in the modes that key them.
  */
 struct dm_GfxDriver
 {
@@ -145,16 +467,83 @@ struct dm_GfxDriver
                     unsigned int w,
                     unsigned int h,
                     unsigned int index); 
+
+  /* The following are optional and may be left NULL; features that
+     need them (such as atlasing) are then disabled. */
+
+  void*
+  (*create_image_data) (unsigned int width,
+                        unsigned int height);
+  int
+  (*copy_image_data) (void *dest,
+                      void *src,
+                      unsigned int src_x,
+                      unsigned int src_y,
+                      unsigned int dest_x,
+                      unsigned int dest_y,
+                      unsigned int width,
+                      unsigned int height);
+  int
+  (*image_data_size) (void *data,
+                      unsigned int *width,
+                      unsigned int *height);
+  void*
+  (*decode_image_data) (const char filename[]);
+  void*
+  (*finish_image_data) (void *decoded);
+  unsigned long
+  (*image_data_bytes) (void *data);
+  void*
+  (*scale_image_data) (void *data,
+                       unsigned int x_factor,
+                       unsigned int y_factor);
+  void*
+  (*image_data_from_pixels) (const void *pixels,
+                             unsigned int width,
+                             unsigned int height,
+                             unsigned int pitch,
+                             const dm_GfxPixelFormat *format);
+  void
+  (*submit_batch) (const dm_GfxCommand *cmds,
+                   unsigned long count);
+  void
+  (*update_rects) (const dm_GfxRect *rects,
+                   int count);
+  int
+  (*init_lowres_buffer) (unsigned int width,
+                         unsigned int height,
+                         const dm_GfxViewport *viewport);
+  int
+  (*init_paletted) (void);
+  void
+  (*set_palette) (const dm_GfxColour colours[],
+                  unsigned int first,
+                  unsigned int count);
+  int
+  (*band_timings) (dm_GfxBandTiming timings[],
+                   int max);
+  int
+  (*read_pixels) (const dm_GfxRect *rect,
+                  unsigned char *dest);
+  int
+  (*init_render_thread) (void);
+  void*
+  (*blend_image_data) (void *data,
+                       int blend);
 };
 
 
 /** Select the driver and register it.
+ *
+ *  @param name  The name of the driver to use (eg "sdl-opengl"), or
+ *  NULL for the first one compiled in, which is also used if the
+ *  named driver is not.
  *
  *  @return non-zero (DM_SUCCESS) for success, zero (DM_FAILURE) for
  *  failure.
  */
 
-int dm_gfx_select_driver(void);
+int dm_gfx_select_driver(const char *name);
 
 
 /** Initialise DISMAL's graphics subsystem.
@@ -180,6 +569,21 @@ void dm_gfx_update(void);
  */
 void dm_gfx_cleanup(void);
 
+
+/** Retrieve how long each band of the last batch of deferred draws
+ *  took to draw.
+ *
+ *  Batches are only split into bands when there are render threads
+ *  (see dm_set_render_threads), and the driver can split them.
+ *
+ *  @param timings  Array to fill with the timings, top band first.
+ *  @param max      Number of entries in timings.
+ *
+ *  @return the number of entries filled, which is 0 if the last batch
+ *  was not split.
+ */
+int dm_gfx_band_timings(dm_GfxBandTiming timings[], int max);
+
 /** Load an image.
  *
  *  This loads the image of given filename from the predesignated
@@ -198,6 +602,23 @@ void dm_gfx_cleanup(void);
 struct dm_GfxImageNode *dm_load_image(const char filename[]);
 
 
+/** Load an image, to be drawn with the given blend mode.
+ *
+ *  This is as dm_load_image(), but the image is drawn with the given
+ *  blend mode rather than colour keyed.  If the driver cannot draw
+ *  that mode, the image is colour keyed after all.
+ *
+ *  @param filename  The name of the image file (eg boom.png).
+ *  @param blend     The blend mode (eg DM_BLEND_ALPHA).
+ *
+ *  @return  A pointer to the image node encapsulating the image
+ *           data.
+ */
+
+struct dm_GfxImageNode *dm_load_image_blend(const char filename[],
+                                            int blend);
+
+
 /** De-allocate an image node.
  *
  *  This should be used instead of free, to ensure that the
@@ -223,7 +644,13 @@ void dm_free_image(struct dm_GfxImageNode *node);
  *
  *  @note  If the image has not yet been loaded into memory with
  *  dm_load_image, the image will be automatically loaded.  This may
- *  cause a delay as the disk is accessed.
+ *  cause a delay as the disk is accessed.  If DM_GFX_ASYNC_AUTOLOAD
+ *  is set, the image is instead queued with dm_load_image_async and
+ *  the placeholder image, if any, is drawn until it is ready.
+ *
+ *  @note  This looks the image up by name on every call.  Images
+ *  drawn every frame should instead be acquired once with
+ *  dm_image_acquire() and drawn with dm_draw_image_h().
  *
  *  @param filename  Filename of the image.
  *  @param image_x   The X-coordinate of the on-image rectangle to
@@ -248,12 +675,104 @@ int dm_draw_image(const char filename[],
                   unsigned short height);
 
 
+/** Acquire a handle to an image.
+ *
+ *  This finds the image of the given filename, loading it if it has
+ *  not yet been loaded, and returns its handle.  The handle stays
+ *  valid until the image is deleted with dm_delete_image() or
+ *  dm_clear_images(); handles are never reissued to a different
+ *  image before dm_clear_images() is called.
+ *
+ *  Acquire handles for frequently drawn images up front and draw
+ *  them with dm_draw_image_h(), which avoids hashing the filename
+ *  on every draw.
+ *
+ *  @param filename  The name of the image file (eg boom.png).
+ *
+ *  @return  the image's handle, or DM_IMAGE_NONE if it could not be
+ *           loaded.
+ */
+
+dm_ImageHandle dm_image_acquire(const char filename[]);
+
+
+/** Acquire a handle to an image, to be drawn with the given blend
+ *  mode.
+ *
+ *  This is as dm_image_acquire(), but loads the image with
+ *  dm_load_image_blend(), or, if it is already loaded, changes its
+ *  blend mode with dm_image_set_blend().
+ *
+ *  @param filename  The name of the image file (eg boom.png).
+ *  @param blend     The blend mode (eg DM_BLEND_ALPHA).
+ *
+ *  @return  the image's handle, or DM_IMAGE_NONE if it could not be
+ *           loaded.
+ */
+
+dm_ImageHandle dm_image_acquire_blend(const char filename[], int blend);
+
+
+/** Retrieve the image node behind a handle.
+ *
+ *  @param handle  The handle of the image.
+ *
+ *  @return  a pointer to the image node, or NULL if the handle is
+ *           invalid or the image has since been deleted.
+ */
+
+struct dm_GfxImageNode *dm_image_node(dm_ImageHandle handle);
+
+
+/** Retrieve the filename of the image behind a handle.
+ *
+ *  @param handle  The handle of the image.
+ *
+ *  @return  the filename, or NULL if the handle is invalid.
+ */
+
+const char *dm_image_name(dm_ImageHandle handle);
+
+
+/** Draw an image on-screen, given its handle.
+ *
+ *  This behaves exactly as dm_draw_image(), except that the image is
+ *  given by a handle from dm_image_acquire() or dm_load_image_async()
+ *  and is never loaded automatically.  If the image is still loading
+ *  in the background, the placeholder image (if any) is drawn
+ *  instead.
+ *
+ *  @see dm_draw_image
+ *
+ *  @param handle    Handle of the image.
+ *  @param image_x   The X-coordinate of the on-image rectangle to
+ *  display.
+ *  @param image_y   The Y-coordinate of the on-image rectangle to
+ *  display.
+ *  @param screen_x  The X-coordinate on-screen to display the image at.
+ *  @param screen_y  The Y-coordinate on-screen to display the image at.
+ *  @param width     The width of the rectangle.
+ *  @param height    The height of the rectangle.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE otherwise (for
+ *           example, if the handle is no longer valid).
+ */
+
+int dm_draw_image_h(dm_ImageHandle handle,
+                    unsigned short image_x,
+                    unsigned short image_y,
+                    unsigned short screen_x,
+                    unsigned short screen_y,
+                    unsigned short width,
+                    unsigned short height);
+
+
 /** Fill a rectangle with the given RGB colour.
  *
  *  When working in 8-bit, the colour used for the fill will instead
  *  be that of the logical palette entry on average closest to the
  *  given colour.  To directly use a logical palette colour to fill, 
- *  use the function dm_fill_image_pal() instead.
+ *  use the function dm_fill_rect_pal() instead.
  *
  *  @param x  X co-ordinate of the top-left corner of the rectangle.
  *  @param y  X co-ordinate of the top-left corner of the rectangle.
@@ -273,18 +792,161 @@ void dm_fill_rect_rgb(unsigned short x,
                       unsigned char b);
 
 
+/** Fill a rectangle with the given logical palette entry.
+ *
+ *  When not working in 8-bit, this fills with the entry's colour, as
+ *  it is when the fill is made.
+ *
+ *  @param x      X co-ordinate of the top-left corner of the
+ *                rectangle.
+ *  @param y      Y co-ordinate of the top-left corner of the
+ *                rectangle.
+ *  @param w      Width of the rectangle.
+ *  @param h      Height of the rectangle.
+ *  @param index  Index of the palette entry to fill with.
+ */
+
+void dm_fill_rect_pal(unsigned short x,
+                      unsigned short y,
+                      unsigned short w,
+                      unsigned short h,
+                      unsigned char index);
+
+
 /** Perform a basic hash on an ASCII string.
  *
- *  This uses the algorithm documented in Kernighan and Pike's ``The
- *  Practice of Programming''.
+ *  This uses the 32-bit FNV-1a algorithm.
  *
  *  @param string  String to be hashed.
  *
- *  @return an integer hash of the string, guaranteed to be between 0
- *  and DM_GFX_HASH_VALS.
+ *  @return a 32-bit hash of the string.  The image hash table reduces
+ *  this to a slot index itself.
+ */
+
+unsigned long dm_ascii_hash(const char string[]);
+
+
+/** Pin an image in memory, or unpin it.
+ *
+ *  Pinned images are never evicted to stay within the image memory
+ *  budget (dm_Config's gfx_image_budget).  Use this for images, such
+ *  as fonts, which are drawn all the time and should never stall on
+ *  a reload.
+ *
+ *  @param handle  The handle of the image.
+ *  @param pinned  DM_TRUE to pin the image, DM_FALSE to unpin it.
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE if the handle is
+ *  invalid or a pinned image could not be reloaded.
+ */
+int dm_image_pin(dm_ImageHandle handle, int pinned);
+
+
+/** Change how an image is drawn.
+ *
+ *  Loaded images are reloaded, so that their data can be prepared
+ *  for the new mode from scratch; images still loading in the
+ *  background, or evicted, are prepared when they are next loaded.
+ *
+ *  Only colour keyed images are packed into atlas pages, so images
+ *  with other modes each keep their own data.
+ *
+ *  @param handle  The handle of the image.
+ *  @param blend   The blend mode (eg DM_BLEND_ALPHA).
+ *
+ *  @return DM_SUCCESS for success, DM_FAILURE if the handle or mode
+ *  is invalid, the image could not be reloaded, or the driver cannot
+ *  draw the mode (in which case the image is colour keyed).
+ */
+int dm_image_set_blend(dm_ImageHandle handle, int blend);
+
+
+/** Get the number of bytes of image data counted against the image
+ *  memory budget.
+ *
+ *  @return the number of bytes.
+ */
+unsigned long dm_image_memory(void);
+
+
+/** Finish loading an image whose data has just been loaded.
+ *
+ *  This enlarges the image if DM_GFX_LOWRES_IMAGES is set, records
+ *  the image's size, packs it into an atlas page if it
+ *  is small enough, marks it ready, and evicts other images if the
+ *  image memory budget is now exceeded.
+ *
+ *  This should NOT be called outside DISMAL.
+ *
+ *  @param node  The image node, with its data set.
+ */
+void dm_image_loaded(struct dm_GfxImageNode *node);
+
+
+/** Throw away an image's data, keeping its node and handle so that it
+ *  is reloaded when next drawn.
+ *
+ *  This should NOT be called outside DISMAL.
+ *
+ *  @param node  The image node, which must be ready.
+ */
+void dm_image_evict(struct dm_GfxImageNode *node);
+
+
+/** Find the image to draw in place of an image.
+ *
+ *  This reloads the image if it was evicted, and falls back to the
+ *  placeholder if it is still loading, then marks the result as
+ *  recently drawn.
+ *
+ *  This should NOT be called outside DISMAL.
+ *
+ *  @param node  The image node.
+ *
+ *  @return  the node to draw, or NULL if there is nothing to draw.
+ */
+struct dm_GfxImageNode *dm_image_drawable(struct dm_GfxImageNode *node);
+
+
+/** Draw part of an image, with coordinates already translated.
+ *
+ *  This is dm_draw_image_h() without the handle lookup, eviction
+ *  handling or coordinate translation, for drawing routines that do
+ *  these once for many draws.
+ *
+ *  This should NOT be called outside DISMAL.
+ *
+ *  @param img  An image node returned by dm_image_drawable().
+ *
+ *  @see dm_GfxDriver's draw_image, which takes the same parameters.
+ *
+ *  @return  DM_SUCCESS for success, DM_FAILURE otherwise.
  */
+int dm_draw_image_translated(struct dm_GfxImageNode *img,
+                             unsigned short image_x,
+                             unsigned short image_y,
+                             unsigned short screen_x,
+                             unsigned short screen_y,
+                             unsigned short width,
+                             unsigned short height);
 
-int dm_ascii_hash(const char string[]);
+
+/** Fill a rectangle, with coordinates already translated.
+ *
+ *  This is dm_fill_rect_rgb() without the coordinate translation.
+ *
+ *  This should NOT be called outside DISMAL.
+ *
+ *  @see dm_GfxDriver's fill_rect_rgb, which takes the same
+ *  parameters.
+ */
+void dm_fill_rect_translated(unsigned short x,
+                             unsigned short y,
+                             unsigned short w,
+                             unsigned short h,
+                             unsigned char r,
+                             unsigned char g,
+                             unsigned char b);
 
 
 /** Delete an image from the hash table.
@@ -304,7 +966,8 @@ void dm_clear_images(void);
  *
  *  If add_pointer is non-NULL, this function is changed into an
  *  addition operation, which will overwrite an existing image file of
- *  the same name.
+ *  the same name.  The name is copied into the image name pool, so
+ *  the caller need not keep it.
  *
  *  For convenience, two wrapper functions are provided,
  *  dm_find_image() and dm_load_image(), which call this function.  It
@@ -313,10 +976,11 @@ void dm_clear_images(void);
  *  @param name  The filename of the image, used to locate the file in
  *  the hash table.
  *
- *  @param add_pointer  Pointer to a dm_GfxImageNode to add to the
- *  hash table, overwriting any existing node.  If this is NULL, then
- *  the function will just attempt to find the given name without
- *  overwriting or adding.
+ *  @param add_pointer  Pointer to a malloc'd dm_GfxImageNode to add
+ *  to the hash table.  If a node of the same name already exists,
+ *  its data is replaced with add_pointer's and add_pointer itself is
+ *  freed.  If this is NULL, then the function will just attempt to
+ *  find the given name without overwriting or adding.
  *
  *  @return NULL if the given name cannot be found and add_pointer is
  *  NULL; a pointer to the installed node otherwise.
@@ -350,12 +1014,40 @@ dm_coord_translate (unsigned short *xp,
                     unsigned short *yp, 
                     unsigned short centre);
 
+/** Transform co-ordinates on the low-res logical screen to ones on
+ *  the real screen.
+ *
+ *  This is the same as dm_coord_translate, except with
+ *  DM_GFX_LOWRES_BUFFER, where drawing co-ordinates are left at
+ *  low-res but the screen is still enlarged, possibly by a fraction;
+ *  use it for anything compared with real screen positions, such as
+ *  the mouse.
+ *
+ *  Positions on the logical screen are looked up in the viewport's
+ *  tables.  Under a fractional scale, a width translated on its own
+ *  may be a pixel off the distance between its translated ends.
+ *
+ *  @param xp      Pointer to the X co-ordinate to change.
+ *  @param yp      Pointer to the Y co-ordinate to change.
+ *  @param centre  Whether or not to centre as part of the
+ *                 translation, as with dm_coord_translate.
+ */
+
+void
+dm_coord_translate_screen (unsigned short *xp,
+                           unsigned short *yp,
+                           unsigned short centre);
+
 /** Perform any co-ordinate transformation necessary.
  *
  *  Given an X co-ordinate and a Y co-ordinate by pointer, this will
  *  reverse the lowres->highres transformation to provide the
  *  coordinates normalised within the 320x200 "logical" screen.
  *
+ *  Positions are looked up in the viewport's inverse tables, so this
+ *  is exact whatever the scale; positions in the bars around the
+ *  logical screen give its nearest edge.
+ *
  *  This can also be used (ie with centre as DM_FALSE) to downscale 
  *  widths and heights.
  *
@@ -373,6 +1065,55 @@ void
 dm_coord_detranslate (unsigned short *xp, unsigned short *yp, 
                       unsigned short centre);
 
+/** Perform dm_coord_translate on many co-ordinates at once.
+ *
+ *  This takes 8 co-ordinates at a time where SSE2 is available.
+ *
+ *  @param xs      X co-ordinates to change, or NULL.
+ *  @param ys      Y co-ordinates to change, or NULL.
+ *  @param count   Number of co-ordinates in each array.
+ *  @param centre  Whether or not to centre, as with
+ *                 dm_coord_translate.
+ */
+
+void
+dm_coord_translate_array (unsigned short xs[],
+                          unsigned short ys[],
+                          unsigned long count,
+                          unsigned short centre);
+
+/** Perform dm_coord_translate_screen on many co-ordinates at once.
+ *
+ *  This takes 8 co-ordinates at a time where SSE2 is available.
+ *
+ *  @param xs      X co-ordinates to change, or NULL.
+ *  @param ys      Y co-ordinates to change, or NULL.
+ *  @param count   Number of co-ordinates in each array.
+ *  @param centre  Whether or not to centre, as with
+ *                 dm_coord_translate.
+ */
+
+void
+dm_coord_translate_screen_array (unsigned short xs[],
+                                 unsigned short ys[],
+                                 unsigned long count,
+                                 unsigned short centre);
+
+/** Perform dm_coord_detranslate on many co-ordinates at once.
+ *
+ *  @param xs      X co-ordinates to change, or NULL.
+ *  @param ys      Y co-ordinates to change, or NULL.
+ *  @param count   Number of co-ordinates in each array.
+ *  @param centre  Whether or not to de-centre, as with
+ *                 dm_coord_detranslate.
+ */
+
+void
+dm_coord_detranslate_array (unsigned short xs[],
+                            unsigned short ys[],
+                            unsigned long count,
+                            unsigned short centre);
+
 /** Remap the coordinates given to another reference point.
  *
  *  The coordinates given by pointer will be changed in-place.
@@ -407,4 +1148,16 @@ void
 dm_coord_map (unsigned short *xp, unsigned short *yp, 
               unsigned short refpoint);
 
+#include "dm-gfx-atlas.h"
+#include "dm-gfx-load.h"
+#include "dm-gfx-pack.h"
+#include "dm-gfx-viewport.h"
+#include "dm-gfx-sprite.h"
+#include "dm-gfx-tilemap.h"
+#include "dm-gfx-font.h"
+#include "dm-gfx-sheet.h"
+#include "dm-gfx-record.h"
+#include "dm-gfx-pattern.h"
+#include "dm-gfx-pipeline.h"
+
 #endif /* __DM_GFX_H__ */
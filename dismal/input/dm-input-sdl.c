@@ -8,6 +8,9 @@
 
 #include "dm-input-sdl.h"
 #include "../dismal.h"
+#include "../base/dm-base-sdl.h"
+
+static int dm_sdl_poll_events(SDL_Event sdlevents[], int max);
 
 int dm_input_sdl_init(struct dm_Config *conf)
 {
@@ -23,73 +26,95 @@ void dm_input_sdl_cleanup(void)
 
 void dm_input_sdl_process(void)
 {
-  SDL_Event sdlevent;
+  SDL_Event sdlevents[DM_INPUT_SDL_BATCH];
+  unsigned short xs[DM_INPUT_SDL_BATCH], ys[DM_INPUT_SDL_BATCH];
+  SDL_Event *sdlevent;
   union dm_InputEvent event;
+  int count, motions, i;
+
+  while ((count = dm_sdl_poll_events(sdlevents, DM_INPUT_SDL_BATCH)) > 0) {
+    /* Detranslate the positions of all the batch's mouse motion at
+       once. */
+    for (i = 0, motions = 0; i < count; i++) {
+      if (sdlevents[i].type == SDL_MOUSEMOTION) {
+        xs[motions] = sdlevents[i].motion.x;
+        ys[motions] = sdlevents[i].motion.y;
+        motions++;
+      }
+    }
 
-  while (SDL_PollEvent(&sdlevent)) {
-    /* Null out the event. */
-    event.type = 0;
+    dm_coord_detranslate_array(xs, ys, motions, DM_TRUE);
 
-    switch(sdlevent.type) {
-    case SDL_QUIT:
-      /* Quit event (eg window close attempted). */
-      event.type = DM_QUIT_EVENT;
-      break;
-    case SDL_MOUSEBUTTONDOWN:
-    case SDL_MOUSEBUTTONUP:
-      /* Mouse button events. */
-      if (sdlevent.button.button == SDL_BUTTON_LEFT) {
-        event.button.button = DM_LMB;
-      } else if (sdlevent.button.button == SDL_BUTTON_MIDDLE) {
-        event.button.button = DM_MMB;
-      } else {
-        /* This of course assumes SDL mice will only ever have 3 buttons. */
-        event.button.button = DM_RMB;
-      } 
-
-      if (sdlevent.type == SDL_MOUSEBUTTONDOWN) {
-        event.type = DM_MOUSE_BUTTON_DOWN_EVENT;
-      } else {
-        event.type = DM_MOUSE_BUTTON_UP_EVENT;
-      }
+    for (i = 0, motions = 0; i < count; i++) {
+      sdlevent = &sdlevents[i];
 
-      break;
-    case SDL_MOUSEMOTION:
-      /* Mouse motion events. */
-      dm_sdl_mouse_motion(&event, &sdlevent);
-      break;
-    case SDL_KEYDOWN:
-    case SDL_KEYUP:
-      /* Keyboard events. */
-      
-      /* Use SDL's unicode support to check for an ASCII key. (It works!) */
+      /* Null out the event. */
+      event.type = 0;
 
-      if (sdlevent.key.keysym.unicode < 0x80 && sdlevent.key.keysym.unicode > 0) {
-        /* ASCII key */
+      switch(sdlevent->type) {
+      case SDL_QUIT:
+        /* Quit event (eg window close attempted). */
+        event.type = DM_QUIT_EVENT;
+        break;
+      case SDL_MOUSEBUTTONDOWN:
+      case SDL_MOUSEBUTTONUP:
+        /* Mouse button events. */
+        if (sdlevent->button.button == SDL_BUTTON_LEFT) {
+          event.button.button = DM_LMB;
+        } else if (sdlevent->button.button == SDL_BUTTON_MIDDLE) {
+          event.button.button = DM_MMB;
+        } else {
+          /* This of course assumes SDL mice will only ever have 3 buttons. */
+          event.button.button = DM_RMB;
+        } 
 
-        if (sdlevent.key.type == SDL_KEYDOWN) { 
-          event.ascii.type = DM_ASCII_KEY_DOWN_EVENT;
+        if (sdlevent->type == SDL_MOUSEBUTTONDOWN) {
+          event.type = DM_MOUSE_BUTTON_DOWN_EVENT;
         } else {
-          event.ascii.type = DM_ASCII_KEY_UP_EVENT;
+          event.type = DM_MOUSE_BUTTON_UP_EVENT;
         }
 
-        dm_debug("eh, steve");
+        break;
+      case SDL_MOUSEMOTION:
+        /* Mouse motion events. */
+        dm_sdl_mouse_motion(&event, sdlevent, xs[motions], ys[motions]);
+        motions++;
+        break;
+      case SDL_KEYDOWN:
+      case SDL_KEYUP:
+        /* Keyboard events. */
+      
+        /* Use SDL's unicode support to check for an ASCII key. (It works!) */
+
+        if (sdlevent->key.keysym.unicode < 0x80
+            && sdlevent->key.keysym.unicode > 0) {
+          /* ASCII key */
 
-        event.ascii.code = (char) sdlevent.key.keysym.unicode;
-      }
+          if (sdlevent->key.type == SDL_KEYDOWN) { 
+            event.ascii.type = DM_ASCII_KEY_DOWN_EVENT;
+          } else {
+            event.ascii.type = DM_ASCII_KEY_UP_EVENT;
+          }
+
+          dm_debug("eh, steve");
+
+          event.ascii.code = (char) sdlevent->key.keysym.unicode;
+        }
         break;
-    default:
-      break;
-    }
+      default:
+        break;
+      }
 
-    /* If there was a proper event, release it to callbacks. */
-    if (event.type != 0) {
-      dm_input_event_release(&event);
+      /* If there was a proper event, release it to callbacks. */
+      if (event.type != 0) {
+        dm_input_event_release(&event);
+      }
     }
   }
 }
 
-void dm_sdl_mouse_motion(dm_InputEvent *event, SDL_Event *sdlevent)
+void dm_sdl_mouse_motion(dm_InputEvent *event, SDL_Event *sdlevent,
+                         unsigned short x, unsigned short y)
 {
   /* We need to check to see if the raw X and Y are within the
      translated screen boundaries. */
@@ -99,8 +124,8 @@ void dm_sdl_mouse_motion(dm_InputEvent *event, SDL_Event *sdlevent)
   right = DM_LOWRES_WIDTH;
   bottom = DM_LOWRES_HEIGHT;
 
-  dm_coord_translate(&left, &top, DM_TRUE);
-  dm_coord_translate(&right, &bottom, DM_TRUE);
+  dm_coord_translate_screen(&left, &top, DM_TRUE);
+  dm_coord_translate_screen(&right, &bottom, DM_TRUE);
 
   if (sdlevent->motion.x >= left && 
       sdlevent->motion.x < right &&
@@ -108,16 +133,29 @@ void dm_sdl_mouse_motion(dm_InputEvent *event, SDL_Event *sdlevent)
       sdlevent->motion.y < bottom) {
 
     event->motion.type = DM_MOUSE_MOTION_EVENT;
-    event->motion.xraw = event->motion.x = sdlevent->motion.x;
-    event->motion.yraw = event->motion.y = sdlevent->motion.y;
+    event->motion.xraw = sdlevent->motion.x;
+    event->motion.yraw = sdlevent->motion.y;
+    event->motion.x = x;
+    event->motion.y = y;
     event->motion.deltax = sdlevent->motion.xrel;
     event->motion.deltay = sdlevent->motion.yrel;
-
-    /* We now need to detranslate to normalise the X and Y 
-       to the logical screen coordinates. */
-
-    dm_coord_detranslate(&(event->motion.x), &(event->motion.y), 
-                         DM_TRUE);
     dm_debug("%u %u", event->motion.x, event->motion.y);
   }
 }
+
+/* Poll for up to max events, keeping clear of any render thread
+   presenting at the same time. */
+static int dm_sdl_poll_events(SDL_Event sdlevents[], int max)
+{
+  int polled;
+
+  dm_base_sdl_video_lock();
+
+  for (polled = 0; polled < max; polled++)
+    if (!SDL_PollEvent(&sdlevents[polled]))
+      break;
+
+  dm_base_sdl_video_unlock();
+
+  return polled;
+}
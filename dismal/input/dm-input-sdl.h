@@ -30,6 +30,11 @@
 #include "SDL/SDL.h"
 #include "../dismal.h"
 
+enum {
+  DM_INPUT_SDL_BATCH = 32 /**< Most SDL events taken from the queue at
+                             once. */
+};
+
 /** Initialise the compiled input module.
  *
  *  This will initialise the internal 
@@ -56,10 +61,16 @@ void dm_input_sdl_cleanup(void);
 void dm_input_sdl_process(void);
 
 /** Handle a SDL mouse motion event.
+ *
+ *  The event's position is detranslated by the caller, so that a
+ *  whole batch of events can be detranslated at once.
  *
  *  @param event     Event union to populate with information.
  *  @param sdlevent  SDL event to extract motion data from.
+ *  @param x         The event's X co-ordinate, detranslated.
+ *  @param y         The event's Y co-ordinate, detranslated.
  */
-void dm_sdl_mouse_motion(dm_InputEvent *event, SDL_Event *sdlevent);
+void dm_sdl_mouse_motion(dm_InputEvent *event, SDL_Event *sdlevent,
+                         unsigned short x, unsigned short y);
 
 #endif /* __DM_INPUT_SDL_H__ */
@@ -0,0 +1,410 @@
+/** @file     tools/dm-pack.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Offline packer for DISMAL asset packs.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+/* Usage: dm-pack [-d depth] [-c symbol] -o pack file...
+
+   Each file is decoded and converted to the given screen depth (16 or
+   32; 32 by default), then written to the pack under the name it was
+   given on the command line, which is the name the game should load
+   it by.  Images with any pixel that is not fully opaque are kept as
+   32-bit ARGB, so their alpha survives; others are colour keyed on
+   magenta, as DISMAL's SDL driver does for images loaded from files.
+
+   With -c, the pack is instead written as C source defining a
+   read-only array holding the pack, named by symbol, and its size, as
+   symbol_size; DISMAL's Makefile uses this to embed assets in the
+   executable (see DM_EMBED_ASSETS).
+
+   @see gfx/dm-gfx-pack.h for the pack layout. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL/SDL.h"
+#include "SDL/SDL_image.h"
+
+#include "dismal/dismal.h"
+#include "dismal/gfx/dm-gfx.h"
+
+typedef struct dm_PackImage dm_PackImage;
+
+/** An image being packed. */
+struct dm_PackImage
+{
+  const char *name;     /**< Name of the image (its filename). */
+  unsigned long hash;   /**< Hash of the name. */
+  SDL_Surface *surf;    /**< The converted image. */
+  unsigned long keyed;  /**< Non-zero if the colour key is used. */
+  unsigned long key;    /**< Colour key pixel value. */
+  unsigned long pitch;  /**< Pitch of the image in the pack. */
+  unsigned long name_offset; /**< Offset of the name in the table. */
+  unsigned long data_offset; /**< Offset of the pixels in the pack. */
+};
+
+static unsigned long hash_name (const char string[]);
+static int has_transparency (SDL_Surface *surf);
+static int convert_image (dm_PackImage *image, const char filename[],
+                          int depth);
+static int compare_images (const void *a, const void *b);
+static void put_u32 (FILE *out, unsigned long value);
+static void put_padding (FILE *out, unsigned long count);
+static int write_pack (FILE *out, dm_PackImage *images, int count);
+static int write_source (FILE *pack, FILE *out, const char symbol[]);
+
+int
+main (int argc, char **argv)
+{
+  dm_PackImage *images;
+  const char *output, *symbol;
+  FILE *out, *source;
+  int depth, count, i, result;
+
+  depth = 32;
+  output = symbol = NULL;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+      if (strcmp (argv[i], "-d") == 0 && i + 1 < argc)
+        depth = atoi (argv[++i]);
+      else if (strcmp (argv[i], "-o") == 0 && i + 1 < argc)
+        output = argv[++i];
+      else if (strcmp (argv[i], "-c") == 0 && i + 1 < argc)
+        symbol = argv[++i];
+      else
+        break;
+    }
+
+  if (output == NULL || i == argc || (depth != 16 && depth != 32))
+    {
+      fprintf (stderr, "usage: %s [-d 16|32] [-c symbol] -o pack file...\n",
+               argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  count = argc - i;
+  images = calloc (count, sizeof (dm_PackImage));
+
+  if (images == NULL)
+    {
+      fprintf (stderr, "%s: out of memory\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  result = EXIT_SUCCESS;
+
+  for (count = 0; i < argc; i++, count++)
+    {
+      if (convert_image (&images[count], argv[i], depth) == DM_FAILURE)
+        {
+          result = EXIT_FAILURE;
+          break;
+        }
+    }
+
+  if (result == EXIT_SUCCESS)
+    {
+      /* The runtime binary-searches the index by hash. */
+      qsort (images, count, sizeof (dm_PackImage), compare_images);
+
+      /* Source output goes through a binary pack first. */
+      out = symbol ? tmpfile () : fopen (output, "wb");
+      source = NULL;
+
+      if (out == NULL || write_pack (out, images, count) == DM_FAILURE)
+        result = EXIT_FAILURE;
+      else if (symbol)
+        {
+          source = fopen (output, "w");
+
+          if (source == NULL
+              || write_source (out, source, symbol) == DM_FAILURE)
+            result = EXIT_FAILURE;
+        }
+
+      if (out && fclose (out) != 0)
+        result = EXIT_FAILURE;
+
+      if (source && fclose (source) != 0)
+        result = EXIT_FAILURE;
+
+      if (result == EXIT_FAILURE)
+        fprintf (stderr, "%s: could not write %s\n", argv[0], output);
+    }
+
+  for (i = 0; i < count; i++)
+    SDL_FreeSurface (images[i].surf);
+
+  free (images);
+  return result;
+}
+
+/* Hash a name exactly as dm_ascii_hash() does. */
+static unsigned long
+hash_name (const char string[])
+{
+  unsigned long hash;
+  const unsigned char *p;
+
+  hash = DM_GFX_HASH_BASIS;
+
+  for (p = (const unsigned char*) string; *p != '\0'; p++)
+    hash = ((hash ^ *p) * DM_GFX_HASH_PRIME) & 0xFFFFFFFFUL;
+
+  return hash;
+}
+
+/* Check whether a 32-bit surface has any pixel that is not fully
+   opaque.  Fully transparent pixels count too, as the keyed format
+   has no alpha to keep them transparent with. */
+static int
+has_transparency (SDL_Surface *surf)
+{
+  Uint32 *row;
+  Uint32 alpha;
+  int x, y, transparent;
+
+  if (surf->format->Amask == 0)
+    return DM_FALSE;
+
+  transparent = DM_FALSE;
+  SDL_LockSurface (surf);
+
+  for (y = 0; y < surf->h && !transparent; y++)
+    {
+      row = (Uint32*) ((Uint8*) surf->pixels + y * surf->pitch);
+
+      for (x = 0; x < surf->w; x++)
+        {
+          alpha = row[x] & surf->format->Amask;
+
+          if (alpha != surf->format->Amask)
+            transparent = DM_TRUE;
+        }
+    }
+
+  SDL_UnlockSurface (surf);
+
+  return transparent;
+}
+
+/* Load an image and convert it to the pack's pixel format. */
+static int
+convert_image (dm_PackImage *image, const char filename[], int depth)
+{
+  SDL_Surface *src, *fmt;
+
+  src = IMG_Load (filename);
+
+  if (src == NULL)
+    {
+      fprintf (stderr, "dm-pack: could not load %s: %s\n", filename,
+               SDL_GetError ());
+      return DM_FAILURE;
+    }
+
+  /* Build a throwaway surface just for its pixel format. */
+  if (src->format->BitsPerPixel == 32 && has_transparency (src))
+    fmt = SDL_CreateRGBSurface (SDL_SWSURFACE, 1, 1, 32, 0x00FF0000,
+                                0x0000FF00, 0x000000FF, 0xFF000000);
+  else if (depth == 32)
+    fmt = SDL_CreateRGBSurface (SDL_SWSURFACE, 1, 1, 32, 0x00FF0000,
+                                0x0000FF00, 0x000000FF, 0);
+  else
+    fmt = SDL_CreateRGBSurface (SDL_SWSURFACE, 1, 1, 16, 0xF800,
+                                0x07E0, 0x001F, 0);
+
+  image->surf = fmt ? SDL_ConvertSurface (src, fmt->format, SDL_SWSURFACE)
+                    : NULL;
+
+  SDL_FreeSurface (src);
+
+  if (image->surf == NULL)
+    {
+      fprintf (stderr, "dm-pack: could not convert %s\n", filename);
+      if (fmt)
+        SDL_FreeSurface (fmt);
+      return DM_FAILURE;
+    }
+
+  image->keyed = (fmt->format->Amask == 0);
+  image->key = image->keyed ? SDL_MapRGB (fmt->format, 255, 0, 255) : 0;
+  SDL_FreeSurface (fmt);
+
+  image->name = filename;
+  image->hash = hash_name (filename);
+  image->pitch = (image->surf->w * image->surf->format->BytesPerPixel
+                  + 3) & ~3UL;
+
+  return DM_SUCCESS;
+}
+
+static int
+compare_images (const void *a, const void *b)
+{
+  unsigned long ha, hb;
+
+  ha = ((const dm_PackImage*) a)->hash;
+  hb = ((const dm_PackImage*) b)->hash;
+
+  return (ha > hb) - (ha < hb);
+}
+
+/* Write a little-endian 32-bit value. */
+static void
+put_u32 (FILE *out, unsigned long value)
+{
+  putc ((int) (value & 0xFF), out);
+  putc ((int) ((value >> 8) & 0xFF), out);
+  putc ((int) ((value >> 16) & 0xFF), out);
+  putc ((int) ((value >> 24) & 0xFF), out);
+}
+
+static void
+put_padding (FILE *out, unsigned long count)
+{
+  for (; count > 0; count--)
+    putc (0, out);
+}
+
+static int
+write_pack (FILE *out, dm_PackImage *images, int count)
+{
+  SDL_PixelFormat *f;
+  unsigned long names, offset, row_bytes;
+  unsigned int one;
+  int i, y;
+
+  /* Lay out the names, then the pixels after them. */
+  names = DM_PACK_HEADER_SIZE + (unsigned long) count * DM_PACK_ENTRY_SIZE;
+  offset = 0;
+
+  for (i = 0; i < count; i++)
+    {
+      images[i].name_offset = offset;
+      offset += strlen (images[i].name) + 1;
+    }
+
+  offset += names;
+
+  for (i = 0; i < count; i++)
+    {
+      offset = (offset + DM_PACK_ALIGN - 1) & ~(DM_PACK_ALIGN - 1UL);
+      images[i].data_offset = offset;
+      offset += images[i].pitch * images[i].surf->h;
+    }
+
+  one = 1;
+
+  fwrite (DM_PACK_MAGIC, 1, 4, out);
+  put_u32 (out, DM_PACK_VERSION);
+  put_u32 (out, (*((unsigned char*) &one) == 1) ? DM_PACK_LITTLE_ENDIAN
+                                                : DM_PACK_BIG_ENDIAN);
+  put_u32 (out, count);
+  put_u32 (out, names);
+
+  for (i = 0; i < count; i++)
+    {
+      f = images[i].surf->format;
+
+      put_u32 (out, images[i].hash);
+      put_u32 (out, images[i].name_offset);
+      put_u32 (out, images[i].surf->w);
+      put_u32 (out, images[i].surf->h);
+      put_u32 (out, images[i].pitch);
+      put_u32 (out, images[i].data_offset);
+      put_u32 (out, f->BitsPerPixel);
+      put_u32 (out, f->Rmask);
+      put_u32 (out, f->Gmask);
+      put_u32 (out, f->Bmask);
+      put_u32 (out, f->Amask);
+      put_u32 (out, images[i].keyed ? DM_PACK_KEYED : 0);
+      put_u32 (out, images[i].key);
+    }
+
+  offset = names;
+
+  for (i = 0; i < count; i++)
+    {
+      fwrite (images[i].name, 1, strlen (images[i].name) + 1, out);
+      offset += strlen (images[i].name) + 1;
+    }
+
+  /* Pixels are written in this machine's byte order, as recorded in
+     the header. */
+  for (i = 0; i < count; i++)
+    {
+      put_padding (out, images[i].data_offset - offset);
+      offset = images[i].data_offset;
+
+      row_bytes = images[i].surf->w * images[i].surf->format->BytesPerPixel;
+      SDL_LockSurface (images[i].surf);
+
+      for (y = 0; y < images[i].surf->h; y++)
+        {
+          fwrite ((Uint8*) images[i].surf->pixels
+                  + y * images[i].surf->pitch, 1, row_bytes, out);
+          put_padding (out, images[i].pitch - row_bytes);
+        }
+
+      SDL_UnlockSurface (images[i].surf);
+      offset += images[i].pitch * images[i].surf->h;
+    }
+
+  return ferror (out) ? DM_FAILURE : DM_SUCCESS;
+}
+
+/* Write a binary pack out as C source. */
+static int
+write_source (FILE *pack, FILE *out, const char symbol[])
+{
+  unsigned long size;
+  int c;
+
+  fflush (pack);
+  size = (unsigned long) ftell (pack);
+  rewind (pack);
+
+  fprintf (out, "/* Generated by dm-pack.  Do not edit. */\n\n");
+
+  /* The union keeps the pixel data suitably aligned for reading whole
+     pixels, which an array of bytes alone would not guarantee. */
+  fprintf (out, "static const union\n{\n");
+  fprintf (out, "  unsigned char bytes[%lu];\n", size);
+  fprintf (out, "  unsigned long align;\n");
+  fprintf (out, "} %s_data = {{", symbol);
+
+  for (size = 0; (c = getc (pack)) != EOF; size++)
+    fprintf (out, "%s0x%02x,", (size % 12) ? " " : "\n  ", c);
+
+  fprintf (out, "\n}};\n\n");
+  fprintf (out, "const unsigned char *const %s = %s_data.bytes;\n",
+           symbol, symbol);
+  fprintf (out, "const unsigned long %s_size = %luUL;\n", symbol, size);
+
+  return (ferror (pack) || ferror (out)) ? DM_FAILURE : DM_SUCCESS;
+}
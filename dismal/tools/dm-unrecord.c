@@ -0,0 +1,287 @@
+/** @file     tools/dm-unrecord.c
+ *  @author   Matt Windsor (captainhayashi)
+ *  @version  0.001
+ *  @brief    Decoder for DISMAL frame recordings.
+ */
+
+/**************************************************************************
+ *                                                                        *
+ *  Copyright 2010       CaptainHayashi etc.                              *
+ *                                                                        *
+ *  This file is part of DISMAL.                                          *
+ *                                                                        *
+ *  DISMAL is free software: you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *                                                                        *
+ *  DISMAL is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with DISMAL.  If not, see <http://www.gnu.org/licenses/>.       *
+ *                                                                        *
+ **************************************************************************/
+
+/* Usage: dm-unrecord [-o pattern] recording
+
+   Reads a recording made with dm_record_start, reporting how many
+   frames it holds and how many were dropped while recording.  With
+   -o, every frame is also written as a PPM image, to the file named
+   by pattern, a printf format given the frame number (such as
+   "frame%06lu.ppm"), which must have exactly one %lu conversion with
+   at most a two-digit width.  Dropped frames are not written, so
+   their numbers are missing from the images.
+
+   Frames dropped at the end of the recording are counted from its
+   trailer; if it has none (because writing failed, or recording was
+   never stopped), only the gaps between the frames written are.
+
+   @see gfx/dm-gfx-record.h for the recording layout. */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dismal/dismal.h"
+#include "dismal/gfx/dm-gfx.h"
+
+static unsigned long get_u16 (const unsigned char *in);
+static unsigned long get_u32 (const unsigned char *in);
+static int read_rect (FILE *in, unsigned char *picture,
+                      unsigned long width, unsigned long height);
+static int write_ppm (const char filename[], const unsigned char *picture,
+                      unsigned long width, unsigned long height);
+
+int
+main (int argc, char **argv)
+{
+  const char *pattern;
+  FILE *in;
+  unsigned char header[DM_RECORD_HEADER_SIZE];
+  unsigned char *picture;
+  char filename[FILENAME_MAX];
+  unsigned long width, height, number, expected, count, frames, dropped;
+  unsigned long time, i;
+  int result, i_arg, ended;
+
+  pattern = NULL;
+
+  for (i_arg = 1; i_arg < argc && argv[i_arg][0] == '-'; i_arg++)
+    {
+      if (strcmp (argv[i_arg], "-o") == 0 && i_arg + 1 < argc)
+        pattern = argv[++i_arg];
+      else
+        break;
+    }
+
+  if (i_arg + 1 != argc)
+    {
+      fprintf (stderr, "usage: %s [-o pattern] recording\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  if (pattern && dm_check_frame_pattern (pattern, FILENAME_MAX) == DM_FAILURE)
+    {
+      fprintf (stderr, "%s: %s is too long, or not a single %%lu of "
+               "at most two digits' width\n", argv[0], pattern);
+      return EXIT_FAILURE;
+    }
+
+  in = fopen (argv[i_arg], "rb");
+
+  /* The recorder's frames are never bigger than 16-bit sizes, which
+     also keeps the picture's size from overflowing. */
+  if (in == NULL
+      || fread (header, DM_RECORD_HEADER_SIZE, 1, in) != 1
+      || memcmp (header, DM_RECORD_MAGIC, 4) != 0
+      || get_u32 (header + 4) != DM_RECORD_VERSION
+      || get_u32 (header + 8) == 0 || get_u32 (header + 8) > 0xFFFF
+      || get_u32 (header + 12) == 0 || get_u32 (header + 12) > 0xFFFF)
+    {
+      fprintf (stderr, "%s: %s is not a recording\n", argv[0],
+               argv[i_arg]);
+      if (in)
+        fclose (in);
+      return EXIT_FAILURE;
+    }
+
+  width = get_u32 (header + 8);
+  height = get_u32 (header + 12);
+
+  /* The picture starts black.  Even 16-bit sizes can overflow its
+     size where unsigned long is 32-bit. */
+  picture = NULL;
+
+  if (height <= (ULONG_MAX - 1) / 3 / width)
+    picture = calloc (width * height * 3 + 1, 1);
+
+  if (picture == NULL)
+    {
+      fprintf (stderr, "%s: out of memory\n", argv[0]);
+      fclose (in);
+      return EXIT_FAILURE;
+    }
+
+  result = EXIT_SUCCESS;
+  frames = dropped = expected = time = 0;
+  ended = DM_FALSE;
+
+  while (fread (header, DM_RECORD_FRAME_SIZE, 1, in) == 1)
+    {
+      number = get_u32 (header);
+      time = get_u32 (header + 4);
+      count = get_u32 (header + 8);
+
+      /* The trailer holds the number of frames presented, so any
+         past the last one written were dropped. */
+      if (number == DM_RECORD_END)
+        {
+          if (time < expected)
+            {
+              fprintf (stderr, "%s: trailer is corrupt\n", argv[0]);
+              result = EXIT_FAILURE;
+              break;
+            }
+
+          dropped += time - expected;
+          time = count;
+          ended = DM_TRUE;
+          break;
+        }
+
+      if (number < expected)
+        {
+          fprintf (stderr, "%s: frame %lu out of order\n", argv[0],
+                   number);
+          result = EXIT_FAILURE;
+          break;
+        }
+
+      /* Gaps in the numbering are frames dropped while recording. */
+      dropped += number - expected;
+      expected = number + 1;
+
+      for (i = 0; i < count && result == EXIT_SUCCESS; i++)
+        if (read_rect (in, picture, width, height) == DM_FAILURE)
+          {
+            fprintf (stderr, "%s: frame %lu is corrupt\n", argv[0],
+                     number);
+            result = EXIT_FAILURE;
+          }
+
+      if (result == EXIT_FAILURE)
+        break;
+
+      frames++;
+
+      if (pattern)
+        {
+          sprintf (filename, pattern, number);
+
+          if (write_ppm (filename, picture, width, height) == DM_FAILURE)
+            {
+              fprintf (stderr, "%s: could not write %s\n", argv[0],
+                       filename);
+              result = EXIT_FAILURE;
+              break;
+            }
+        }
+    }
+
+  printf ("%lux%lu, %lu frames over %lu.%03lu s, %lu dropped%s\n",
+          width, height, frames, time / 1000000, time / 1000 % 1000,
+          dropped, ended ? "" : " (no trailer, so not counting any "
+          "dropped at the end)");
+
+  free (picture);
+  fclose (in);
+  return result;
+}
+
+static unsigned long
+get_u16 (const unsigned char *in)
+{
+  return (unsigned long) in[0] | ((unsigned long) in[1] << 8);
+}
+
+static unsigned long
+get_u32 (const unsigned char *in)
+{
+  return get_u16 (in) | (get_u16 (in + 2) << 16);
+}
+
+/* Read a rectangle and its runs, applying them to the picture. */
+static int
+read_rect (FILE *in, unsigned char *picture,
+           unsigned long width, unsigned long height)
+{
+  unsigned char header[DM_RECORD_RECT_SIZE], counts[DM_RECORD_RUN_SIZE];
+  unsigned long x, y, w, h, size, pos, end, same, changed, px;
+
+  if (fread (header, DM_RECORD_RECT_SIZE, 1, in) != 1)
+    return DM_FAILURE;
+
+  x = get_u16 (header);
+  y = get_u16 (header + 2);
+  w = get_u16 (header + 4);
+  h = get_u16 (header + 6);
+  size = get_u32 (header + 8);
+
+  if (x + w > width || y + h > height)
+    return DM_FAILURE;
+
+  /* pos counts the rectangle's pixels, row by row. */
+  end = w * h;
+
+  for (pos = 0; pos < end; )
+    {
+      if (size < DM_RECORD_RUN_SIZE
+          || fread (counts, DM_RECORD_RUN_SIZE, 1, in) != 1)
+        return DM_FAILURE;
+
+      size -= DM_RECORD_RUN_SIZE;
+      same = get_u16 (counts);
+      changed = get_u16 (counts + 2);
+
+      if (pos + same + changed > end || changed * 3 > size)
+        return DM_FAILURE;
+
+      pos += same;
+      size -= changed * 3;
+
+      for (; changed > 0; changed--, pos++)
+        {
+          px = ((y + pos / w) * width + x + pos % w) * 3;
+
+          if (fread (picture + px, 3, 1, in) != 1)
+            return DM_FAILURE;
+        }
+    }
+
+  return (size == 0 ? DM_SUCCESS : DM_FAILURE);
+}
+
+static int
+write_ppm (const char filename[], const unsigned char *picture,
+           unsigned long width, unsigned long height)
+{
+  FILE *out;
+  int ok;
+
+  out = fopen (filename, "wb");
+
+  if (out == NULL)
+    return DM_FAILURE;
+
+  ok = (fprintf (out, "P6\n%lu %lu\n255\n", width, height) > 0
+        && fwrite (picture, 3, width * height, out) == width * height);
+
+  if (fclose (out) != 0 || !ok)
+    return DM_FAILURE;
+
+  return DM_SUCCESS;
+}
@@ -36,9 +36,31 @@
 int
 init_screen (struct AppCore *core)
 {
-  if (dm_load_image (FONT_PATH))
+  core->gfx = malloc (sizeof (struct Gfx));
+
+  if (core->gfx == NULL)
+    {
+      fprintf (stderr, "Could not allocate memory for graphics.\n");
+      return FALSE;
+    }
+
+  core->gfx->tiles = NULL;
+  core->gfx->font = NULL;
+
+  core->gfx->images[ISL_FONT] = dm_image_acquire (FONT_PATH);
+
+  if (core->gfx->images[ISL_FONT] != DM_IMAGE_NONE)
     {
-      if (dm_load_image (TILES_PATH))
+      /* Text is drawn every frame, so never let the font be evicted. */
+      dm_image_pin (core->gfx->images[ISL_FONT], TRUE);
+
+      core->gfx->font = dm_font_create (core->gfx->images[ISL_FONT],
+                                        FONT_W, FONT_H, FONT_COLS);
+
+      core->gfx->images[ISL_TILES] = dm_image_acquire (TILES_PATH);
+
+      if (core->gfx->images[ISL_TILES] != DM_IMAGE_NONE
+          && core->gfx->font != NULL)
         return TRUE;
       else
         {
@@ -49,9 +71,23 @@ init_screen (struct AppCore *core)
   else
     fprintf (stderr, "Error loading %s.\n", FONT_PATH); 
 
+  cleanup_screen (core);
   return FALSE;
 }
 
+void
+cleanup_screen (struct AppCore *core)
+{
+  if (core->gfx)
+    {
+      dm_tilemap_destroy (core->gfx->tiles);
+      dm_font_destroy (core->gfx->font);
+      free (core->gfx);
+    }
+
+  core->gfx = NULL;
+}
+
 void
 update_screen (struct AppCore *core)
 {
@@ -66,7 +102,7 @@ update_scores (struct AppCore *core)
 {
   char buf[256];
 
-  dm_fill_rect_rgb (0, 0, 200, 200, 0, 0, 0);
+  dm_fill_rect_rgb (0, 0, SCORES_W, SCORES_H, 0, 0, 0);
 
   sprintf (buf, "Score: %u", core->score);
   write_str (core, SCORE_X, SCORE_Y, 0, ALIGN_LEFT, buf);
@@ -85,6 +121,22 @@ void update_tiles(struct AppCore *core)
 
   dm_coord_map (&core->grid_x, &core->grid_y, DM_CENTRE);
 
+  /* Create the grid's tilemap the first time round.  The tileset is
+     one row of tiles, with their highlighted versions beneath. */
+  if (core->gfx->tiles == NULL)
+    {
+      core->gfx->tiles = dm_tilemap_create (core->gfx->images[ISL_TILES],
+                                            TILE_TYPES, TILE_W, TILE_H,
+                                            core->grid_w, core->grid_h);
+
+      if (core->gfx->tiles == NULL)
+        return;
+
+      dm_tilemap_set_highlight (core->gfx->tiles, 0, TILE_H);
+    }
+
+  dm_tilemap_set_position (core->gfx->tiles, core->grid_x, core->grid_y);
+
   for (i = 0; i < (core->grid_w * core->grid_h); i++)
     {
       /* Determine row and column. */
@@ -95,6 +147,8 @@ void update_tiles(struct AppCore *core)
       type = core->grid[i];
       draw_tile (core, row, col, type, core->gridmask[i]);
     }
+
+  dm_tilemap_draw (core->gfx->tiles);
 }
 
 void
@@ -105,55 +159,13 @@ write_str (struct AppCore *core,
            unsigned char alignment,
            const char *string)
 {
-  char chr;
-  unsigned int i, x1, slength, length, midpoint;
- 
-  slength = strlen (string);
-  length = FONT_W * slength;
-  
-  /* Set up alignment */
-  switch (alignment)
-    {
-    case ALIGN_LEFT:
-      x1 = x;
-      break;
-    case ALIGN_RIGHT:
-      x1 = box_width - slength;
-      break;
-    case ALIGN_CENTRE:   
-      midpoint = x + (box_width / 2);
-      x1 = midpoint - (length / 2);
-      break;
-    }
-
-  /* Draw each character using the font image. */
-  for (i = 0; i < strlen (string); i++)
-    {
-      chr = string[i];
-      dm_draw_image ("font.png", 
-                     (chr % 16) * FONT_W, 
-                     ((chr - (chr % 16))/16) * FONT_H, 
-                     x1, y, FONT_W, FONT_H);
-
-      x1 += FONT_W;
-    }  
+  dm_draw_text (core->gfx->font, x, y, box_width, alignment, string);
 }
 
 void
 draw_tile (struct AppCore *core, int row, int col, int type, int highlight)
 {
-  int offset;
-
-  /* Use the offset to retrieve the second line of tile images if a 
-     highlight is needed. */
-
-  if (highlight)
-    offset = TILE_H;
-  else
-    offset = 0;
-
-  dm_draw_image ("tiles.png",
-                 type * TILE_W, offset,
-                 (col * TILE_W) + core->grid_x, (row * TILE_H) + core->grid_y,
-                 TILE_W, TILE_H);
+  dm_tilemap_set_cell (core->gfx->tiles, col, row, type);
+  dm_tilemap_set_flags (core->gfx->tiles, col, row,
+                        highlight ? DM_TILE_HIGHLIGHT : 0);
 }
@@ -46,15 +46,20 @@ enum
     PSCORE_X = 16, /**< X offset of potential score. */
     PSCORE_Y = 32, /**< X offset of potential score. */
 
+    SCORES_W = 100, /**< Width of the area cleared behind the scores. */
+    SCORES_H = 48,  /**< Height of the area cleared behind the scores. */
+
     TILE_W = 8, /**< Untranslated width of one tile. */
     TILE_H = 8, /**< Untranslated height of one tile. */
 
     FONT_W = 5, /**< Untranslated width of one font character. */
     FONT_H = 5, /**< Untranslated height of one font character. */
 
-    ALIGN_LEFT = 0, /**< Left alignment for text. */
-    ALIGN_CENTRE,   /**< Centre alignment for text. */
-    ALIGN_RIGHT,    /**< Right alignment for text. */
+    ALIGN_LEFT   = DM_ALIGN_LEFT,   /**< Left alignment for text. */
+    ALIGN_CENTRE = DM_ALIGN_CENTRE, /**< Centre alignment for text. */
+    ALIGN_RIGHT  = DM_ALIGN_RIGHT,  /**< Right alignment for text. */
+
+    FONT_COLS = 16, /**< Number of characters in each row of the font. */
 
     RGB_ELEMENTS = 3, /**< Number of elements in an RGB triplet. */
     R = 0, /**< Red element. */
@@ -69,9 +74,9 @@ enum
 
 struct Gfx
 {
-  struct SDL_Surface *screen; /**< The SDL screen used for
-                                 graphics. */
-  struct SDL_Surface *images[IMAGE_SLOTS]; /**< Image slots. */
+  dm_ImageHandle images[IMAGE_SLOTS]; /**< Image slots. */
+  dm_Tilemap *tiles; /**< Tilemap of the grid, or NULL. */
+  dm_Font *font;     /**< Font for text, or NULL. */
 };
 
 /** Initialise the screen.
@@ -84,11 +89,10 @@ struct Gfx
 int
 init_screen (struct AppCore *core);
 
-/** De-initialise the screen (stub).
+/** De-initialise the screen.
  *
- *  Since SDL_Quit deletes the screen surface, this function is
- *  actually a no-operation and is reserved for if special screen
- *  cleanup operations are required in the future.
+ *  This frees the image slot structure; the images themselves are
+ *  freed by DISMAL on cleanup.
  *
  *  @param core  Pointer to the application core structure.
  */
@@ -217,8 +221,9 @@ write_str (struct AppCore *core,
 
 /** Draw a single tile.
  *
- *  This draws a tile of the given type in the given row and column on
- *  the graphical grid.
+ *  This sets the tile in the given row and column of the grid's
+ *  tilemap to the given type; DISMAL only redraws it if it has
+ *  changed.
  *
  *  If highlight is TRUE, a lighter version of the tile will be
  *  drawn. This is used to signify selection.
@@ -57,6 +57,10 @@ main (int argc, char **argv)
 
       dm_set_resolution (X_RES, Y_RES);
 
+      /* Allow the graphics driver to be chosen, eg "sdl-opengl". */
+      if (argc > 1)
+        dm_set_gfx_driver (argv[1]);
+
       /* Init DISMAL, the Display/Image/Sound Meta-Abstraction Layer. */
       if (dm_init () == DM_SUCCESS)
         {
@@ -76,6 +80,8 @@ main (int argc, char **argv)
                 }
               else
                 fprintf (stderr, "Could not initialise game grid.\n");
+
+              cleanup_screen (_core);
             }
           else
             fprintf (stderr, "Could not initialise screen.\n");